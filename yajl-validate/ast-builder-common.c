@@ -14,9 +14,10 @@
 
 #include <regex.h>
 #include <yajl/yajl_tree.h>
-#include <yajl/yajl_parse.h>
 
 #include "ast-builder.h"
+#include "stats.h"
+#include "emit.h"
 
 
 /* Compiler a regular expression or output an error to stderr in
@@ -62,191 +63,451 @@ match_regexp (enum tree_regexps r, const char *txt)
 }
 
 
+__thread FILE *  ab_diag_stream = NULL;
+
+
 void
 ab_err (const char *format, ...)
 {
+  FILE *  out = ab_diag_stream ? ab_diag_stream : stderr;
   va_list args;
 
-  fprintf (stderr, "ast-builder error: ");
+  fprintf (out, "ast-builder error: ");
   va_start (args, format);
-  vfprintf (stderr, format, args);
+  vfprintf (out, format, args);
   va_end (args);
-  fprintf (stderr, "\n");
-  fflush (stderr);
+  fprintf (out, "\n");
+  fflush (out);
 }
 
 void
 ab_warn (const char *format, ...)
 {
+  FILE *  out = ab_diag_stream ? ab_diag_stream : stderr;
   va_list args;
 
-  fprintf (stderr, "ast-builder warning: ");
+  fprintf (out, "ast-builder warning: ");
   va_start (args, format);
-  vfprintf (stderr, format, args);
+  vfprintf (out, format, args);
   va_end (args);
-  fprintf (stderr, "\n");
-  fflush (stderr);
+  fprintf (out, "\n");
+  fflush (out);
 }
 
 
-bool
-parse_json (const char *txt, yajl_val *t)
+/* A generated file that is rendered into memory.  The emitter is the
+   first member, so the emitter handed out to the generator leads back
+   to its file.  */
+struct gen_file
 {
-  char errbuf[BUFSIZ];
-  size_t txt_len = strlen (txt);
+  struct emitter e;
+  char *  fname;
+};
 
-  /* This is a workaround of a bug in the yajl library to show the
-     correct position in the error message produced by the library.
-     In case this is fixed in yajl, one should avoid double parsing
-     and pring the error message produced by yajl_tree_parse.  */
-  yajl_status stat;
-  yajl_handle hand = yajl_alloc(NULL, NULL, NULL);
-  stat = yajl_parse(hand, (const unsigned char *)txt, txt_len);
 
-  if (stat != yajl_status_ok)
-    {
-      unsigned char * str;
-      str = yajl_get_error(hand, 1, (const unsigned char *) txt, txt_len);
-      ab_err ("%s", (const char *) str);
-      yajl_free_error(hand, str);
-      yajl_free (hand);
-      return false;
-    }
-  else
-    yajl_free (hand);
+/* A closed file of the current thread kept for its buffer, so that the
+   buffer grown by one generator is reused by the next one.  */
+static __thread struct gen_file *  gen_spare = NULL;
 
-  *t = yajl_tree_parse ((const char *)txt, errbuf, sizeof (errbuf));
 
-  assert (*t != NULL);
-  return true;
+struct emitter *
+gen_open_file (const char *  fname)
+{
+  struct gen_file *  gf = gen_spare;
+
+  if (gf)
+    gen_spare = NULL;
+  else if ((gf = malloc (sizeof *gf)))
+    gf->e = (struct emitter){ NULL, 0, 0 };
+  else
+    return NULL;
+
+  gf->e.size = 0;
+  gf->fname = strdup (fname);
+  return &gf->e;
 }
 
 
-char *
-get_file_content (const char *fname)
+void
+gen_release_buffers ()
 {
-  char *buf = NULL;
-  char *bufp;
+  if (gen_spare)
+    {
+      free (gen_spare->e.buf);
+      free (gen_spare);
+      gen_spare = NULL;
+    }
+}
 
-  struct stat st;
-  size_t bufsz, cursz, curpos;
-  ssize_t ssz;
 
+/* Check whether the file FNAME exists and its content is exactly
+   SIZE bytes of BUF.  */
+static bool
+file_content_equal_p (const char *  fname, const char *  buf, size_t size)
+{
+  struct stat st;
+  bool ret = false;
   int fd;
 
-  /* Open the file.  */
   if (-1 == (fd = open (fname, O_RDONLY)))
+    return false;
+
+  if (0 != fstat (fd, &st))
+    err_func (fstat);
+
+  if ((size_t) st.st_size == size)
     {
-      warn ("failed to open `%s'", fname);
-      return NULL;
+      char *  content = malloc (size + 1);
+      size_t pos = 0;
+      ssize_t ssz;
+
+      while (pos < size && (ssz = read (fd, content + pos, size - pos)) > 0)
+        pos += ssz;
+
+      ret = pos == size && !memcmp (content, buf, size);
+      free (content);
     }
 
+  close (fd);
+  return ret;
+}
 
-  /* Get FD status information.  */
-  if (0 != fstat (fd, &st))
-    err_func (fstat);
 
-  bufsz = (size_t) st.st_blksize;
+bool
+replace_file (const char *  fname, const char *  buf, size_t size)
+{
+  char tmp_fname[strlen (fname) + 32];
+  struct stat st;
+  int fd;
+
+  sprintf (tmp_fname, "%s.%ld.tmp", fname, (long) getpid ());
+  if (-1 == (fd = open (tmp_fname, O_WRONLY | O_CREAT | O_TRUNC, 0666)))
+    {
+      ab_err ("failed to open file `%s' for writing: %s",
+              tmp_fname, strerror (errno));
+      return false;
+    }
 
-  buf = (char *) malloc (bufsz);
-  curpos = 0;
-  cursz = bufsz;
+  /* The file that is replaced keeps its permissions.  */
+  if (0 == stat (fname, &st) && 0 != fchmod (fd, st.st_mode & 07777))
+    {
+      ab_err ("failed to set the mode of `%s': %s", tmp_fname, strerror (errno));
+      close (fd);
+      unlink (tmp_fname);
+      return false;
+    }
 
-  while ((ssz = read (fd, buf + curpos, bufsz)) > 0)
+  while (size > 0)
     {
-      curpos += ssz;
-      cursz = curpos + bufsz;
-      if (NULL == (bufp = (char *) realloc (buf, cursz)))
-        err_func (realloc);
+      ssize_t ssz = write (fd, buf, size);
 
-      buf = bufp;
+      if (ssz < 0 && errno == EINTR)
+        continue;
+
+      if (ssz < 0)
+        {
+          ab_err ("failed to write file `%s': %s", tmp_fname, strerror (errno));
+          close (fd);
+          unlink (tmp_fname);
+          return false;
+        }
+
+      buf += ssz;
+      size -= ssz;
     }
 
-  buf[curpos] = 0;
-  close (fd);
-  return buf;
+  if (0 != close (fd))
+    err_func (close);
+
+  if (0 != rename (tmp_fname, fname))
+    {
+      ab_err ("failed to rename `%s' to `%s': %s",
+              tmp_fname, fname, strerror (errno));
+      unlink (tmp_fname);
+      return false;
+    }
+
+  return true;
 }
 
 
-static char *
-xgetcwd ()
+bool
+gen_close_file (struct emitter *  e)
 {
-  size_t size = PATH_MAX;
+  struct gen_file *  gf = (struct gen_file *) e;
+  bool ret = true;
+
+  stats_bytes += e->size;
 
-  while (true)
+  if (!update_changed_only
+      || !file_content_equal_p (gf->fname, e->buf, e->size))
+    ret = replace_file (gf->fname, e->buf, e->size);
+
+  free (gf->fname);
+  gf->fname = NULL;
+
+  gen_release_buffers ();
+  gen_spare = gf;
+  return ret;
+}
+
+
+
+/* The index of the base names of all the files under a directory,
+   used by FIND_FILE.  The directories are stored together with their
+   modification times to check whether a cached index is still valid:
+   adding, removing or renaming a file changes the modification time of
+   its directory.  */
+struct file_index_name
+{
+  char *  name;
+  UT_hash_handle hh;
+};
+
+struct file_index_dir
+{
+  char *  path;
+  struct timespec mtime;
+};
+
+static struct
+{
+  char *  root;
+  struct file_index_name *  names;
+  struct file_index_dir *  dirs;
+  size_t n_dirs;
+  size_t cap_dirs;
+} file_index;
+
+
+#define FILE_INDEX_MAGIC "ast-builder file index 1"
+
+
+static void
+file_index_add_name (const char *  name)
+{
+  struct file_index_name *  fn;
+
+  HASH_FIND_STR (file_index.names, name, fn);
+  if (fn)
+    return;
+
+  fn = malloc (sizeof (*fn));
+  fn->name = strdup (name);
+  HASH_ADD_KEYPTR (hh, file_index.names, fn->name, strlen (fn->name), fn);
+}
+
+
+static void
+file_index_add_dir (const char *  path, struct timespec mtime)
+{
+  if (file_index.n_dirs == file_index.cap_dirs)
     {
-      char *buffer = malloc (size);
+      file_index.cap_dirs = file_index.cap_dirs ? 2 * file_index.cap_dirs : 64;
+      file_index.dirs = realloc (file_index.dirs,
+                                 file_index.cap_dirs * sizeof (*file_index.dirs));
+      if (!file_index.dirs)
+        err_func (realloc);
+    }
 
-      if (getcwd (buffer, size) == buffer)
-        return buffer;
+  file_index.dirs[file_index.n_dirs].path = strdup (path);
+  file_index.dirs[file_index.n_dirs].mtime = mtime;
+  file_index.n_dirs++;
+}
 
-      free (buffer);
 
-      if (errno != ERANGE)
-        return 0;
+void
+file_index_free ()
+{
+  struct file_index_name *  fn;
+  struct file_index_name *  tmp;
 
-      size *= 2;
+  HASH_ITER (hh, file_index.names, fn, tmp)
+    {
+      HASH_DEL (file_index.names, fn);
+      free (fn->name);
+      free (fn);
     }
+
+  for (size_t i = 0; i < file_index.n_dirs; i++)
+    free (file_index.dirs[i].path);
+
+  free (file_index.dirs);
+  free (file_index.root);
+  memset (&file_index, 0, sizeof (file_index));
 }
 
 
-static bool
-_find_file (const char *  fname)
+/* Add all the files under the directory PATH to the index.  The tree
+   is read with a single pass over each directory; STAT is only called
+   when the file system does not report the type of an entry.  */
+static void
+file_index_scan (const char *  path)
 {
   DIR *  dir;
-  struct dirent* entry;
-  struct stat dir_stat;
-  bool ret = false;
+  struct dirent *  entry;
+  struct stat st;
 
-  if (!(dir = opendir (".")))
+  if (!(dir = opendir (path)))
     err_func (opendir);
 
+  if (0 != fstat (dirfd (dir), &st))
+    err_func (fstat);
+
+  file_index_add_dir (path, st.st_mtim);
+
   while ((entry = readdir (dir)))
     {
-      if (-1 == stat (entry->d_name, &dir_stat))
-        err_func (stat);
+      bool dir_p;
 
       if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
         continue;
 
-      if (!S_ISDIR (dir_stat.st_mode))
-        {
-          if (!strcmp (entry->d_name, fname))
-            {
-              ret = true;
-              goto out;
-            }
-        }
+#ifdef _DIRENT_HAVE_D_TYPE
+      if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+        dir_p = entry->d_type == DT_DIR;
       else
+#endif
         {
-          bool found;
+          if (-1 == fstatat (dirfd (dir), entry->d_name, &st, 0))
+            err_func (fstatat);
 
-          chdir (entry->d_name);
-          found = _find_file (fname);
-          chdir ("..");
+          dir_p = S_ISDIR (st.st_mode);
+        }
+
+      if (dir_p)
+        {
+          char subdir[strlen (path) + strlen (entry->d_name) + 2];
 
-          if (found)
-            {
-              ret = true;
-              goto out;
-            }
+          sprintf (subdir, "%s/%s", path, entry->d_name);
+          file_index_scan (subdir);
         }
+      else
+        file_index_add_name (entry->d_name);
     }
 
-out:
   closedir (dir);
+}
+
+
+/* Load the index of the directory ROOT from the cache file FNAME.
+   Returns FALSE if the cache does not exist, was made for a different
+   directory or any of the directories was modified since.  */
+static bool
+file_index_load_cache (const char *  fname, const char *  root)
+{
+  FILE *  f;
+  char *  line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  bool ret = false;
+
+  if (!(f = fopen (fname, "r")))
+    return false;
+
+  if ((len = getline (&line, &size, f)) <= 0
+      || strcmp (line, FILE_INDEX_MAGIC "\n"))
+    goto out;
+
+  if ((len = getline (&line, &size, f)) <= 2
+      || line[0] != 'R' || line[1] != ' ')
+    goto out;
+
+  line[len - 1] = '\0';
+  if (strcmp (&line[2], root))
+    goto out;
+
+  while ((len = getline (&line, &size, f)) > 0)
+    {
+      struct stat st;
+      long long sec;
+      long nsec;
+      int pos;
+
+      if (line[len - 1] != '\n')
+        goto out;
+
+      line[len - 1] = '\0';
+      if (line[0] == 'F' && line[1] == ' ')
+        file_index_add_name (&line[2]);
+      else if (line[0] == 'D'
+               && 2 == sscanf (line, "D %lld %ld %n", &sec, &nsec, &pos)
+               && 0 == stat (&line[pos], &st)
+               && st.st_mtim.tv_sec == sec
+               && st.st_mtim.tv_nsec == nsec)
+        file_index_add_dir (&line[pos], st.st_mtim);
+      else
+        goto out;
+    }
+
+  ret = file_index.n_dirs != 0;
+
+out:
+  free (line);
+  fclose (f);
   return ret;
 }
 
+
+static void
+file_index_save_cache (const char *  fname)
+{
+  struct file_index_name *  fn;
+  char *  buf = NULL;
+  size_t size = 0;
+  FILE *  f;
+
+  if (!(f = open_memstream (&buf, &size)))
+    err_func (open_memstream);
+
+  fprintf (f, FILE_INDEX_MAGIC "\n"
+              "R %s\n", file_index.root);
+
+  for (size_t i = 0; i < file_index.n_dirs; i++)
+    fprintf (f, "D %lld %ld %s\n", (long long) file_index.dirs[i].mtime.tv_sec,
+             file_index.dirs[i].mtime.tv_nsec, file_index.dirs[i].path);
+
+  for (fn = file_index.names; fn; fn = fn->hh.next)
+    fprintf (f, "F %s\n", fn->name);
+
+  if (0 != fclose (f))
+    err_func (fclose);
+
+  if (!replace_file (fname, buf, size))
+    ab_warn ("the file index cache `%s' was not updated", fname);
+
+  free (buf);
+}
+
+
+/* Build the index of the directory ROOT, reusing FILE_INDEX_CACHE
+   when it is set and still valid.  */
+static void
+file_index_build (const char *  root)
+{
+  file_index_free ();
+  file_index.root = strdup (root);
+
+  if (file_index_cache && file_index_load_cache (file_index_cache, root))
+    return;
+
+  file_index_free ();
+  file_index.root = strdup (root);
+  file_index_scan (root);
+
+  if (file_index_cache)
+    file_index_save_cache (file_index_cache);
+}
+
+
 bool
 find_file (const char *  dirname, const char *  fname)
 {
-  char *  cwd = xgetcwd ();
-  bool res;
+  struct file_index_name *  fn;
+
+  if (!file_index.root || strcmp (file_index.root, dirname))
+    file_index_build (dirname);
 
-  chdir (dirname);
-  res = _find_file (fname);
-  chdir (cwd);
-  free (cwd);
-  return res;
+  HASH_FIND_STR (file_index.names, fname, fn);
+  return fn != NULL;
 }
@@ -1,7 +1,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <getopt.h>
+#include <err.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -16,6 +20,11 @@
 #include "validate-traversals.h"
 
 #include "gen.h"
+#include "json.h"
+#include "deps.h"
+#include "stats.h"
+#include "layout.h"
+#include "phases.h"
 
 
 const char *regexp_txt[] = {
@@ -46,6 +55,111 @@ struct traversal_name *  traversal_names = NULL;
 char *  sac2cbase = NULL;
 
 
+/* Whether to leave generated files untouched when their content
+   did not change.  */
+bool update_changed_only = false;
+
+
+/* Whether to generate traverse tables in the compact layout.  */
+bool compact_travtables = false;
+
+
+/* A file to cache the index of the sac2c source tree in.  */
+char *  file_index_cache = NULL;
+
+
+/* A file to keep the snapshot of the validated model in.  */
+static char *  snapshot_fname = NULL;
+
+
+/* Files selected with --only.  */
+static bool only_files_p = false;
+static bool only_files[f_max];
+
+
+/* The state of the entities of the model for --changed-since.  */
+static const char *  changed_since = NULL;
+
+
+/* The Make dependency file.  */
+static const char *  depfile = NULL;
+
+
+/* Whether --stats=json was given.  */
+static bool stats_json_p = false;
+
+
+/* The file for the report of the attribute layouts.  */
+static const char *  layout_report_fname = NULL;
+
+
+/* The access profile that moves rarely used attributes out of nodes.  */
+static const char *  access_profile_fname = NULL;
+
+
+/* The list of the phases of sac2c.  */
+static const char *  phases_fname = NULL;
+static struct phase_order phases;
+struct phase_order *  phase_order = NULL;
+
+
+/* The value of --phases for --changed-since: the names of the phases of
+   PO in order, or the empty string without PO.  */
+static char *
+phases_setting (const struct phase_order *  po)
+{
+  size_t len = 1;
+  char *  s;
+
+  for (size_t i = 0; po && i < po->n_phases; i++)
+    len += strlen (po->phases[i].name) + 1;
+
+  if (!(s = malloc (len)))
+    err_func (malloc);
+
+  *s = '\0';
+  for (size_t i = 0; po && i < po->n_phases; i++)
+    strcat (strcat (s, po->phases[i].name), " ");
+
+  return s;
+}
+
+
+/* Mark the files of the comma-separated list LIST in ONLY_FILES.  Every
+   file is given either by its path relative to `src/libsac2c' or by
+   its base name.  */
+static bool
+select_only_files (const char *  list)
+{
+  char *  copy = strdup (list);
+  char *  save;
+  bool ret = true;
+
+  only_files_p = true;
+  for (char *  x = strtok_r (copy, ",", &save); x; x = strtok_r (NULL, ",", &save))
+    {
+      bool found = false;
+
+      for (size_t i = 0; i < f_max; i++)
+        {
+          const char *  base = strrchr (gen_file_pathes[i], '/');
+
+          if (!strcmp (x, gen_file_pathes[i]) || (base && !strcmp (x, base + 1)))
+            found = only_files[i] = true;
+        }
+
+      if (!found)
+        {
+          ab_err ("`%s' is not a generated file", x);
+          ret = false;
+        }
+    }
+
+  free (copy);
+  return ret;
+}
+
+
 /* Path of each file in sac2c source tree.  */
 const char *gen_file_pathes[] =
 {
@@ -79,22 +193,66 @@ const char *gen_file_pathes[] =
   [f_serialize_buildstack_c] = "serialize/serialize_buildstack.c"
 };
 
-static yajl_val
-get_yajl_tree_from_file (const char *  fname)
+
+/* Parts of the model read by the generator of each file.  A file is
+   only regenerated by --changed-since when one of its parts changed.
+   Targets of sons and attributes refer to nodesets, and attributes
+   refer to attribute types.  */
+static const unsigned gen_file_reads[f_max] =
+{
+  [f_types_trav_h] =           mp_traversals,
+  [f_types_nodetype_h] =       mp_nodes,
+  [f_traverse_tables_h] =      mp_nodes | mp_traversals,
+  [f_traverse_tables_c] =      mp_nodes | mp_sons | mp_nodesets | mp_traversals
+                               | mp_targets,
+  [f_traverse_helper_c] =      mp_nodes | mp_sons,
+  [f_sons_h] =                 mp_nodes | mp_sons,
+  [f_node_info_mac] =          mp_nodes,
+  [f_free_node_h] =            mp_nodes,
+  [f_attribs_h] =              mp_nodes | mp_attributes | mp_flags | mp_attrtypes,
+  [f_node_alloc_h] =           mp_nodes | mp_sons | mp_attributes | mp_flags,
+  [f_node_basic_h] =           mp_nodes | mp_sons | mp_attributes | mp_flags
+                               | mp_nodesets | mp_attrtypes,
+  [f_free_attribs_h] =         mp_attrtypes,
+  [f_check_reset_h] =          mp_nodes | mp_nodesets,
+  [f_check_node_h] =           mp_nodes,
+  [f_check_h] =                mp_nodes,
+  [f_node_basic_c] =           mp_nodes | mp_sons | mp_attributes | mp_flags
+                               | mp_nodesets | mp_attrtypes | mp_targets,
+  [f_free_node_c] =            mp_nodes | mp_sons | mp_attributes | mp_attrtypes,
+  [f_check_reset_c] =          mp_nodes | mp_sons,
+  [f_check_node_c] =           mp_nodes | mp_sons | mp_attributes | mp_attrtypes,
+  [f_check_c] =                mp_nodes | mp_sons | mp_attributes | mp_checks
+                               | mp_nodesets | mp_attrtypes | mp_targets,
+  [f_serialize_attribs_h] =    mp_attrtypes,
+  [f_serialize_node_h] =       mp_nodes,
+  [f_serialize_link_h] =       mp_nodes,
+  [f_serialize_buildstack_h] = mp_nodes,
+  [f_serialize_node_c] =       mp_nodes | mp_sons | mp_attributes | mp_flags
+                               | mp_attrtypes,
+  [f_serialize_link_c] =       mp_nodes | mp_sons | mp_attributes | mp_attrtypes,
+  [f_serialize_helper_c] =     mp_nodes | mp_sons | mp_attributes | mp_flags
+                               | mp_attrtypes,
+  [f_serialize_buildstack_c] = mp_nodes | mp_sons | mp_attributes | mp_attrtypes
+};
+
+/* The absolute name of the file FNAME for the depfile, or a copy of
+   FNAME if it cannot be resolved.  NULL stays NULL.  */
+static char *
+depfile_name (const char *  fname)
 {
-  char *  text = get_file_content (fname);
-  yajl_val node;
+  char *  name;
 
-  if (!text)
+  if (!fname)
     return NULL;
 
-  if (!parse_json (text, &node))
-    node = NULL;
+  if (!(name = realpath (fname, NULL)) && !(name = strdup (fname)))
+    err_func (strdup);
 
-  free (text);
-  return node;
+  return name;
 }
 
+
 #define GET_OUT_IF(__expr)    \
 do {                          \
   if (__expr)                 \
@@ -105,12 +263,289 @@ do {                          \
 } while (0)
 
 
+/* Run the statement STMT as the phase NAME of the statistics.  */
+#define STATS_PHASE(__name, __stmt)             \
+do {                                            \
+  struct stats_phase __phase;                   \
+  stats_start (&__phase, __name, false);        \
+  __stmt;                                       \
+  stats_stop (&__phase);                        \
+} while (0)
+
+
+
+/* Inputs of the generators and full pathes of the generated files.  */
+struct gen_inputs
+{
+  const struct model *  model;
+  char *  pathes[f_max];
+  /* Files that are not selected are left untouched.  */
+  bool selected[f_max];
+};
+
+
+/* Generate the file FN.  */
+static bool
+gen_file (const struct gen_inputs *  in, enum file_names fn)
+{
+  const char *  p = in->pathes[fn];
+
+  switch (fn)
+    {
+    case f_types_trav_h:
+      return gen_types_trav_h (in->model, p);
+    case f_types_nodetype_h:
+      return gen_types_nodetype_h (in->model, p);
+    case f_traverse_tables_h:
+      return gen_traverse_tables_h (in->model, p);
+    case f_traverse_tables_c:
+      return gen_traverse_tables_c (in->model, p);
+    case f_traverse_helper_c:
+      return gen_traverse_helper_c (in->model, p);
+    case f_sons_h:
+      return gen_sons_h (in->model, p);
+    case f_node_info_mac:
+      return gen_node_info_mac (in->model, p);
+    case f_free_node_h:
+      return gen_free_node_h (in->model, p);
+    case f_attribs_h:
+      return gen_attribs_h (in->model, p);
+    case f_node_alloc_h:
+      return gen_node_alloc_h (in->model, p);
+    case f_node_basic_h:
+      return gen_node_basic_h (in->model, p);
+    case f_free_attribs_h:
+      return gen_free_attribs_h (in->model, p);
+    case f_check_reset_h:
+      return gen_check_reset_h (in->model, p);
+    case f_check_node_h:
+      return gen_check_node_h (in->model, p);
+    case f_check_h:
+      return gen_check_h (in->model, p);
+    case f_node_basic_c:
+      return gen_node_basic_c (in->model, p);
+    case f_free_node_c:
+      return gen_free_node_c (in->model, p);
+    case f_check_reset_c:
+      return gen_check_reset_c (in->model, p);
+    case f_check_node_c:
+      return gen_check_node_c (in->model, p);
+    case f_check_c:
+      return gen_check_c (in->model, p);
+    case f_serialize_attribs_h:
+      return gen_serialize_attribs_h (in->model, p);
+    case f_serialize_node_h:
+      return gen_serialize_node_h (in->model, p);
+    case f_serialize_link_h:
+      return gen_serialize_link_h (in->model, p);
+    case f_serialize_buildstack_h:
+      return gen_serialize_buildstack_h (in->model, p);
+    case f_serialize_node_c:
+      return gen_serialize_node_c (in->model, p);
+    case f_serialize_link_c:
+      return gen_serialize_link_c (in->model, p);
+    case f_serialize_helper_c:
+      return gen_serialize_helper_c (in->model, p);
+    case f_serialize_buildstack_c:
+      return gen_serialize_buildstack_c (in->model, p);
+    default:
+      assert (0);
+    }
+}
+
+
+/* The order in which the files are handed out to the workers.  Generators
+   are independent, so the order only matters for the load balancing:
+   the most expensive files go first, so that the total time is bounded
+   by the slowest generator rather than by an unlucky tail.  */
+static const enum file_names gen_schedule[f_max] =
+{
+  f_traverse_tables_c,
+  f_node_basic_c,
+  f_check_c,
+  f_node_basic_h,
+  f_serialize_node_c,
+  f_serialize_helper_c,
+  f_free_node_c,
+  f_serialize_link_c,
+  f_traverse_helper_c,
+  f_serialize_buildstack_c,
+  f_check_node_c,
+  f_check_reset_c,
+  f_attribs_h,
+  f_node_alloc_h,
+  f_sons_h,
+  f_check_reset_h,
+  f_check_node_h,
+  f_free_node_h,
+  f_serialize_buildstack_h,
+  f_serialize_link_h,
+  f_check_h,
+  f_serialize_node_h,
+  f_types_trav_h,
+  f_serialize_attribs_h,
+  f_node_info_mac,
+  f_free_attribs_h,
+  f_types_nodetype_h,
+  f_traverse_tables_h
+};
+
+
+/* The result of generating one file.  Diagnostics are collected in DIAG
+   and printed after all the generators finished.  */
+struct gen_job
+{
+  bool ok;
+  char *  diag;
+  size_t diag_size;
+};
+
+
+/* A pool of workers that share the list of jobs.  */
+struct gen_pool
+{
+  const struct gen_inputs *  in;
+  struct gen_job jobs[f_max];
+  size_t next;
+  pthread_mutex_t lock;
+};
+
+
+static void *
+gen_worker (void *  arg)
+{
+  struct gen_pool *  pool = arg;
+
+  while (true)
+    {
+      size_t i;
+
+      pthread_mutex_lock (&pool->lock);
+      i = pool->next++;
+      pthread_mutex_unlock (&pool->lock);
+
+      if (i >= f_max)
+        break;
+
+      enum file_names fn = gen_schedule[i];
+      struct gen_job *  job = &pool->jobs[fn];
+
+      if (!pool->in->selected[fn])
+        {
+          job->ok = true;
+          continue;
+        }
+
+      if (!(ab_diag_stream = open_memstream (&job->diag, &job->diag_size)))
+        err_func (open_memstream);
+
+      struct stats_phase phase;
+      char *  name = NULL;
+
+      if (stats_enabled)
+        {
+          name = malloc (strlen ("gen ") + strlen (gen_file_pathes[fn]) + 1);
+          sprintf (name, "gen %s", gen_file_pathes[fn]);
+        }
+
+      stats_start (&phase, name, true);
+      job->ok = gen_file (pool->in, fn);
+      stats_stop (&phase);
+      free (name);
+
+      fclose (ab_diag_stream);
+      ab_diag_stream = NULL;
+    }
+
+  gen_release_buffers ();
+  return NULL;
+}
+
+
+/* Generate all the files using NJOBS threads.  Diagnostics are reported
+   in the order of FILE_NAMES, independently of the scheduling.  */
+static bool
+gen_all_files (const struct gen_inputs *  in, long njobs)
+{
+  struct gen_pool pool = { .in = in, .next = 0 };
+  bool ret = true;
+
+  /* There is no point to have more workers than files.  */
+  if (njobs > f_max)
+    njobs = f_max;
+
+  pthread_t threads[njobs];
+  pthread_mutex_init (&pool.lock, NULL);
+
+  /* The main thread is one of the workers.  */
+  for (long i = 1; i < njobs; i++)
+    if (0 != pthread_create (&threads[i], NULL, gen_worker, &pool))
+      err_func (pthread_create);
+
+  gen_worker (&pool);
+
+  for (long i = 1; i < njobs; i++)
+    pthread_join (threads[i], NULL);
+
+  pthread_mutex_destroy (&pool.lock);
+
+  for (size_t i = 0; i < f_max; i++)
+    {
+      fwrite (pool.jobs[i].diag, 1, pool.jobs[i].diag_size, stderr);
+      free (pool.jobs[i].diag);
+      ret = ret && pool.jobs[i].ok;
+    }
+
+  fflush (stderr);
+  return ret;
+}
+
 
 static int
 usage (const char *  prog_name)
 {
   fprintf (stderr, "usage: %s [flags]\n"
                    "    --sac2cbase, -s  Set the location of sac2c.\n"
+                   "    --update, -u     Only replace generated files which content\n"
+                   "                     has changed; omit timestamps in generated files.\n"
+                   "    --jobs, -j N     Run N generators in parallel; the default is\n"
+                   "                     the number of online processors.\n"
+                   "    --only, -o FILES\n"
+                   "                     Generate only the comma-separated list of FILES,\n"
+                   "                     given as `tree/node_basic.c' or `node_basic.c'.\n"
+                   "    --changed-since, -C STATE\n"
+                   "                     Only generate files that depend on the parts of\n"
+                   "                     the json files changed since the run that saved\n"
+                   "                     STATE, and save the new STATE.\n"
+                   "    --depfile, -d FILE\n"
+                   "                     Write the dependencies of the generated files on\n"
+                   "                     the json files into FILE in the Make format.\n"
+                   "    --compact-travtables, -t\n"
+                   "                     Generate traverse tables as small per-traversal\n"
+                   "                     rows of indices into a shared function array\n"
+                   "                     instead of a dense array of function pointers.\n"
+                   "    --snapshot, -m FILE\n"
+                   "                     Keep the validated model in FILE and reuse it\n"
+                   "                     while the json files and the tool are unchanged.\n"
+                   "                     The json files are not validated again then, so\n"
+                   "                     warnings are only reported by the run saving FILE.\n"
+                   "    --index-cache, -c FILE\n"
+                   "                     Keep the index of sac2c sources in FILE and\n"
+                   "                     reuse it while the source tree is unchanged.\n"
+                   "    --stats[=json]   Print the time, the memory and the allocations\n"
+                   "                     of every phase of the run on the standard\n"
+                   "                     output, as a table or as json.  Allocations\n"
+                   "                     are counted in builds with -DAB_ALLOC_STATS.\n"
+                   "    --layout-report FILE\n"
+                   "                     Write the size, the padding and the cache lines\n"
+                   "                     of the attribute structure of every node into FILE.\n"
+                   "    --access-profile FILE\n"
+                   "                     Move the attributes that are rarely accessed\n"
+                   "                     according to the profile FILE into a separately\n"
+                   "                     allocated block of cold attributes.\n"
+                   "    --phases FILE    Check the phases of the targets against the\n"
+                   "                     json list of sac2c phases FILE and generate the\n"
+                   "                     tree checker with a mask of phases per target.\n"
                    "    --help, -h       Print help message and exit.\n\n",
            prog_name);
 
@@ -121,6 +556,18 @@ usage (const char *  prog_name)
 static struct option long_options[] =
 {
   {"sac2cbase", required_argument, NULL, 's'},
+  {"update", no_argument, NULL, 'u'},
+  {"jobs", required_argument, NULL, 'j'},
+  {"index-cache", required_argument, NULL, 'c'},
+  {"compact-travtables", no_argument, NULL, 't'},
+  {"snapshot", required_argument, NULL, 'm'},
+  {"only", required_argument, NULL, 'o'},
+  {"changed-since", required_argument, NULL, 'C'},
+  {"depfile", required_argument, NULL, 'd'},
+  {"stats", optional_argument, NULL, 'S'},
+  {"layout-report", required_argument, NULL, 'L'},
+  {"access-profile", required_argument, NULL, 'P'},
+  {"phases", required_argument, NULL, 'p'},
   {"help", no_argument, NULL, 'h'},
   {NULL, 0, NULL, 0}
 };
@@ -132,15 +579,79 @@ int
 main (int argc, char *argv[])
 {
   const char *  prog_name = argv[0];
+  long njobs = sysconf (_SC_NPROCESSORS_ONLN);
   int ch;
 
-  while ((ch = getopt_long (argc, argv, "s:h", long_options, NULL)) != -1)
+  while ((ch = getopt_long (argc, argv, "s:uj:c:tm:o:C:d:h", long_options, NULL)) != -1)
     switch (ch)
       {
       case 's':
         sac2cbase = strdup (optarg);
         break;
 
+      case 'u':
+        update_changed_only = true;
+        break;
+
+      case 'j':
+        {
+          char *  end;
+          njobs = strtol (optarg, &end, 10);
+          if (*end != '\0' || njobs < 1)
+            {
+              ab_err ("invalid number of jobs `%s'", optarg);
+              exit (usage (prog_name));
+            }
+          break;
+        }
+
+      case 'c':
+        file_index_cache = strdup (optarg);
+        break;
+
+      case 't':
+        compact_travtables = true;
+        break;
+
+      case 'm':
+        snapshot_fname = strdup (optarg);
+        break;
+
+      case 'o':
+        if (!select_only_files (optarg))
+          exit (usage (prog_name));
+        break;
+
+      case 'C':
+        changed_since = optarg;
+        break;
+
+      case 'd':
+        depfile = optarg;
+        break;
+
+      case 'S':
+        if (optarg && strcmp (optarg, "json"))
+          {
+            ab_err ("invalid statistics format `%s'", optarg);
+            exit (usage (prog_name));
+          }
+        stats_enabled = true;
+        stats_json_p = optarg != NULL;
+        break;
+
+      case 'L':
+        layout_report_fname = optarg;
+        break;
+
+      case 'P':
+        access_profile_fname = optarg;
+        break;
+
+      case 'p':
+        phases_fname = optarg;
+        break;
+
       case 'h':
         exit (usage (prog_name));
 
@@ -151,12 +662,15 @@ main (int argc, char *argv[])
         abort ();
       }
 
+  if (njobs < 1)
+    njobs = 1;
+
   if (!sac2cbase && !getenv ("SAC2CBASE"))
     {
       ab_err ("The location of sac2c is unknown");
       return EXIT_FAILURE;
     }
-  else
+  else if (!sac2cbase)
     sac2cbase = strdup (getenv ("SAC2CBASE"));
 
   int ret = EXIT_SUCCESS;
@@ -165,78 +679,197 @@ main (int argc, char *argv[])
   yajl_val nodeset_node = NULL;
   yajl_val attrtype_node = NULL;
   yajl_val traversal_node = NULL;
+  struct model model = { 0 };
+  bool use_snapshot = false;
+  struct deps_entity *  entities = NULL;
+  uint64_t snapshot_key;
 
   const char ast_fname[] = "../ast.json";
   const char attrtype_fname[] = "../attrtypes.json";
   const char nodeset_fname[] = "../nodesets.json";
   const char traversal_fname[] = "../traversals.json";
+  const char *  input_fnames[] = {
+    ast_fname, attrtype_fname, nodeset_fname, traversal_fname
+  };
 
   init_regexps ();
 
-  GET_OUT_IF (NULL == (ast_node = get_yajl_tree_from_file (ast_fname)));
-  GET_OUT_IF (NULL == (attrtype_node = get_yajl_tree_from_file (attrtype_fname)));
-  GET_OUT_IF (NULL == (nodeset_node = get_yajl_tree_from_file (nodeset_fname)));
-  GET_OUT_IF (NULL == (traversal_node = get_yajl_tree_from_file (traversal_fname)));
-  GET_OUT_IF (!load_node_names (ast_node, ast_fname));
-  GET_OUT_IF (!load_attrtype_names (attrtype_node, attrtype_fname));
-  GET_OUT_IF (!load_and_validate_nodesets (nodeset_node, nodeset_fname));
-  GET_OUT_IF (!load_and_validate_traversals (traversal_node, traversal_fname));
-  GET_OUT_IF (!validate_ast (ast_node));
+  /* When none of the inputs changed since the last run, the validated
+     model is loaded from its snapshot and the json files are not even
+     parsed.  */
+  if (snapshot_fname)
+    use_snapshot = model_snapshot_key (input_fnames, 4, &snapshot_key);
+
+  bool loaded = false;
+  bool ok;
+
+  if (use_snapshot)
+    STATS_PHASE ("model_snapshot_load",
+                 loaded = model_snapshot_load (&model, snapshot_fname,
+                                               snapshot_key));
+
+  /* The key of the snapshot covers the json files but not SAC2CBASE, so
+     the includes of the traversals are looked up again.  */
+  if (loaded)
+    {
+      ok = true;
+      for (size_t i = 0; i < model.n_traversals; i++)
+        ok = validate_traversal_include (model.traversals[i].name->name,
+                                         model.traversals[i].include) && ok;
+      GET_OUT_IF (!ok);
+    }
+
+  if (!loaded)
+    {
+      /* The files are read and parsed in a single pass.  */
+      STATS_PHASE ("read ast.json", ast_node = json_load (ast_fname));
+      GET_OUT_IF (NULL == ast_node);
+      STATS_PHASE ("read attrtypes.json",
+                   attrtype_node = json_load (attrtype_fname));
+      GET_OUT_IF (NULL == attrtype_node);
+      STATS_PHASE ("read nodesets.json",
+                   nodeset_node = json_load (nodeset_fname));
+      GET_OUT_IF (NULL == nodeset_node);
+      STATS_PHASE ("read traversals.json",
+                   traversal_node = json_load (traversal_fname));
+      GET_OUT_IF (NULL == traversal_node);
+
+      STATS_PHASE ("load_node_names",
+                   ok = load_node_names (ast_node, ast_fname));
+      GET_OUT_IF (!ok);
+      STATS_PHASE ("load_attrtype_names",
+                   ok = load_attrtype_names (attrtype_node, attrtype_fname));
+      GET_OUT_IF (!ok);
+      STATS_PHASE ("load_and_validate_nodesets",
+                   ok = load_and_validate_nodesets (nodeset_node, nodeset_fname));
+      GET_OUT_IF (!ok);
+      STATS_PHASE ("load_and_validate_traversals",
+                   ok = load_and_validate_traversals (traversal_node,
+                                                      traversal_fname));
+      GET_OUT_IF (!ok);
+      STATS_PHASE ("validate_ast", ok = validate_ast (ast_node));
+      GET_OUT_IF (!ok);
+
+      STATS_PHASE ("model_build",
+                   model_build (&model, ast_node, nodeset_node, traversal_node));
+
+      if (use_snapshot)
+        {
+          STATS_PHASE ("model_snapshot_save",
+                       ok = model_snapshot_save (&model, snapshot_fname,
+                                                 snapshot_key));
+          if (!ok)
+            ab_warn ("failed to save the model snapshot `%s'", snapshot_fname);
+        }
+    }
+
+  /* The profile is applied after the snapshot is saved, as the key of
+     the snapshot does not cover it.  */
+  GET_OUT_IF (access_profile_fname
+              && !layout_apply_profile (&model, access_profile_fname));
+  GET_OUT_IF (layout_report_fname && !layout_report (&model, layout_report_fname));
+
+  if (phases_fname)
+    {
+      GET_OUT_IF (!phases_load (&phases, phases_fname));
+      phase_order = &phases;
+      GET_OUT_IF (!phases_check (&model, phase_order));
+    }
 
   /* Make a full path to each file including sac2cbase prefix.  */
-  char *prefixed_pathes[f_max];
+  struct gen_inputs in = { .model = &model };
+  unsigned changed = mp_all;
+
+  if (changed_since)
+    {
+      entities = deps_entities (&model);
+
+      /* Another version of the tool may generate different files from
+         the same model.  */
+      for (unsigned part = 1; part & mp_all; part <<= 1)
+        deps_add_setting (&entities, part, "version", tool_version ());
+
+      deps_add_setting (&entities, mp_traversals, "travtables",
+                        compact_travtables ? "compact" : "dense");
+      char *  setting = phases_setting (phase_order);
+      deps_add_setting (&entities, mp_checks, "phases", setting);
+      free (setting);
+      changed = deps_changed_parts (changed_since, entities);
+    }
 
   for (size_t i = 0; i < f_max; i++)
     {
       const char *  p = "/src/libsac2c/";
-      prefixed_pathes[i] = malloc (strlen (sac2cbase)
-                                   + strlen (p)
-                                   + strlen (gen_file_pathes[i])
-                                   + 1);
-      sprintf (prefixed_pathes[i], "%s%s%s", sac2cbase, p, gen_file_pathes[i]);
+      in.pathes[i] = malloc (strlen (sac2cbase)
+                             + strlen (p)
+                             + strlen (gen_file_pathes[i])
+                             + 1);
+      sprintf (in.pathes[i], "%s%s%s", sac2cbase, p, gen_file_pathes[i]);
+
+      /* A missing file is always generated.  */
+      in.selected[i] = (!only_files_p || only_files[i])
+                       && ((changed & gen_file_reads[i])
+                           || 0 != access (in.pathes[i], F_OK));
+    }
+
+  if (!gen_all_files (&in, njobs))
+    ret = EXIT_FAILURE;
+
+  /* With --only some of the affected files might be left behind, so
+     the state is only saved when all of them were considered.  */
+  if (ret == EXIT_SUCCESS && changed_since && !only_files_p
+      && !deps_save (changed_since, entities))
+    ret = EXIT_FAILURE;
+
+  if (ret == EXIT_SUCCESS && depfile)
+    {
+      /* The json files containing each part of the model, by their
+         absolute names, as the depfile is read from another directory.  */
+      char *  ast = depfile_name (ast_fname);
+      char *  nodesets = depfile_name (nodeset_fname);
+      char *  traversals = depfile_name (traversal_fname);
+      char *  attrtypes = depfile_name (attrtype_fname);
+      char *  profile = depfile_name (access_profile_fname);
+      char *  phase_list = depfile_name (phases_fname);
+      char *  generator = depfile_name ("/proc/self/exe");
+      const char *  part_inputs[] = {
+        ast, ast, ast, ast, ast, nodesets, traversals, attrtypes, ast
+      };
+      /* The access profile makes attributes cold and the phase list
+         turns the phases of the checks into masks.  */
+      const char *  part_extra_inputs[] = {
+        NULL, NULL, profile, NULL, phase_list, NULL, NULL, NULL, NULL
+      };
+
+      if (!deps_write_depfile (depfile, in.pathes, gen_file_reads, f_max,
+                               generator, part_inputs, part_extra_inputs))
+        ret = EXIT_FAILURE;
+
+      free (ast);
+      free (nodesets);
+      free (traversals);
+      free (attrtypes);
+      free (profile);
+      free (phase_list);
+      free (generator);
     }
 
-#define PP(x) prefixed_pathes[x]
-
-  gen_types_trav_h (traversal_node, PP (f_types_trav_h));
-  gen_types_nodetype_h (ast_node, PP (f_types_nodetype_h));
-  gen_traverse_tables_h (ast_node, traversal_node, PP (f_traverse_tables_h));
-  gen_traverse_tables_c (ast_node, traversal_node, PP (f_traverse_tables_c));
-  gen_traverse_helper_c (ast_node, PP (f_traverse_helper_c));
-  gen_sons_h (ast_node, PP (f_sons_h));
-  gen_node_info_mac (ast_node, PP (f_node_info_mac));
-  gen_free_node_h (ast_node, PP (f_free_node_h));
-  gen_attribs_h (ast_node, PP (f_attribs_h));
-  gen_node_alloc_h (ast_node, PP (f_node_alloc_h));
-  gen_node_basic_h (ast_node, PP (f_node_basic_h));
-  gen_free_attribs_h (PP (f_free_attribs_h));
-  gen_check_reset_h (PP (f_check_reset_h));
-  gen_check_node_h (PP (f_check_node_h));
-  gen_check_h (PP (f_check_h));
-  gen_node_basic_c (ast_node, nodeset_node, PP (f_node_basic_c));
-  gen_free_node_c (ast_node, PP (f_free_node_c));
-  gen_check_reset_c (ast_node, PP (f_check_reset_c));
-  gen_check_node_c (ast_node, PP (f_check_node_c));
-  gen_check_c (ast_node, nodeset_node, PP (f_check_c));
-  gen_serialize_attribs_h (PP (f_serialize_attribs_h));
-  gen_serialize_node_h (PP (f_serialize_node_h));
-  gen_serialize_link_h (PP (f_serialize_link_h));
-  gen_serialize_buildstack_h (PP (f_serialize_buildstack_h));
-  gen_serialize_node_c (ast_node, PP (f_serialize_node_c));
-  gen_serialize_link_c (ast_node, PP (f_serialize_link_c));
-  gen_serialize_helper_c (ast_node, PP (f_serialize_helper_c));
-  gen_serialize_buildstack_c (ast_node, PP (f_serialize_buildstack_c));
-
-#undef PP
   for (size_t i = 0; i < f_max; i++)
-    free (prefixed_pathes[i]);
+    free (in.pathes[i]);
 
 out:
+  stats_report (stdout, stats_json_p);
   free (sac2cbase);
-  yajl_tree_free (ast_node);
-  yajl_tree_free (attrtype_node);
-  yajl_tree_free (nodeset_node);
-  yajl_tree_free (traversal_node);
+  free (file_index_cache);
+  free (snapshot_fname);
+  deps_free (entities);
+  file_index_free ();
+  model_free (&model);
+  phases_free (&phases);
+  json_free (ast_node);
+  json_free (attrtype_node);
+  json_free (nodeset_node);
+  json_free (traversal_node);
   node_names_free ();
   attrype_names_free ();
   traversal_names_free ();
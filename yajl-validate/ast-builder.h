@@ -2,6 +2,8 @@
 #define __VALIDATOR_H__
 
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "uthash.h"
 
@@ -12,6 +14,13 @@
 #   define PRINTF_FORMAT(x, y)
 #endif
 
+/* The version of the tool.  The key of the model snapshot and the state
+   of --changed-since hash the binary of the tool as well, see
+   TOOL_VERSION, but the version should still be changed whenever the
+   validation, the building or the layout of the model or the generated
+   files change.  */
+#define AST_BUILDER_VERSION "0.4"
+
 #define err_func(name)                          \
     err (EXIT_FAILURE, "system call `" #name "' failed")
 
@@ -75,7 +84,9 @@ enum trav_node_type
   tnt_user,
   tnt_sons,
   tnt_error,
-  tnt_none
+  tnt_none,
+  /* The function named by the `default' field of the traversal.  */
+  tnt_default
 };
 
 static inline const char *
@@ -115,6 +126,21 @@ trav_node_type_fun_name (enum trav_node_type n)
 }
 
 
+/* Whether the attribute ATTR of the node NODE survives in zombie fundefs,
+   which FREEfundef leaves behind instead of freeing them.  */
+static inline bool
+zombie_attribute_p (const char *  node, const char *  attr)
+{
+  return !strcmp (node, "Fundef")
+         && (!strcmp (attr, "Name")
+             || !strcmp (attr, "Mod")
+             || !strcmp (attr, "LinkMod")
+             || !strcmp (attr, "Types")
+             || !strcmp (attr, "Type")
+             || !strcmp (attr, "Impl"));
+}
+
+
 /* A structure for the hash table to store the ast node names.  */
 struct node_name
 {
@@ -140,6 +166,10 @@ struct attrtype_name
   char *  vtype;
   char *  init;
   bool persist;
+  /* The size and the alignment of CTYPE in bytes, or 0 when they are
+     not given in `attrtypes.json'.  */
+  size_t size;
+  size_t align;
   UT_hash_handle hh;
 };
 
@@ -163,6 +193,9 @@ extern struct node_name *  node_names;
 extern struct attrtype_name *  attrtype_names;
 extern struct traversal_name *  traversal_names;
 extern char *  sac2cbase;
+extern bool update_changed_only;
+extern bool compact_travtables;
+extern char *  file_index_cache;
 extern const char *gen_file_pathes[];
 
 /* A list of the regular expressions we might ever want to use
@@ -188,6 +221,11 @@ void init_regexps ();
 void free_regexps ();
 
 
+/* When set, diagnostics of the current thread are collected in this
+   stream instead of being printed on STDERR.  */
+extern __thread FILE *  ab_diag_stream;
+
+
 /* Wrapper for printing errors on STDERR.  */
 void ab_err (const char *format, ...) PRINTF_FORMAT (1, 2);
 
@@ -196,13 +234,37 @@ void ab_err (const char *format, ...) PRINTF_FORMAT (1, 2);
 void ab_warn (const char *format, ...) PRINTF_FORMAT (1, 2);
 
 
-/* Parse json file TXT or print an error and return FALSE.  */
-bool parse_json (const char *txt, yajl_val *t);
+/* Check whether a file called FNAME exists anywhere under the directory
+   DIRNAME.  The directory is scanned once into an index of file names;
+   when FILE_INDEX_CACHE is set, the index is kept in that file and
+   reused while none of the directories change.  */
+bool find_file (const char *  dirname, const char *  fname);
 
 
-/* Read the file FNAME and return its content.  */
-char * get_file_content (const char *fname);
+/* Free the index built by FIND_FILE.  */
+void file_index_free ();
 
-bool find_file (const char *  dirname, const char *  fname);
+
+/* Write SIZE bytes of BUF into a temporary file next to FNAME and
+   rename it to FNAME, so that the file is never seen half-written.  */
+bool replace_file (const char *  fname, const char *  buf, size_t size);
+
+
+struct emitter;
+
+/* Open an emitter that will hold the content of the generated file
+   FNAME.  The emitter has to be closed with GEN_CLOSE_FILE.  */
+struct emitter * gen_open_file (const char *  fname);
+
+
+/* Close the emitter E obtained from GEN_OPEN_FILE and atomically replace
+   the file on disk with its content.  If UPDATE_CHANGED_ONLY is set,
+   the file is left untouched when its content did not change.  The
+   buffer of E is kept for the next file opened by the same thread.  */
+bool gen_close_file (struct emitter *  e);
+
+
+/* Free the buffer kept by GEN_CLOSE_FILE in the current thread.  */
+void gen_release_buffers ();
 
 #endif // __VALIDATOR_H__
@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+#
+# Benchmark the ast-builder on synthetic models.
+#
+# The real ast.json is too small to show how the validation and the
+# generators scale, so this script generates valid models where one
+# dimension (the number of nodes, sons per node, nodesets or traversals)
+# grows 1x, 10x and 100x while the others stay at the size of the real
+# model.  Every model is run through the full pipeline into a temporary
+# stand-in for SAC2CBASE, and the time of every phase reported by
+# `ast-builder --stats=json' is collected.
+#
+# For every phase the growth of its time is compared to the growth of
+# the dimension: an exponent close to 1 means linear scaling, while
+# phases growing faster than SUPERLINEAR are reported.
+
+import argparse
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+# The dimensions that can be scaled.
+DIMS = ["nodes", "sons", "nodesets", "traversals"]
+
+# The number of user handlers of every traversal.
+TRAVUSER = 6
+
+# The exponent above which the scaling of a phase is reported.
+SUPERLINEAR = 1.3
+
+# The directories of sac2c where the files are generated.
+GEN_DIRS = ["tree", "types", "global", "serialize"]
+
+
+def die (s):
+    print ("error:", s, file=sys.stderr)
+    sys.exit (1)
+
+
+def node_name (i):
+    return "Node%d" % i
+
+
+def trav_name (i):
+    # Traversal names are limited to `^[A-Z][A-Z0-9]*$'.
+    return "TR%d" % i
+
+
+def real_base (root):
+    """The size of the real model in ROOT that the scales multiply: the
+    number of nodes, the average number of sons per node, the number of
+    nodesets and the number of traversals."""
+    def load (name):
+        with open (os.path.join (root, name)) as f:
+            return json.load (f)
+
+    ast = load ("ast.json")
+    sons = sum (len (n.get ("sons", {})) for n in ast.values ())
+    return {
+        "nodes": len (ast),
+        "sons": max (1, round (sons / len (ast))),
+        "nodesets": len (load ("nodesets.json")),
+        "traversals": len (load ("traversals.json")),
+    }
+
+
+def gen_attrtypes ():
+    return {
+        "Node": {"copy": "function", "ctype": "node*", "init": "NULL"},
+        "Link": {"copy": "hash", "ctype": "node*", "init": "NULL", "persist": True},
+        "String": {"copy": "function", "ctype": "char*", "init": "NULL"},
+        "Int": {"copy": "literal", "ctype": "int", "init": "0", "vtype": "int"},
+        "Bool": {"copy": "literal", "ctype": "bool", "init": "FALSE", "vtype": "int"},
+    }
+
+
+def gen_nodesets (dims):
+    n = dims["nodes"]
+    sets = {}
+    for i in range (dims["nodesets"]):
+        # Every nodeset has 10 members spread over all the nodes.
+        sets["Set%d" % i] = [node_name ((i * 7 + j * 13) % n) for j in range (10)]
+    return sets
+
+
+def target (contains, mandatory=False):
+    return {"phases": "all", "contains": contains, "mandatory": mandatory}
+
+
+def gen_ast (dims):
+    n = dims["nodes"]
+    n_sets = dims["nodesets"]
+    ast = {}
+    for i in range (n):
+        sons = {}
+        for j in range (dims["sons"]):
+            # Sons alternate between single nodes, lists of nodes and
+            # nodesets, so every kind of check is generated.
+            if j % 3 == 0:
+                contains = node_name ((i + j + 1) % n)
+            elif j % 3 == 1:
+                contains = [node_name ((i + j * 5) % n), node_name ((i + j * 11) % n)]
+            else:
+                contains = "Set%d" % ((i + j) % n_sets)
+            sons["Son%d" % j] = {"targets": target (contains)}
+
+        attributes = {
+            "Count": {"type": "Int", "inconstructor": True,
+                      "targets": target ("any", True)},
+            "Name": {"type": "String", "inconstructor": False, "default": "NULL",
+                     "targets": target ("any")},
+            "Ref": {"type": "Link", "inconstructor": False,
+                    "targets": target (node_name ((i + 3) % n))},
+            "Expr": {"type": "Node", "inconstructor": False,
+                     "targets": target ("Set%d" % (i % n_sets))},
+        }
+
+        ast[node_name (i)] = {
+            "description": ["Synthetic node %d." % i],
+            "sons": sons,
+            "attributes": attributes,
+            "flags": {"IsDone": {"default": "FALSE"}, "IsUsed": {}},
+        }
+    return ast
+
+
+def gen_traversals (dims):
+    n = dims["nodes"]
+    travs = {}
+    for i in range (dims["traversals"]):
+        t = {
+            "name": "Synthetic traversal %d" % i,
+            "include": "bench_trav%d.h" % i,
+            "default": ["sons", "none", "error"][i % 3],
+            "travuser": sorted (set (node_name ((i * 3 + j * 17) % n)
+                                     for j in range (TRAVUSER))),
+        }
+        if i % 10 == 1:
+            t["prefun"] = "TR%dpre" % i
+            t["postfun"] = "TR%dpost" % i
+        if i % 10 == 2:
+            t["ifndef"] = "BENCH_NO_TR%d" % i
+        travs[trav_name (i)] = t
+    return travs
+
+
+def setup (root, dims):
+    """Write the json files and the sac2c stand-in into ROOT and return
+       the directory to run the ast-builder from and the SAC2CBASE."""
+    model = os.path.join (root, "model")
+    work = os.path.join (model, "work")
+    base = os.path.join (root, "sac2c")
+    libsac2c = os.path.join (base, "src", "libsac2c")
+
+    os.makedirs (work)
+    for d in GEN_DIRS + ["bench"]:
+        os.makedirs (os.path.join (libsac2c, d))
+
+    files = {
+        "ast.json": gen_ast (dims),
+        "attrtypes.json": gen_attrtypes (),
+        "nodesets.json": gen_nodesets (dims),
+        "traversals.json": gen_traversals (dims),
+    }
+    for fname, content in files.items ():
+        with open (os.path.join (model, fname), "w") as f:
+            json.dump (content, f, indent=4)
+
+    # Every traversal has to provide its include file.
+    for i in range (dims["traversals"]):
+        with open (os.path.join (libsac2c, "bench", "bench_trav%d.h" % i), "w") as f:
+            f.write ("/* Traversal %s.  */\n" % trav_name (i))
+
+    return work, base
+
+
+def run (builder, work, base, jobs):
+    """Run the ast-builder and return the list of its phases."""
+    cmd = [builder, "--sac2cbase", base, "--jobs", str (jobs),
+           "--stats=json"]
+    p = subprocess.run (cmd, cwd=work, stdout=subprocess.PIPE,
+                        stderr=subprocess.PIPE, universal_newlines=True)
+    if p.returncode != 0:
+        die ("`%s' failed:\n%s" % (" ".join (cmd), p.stderr))
+    return json.loads (p.stdout)["phases"]
+
+
+def measure (builder, dims, jobs, repeat, keep):
+    """Return the minimum time of every phase over REPEAT runs together
+       with the total and the bytes written."""
+    root = tempfile.mkdtemp (prefix="ast-builder-bench-")
+    try:
+        work, base = setup (root, dims)
+        best = {}
+        for _ in range (repeat):
+            total = 0.0
+            for p in run (builder, work, base, jobs):
+                total += p["wall_ms"]
+                if p["name"] not in best or p["wall_ms"] < best[p["name"]]["wall_ms"]:
+                    best[p["name"]] = p
+            if "total" not in best or total < best["total"]["wall_ms"]:
+                best["total"] = {"name": "total", "wall_ms": total,
+                                 "bytes": sum (p["bytes"] for p in best.values ()
+                                               if p["name"] != "total")}
+        return best
+    finally:
+        if keep:
+            print ("kept `%s'" % root, file=sys.stderr)
+        else:
+            shutil.rmtree (root)
+
+
+def main ():
+    here = os.path.dirname (os.path.abspath (__file__))
+    ap = argparse.ArgumentParser (description="Benchmark the ast-builder on synthetic models.")
+    ap.add_argument ("--builder", default=os.path.join (here, "..", "ast-builder"),
+                     help="the ast-builder binary")
+    ap.add_argument ("--scales", default="1,10,100",
+                     help="comma-separated list of scales")
+    ap.add_argument ("--dims", default=",".join (DIMS),
+                     help="comma-separated list of dimensions to scale: %s"
+                          % ", ".join (DIMS))
+    ap.add_argument ("--jobs", type=int, default=1,
+                     help="the number of generator threads")
+    ap.add_argument ("--repeat", type=int, default=3,
+                     help="the number of runs of every model")
+    ap.add_argument ("--json", action="store_true",
+                     help="print the results as json")
+    ap.add_argument ("--keep", action="store_true",
+                     help="keep the generated models")
+    args = ap.parse_args ()
+
+    builder = os.path.abspath (args.builder)
+    if not os.access (builder, os.X_OK):
+        die ("cannot execute `%s'" % builder)
+
+    scales = [int (s) for s in args.scales.split (",")]
+    dims = args.dims.split (",")
+    for d in dims:
+        if d not in DIMS:
+            die ("unknown dimension `%s'" % d)
+
+    base = real_base (os.path.join (here, "..", ".."))
+
+    results = {}
+    for d in dims:
+        results[d] = {}
+        for s in scales:
+            model = dict (base)
+            model[d] = base[d] * s
+            print ("%s x%d ..." % (d, s), file=sys.stderr)
+            results[d][s] = measure (builder, model, args.jobs, args.repeat, args.keep)
+
+    if args.json:
+        json.dump (results, sys.stdout, indent=2)
+        print ()
+        return
+
+    for d in dims:
+        print ("== %s (base %d)" % (d, base[d]))
+        phases = list (results[d][scales[0]])
+        print ("%-40s" % "phase" + "".join ("%12s" % ("x%d ms" % s) for s in scales)
+               + "%10s" % "exponent")
+        for name in phases:
+            times = [results[d][s].get (name, {"wall_ms": 0.0})["wall_ms"] for s in scales]
+            # The exponent of the growth between the first and the last
+            # scale; times below 0.05 ms are too noisy to tell.
+            exp = ""
+            if len (scales) > 1 and times[0] >= 0.05 and times[-1] > 0:
+                e = math.log (times[-1] / times[0]) / math.log (scales[-1] / scales[0])
+                exp = "%.2f%s" % (e, " !" if e > SUPERLINEAR else "")
+            print ("%-40s" % name + "".join ("%12.3f" % t for t in times) + "%10s" % exp)
+
+        print ("%-40s" % "throughput MB/s" + "".join (
+            "%12.1f" % (results[d][s]["total"]["bytes"]
+                        / max (results[d][s]["total"]["wall_ms"], 1e-3) / 1e3)
+            for s in scales))
+        print ()
+
+
+if __name__ == "__main__":
+    main ()
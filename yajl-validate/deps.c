@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "deps.h"
+
+
+#define DEPS_MAGIC "ast-builder deps 2"
+
+
+/* Names of the parts of the model in the order of their bits.  */
+static const char *  part_names[] =
+{
+  "nodes", "sons", "attributes", "flags", "checks",
+  "nodesets", "traversals", "attrtypes", "targets"
+};
+
+
+static const char *
+part_name (enum model_part part)
+{
+  for (size_t i = 0; i < sizeof (part_names) / sizeof (part_names[0]); i++)
+    if (part == 1u << i)
+      return part_names[i];
+
+  assert (false);
+  return NULL;
+}
+
+
+static inline uint64_t
+hash_str (uint64_t h, const char *  s)
+{
+  /* NULL and the empty string have to differ.  */
+  return s ? model_hash (h, s, strlen (s) + 1) : model_hash (h, "\377", 1);
+}
+
+
+static inline uint64_t
+hash_size (uint64_t h, size_t n)
+{
+  uint64_t x = n;
+  return model_hash (h, &x, sizeof (x));
+}
+
+
+static uint64_t
+hash_targets (uint64_t h, const struct model_target *  targets, size_t n)
+{
+  h = hash_size (h, n);
+  for (size_t i = 0; i < n; i++)
+    {
+      const struct model_target *  t = &targets[i];
+
+      h = hash_size (h, t->all_phases_p);
+      h = hash_size (h, t->n_phases);
+      for (size_t j = 0; j < t->n_phases; j++)
+        {
+          h = hash_str (h, t->phases[j].phase);
+          h = hash_str (h, t->phases[j].from);
+          h = hash_str (h, t->phases[j].to);
+        }
+
+      h = hash_size (h, t->contains_list_p);
+      h = hash_size (h, t->n_contains);
+      for (size_t j = 0; j < t->n_contains; j++)
+        h = hash_str (h, t->contains[j].name);
+
+      h = hash_size (h, t->mandatory);
+    }
+
+  return h;
+}
+
+
+static void
+deps_add (struct deps_entity **  entities, enum model_part part,
+          const char *  name, uint64_t hash)
+{
+  const char *  pname = part_name (part);
+  struct deps_entity *  e = malloc (sizeof (*e));
+
+  e->key = malloc (strlen (pname) + strlen (name) + 2);
+  sprintf (e->key, "%s/%s", pname, name);
+  e->part = part;
+  e->hash = hash;
+  HASH_ADD_KEYPTR (hh, *entities, e->key, strlen (e->key), e);
+}
+
+
+struct deps_entity *
+deps_entities (const struct model *  m)
+{
+  struct deps_entity *  entities = NULL;
+  uint64_t list;
+
+  /* The order of the nodes matters as well as their names.  The
+     entity `*' of every part stands for the list of its items.  */
+  list = MODEL_HASH_INIT;
+  for (size_t i = 0; i < m->n_nodes; i++)
+    list = hash_str (list, m->nodes[i].name->name);
+  deps_add (&entities, mp_nodes, "*", list);
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+      const char *  name = node->name->name;
+      uint64_t h;
+
+      h = hash_size (MODEL_HASH_INIT, node->n_sons);
+      for (size_t j = 0; j < node->n_sons; j++)
+        {
+          h = hash_str (h, node->sons[j].name->name);
+          h = hash_str (h, node->sons[j].def);
+        }
+      deps_add (&entities, mp_sons, name, h);
+
+      h = hash_size (MODEL_HASH_INIT, node->n_attributes);
+      for (size_t j = 0; j < node->n_attributes; j++)
+        {
+          const struct model_attribute *  a = &node->attributes[j];
+
+          h = hash_str (h, a->name->name);
+          h = hash_str (h, a->type->name);
+          h = hash_str (h, a->def);
+          h = hash_size (h, a->inconstructor);
+          h = hash_size (h, a->cold);
+        }
+      h = hash_size (h, node->reorder);
+      deps_add (&entities, mp_attributes, name, h);
+
+      /* The fields are identified by their position, as their names
+         are covered by the sons and the attributes.  */
+      h = MODEL_HASH_INIT;
+      for (size_t j = 0; j < node->n_sons; j++)
+        h = hash_targets (h, node->sons[j].targets, node->sons[j].n_targets);
+      for (size_t j = 0; j < node->n_attributes; j++)
+        h = hash_targets (h, node->attributes[j].targets,
+                          node->attributes[j].n_targets);
+      deps_add (&entities, mp_targets, name, h);
+
+      h = hash_size (MODEL_HASH_INIT, node->n_flags);
+      for (size_t j = 0; j < node->n_flags; j++)
+        {
+          h = hash_str (h, node->flags[j].name->name);
+          h = hash_str (h, node->flags[j].def);
+        }
+      deps_add (&entities, mp_flags, name, h);
+
+      h = hash_size (MODEL_HASH_INIT, node->n_checks);
+      for (size_t j = 0; j < node->n_checks; j++)
+        h = hash_str (h, node->checks[j]);
+      deps_add (&entities, mp_checks, name, h);
+    }
+
+  list = MODEL_HASH_INIT;
+  for (size_t i = 0; i < m->n_nodesets; i++)
+    {
+      const struct model_nodeset *  ns = &m->nodesets[i];
+      uint64_t h = hash_size (MODEL_HASH_INIT, ns->n_nodes);
+
+      for (size_t j = 0; j < ns->n_nodes; j++)
+        h = hash_str (h, ns->nodes[j]->name->name);
+
+      list = hash_str (list, ns->name->name);
+      deps_add (&entities, mp_nodesets, ns->name->name, h);
+    }
+  deps_add (&entities, mp_nodesets, "*", list);
+
+  list = MODEL_HASH_INIT;
+  for (size_t i = 0; i < m->n_traversals; i++)
+    {
+      const struct model_traversal *  t = &m->traversals[i];
+      uint64_t h = MODEL_HASH_INIT;
+
+      h = hash_str (h, t->include);
+      h = hash_str (h, t->ifndef);
+      h = hash_str (h, t->prefun);
+      h = hash_str (h, t->postfun);
+      h = hash_str (h, t->def);
+      for (size_t j = 0; j < m->n_nodes; j++)
+        h = hash_size (h, t->node_types[j]);
+
+      list = hash_str (list, t->name->name);
+      deps_add (&entities, mp_traversals, t->name->name, h);
+    }
+  deps_add (&entities, mp_traversals, "*", list);
+
+  list = MODEL_HASH_INIT;
+  for (size_t i = 0; i < m->n_attrtypes; i++)
+    {
+      const struct attrtype_name *  at = m->attrtypes[i];
+      uint64_t h = MODEL_HASH_INIT;
+
+      h = hash_size (h, at->copy_type);
+      h = hash_str (h, at->ctype);
+      h = hash_str (h, at->vtype);
+      h = hash_str (h, at->init);
+      h = hash_size (h, at->persist);
+      h = hash_size (h, at->size);
+      h = hash_size (h, at->align);
+
+      list = hash_str (list, at->name);
+      deps_add (&entities, mp_attrtypes, at->name, h);
+    }
+  deps_add (&entities, mp_attrtypes, "*", list);
+
+  return entities;
+}
+
+
+void
+deps_add_setting (struct deps_entity **  entities, enum model_part part,
+                  const char *  name, const char *  value)
+{
+  char key[strlen (name) + 2];
+
+  /* Settings cannot clash with the names of the model.  */
+  sprintf (key, "@%s", name);
+  deps_add (entities, part, key, hash_str (MODEL_HASH_INIT, value));
+}
+
+
+void
+deps_free (struct deps_entity *  entities)
+{
+  struct deps_entity *  e;
+  struct deps_entity *  tmp;
+
+  HASH_ITER (hh, entities, e, tmp)
+    {
+      HASH_DEL (entities, e);
+      free (e->key);
+      free (e);
+    }
+}
+
+
+/* The part of the entity with the key KEY or 0 if it is unknown.  */
+static unsigned
+part_of_key (const char *  key)
+{
+  for (size_t i = 0; i < sizeof (part_names) / sizeof (part_names[0]); i++)
+    {
+      size_t len = strlen (part_names[i]);
+
+      if (!strncmp (key, part_names[i], len) && key[len] == '/')
+        return 1u << i;
+    }
+
+  return 0;
+}
+
+
+unsigned
+deps_changed_parts (const char *  fname, struct deps_entity *  entities)
+{
+  struct deps_entity *  saved = NULL;
+  struct deps_entity *  e;
+  struct deps_entity *  x;
+  unsigned changed = 0;
+  char *  line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  FILE *  f;
+
+  if (!(f = fopen (fname, "r")))
+    return mp_all;
+
+  if (getline (&line, &size, f) <= 0 || strcmp (line, DEPS_MAGIC "\n"))
+    changed = mp_all;
+
+  /* Every line is the hash and the key of an entity.  */
+  while (!changed && (len = getline (&line, &size, f)) > 0)
+    {
+      unsigned long long hash;
+      unsigned part;
+      int pos;
+
+      if (line[len - 1] == '\n')
+        line[len - 1] = '\0';
+
+      if (1 != sscanf (line, "%llx %n", &hash, &pos)
+          || !(part = part_of_key (&line[pos])))
+        {
+          changed = mp_all;
+          break;
+        }
+
+      e = malloc (sizeof (*e));
+      e->key = strdup (&line[pos]);
+      e->part = part;
+      e->hash = hash;
+      HASH_ADD_KEYPTR (hh, saved, e->key, strlen (e->key), e);
+    }
+
+  free (line);
+  fclose (f);
+
+  /* An entity that changed, appeared or disappeared marks its part
+     as changed.  */
+  for (e = entities; e && !changed; e = e->hh.next)
+    {
+      HASH_FIND_STR (saved, e->key, x);
+      if (!x || x->hash != e->hash)
+        changed |= e->part;
+    }
+
+  for (e = saved; e && changed != mp_all; e = e->hh.next)
+    {
+      HASH_FIND_STR (entities, e->key, x);
+      if (!x)
+        changed |= e->part;
+    }
+
+  deps_free (saved);
+  return changed;
+}
+
+
+bool
+deps_save (const char *  fname, struct deps_entity *  entities)
+{
+  struct deps_entity *  e;
+  char *  buf = NULL;
+  size_t size = 0;
+  FILE *  f;
+  bool ret;
+
+  if (!(f = open_memstream (&buf, &size)))
+    err_func (open_memstream);
+
+  fprintf (f, DEPS_MAGIC "\n");
+  for (e = entities; e; e = e->hh.next)
+    fprintf (f, "%016llx %s\n", (unsigned long long) e->hash, e->key);
+
+  if (0 != fclose (f))
+    err_func (fclose);
+
+  ret = replace_file (fname, buf, size);
+  free (buf);
+  return ret;
+}
+
+
+bool
+deps_write_depfile (const char *  fname, char *const *  outputs,
+                    const unsigned *  reads, size_t n,
+                    const char *  generator,
+                    const char *const *  inputs,
+                    const char *const *  extra_inputs)
+{
+  char *  buf = NULL;
+  size_t size = 0;
+  FILE *  f;
+  bool ret;
+
+  if (!(f = open_memstream (&buf, &size)))
+    err_func (open_memstream);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      /* Several parts live in the same file, so every input is listed
+         once.  */
+      const char *  listed[2 * sizeof (part_names) / sizeof (part_names[0])];
+      size_t n_listed = 0;
+
+      fprintf (f, "%s: %s", outputs[i], generator);
+      for (size_t j = 0; j < 2 * sizeof (part_names) / sizeof (part_names[0]); j++)
+        {
+          const size_t n_parts = sizeof (part_names) / sizeof (part_names[0]);
+          const char *  input = j < n_parts ? inputs[j] : extra_inputs[j - n_parts];
+          bool dup = false;
+
+          if (!input || !(reads[i] & (1u << (j % n_parts))))
+            continue;
+
+          for (size_t k = 0; k < n_listed; k++)
+            dup = dup || !strcmp (listed[k], input);
+
+          if (!dup)
+            {
+              fprintf (f, " %s", input);
+              listed[n_listed++] = input;
+            }
+        }
+      fprintf (f, "\n");
+    }
+
+  if (0 != fclose (f))
+    err_func (fclose);
+
+  ret = replace_file (fname, buf, size);
+  free (buf);
+  return ret;
+}
@@ -0,0 +1,79 @@
+#ifndef __DEPS_H__
+#define __DEPS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "model.h"
+
+
+/* Parts of the model a generated file can depend on.  */
+enum model_part
+{
+  /* The list of nodes and their names.  */
+  mp_nodes = 1 << 0,
+  /* Sons, attributes, flags and checks of every node.  */
+  mp_sons = 1 << 1,
+  mp_attributes = 1 << 2,
+  mp_flags = 1 << 3,
+  mp_checks = 1 << 4,
+  mp_nodesets = 1 << 5,
+  mp_traversals = 1 << 6,
+  mp_attrtypes = 1 << 7,
+  /* The targets of the sons and the attributes of every node, which
+     only few files read.  */
+  mp_targets = 1 << 8,
+  mp_all = (1 << 9) - 1
+};
+
+
+/* A hash of a single entity of the model, like the sons of the node
+   `Fundef' or the traversal `CHK', or the list of all the entities of
+   one kind.  */
+struct deps_entity
+{
+  char *  key;
+  enum model_part part;
+  uint64_t hash;
+  UT_hash_handle hh;
+};
+
+
+/* Compute the hashes of all the entities of the model M.  */
+struct deps_entity * deps_entities (const struct model *  m);
+
+
+/* Add to ENTITIES a setting NAME of the run with the value VALUE that
+   changes the generated files reading the part PART of the model, so
+   that changing the setting regenerates them.  */
+void deps_add_setting (struct deps_entity **  entities, enum model_part part,
+                       const char *  name, const char *  value);
+
+
+/* Free the hash table ENTITIES.  */
+void deps_free (struct deps_entity *  entities);
+
+
+/* Compare ENTITIES with the ones saved in the file FNAME and return the
+   parts of the model that changed.  If the file cannot be read, all
+   the parts are considered changed.  */
+unsigned deps_changed_parts (const char *  fname, struct deps_entity *  entities);
+
+
+/* Save the hashes ENTITIES into the file FNAME.  */
+bool deps_save (const char *  fname, struct deps_entity *  entities);
+
+
+/* Write a Make rule for each of the N generated files OUTPUTS that
+   lists the generator GENERATOR and the json files containing the parts
+   READS of the model the generated file depends on.  INPUTS maps every
+   part to its json file and EXTRA_INPUTS to a file from the command line
+   that changes it as well, or NULL.  */
+bool deps_write_depfile (const char *  fname, char *const *  outputs,
+                         const unsigned *  reads, size_t n,
+                         const char *  generator,
+                         const char *const *  inputs,
+                         const char *const *  extra_inputs);
+
+
+#endif // __DEPS_H__
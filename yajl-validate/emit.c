@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <err.h>
+
+#include <sys/types.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "emit.h"
+
+
+void
+emit_grow (struct emitter *  e, size_t n)
+{
+  size_t cap = e->cap ? e->cap : 4096;
+
+  while (cap - e->size < n)
+    cap *= 2;
+
+  if (!(e->buf = realloc (e->buf, cap)))
+    err_func (realloc);
+
+  e->cap = cap;
+}
+
+
+void
+emit_size (struct emitter *  e, size_t x)
+{
+  char digits[3 * sizeof (x)];
+  char *  p = digits + sizeof (digits);
+
+  do
+    {
+      *--p = '0' + x % 10;
+      x /= 10;
+    }
+  while (x);
+
+  emit_mem (e, p, digits + sizeof (digits) - p);
+}
+
+
+static void
+emit_ssize (struct emitter *  e, long long x)
+{
+  if (x < 0)
+    {
+      emit_char (e, '-');
+      emit_size (e, -(unsigned long long) x);
+    }
+  else
+    emit_size (e, x);
+}
+
+
+void
+emit_padded (struct emitter *  e, const char *  s, size_t width)
+{
+  size_t len = strlen (s);
+
+  if (len < width)
+    emit_indent (e, width - len);
+
+  emit_mem (e, s, len);
+}
+
+
+/* Append the conversion of FORMAT that starts at P, after its `%', with
+   snprintf and return the position after it.  The argument is taken
+   from ARGS according to the conversion.  A conversion that is not
+   understood is fatal, as its argument cannot be skipped.  */
+static const char *
+emit_conversion (struct emitter *  e, const char *  format, const char *  p,
+                 va_list *  args)
+{
+  const char *  start = p - 1;
+  char spec[64];
+  char buf[512];
+  char length[3] = "";
+  int star[2];
+  size_t n_stars = 0;
+  int len;
+
+  p += strspn (p, "-+ #0'");
+  for (int i = 0; i < 2; i++)
+    {
+      if (i == 1 && *p != '.')
+        break;
+      if (i == 1)
+        p++;
+      if (*p == '*')
+        {
+          star[n_stars++] = va_arg (*args, int);
+          p++;
+        }
+      else
+        p += strspn (p, "0123456789");
+    }
+
+  for (size_t i = 0; i < 2 && strchr ("hljztL", *p) && *p; i++)
+    length[i] = *p++;
+
+  if (!*p || (size_t) (p + 1 - start) >= sizeof (spec))
+    errx (EXIT_FAILURE, "unsupported conversion in the format `%s'", format);
+
+  memcpy (spec, start, p + 1 - start);
+  spec[p + 1 - start] = '\0';
+
+#define CONVERT(__type)                                                 \
+  do                                                                    \
+    {                                                                   \
+      __type x = va_arg (*args, __type);                                \
+      len = n_stars == 2 ? snprintf (buf, sizeof (buf), spec, star[0], star[1], x) \
+            : n_stars == 1 ? snprintf (buf, sizeof (buf), spec, star[0], x) \
+            : snprintf (buf, sizeof (buf), spec, x);                    \
+    }                                                                   \
+  while (0)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  switch (*p)
+    {
+    case 'd': case 'i':
+    case 'u': case 'o': case 'x': case 'X':
+      if (!strcmp (length, "l"))
+        CONVERT (long);
+      else if (!strcmp (length, "ll"))
+        CONVERT (long long);
+      else if (!strcmp (length, "z"))
+        CONVERT (size_t);
+      else if (!strcmp (length, "j"))
+        CONVERT (intmax_t);
+      else if (!strcmp (length, "t"))
+        CONVERT (ptrdiff_t);
+      else if (!length[0] || !strcmp (length, "h") || !strcmp (length, "hh"))
+        CONVERT (int);
+      else
+        errx (EXIT_FAILURE, "unsupported conversion `%s' in the format `%s'",
+              spec, format);
+      break;
+
+    case 'c':
+      CONVERT (int);
+      break;
+
+    case 's':
+      CONVERT (const char *);
+      break;
+
+    case 'p':
+      CONVERT (void *);
+      break;
+
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':
+      if (!strcmp (length, "L"))
+        CONVERT (long double);
+      else
+        CONVERT (double);
+      break;
+
+    default:
+      errx (EXIT_FAILURE, "unsupported conversion `%s' in the format `%s'",
+            spec, format);
+    }
+#pragma GCC diagnostic pop
+#undef CONVERT
+
+  if (len < 0 || (size_t) len >= sizeof (buf))
+    errx (EXIT_FAILURE, "the conversion `%s' of the format `%s' is too long",
+          spec, format);
+
+  emit_mem (e, buf, len);
+  return p + 1;
+}
+
+
+void
+emit_vfmt (struct emitter *  e, const char *  format, va_list args)
+{
+  const char *  p = format;
+  va_list ap;
+
+  /* The va_list is passed on by address, which is only portable for a
+     copy.  */
+  va_copy (ap, args);
+
+  while (true)
+    {
+      const char *  q = strchr (p, '%');
+      const char *  conv;
+      size_t width = 0;
+
+      if (!q)
+        {
+          emit_str (e, p);
+          va_end (ap);
+          return;
+        }
+
+      emit_mem (e, p, q - p);
+      p = conv = q + 1;
+
+      while (*p >= '0' && *p <= '9')
+        width = width * 10 + (*p++ - '0');
+
+      if (*p == '%' && p == conv)
+        {
+          emit_char (e, '%');
+          p++;
+        }
+      else if (*p == 's')
+        {
+          emit_padded (e, va_arg (ap, const char *), width);
+          p++;
+        }
+      else if (*p == 'd' && p == conv)
+        {
+          emit_ssize (e, va_arg (ap, int));
+          p++;
+        }
+      else if (*p == 'z' && p == conv && p[1] == 'u')
+        {
+          emit_size (e, va_arg (ap, size_t));
+          p += 2;
+        }
+      else if (*p == 'z' && p == conv && p[1] == 'd')
+        {
+          emit_ssize (e, va_arg (ap, ssize_t));
+          p += 2;
+        }
+      else
+        p = emit_conversion (e, format, conv, &ap);
+    }
+}
+
+
+void
+emit_fmt (struct emitter *  e, const char *  format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  emit_vfmt (e, format, args);
+  va_end (args);
+}
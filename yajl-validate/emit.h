@@ -0,0 +1,82 @@
+#ifndef __EMIT_H__
+#define __EMIT_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+
+/* An append-only buffer that holds the content of a generated file.
+   The text is copied into the buffer with the primitives below, which
+   do not go through stdio.  */
+struct emitter
+{
+  char *  buf;
+  size_t size;
+  size_t cap;
+};
+
+
+/* Make room for at least N more bytes in E.  */
+void emit_grow (struct emitter *  e, size_t n);
+
+
+static inline void
+emit_mem (struct emitter *  e, const char *  s, size_t n)
+{
+  if (e->cap - e->size < n)
+    emit_grow (e, n);
+
+  memcpy (e->buf + e->size, s, n);
+  e->size += n;
+}
+
+
+static inline void
+emit_str (struct emitter *  e, const char *  s)
+{
+  emit_mem (e, s, strlen (s));
+}
+
+
+static inline void
+emit_char (struct emitter *  e, char c)
+{
+  if (e->cap == e->size)
+    emit_grow (e, 1);
+
+  e->buf[e->size++] = c;
+}
+
+
+/* Append N spaces.  */
+static inline void
+emit_indent (struct emitter *  e, size_t n)
+{
+  if (e->cap - e->size < n)
+    emit_grow (e, n);
+
+  memset (e->buf + e->size, ' ', n);
+  e->size += n;
+}
+
+
+/* Append the decimal representation of X.  */
+void emit_size (struct emitter *  e, size_t x);
+
+
+/* Append S right-aligned in a field of WIDTH characters.  */
+void emit_padded (struct emitter *  e, const char *  s, size_t width);
+
+
+/* Append the text described by FORMAT.  The conversions used by the
+   generators, `%s', `%Ns' with a field width N, `%zu', `%zd', `%d' and
+   `%%', are appended directly; the other ones of printf go through
+   snprintf.  Literal parts of the format are copied as a whole.  */
+void emit_fmt (struct emitter *  e, const char *  format, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+void emit_vfmt (struct emitter *  e, const char *  format, va_list args);
+
+
+#endif // __EMIT_H__
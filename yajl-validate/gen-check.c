@@ -1,524 +1,926 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <regex.h>
 #include <err.h>
 #include <yajl/yajl_tree.h>
 #include "ast-builder.h"
 #include "gen.h"
+#include "layout.h"
+#include "phases.h"
 
 
-/* Generate is<nodeset> functions for every nodeset, checking if the
-   argument passed to such a function is of allowed node type.  */
-static inline bool
-check_gen_is_functions (FILE *  f, yajl_val nodesets)
+/* Convert `contains' to text which later will be used to produce
+   an error message in case a node is not within the range of values
+   allowed by `contains'.  */
+static inline void
+gen_contains_expected (struct emitter *  f, const struct model_target *  target)
 {
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodesets); i++)
-    {
-      const char *  nname = YAJL_OBJECT_KEYS (nodesets)[i];
-      const yajl_val nnodes = YAJL_OBJECT_VALUES (nodesets)[i];
-
-      fprintf (f, "static inline bool\n"
-                  "is%s (node *  arg_node)\n"
-                  "{\n"
-                  "  return ",
-               nname);
-
-      for (size_t i = 0; i < YAJL_ARRAY_LENGTH (nnodes); i++)
-        {
-          const char *  node_name = YAJL_STRING_VALUE (YAJL_ARRAY_VALUES (nnodes)[i]);
-          char * node_name_lower = string_tolower (node_name);
+  if (!target->contains_list_p)
+    emit_fmt (f, "%s `%s'",
+              target->contains[0].nodeset ? "nodeset" : "node",
+              target->contains[0].name);
+  else
+    for (size_t i = 0; i < target->n_contains; i++)
+      {
+        const struct model_contains *  item = &target->contains[i];
+        assert (item->node || item->nodeset);
 
-          fprintf (f, "%sNODE_TYPE (arg_node) == N_%s%s\n",
-                   /* put `||' if it is not the first occurrence.  */
-                   i == 0 ? "" : "         || ",
-                   node_name_lower,
-                   /* put `;' if it is the last occurrence.  */
-                   i == YAJL_ARRAY_LENGTH (nnodes) - 1 ? ";" : "");
+        emit_fmt (f, "%s%s `%s'",
+                  i == 0 ? "either " : " or ",
+                  item->node ? "node" : "nodeset",
+                  item->name);
+      }
 
-          free (node_name_lower);
-        }
+}
 
-      fprintf (f, "}\n\n");
-    }
 
-  /* the original XSL file also generates `isDummy' function, but as far as it
-     is not being used anywhere in the sac2c code, we don't generate it.  */
+/* A row of a table of bitsets, the node types allowed by a target or
+   the phases in which it applies.  Rules with the same set share the
+   row.  */
+struct chk_bitset
+{
+  unsigned char *  bits;
+  size_t id;
+  UT_hash_handle hh;
+};
 
-  return true;
-}
 
+/* The tables of the generated checker.  They are collected while walking
+   the nodes and written out together.  */
+struct chk_tables
+{
+  struct emitter phases;
+  struct emitter types;
+  struct emitter rules;
+  struct emitter sons;
+  struct emitter nodes;
+
+  size_t n_phases;
+  size_t n_types;
+  size_t n_rules;
+  size_t n_sons;
+
+  /* The size of a row of CHK_TYPES.  */
+  size_t n_bytes;
+  struct chk_bitset *  typesets;
+
+  /* With the order of the phases, the phases of the targets are rows
+     of CHK_PHASE_MASKS instead of ranges of CHK_PHASES.  */
+  const struct phase_order *  po;
+  size_t mask_bytes;
+  struct chk_bitset *  masks;
+};
+
+
+/* Find the row BITS in the table SETS of *N rows written to ROWS, adding
+   it when it is new.  BITS is taken over.  */
+static size_t
+chk_bitset_row (struct chk_bitset **  sets, size_t *  n, struct emitter *  rows,
+                unsigned char *  bits, size_t n_bytes)
+{
+  struct chk_bitset *  bs;
 
-/* Convert a value of a phase into the appropriate condition:
+  HASH_FIND (hh, *sets, bits, n_bytes, bs);
+  if (bs)
+    {
+      free (bits);
+      return bs->id;
+    }
 
-       * If it is a string, it means that this string encodes a phase,
-         thus the condition will be:
+  if (!(bs = malloc (sizeof (*bs))))
+    err_func (malloc);
 
-                   global.compiler_anyphase == PH_<phase>
+  bs->bits = bits;
+  bs->id = (*n)++;
+  HASH_ADD_KEYPTR (hh, *sets, bs->bits, n_bytes, bs);
+  gen_nodetype_bitset (rows, bits, n_bytes);
 
-       * If it is an object containing keys `from' and `to', it encodes
-         a range and results in the condition:
+  return bs->id;
+}
 
-                  global.compiler_anyphase >= PH_<from>
-                  && global.compiler_anyphase < PH_<to>  */
 
-static inline void
-gen_phase_condition (FILE *  f, yajl_val phase)
+static void
+chk_bitsets_free (struct chk_bitset *  sets)
 {
-  if (YAJL_IS_STRING (phase))
-    fprintf (f, "global.compiler_anyphase == PH_%s", YAJL_GET_STRING (phase));
-  else if (YAJL_IS_OBJECT (phase))
-    {
-      yajl_val fr = yajl_tree_get (phase, (const char *[]){"from", 0}, yajl_t_string);
-      yajl_val to = yajl_tree_get (phase, (const char *[]){"to", 0}, yajl_t_string);
-      assert (fr && to);
+  struct chk_bitset *  bs;
+  struct chk_bitset *  tmp;
 
-      fprintf (f, "(global.compiler_anyphase >= PH_%s &&"
-                  " global.compiler_anyphase < PH_%s)",
-                  YAJL_GET_STRING (fr), YAJL_GET_STRING (to));
+  HASH_ITER (hh, sets, bs, tmp)
+    {
+      HASH_DEL (sets, bs);
+      free (bs->bits);
+      free (bs);
     }
-  else
-    assert (0);
 }
 
 
-/* Phases may be of type array, in which case, evey value inside
-   the array is either a string or an object.  */
-static inline void
-gen_phases_condition (FILE *  f, yajl_val phases)
+/* Find the row of CHK_TYPES with the node types allowed by TARGET, adding
+   it when it is new.  Return false when TARGET allows any node.  */
+static bool
+chk_typeset (struct chk_tables *  t, const struct model *  m,
+             const struct model_target *  target, size_t *  id)
 {
-  if (YAJL_IS_STRING (phases) || YAJL_IS_OBJECT (phases))
-    gen_phase_condition (f, phases);
-  else if (YAJL_IS_ARRAY (phases))
-    for (size_t i = 0; i < YAJL_ARRAY_LENGTH (phases); i++)
-      {
-        if (i > 0)
-          fprintf (f, " || ");
+  unsigned char *  bits = calloc (t->n_bytes, 1);
 
-        gen_phase_condition (f, YAJL_ARRAY_VALUES (phases)[i]);
-      }
+  if (!bits)
+    err_func (calloc);
+
+  for (size_t i = 0; i < target->n_contains; i++)
+    {
+      const struct model_contains *  item = &target->contains[i];
+
+      if (item->node)
+        nodetype_bitset_add (bits, m, item->node);
+      else if (item->nodeset)
+        for (size_t j = 0; j < item->nodeset->n_nodes; j++)
+          nodetype_bitset_add (bits, m, item->nodeset->nodes[j]);
+      else
+        {
+          free (bits);
+          return false;
+        }
+    }
+
+  *id = chk_bitset_row (&t->typesets, &t->n_types, &t->types, bits, t->n_bytes);
+  return true;
 }
 
 
-/* Convert `contains' to text which later will be used to produce
-   an error message in case a node is not within the range of values
-   allowed by `contains'.  */
-static inline void
-gen_contains_expected (FILE *  f, yajl_val contains)
+/* Generate the rule of TARGET for the field NAME of NODE.  FIELD is the
+   macro that describes the field in the rule.  The allowed node types
+   are only checked when TYPES_P is set and TARGET does not allow any
+   node.  */
+static void
+gen_rule (struct chk_tables *  t, const struct model *  m,
+          const struct model_node *  node, const struct model_name *  name,
+          const char *  field, bool son_p, const struct model_target *  target,
+          bool last_p, bool types_p)
 {
-  struct node_name *  nn;
+  const char *  node_name_upper = node->name->upper;
+  size_t phases = t->n_phases;
+  size_t types = 0;
+  bool flag_p = false;
+
+  types_p = types_p && chk_typeset (t, m, target, &types);
 
-  if (YAJL_IS_STRING (contains))
+  if (t->po && !target->all_phases_p)
     {
-      const char *  contains_name = YAJL_GET_STRING (contains);
-      HASH_FIND_STR (node_names, contains_name, nn);
-      //assert (nn);
+      unsigned char *  mask = calloc (t->mask_bytes, 1);
+
+      if (!mask)
+        err_func (calloc);
 
-      fprintf (f, "%s `%s'",
-                 (!nn || nn->name_type == nnt_node) ? "node" : "nodeset",
-                 contains_name);
+      phases_target_mask (t->po, target, mask);
+      phases = chk_bitset_row (&t->masks, &t->n_phases, &t->phases, mask,
+                               t->mask_bytes);
     }
-  else if (YAJL_IS_ARRAY (contains))
-    for (size_t i = 0; i < YAJL_ARRAY_LENGTH (contains); i++)
+  else if (!target->all_phases_p)
+    for (size_t i = 0; i < target->n_phases; i++)
       {
-        const char *  contains_name = YAJL_GET_STRING (YAJL_ARRAY_VALUES (contains)[i]);
+        const struct model_phase *  phase = &target->phases[i];
 
-        HASH_FIND_STR (node_names, contains_name, nn);
-        assert (nn);
+        if (phase->phase)
+          emit_fmt (&t->phases, "  { PH_%s, PH_%s + 1 },\n",
+                    phase->phase, phase->phase);
+        else
+          emit_fmt (&t->phases, "  { PH_%s, PH_%s },\n", phase->from, phase->to);
 
-        fprintf (f, "%s%s `%s'",
-                 i == 0 ? "either " : " or ",
-                 nn->name_type == nnt_node ? "node" : "nodeset",
-                 nn->name);
+        t->n_phases++;
       }
 
-}
-
+  emit_fmt (&t->rules, "  { %s (N_%s, %s), ",
+            field, node_name_upper, name->name);
+  emit_size (&t->rules, phases);
+  emit_str (&t->rules, ", ");
+  emit_size (&t->rules, t->po ? 0 : t->n_phases - phases);
+  emit_str (&t->rules, ", ");
+  emit_size (&t->rules, types);
+  emit_str (&t->rules, ",\n    ");
+
+#define FLAG(__p, __flag)                         \
+  if (__p)                                        \
+    {                                             \
+      emit_str (&t->rules, flag_p ? " | " : "");  \
+      emit_str (&t->rules, __flag);               \
+      flag_p = true;                              \
+    }
 
+  FLAG (son_p, "CHK_SON");
+  FLAG (target->mandatory, "CHK_MANDATORY");
+  FLAG (target->all_phases_p, "CHK_ALL_PHASES");
+  FLAG (last_p, "CHK_LAST");
+  FLAG (types_p, "CHK_TYPES");
+  if (!flag_p)
+    emit_str (&t->rules, "0");
+#undef FLAG
 
-/* Helper function for GEN_CONTAINS_CONDITION.  Generates part of the condition resulting
-   for a particular node or nodeset from the `contains' specification of a `target'.
-   CONTAINS_NAME is the node of the name or a node or nodeset;
-   IS_FIRST specifies whether to generate `||' before the condition.  */
-static inline void
-gen_contains_item (FILE *  f, const char *  contains_name, const char *  node_name_upper,
-                   const char *  son_name_upper, bool is_first)
-{
-  struct node_name *  nn;
+  emit_str (&t->rules, ",\n");
 
-  HASH_FIND_STR (node_names, contains_name, nn);
-  assert (nn);
+  if (target->mandatory)
+    emit_fmt (&t->rules, "    \"mandatory %s %s_%s is NULL\",\n",
+              son_p ? "son" : "attribute", node_name_upper, name->upper);
+  else
+    emit_str (&t->rules, "    NULL,\n");
 
-  if (nn->name_type == nnt_node)
+  if (types_p)
     {
-      char *  contains_name_lower = string_tolower (contains_name);
-      fprintf (f, "%sNODE_TYPE (%s_%s (arg_node)) != N_%s",
-               is_first ? "" : " && ",
-               node_name_upper, son_name_upper,
-               contains_name_lower);
-      free (contains_name_lower);
+      emit_fmt (&t->rules, "    \"%s_%s hasnt the right type.\"\n"
+                           "    \"It should be: ",
+                node_name_upper, name->upper);
+      gen_contains_expected (&t->rules, target);
+      emit_str (&t->rules, "\",\n");
     }
   else
-    fprintf (f, "%s!is%s (%s_%s (arg_node))",
-             is_first ? "" : " && ",
-             contains_name,
-             node_name_upper, son_name_upper);
+    emit_str (&t->rules, "    NULL,\n");
 
+  /* A field with a target for all phases is never required to be NULL.  */
+  if (last_p && !target->all_phases_p)
+    emit_fmt (&t->rules, "    \"attribute %s_%s must be NULL\" },\n",
+              node_name_upper, name->upper);
+  else
+    emit_str (&t->rules, "    NULL },\n");
+
+  t->n_rules++;
+  assert (t->n_rules <= UINT16_MAX && t->n_phases <= UINT16_MAX
+          && t->n_types <= UINT16_MAX);
 }
 
 
-/* FIXME This can be unified with the similar code in `gen-node-basic.c'  */
-static inline void
-gen_contains_condition (FILE *  f, yajl_val contains, const char *  node_name_upper,
-                       const char *  son_name_upper)
+/* Whether a target of SON allows the node NODE.  */
+static bool
+son_may_contain (const struct model_son *  son, const struct model_node *  node)
 {
-  fprintf (f, "%s_%s (arg_node) && ",
-           node_name_upper, son_name_upper);
-
-  if (YAJL_IS_STRING (contains))
-    gen_contains_item (f, YAJL_GET_STRING (contains), node_name_upper, son_name_upper, true);
-  else if (YAJL_IS_ARRAY (contains))
-    for (size_t i = 0; i < YAJL_ARRAY_LENGTH (contains); i++)
-      gen_contains_item (f, YAJL_GET_STRING (YAJL_ARRAY_VALUES (contains)[i]),
-                         node_name_upper, son_name_upper, i == 0);
-  else
-    abort ();
-}
+  for (size_t i = 0; i < son->n_targets; i++)
+    for (size_t j = 0; j < son->targets[i].n_contains; j++)
+      {
+        const struct model_contains *  item = &son->targets[i].contains[j];
 
+        if (item->node == node)
+          return true;
 
-static inline void
-gen_son_target_check_body (FILE *  f, const yajl_val mandatory, const yajl_val contains,
-                           const char *  node_name_upper, const char *  son_name_upper,
-                           const char *  indent)
-{
-  if (YAJL_IS_TRUE (mandatory))
-    fprintf (f, "%s  CHKexistSon (%s_%s (arg_node), arg_node,\n"
-                "%s               \"mandatory son %s_%s is NULL\");\n",
-             indent, node_name_upper, son_name_upper,
-             indent, node_name_upper, son_name_upper);
-
-  fprintf (f, "%s  if (", indent);
-  gen_contains_condition (f, contains, node_name_upper, son_name_upper);
-  fprintf (f, ")\n"
-              "%s    CHKcorrectTypeInsertError (arg_node, \"%s_%s hasnt the right type.\"\n"
-              "%s                               \"It should be: ",
-           indent, node_name_upper, son_name_upper,
-           indent);
-  gen_contains_expected (f, contains);
-  fprintf (f, "\");\n");
+        if (item->nodeset)
+          for (size_t k = 0; k < item->nodeset->n_nodes; k++)
+            if (item->nodeset->nodes[k] == node)
+              return true;
+      }
 
+  return false;
 }
 
 
-static inline void
-gen_node_son_check_target (FILE *  f, yajl_val targets, const char *  node_name_upper,
-                           const char *  son_name_upper, bool last_target_p)
+/* Generate the rules and the offsets of the sons of NODE and its entry
+   in CHK_NODES.  */
+static void
+gen_node_rules (struct chk_tables *  t, const struct model *  m,
+                const struct model_node *  node)
 {
-  yajl_val phases = yajl_tree_get (targets, (const char *[]){"phases", 0}, yajl_t_any);
-  yajl_val contains = yajl_tree_get (targets, (const char *[]){"contains", 0}, yajl_t_any);
-  yajl_val mandatory = yajl_tree_get (targets, (const char *[]){"mandatory", 0}, yajl_t_any);
-  const char * s;
+  size_t first_rule = t->n_rules;
+  size_t first_son = t->n_sons;
+  bool chain = false;
 
-  /*if (!contains)
-    ab_warn ("the target of son `%s' of the node `%s' does not have `contains' tag",
-               son_name_upper, node_name_upper);*/
-  assert (contains);
+  for (size_t i = 0; i < node->n_sons; i++)
+    {
+      const struct model_son *  son = &node->sons[i];
 
-  /* For `all' phases we do not have a case when a son must be NULL.  */
-  if (YAJL_IS_STRING (phases) && !strcmp (s = YAJL_GET_STRING (phases), "all"))
-    gen_son_target_check_body (f, mandatory, contains, node_name_upper, son_name_upper, "");
+      emit_fmt (&t->sons, "  offsetof (struct NODE_ALLOC_N_%s, sonstructure.%s),\n",
+                node->name->upper, son->name->name);
+      t->n_sons++;
 
-  /* If it is specified just per one phase.  */
-  else
+      for (size_t j = 0; j < son->n_targets; j++)
+        gen_rule (t, m, node, son->name, "CHK_SON_FIELD", true, &son->targets[j],
+                  j == son->n_targets - 1, true);
+    }
+
+  for (size_t i = 0; i < node->n_attributes; i++)
     {
-      fprintf (f, "  if (");
-      gen_phases_condition (f, phases);
-      fprintf (f, ")\n"
-                  "    {\n");
-      gen_son_target_check_body (f, mandatory, contains, node_name_upper, son_name_upper, "    ");
-      fprintf (f, "    }\n");
-
-      if (last_target_p)
-        fprintf (f, "  else\n"
-                    "    CHKnotExist ((intptr_t) %s_%s (arg_node), arg_node,\n"
-                    "                 \"attribute %s_%s must be NULL\");\n\n",
-                 node_name_upper, son_name_upper,
-                 node_name_upper, son_name_upper);
+      const struct model_attribute *  attrib = &node->attributes[i];
+      const struct attrtype_name *  an = attrib->type;
+
+      /* Skip the attribute if its type prescribes literal copying.  */
+      if (an->copy_type == act_literal)
+        continue;
+
+      /* Only attributes of type `Node' or `Link' hold nodes.  */
+      for (size_t j = 0; j < attrib->n_targets; j++)
+        gen_rule (t, m, node, attrib->name,
+                  attrib->cold ? "CHK_COLD_FIELD" : "CHK_ATTRIB_FIELD",
+                  false, &attrib->targets[j], j == attrib->n_targets - 1,
+                  !strcmp (an->name, "Node") || !strcmp (an->name, "Link"));
     }
+
+  /* A node is part of a chain if one of its sons may hold its like.  */
+  for (size_t i = 0; i < node->n_sons && !chain; i++)
+    chain = son_may_contain (&node->sons[i], node);
+
+  emit_fmt (&t->nodes, "  [N_%s] = { %zu, %zu, %zu, %zu, %s, \"Node illegally shared: N_%s\" },\n",
+            node->name->lower, first_rule, t->n_rules, first_son, t->n_sons,
+            chain ? "TRUE" : "FALSE", node->name->lower);
 }
 
 
+/* Write the table NAME of type TYPE from E.  An empty table gets the
+   entry DUMMY, as C has no empty arrays.  */
+static void
+gen_table (struct emitter *  f, const char *  type, const char *  name,
+           struct emitter *  e, const char *  dummy)
+{
+  emit_fmt (f, "static const %s %s =\n"
+               "{\n",
+            type, name);
+
+  if (e->size)
+    emit_mem (f, e->buf, e->size);
+  else
+    emit_str (f, dummy);
 
+  emit_str (f, "};\n\n");
+  free (e->buf);
+}
 
 
-static inline void
-gen_attrib_target_check_body (FILE *  f, const yajl_val mandatory, const yajl_val contains,
-                              const char *  node_name_upper, const char *  attrib_name_upper,
-                              bool attr_type_node_p, const char *  indent)
+/* Emit the masks of the phases of the rules and the order of the phases
+   they were generated for.  */
+static void
+gen_phase_masks (struct emitter *  f, struct chk_tables *  t)
 {
-  const char *  s;
-
-  if (YAJL_IS_TRUE (mandatory))
-    fprintf (f, "%s  CHKexistAttribute ((intptr_t) %s_%s (arg_node), arg_node,\n"
-                "%s                     \"mandatory attribute %s_%s is NULL\");\n",
-             indent, node_name_upper, attrib_name_upper,
-             indent, node_name_upper, attrib_name_upper);
-
-  /* If the type of an attribute is not 'Node' and `contains' is not `any',
-     do the value check of an attribute.  */
-  if (!attr_type_node_p
-      || (YAJL_IS_STRING (contains) && !strcmp (s = YAJL_GET_STRING (contains), "any")))
-    return;
-
-  fprintf (f, "%s  if (", indent);
-  gen_contains_condition (f, contains, node_name_upper, attrib_name_upper);
-  fprintf (f, ")\n"
-              "%s    CHKcorrectTypeInsertError (arg_node, \"%s_%s hasnt the right type.\"\n"
-              "%s                               \"It should be: ",
-           indent, node_name_upper, attrib_name_upper,
-           indent);
-  gen_contains_expected (f, contains);
-  fprintf (f, "\");\n");
+  char type[64];
 
-}
+  emit_fmt (f, "#define CHK_N_PHASES %zu\n"
+               "\n"
+               "/* The phases in the order the masks were generated for.  */\n"
+               "static const compiler_phase_t chk_phase_order[CHK_N_PHASES] =\n"
+               "{\n",
+            t->po->n_phases);
 
+  for (size_t i = 0; i < t->po->n_phases; i++)
+    emit_fmt (f, "  PH_%s,\n", t->po->phases[i].name);
 
+  emit_str (f, "};\n\n");
 
-/* Attribute checking routines.  */
-static inline void
-gen_node_attrib_check_target (FILE *  f, yajl_val targets, const char *  node_name_upper,
-                              const char *  attrib_name_upper, bool attr_type_node_p,
-                              bool last_target_p)
-{
-  yajl_val phases = yajl_tree_get (targets, (const char *[]){"phases", 0}, yajl_t_any);
-  yajl_val contains = yajl_tree_get (targets, (const char *[]){"contains", 0}, yajl_t_any);
-  yajl_val mandatory = yajl_tree_get (targets, (const char *[]){"mandatory", 0}, yajl_t_any);
-  const char * s;
-
-  /*if (!contains)
-    ab_warn ("the target of son `%s' of the node `%s' does not have `contains' tag",
-               son_name_upper, node_name_upper);*/
-  assert (contains);
-
-  /* For `all' phases we do not have a case when a son must be NULL.  */
-  if (YAJL_IS_STRING (phases) && !strcmp (s = YAJL_GET_STRING (phases), "all"))
-    gen_attrib_target_check_body (f, mandatory, contains, node_name_upper, attrib_name_upper,
-                               attr_type_node_p, "");
-
-  /* If it is specified just per one phase.  */
-  else
-    {
-      fprintf (f, "  if (");
-      gen_phases_condition (f, phases);
-      fprintf (f, ")\n"
-                  "    {\n");
-      gen_attrib_target_check_body (f, mandatory, contains, node_name_upper, attrib_name_upper,
-                                 attr_type_node_p, "    ");
-      fprintf (f, "    }\n");
-
-      if (last_target_p)
-        fprintf (f, "  else\n"
-                    "    CHKnotExist ((intptr_t) %s_%s (arg_node), arg_node,\n"
-                    "                 \"attribute %s_%s must be NULL\");\n\n",
-                 node_name_upper, attrib_name_upper,
-                 node_name_upper, attrib_name_upper);
-    }
+  snprintf (type, sizeof (type), "chk_phase_masks[][%zu]", t->mask_bytes);
+  gen_table (f, "unsigned char", type, &t->phases, "  { 0 },\n");
 }
 
 
+/* Emit CHKupdateActiveRules, which finds the rules that apply in the
+   current phase, either from the masks of the phases or from the ranges
+   of phases of the rules.  */
+static void
+gen_update_active_rules (struct emitter *  f, bool masks_p)
+{
+  emit_str (f, "static void\n"
+               "CHKupdateActiveRules (void)\n"
+               "{\n");
+
+  if (masks_p)
+    emit_str (f, "  size_t phase = (size_t) global.compiler_anyphase;\n"
+                 "\n");
+
+  emit_str (f, "  if (chk_active_valid && chk_active_phase == global.compiler_anyphase)\n"
+               "    return;\n"
+               "\n");
+
+  if (masks_p)
+    emit_str (f, "  for (size_t i = 0; i < CHK_N_PHASES; i++)\n"
+                 "    DBUG_ASSERT (chk_phase_order[i] == (compiler_phase_t) i,\n"
+                 "                 \"check.c was generated for another order of the phases\");\n"
+                 "\n"
+                 "  for (size_t i = 0; i < CHK_N_RULES; i++)\n"
+                 "    chk_active[i] = ((chk_rules[i].flags & CHK_ALL_PHASES)\n"
+                 "                     || (phase < CHK_N_PHASES\n"
+                 "                         && ((chk_phase_masks[chk_rules[i].phases][phase / 8]\n"
+                 "                              >> (phase % 8)) & 1)));\n");
+  else
+    emit_str (f, "  for (size_t i = 0; i < CHK_N_RULES; i++)\n"
+                 "    {\n"
+                 "      const struct CHK_RULE *r = &chk_rules[i];\n"
+                 "      bool active = (r->flags & CHK_ALL_PHASES) != 0;\n"
+                 "\n"
+                 "      for (size_t p = r->phases; !active && p < r->phases + r->n_phases; p++)\n"
+                 "        active = (global.compiler_anyphase >= chk_phases[p].from\n"
+                 "                  && global.compiler_anyphase < chk_phases[p].to);\n"
+                 "\n"
+                 "      chk_active[i] = active;\n"
+                 "    }\n");
+
+  emit_str (f, "\n"
+               "  chk_active_phase = global.compiler_anyphase;\n"
+               "  chk_active_valid = TRUE;\n"
+               "}\n"
+               "\n");
+}
 
 
-bool
-gen_check_c (yajl_val nodes, yajl_val nodesets, const char *  fname)
+/* Generate the part of CHKfundef that skips the fundefs left out by the
+   sampling.  Their sons that may hold other fundefs are still traversed,
+   as those fundefs are sampled on their own.  */
+static void
+gen_fundef_sampling (struct emitter *  f, const struct model_node *  node)
 {
-  FILE *  f;
-  GEN_OPEN_FILE (f, fname);
-  GEN_HEADER (f, "   Functions needed by check traversal");
+  emit_str (f, "  if (!CHKsampleFundef (arg_node))\n"
+               "    {\n");
 
-  fprintf (f, "#ifndef DBUG_OFF\n"
-              "\n"
-              "#include \"check.h\"\n"
-              "#include \"globals.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"CHK\"\n"
-              "#include \"debug.h\"\n"
-              "#include \"check_lib.h\"\n"
-              "#include \"check_mem.h\"\n"
-              "\n"
-              "\n"
-              "node *\n"
-              "CHKdoTreeCheck (node *arg_node)\n"
-              "{\n"
-              "  node *  keep_next;\n"
-              "\n"
-              "  DBUG_ENTER ();\n"
-              "  DBUG_ASSERT (NODE_TYPE (arg_node) == N_module\n"
-              "               || NODE_TYPE (arg_node) == N_fundef,\n"
-              "               \"Illegal argument node!\");\n"
-              "\n"
-              "  DBUG_ASSERT (NODE_TYPE (arg_node) == N_module\n"
-              "               || global.local_funs_grouped,\n"
-              "               \"If run fun-based, special funs must be grouped.\");\n"
-              "\n"
-              "  /* If this check is called function-based, we do not want to traverse into the\n"
-              "     next fundef, but restrict ourselves to this function and its subordinate\n"
-              "     special functions.  */\n"
-              "  if (NODE_TYPE (arg_node) == N_fundef)\n"
-              "   {\n"
-              "     keep_next = FUNDEF_NEXT (arg_node);\n"
-              "     FUNDEF_NEXT (arg_node) = NULL;\n"
-              "   }\n"
-              "\n"
-              "  DBUG_PRINT (\"Starting the check mechanism\");\n"
-              "\n"
-              "  TRAVpush (TR_chk);\n"
-              "  arg_node = TRAVdo (arg_node, NULL);\n"
-              "  TRAVpop ();\n"
-              "\n"
-              "  DBUG_PRINT (\"Check mechanism complete\");\n"
-              "\n"
-              "  /* If this check is called function-based, we must restore the original\n"
-              "     fundef chain here.  */\n"
-              "  if (NODE_TYPE (arg_node) == N_fundef)\n"
-              "    FUNDEF_NEXT (arg_node) = keep_next;\n"
-              "\n"
-              "  DBUG_RETURN (arg_node);\n"
-              "}\n\n");
-
-  check_gen_is_functions (f, nodesets);
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  for (size_t i = 0; i < node->n_sons; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val checks = yajl_tree_get (node, (const char *[]){"checks", 0}, yajl_t_array);
-
-      fprintf (f, "node *\n"
-                  "CHK%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n\n",
-               node_name_lower);
-
-      fprintf (f, "  if (NODE_CHECKVISITED (arg_node))\n"
-                  "    NODE_ERROR (arg_node) = CHKinsertError (NODE_ERROR (arg_node),\n"
-                  "                                            \"Node illegally shared: N_%s\");\n"
-                  "  else\n"
-                  "    NODE_CHECKVISITED (arg_node) = TRUE;\n\n",
-               node_name_lower);
-
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
-        {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          char *  son_name_upper = string_toupper (son_name);
-          const yajl_val son = YAJL_OBJECT_VALUES (sons)[i];
-          const yajl_val targets = yajl_tree_get (son, (const char *[]){"targets", 0}, yajl_t_any);
+      const struct model_son *  son = &node->sons[i];
 
-          fprintf (f, "  /* Checking `%s' son.  */\n", son_name);
+      if (!son_may_contain (son, node))
+        continue;
 
-          assert (targets);
-          if (YAJL_IS_OBJECT (targets))
-            gen_node_son_check_target (f, targets, node_name_upper, son_name_upper, true);
+      emit_fmt (f, "      if (%s_%s (arg_node) != NULL)\n"
+                   "        %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n",
+                node->name->upper, son->name->upper,
+                node->name->upper, son->name->upper,
+                node->name->upper, son->name->upper);
+    }
 
-          else if (YAJL_IS_ARRAY (targets))
-            for (size_t j = 0; j < YAJL_ARRAY_LENGTH (targets); j++)
-              {
-                if (j > 0)
-                  fprintf (f, "  else");
+  emit_str (f, "      DBUG_RETURN (arg_node);\n"
+               "    }\n"
+               "\n");
+}
 
-                gen_node_son_check_target (f, YAJL_ARRAY_VALUES (targets)[j],
-                                           node_name_upper, son_name_upper,
-                                           j == YAJL_ARRAY_LENGTH (targets) - 1);
-              }
 
-          free (son_name_upper);
-        }
+/* The checker is a generic interpreter of a table of rules, one rule per
+   target of every son and attribute.  The rules that apply in a phase
+   are found once per tree check instead of testing the phases of every
+   target at every node.  */
+bool
+gen_check_c (const struct model *  m, const char *  fname)
+{
+  struct emitter *  f;
+  struct chk_tables t;
+  char type[64];
 
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
-        {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-          const yajl_val targets = yajl_tree_get (attrib, (const char *[]){"targets", 0}, yajl_t_any);
-
-          /* Skip the attribute if its type prescribes literal copying.  */
-          const char *  type_name = YAJL_GET_STRING (type);
-          struct attrtype_name *  an;
-          HASH_FIND_STR (attrtype_names, type_name, an);
-          assert (an);
-
-          if (an->copy_type == act_literal)
-            continue;
-
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  /* Checking `%s' attribute.  */\n", attrib_name);
-
-          assert (targets);
-          if (YAJL_IS_OBJECT (targets))
-            gen_node_attrib_check_target (f, targets, node_name_upper, attrib_name_upper,
-                                          !strcmp (an->name, "Node")
-                                          || !strcmp (an->name, "Link"), true);
-
-          else if (YAJL_IS_ARRAY (targets))
-            for (size_t j = 0; j < YAJL_ARRAY_LENGTH (targets); j++)
-              {
-                if (j > 0)
-                  fprintf (f, "  else");
-
-                gen_node_attrib_check_target (f, YAJL_ARRAY_VALUES (targets)[j],
-                                              node_name_upper, attrib_name_upper,
-                                              !strcmp (an->name, "Node")
-                                              || !strcmp (an->name, "Link"),
-                                              j == YAJL_ARRAY_LENGTH (targets) - 1);
-              }
-
-          free (attrib_name_upper);
-        }
+  GEN_OPEN_FILE (f, fname);
+  GEN_HEADER (f, "   Functions needed by check traversal");
 
+  emit_str (f, "#ifndef DBUG_OFF\n"
+               "\n"
+               "#include <limits.h>\n"
+               "#include <stddef.h>\n"
+               "#include <stdint.h>\n"
+               "#include <stdlib.h>\n"
+               "#include <string.h>\n"
+               "#include \"check.h\"\n"
+               "#include \"globals.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"node_alloc.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"CHK\"\n"
+               "#include \"debug.h\"\n"
+               "#include \"check_lib.h\"\n"
+               "#include \"check_mem.h\"\n"
+               "\n"
+               "\n"
+               "/* The flags of a rule.  */\n"
+               "#define CHK_SON 0x01\n"
+               "#define CHK_MANDATORY 0x02\n"
+               "#define CHK_ALL_PHASES 0x04\n"
+               "/* The rule is the last target of its field.  */\n"
+               "#define CHK_LAST 0x08\n"
+               "/* The type of the value is checked against TYPES.  */\n"
+               "#define CHK_TYPES 0x10\n"
+               "\n"
+               "/* A rule checks a son or an attribute against one of its targets.  The\n"
+               "   targets of a field are tried in order and the first one that applies\n"
+               "   in the current phase is checked; when none applies, the field must\n"
+               "   be NULL.  */\n"
+               "struct CHK_RULE\n"
+               "{\n"
+               "  /* The offset of the field from the node, or from the block of cold\n"
+               "     attributes when COLD, the offset of the pointer to that block, is\n"
+               "     not 0.  */\n"
+               "  uint16_t offset;\n"
+               "  uint16_t cold;\n"
+               "  uint8_t size;\n");
+
+  if (phase_order)
+    emit_str (f, "  /* The row of CHK_PHASE_MASKS, N_PHASES is not used.  */\n");
+  else
+    emit_str (f, "  /* The phase ranges in CHK_PHASES.  */\n");
+
+  emit_str (f, "  uint16_t phases;\n"
+               "  uint16_t n_phases;\n"
+               "  /* The set of allowed node types in CHK_TYPES.  */\n"
+               "  uint16_t types;\n"
+               "  uint8_t flags;\n"
+               "  char *mandatory;\n"
+               "  char *wrong_type;\n"
+               "  char *not_null;\n"
+               "};\n"
+               "\n"
+               "/* The rules of every node type and the offsets of its sons.  */\n"
+               "struct CHK_NODE\n"
+               "{\n"
+               "  uint16_t first_rule;\n"
+               "  uint16_t last_rule;\n"
+               "  uint16_t first_son;\n"
+               "  uint16_t last_son;\n"
+               "  bool chain;\n"
+               "  char *shared;\n"
+               "};\n"
+               "\n"
+               "/* The offset, the offset of the pointer to the cold attributes and the\n"
+               "   size of a field of the node type __N, as stored in a rule.  */\n"
+               "#define CHK_SON_FIELD(__n, __f) \\\n"
+               "  offsetof (struct NODE_ALLOC_##__n, sonstructure.__f), 0, \\\n"
+               "  sizeof (((struct NODE_ALLOC_##__n *) 0)->sonstructure.__f)\n"
+               "#define CHK_ATTRIB_FIELD(__n, __f) \\\n"
+               "  offsetof (struct NODE_ALLOC_##__n, attributestructure.__f), 0, \\\n"
+               "  sizeof (((struct NODE_ALLOC_##__n *) 0)->attributestructure.__f)\n"
+               "#define CHK_COLD_FIELD(__n, __f) \\\n"
+               "  offsetof (struct ATTRIBS_COLD_##__n, __f), \\\n"
+               "  offsetof (struct NODE_ALLOC_##__n, attributestructure." LAYOUT_COLD_MEMBER "), \\\n"
+               "  sizeof (((struct ATTRIBS_COLD_##__n *) 0)->__f)\n"
+               "\n"
+               "\n"
+               "\n");
+
+  memset (&t, 0, sizeof (t));
+  t.n_bytes = NODETYPE_BITSET_BYTES (m);
+  t.po = phase_order;
+  if (t.po)
+    t.mask_bytes = PHASE_MASK_BYTES (t.po);
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    gen_node_rules (&t, m, &m->nodes[i]);
+
+  if (t.po)
+    gen_phase_masks (f, &t);
+  else
+    {
+      emit_str (f, "/* The bounds of a range of phases, TO is not included.  */\n"
+                   "struct CHK_PHASES\n"
+                   "{\n"
+                   "  compiler_phase_t from;\n"
+                   "  compiler_phase_t to;\n"
+                   "};\n"
+                   "\n");
+      gen_table (f, "struct CHK_PHASES", "chk_phases[]", &t.phases, "  { 0, 0 },\n");
+    }
 
-      /* Generate custom checks.  */
-      for (size_t i = 0; checks && i < YAJL_ARRAY_LENGTH (checks); i++)
-        {
-          if (i == 0)
-            fprintf (f, "\n  /* Custom checks for the `%s' node.  */\n", node_name);
+  snprintf (type, sizeof (type), "chk_types[][%zu]", t.n_bytes);
+  gen_table (f, "unsigned char", type, &t.types, "  { 0 },\n");
+
+  emit_fmt (f, "#define CHK_N_RULES %zu\n\n", t.n_rules ? t.n_rules : 1);
+  gen_table (f, "struct CHK_RULE", "chk_rules[CHK_N_RULES]", &t.rules,
+             "  { 0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL },\n");
+
+  gen_table (f, "uint16_t", "chk_sons[]", &t.sons, "  0,\n");
+  gen_table (f, "struct CHK_NODE", "chk_nodes[MAX_NODES + 1]", &t.nodes,
+             "  { 0, 0, 0, 0, FALSE, NULL },\n");
+
+  chk_bitsets_free (t.typesets);
+  chk_bitsets_free (t.masks);
+
+  emit_str (f, "\n"
+               "#define CHK_ALLOWED(__types, __type) \\\n"
+               "  ((chk_types[__types][(__type) / 8] >> ((__type) % 8)) & 1)\n"
+               "\n"
+               "/* Whether every rule applies in CHK_ACTIVE_PHASE.  */\n"
+               "static bool chk_active[CHK_N_RULES];\n"
+               "static bool chk_active_valid = FALSE;\n"
+               "static compiler_phase_t chk_active_phase;\n"
+               "\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "/* The rules change with the phase, so a node that passed the last check\n"
+               "   may break a rule of the current one.  Every node is checked until a\n"
+               "   check of the whole module has run in CHK_MODULE_PHASE.  */\n"
+               "static bool chk_full;\n"
+               "static bool chk_module_valid = FALSE;\n"
+               "static compiler_phase_t chk_module_phase;\n"
+               "#endif\n"
+               "\n");
+
+  gen_update_active_rules (f, t.po != NULL);
+
+  emit_str (f, "static inline intptr_t\n"
+               "CHKfieldValue (node *arg_node, const struct CHK_RULE *r)\n"
+               "{\n"
+               "  const char *base = (const char *) arg_node;\n"
+               "  intptr_t value = 0;\n"
+               "\n"
+               "  if (r->cold != 0)\n"
+               "    {\n"
+               "      memcpy (&base, base + r->cold, sizeof (base));\n"
+               "      /* The block is allocated on the first access with the defaults,\n"
+               "         which are NULL for the attributes that are checked.  */\n"
+               "      if (base == NULL)\n"
+               "        return 0;\n"
+               "    }\n"
+               "\n"
+               "  /* Only the existence of fields smaller than a pointer is checked.  */\n"
+               "  memcpy (&value, base + r->offset,\n"
+               "          r->size < sizeof (value) ? r->size : sizeof (value));\n"
+               "  return value;\n"
+               "}\n"
+               "\n"
+               "/* Mark ARG_NODE as visited and tell whether its rules and custom checks\n"
+               "   have to run.  With AST_DIRTY_TRACKING only the nodes accessed since the\n"
+               "   last check are checked, together with their parents, unless the phase\n"
+               "   has changed.  */\n"
+               "static bool\n"
+               "CHKvisit (node *arg_node)\n"
+               "{\n"
+               "  const struct CHK_NODE *n = &chk_nodes[NODE_TYPE (arg_node)];\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "  bool dirty = chk_full || (NODE_DIRTY (arg_node) & NB_DIRTY_SELF);\n"
+               "#endif\n"
+               "\n"
+               "  if (NODE_CHECKVISITED (arg_node))\n"
+               "    NODE_ERROR (arg_node) = CHKinsertError (NODE_ERROR (arg_node), n->shared);\n"
+               "  else\n"
+               "    NODE_CHECKVISITED (arg_node) = TRUE;\n"
+               "\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "  for (size_t i = n->first_son; !dirty && i < n->last_son; i++)\n"
+               "    {\n"
+               "      node *son = *(node **) ((char *) arg_node + chk_sons[i]);\n"
+               "\n"
+               "      dirty = son != NULL && (NODE_DIRTY (son) & NB_DIRTY_SELF);\n"
+               "    }\n"
+               "\n"
+               "  NODE_DIRTY (arg_node) = 0;\n"
+               "  return dirty;\n"
+               "#else\n"
+               "  return TRUE;\n"
+               "#endif\n"
+               "}\n"
+               "\n"
+               "static node *\n"
+               "CHKapplyRules (node *arg_node)\n"
+               "{\n"
+               "  const struct CHK_NODE *n = &chk_nodes[NODE_TYPE (arg_node)];\n"
+               "\n"
+               "  for (size_t i = n->first_rule; i < n->last_rule; i++)\n"
+               "    {\n"
+               "      const struct CHK_RULE *r = &chk_rules[i];\n"
+               "      intptr_t value = CHKfieldValue (arg_node, r);\n"
+               "\n"
+               "      if (!chk_active[i])\n"
+               "        {\n"
+               "          if (r->flags & CHK_LAST)\n"
+               "            CHKnotExist (value, arg_node, r->not_null);\n"
+               "          continue;\n"
+               "        }\n"
+               "\n"
+               "      if (r->flags & CHK_MANDATORY)\n"
+               "        {\n"
+               "          if (r->flags & CHK_SON)\n"
+               "            CHKexistSon ((node *) value, arg_node, r->mandatory);\n"
+               "          else\n"
+               "            CHKexistAttribute (value, arg_node, r->mandatory);\n"
+               "        }\n"
+               "\n"
+               "      if ((r->flags & CHK_TYPES) && value != 0\n"
+               "          && !CHK_ALLOWED (r->types, NODE_TYPE ((node *) value)))\n"
+               "        CHKcorrectTypeInsertError (arg_node, r->wrong_type);\n"
+               "\n"
+               "      /* The other targets of the field do not apply.  */\n"
+               "      while (!(chk_rules[i].flags & CHK_LAST))\n"
+               "        i++;\n"
+               "    }\n"
+               "\n"
+               "  return arg_node;\n"
+               "}\n"
+               "\n"
+               "static node *\n"
+               "CHKtravSons (node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  const struct CHK_NODE *n = &chk_nodes[NODE_TYPE (arg_node)];\n"
+               "\n"
+               "  for (size_t i = n->first_son; i < n->last_son; i++)\n"
+               "    {\n"
+               "      node **son = (node **) ((char *) arg_node + chk_sons[i]);\n"
+               "\n"
+               "      if (*son == NULL)\n"
+               "        continue;\n"
+               "\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "      /* Clean subtrees are left out.  Chains are followed anyway, as a\n"
+               "         node put into a chain by the handler of another node does not\n"
+               "         mark the nodes before it.  */\n"
+               "      if (!chk_full && NODE_DIRTY (*son) == 0\n"
+               "          && !chk_nodes[NODE_TYPE (*son)].chain)\n"
+               "        continue;\n"
+               "#endif\n"
+               "\n"
+               "      *son = TRAVdo (*son, arg_info);\n"
+               "    }\n"
+               "\n"
+               "  return arg_node;\n"
+               "}\n"
+               "\n");
+
+  emit_str (f, "/* The sampling of the checks, read from the environment by the first\n"
+               "   check:\n"
+               "\n"
+               "     CHK_SAMPLE_EVERY=N      only every Nth call of CHKdoTreeCheck checks;\n"
+               "     CHK_SAMPLE_PERCENT=P    only P percent of the fundefs are checked;\n"
+               "     CHK_SAMPLE_SEED=S       the seed of the choice of these fundefs;\n"
+               "     CHK_SAMPLE_MIN_SIZE=N,\n"
+               "     CHK_SAMPLE_MAX_SIZE=N   only fundefs with at least and at most N\n"
+               "                             assignments at the top of their body are\n"
+               "                             checked.\n"
+               "\n"
+               "   Whether a fundef is checked only depends on the seed, its name and the\n"
+               "   number of the call of CHKdoTreeCheck, so runs with the same settings\n"
+               "   check the same fundefs.  By default everything is checked.  */\n"
+               "static struct\n"
+               "{\n"
+               "  bool init;\n"
+               "  /* Set when every fundef of a check is checked.  */\n"
+               "  bool all;\n"
+               "  unsigned long every;\n"
+               "  unsigned long percent;\n"
+               "  unsigned long seed;\n"
+               "  unsigned long min_size;\n"
+               "  unsigned long max_size;\n"
+               "  unsigned long calls;\n"
+               "} chk_sample;\n"
+               "\n"
+               "static unsigned long\n"
+               "CHKsampleSetting (const char *name, unsigned long def)\n"
+               "{\n"
+               "  const char *value = getenv (name);\n"
+               "\n"
+               "  return value != NULL && *value != '\\0' ? strtoul (value, NULL, 10) : def;\n"
+               "}\n"
+               "\n"
+               "static void\n"
+               "CHKsampleInit (void)\n"
+               "{\n"
+               "  chk_sample.every = CHKsampleSetting (\"CHK_SAMPLE_EVERY\", 1);\n"
+               "  chk_sample.percent = CHKsampleSetting (\"CHK_SAMPLE_PERCENT\", 100);\n"
+               "  chk_sample.seed = CHKsampleSetting (\"CHK_SAMPLE_SEED\", 0);\n"
+               "  chk_sample.min_size = CHKsampleSetting (\"CHK_SAMPLE_MIN_SIZE\", 0);\n"
+               "  chk_sample.max_size = CHKsampleSetting (\"CHK_SAMPLE_MAX_SIZE\", ULONG_MAX);\n"
+               "\n"
+               "  if (chk_sample.every == 0)\n"
+               "    chk_sample.every = 1;\n"
+               "\n"
+               "  chk_sample.all = chk_sample.percent >= 100 && chk_sample.min_size == 0\n"
+               "                   && chk_sample.max_size == ULONG_MAX;\n"
+               "  chk_sample.init = TRUE;\n"
+               "}\n"
+               "\n"
+               "/* The number of assignments at the top of the body of FUNDEF.  */\n"
+               "static unsigned long\n"
+               "CHKfundefSize (node *fundef)\n"
+               "{\n"
+               "  unsigned long size = 0;\n"
+               "\n"
+               "  if (FUNDEF_BODY (fundef) != NULL)\n"
+               "    for (node *assign = BLOCK_ASSIGNS (FUNDEF_BODY (fundef)); assign != NULL;\n"
+               "         assign = ASSIGN_NEXT (assign))\n"
+               "      size++;\n"
+               "\n"
+               "  return size;\n"
+               "}\n"
+               "\n"
+               "static bool\n"
+               "CHKsampleFundef (node *fundef)\n"
+               "{\n"
+               "  unsigned long size;\n"
+               "  uint32_t hash = 2166136261u;\n"
+               "  const char *name;\n"
+               "\n"
+               "  if (chk_sample.all)\n"
+               "    return TRUE;\n"
+               "\n"
+               "  size = CHKfundefSize (fundef);\n"
+               "  if (size < chk_sample.min_size || size > chk_sample.max_size)\n"
+               "    return FALSE;\n"
+               "\n"
+               "  if (chk_sample.percent >= 100)\n"
+               "    return TRUE;\n"
+               "\n"
+               "  /* FNV-1a over the seed, the number of the call and the name.  */\n"
+               "  for (size_t i = 0; i < sizeof (unsigned long); i++)\n"
+               "    hash = (hash ^ ((chk_sample.seed >> (i * 8)) & 0xff)) * 16777619u;\n"
+               "  for (size_t i = 0; i < sizeof (unsigned long); i++)\n"
+               "    hash = (hash ^ ((chk_sample.calls >> (i * 8)) & 0xff)) * 16777619u;\n"
+               "  for (name = FUNDEF_NAME (fundef); name != NULL && *name != '\\0'; name++)\n"
+               "    hash = (hash ^ (unsigned char) *name) * 16777619u;\n"
+               "\n"
+               "  return hash % 100 < chk_sample.percent;\n"
+               "}\n"
+               "\n");
+
+  emit_str (f, "\n"
+               "node *\n"
+               "CHKdoTreeCheck (node *arg_node)\n"
+               "{\n"
+               "  node *  keep_next;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "  DBUG_ASSERT (NODE_TYPE (arg_node) == N_module\n"
+               "               || NODE_TYPE (arg_node) == N_fundef,\n"
+               "               \"Illegal argument node!\");\n"
+               "\n"
+               "  DBUG_ASSERT (NODE_TYPE (arg_node) == N_module\n"
+               "               || global.local_funs_grouped,\n"
+               "               \"If run fun-based, special funs must be grouped.\");\n"
+               "\n"
+               "  if (!chk_sample.init)\n"
+               "    CHKsampleInit ();\n"
+               "\n"
+               "  if (++chk_sample.calls % chk_sample.every != 0)\n"
+               "    {\n"
+               "      DBUG_PRINT (\"Skipping the check %lu\", chk_sample.calls);\n"
+               "      DBUG_RETURN (arg_node);\n"
+               "    }\n"
+               "\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "  chk_full = !chk_module_valid || chk_module_phase != global.compiler_anyphase;\n"
+               "  if (NODE_TYPE (arg_node) == N_module)\n"
+               "    {\n"
+               "      chk_module_valid = TRUE;\n"
+               "      chk_module_phase = global.compiler_anyphase;\n"
+               "    }\n"
+               "\n"
+               "  /* The check does not mark the nodes it reads or writes.  */\n"
+               "  nbdirty_paused = TRUE;\n"
+               "#endif\n"
+               "\n"
+               "  /* If this check is called function-based, we do not want to traverse into the\n"
+               "     next fundef, but restrict ourselves to this function and its subordinate\n"
+               "     special functions.  */\n"
+               "  if (NODE_TYPE (arg_node) == N_fundef)\n"
+               "   {\n"
+               "     keep_next = FUNDEF_NEXT (arg_node);\n"
+               "     FUNDEF_NEXT (arg_node) = NULL;\n"
+               "   }\n"
+               "\n"
+               "  DBUG_PRINT (\"Starting the check mechanism\");\n"
+               "\n"
+               "  CHKupdateActiveRules ();\n"
+               "\n"
+               "  TRAVpush (TR_chk);\n"
+               "  arg_node = TRAVdo (arg_node, NULL);\n"
+               "  TRAVpop ();\n"
+               "\n"
+               "  DBUG_PRINT (\"Check mechanism complete\");\n"
+               "\n"
+               "  /* If this check is called function-based, we must restore the original\n"
+               "     fundef chain here.  */\n"
+               "  if (NODE_TYPE (arg_node) == N_fundef)\n"
+               "    FUNDEF_NEXT (arg_node) = keep_next;\n"
+               "\n"
+               "#ifdef AST_DIRTY_TRACKING\n"
+               "  nbdirty_paused = FALSE;\n"
+               "#endif\n"
+               "\n"
+               "  DBUG_RETURN (arg_node);\n"
+               "}\n"
+               "\n"
+               "\n"
+               "\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
 
-          const yajl_val check = YAJL_ARRAY_VALUES (checks)[i];
-          assert (YAJL_IS_STRING (check));
-          fprintf (f, "  arg_node = %s (arg_node);\n", YAJL_GET_STRING (check));
-        }
+      emit_fmt (f, "node *\n"
+                   "CHK%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n\n",
+                node->name->lower);
 
+      if (!strcmp (node->name->name, "Fundef"))
+        gen_fundef_sampling (f, node);
 
-      /* Generate traversals into sons.  */
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      if (node->n_checks == 0)
+        emit_str (f, "  if (CHKvisit (arg_node))\n"
+                     "    arg_node = CHKapplyRules (arg_node);\n");
+      else
         {
-          if (i == 0)
-            fprintf (f, "\n  /* Traversals into sons of the `%s' node.  */\n", node_name);
+          emit_fmt (f, "  if (CHKvisit (arg_node))\n"
+                       "    {\n"
+                       "      arg_node = CHKapplyRules (arg_node);\n"
+                       "\n"
+                       "      /* Custom checks for the `%s' node.  */\n",
+                    node->name->name);
 
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          char *  son_name_upper = string_toupper (son_name);
+          for (size_t i = 0; i < node->n_checks; i++)
+            emit_fmt (f, "      arg_node = %s (arg_node);\n", node->checks[i]);
 
-          fprintf (f, "  if (NULL != %s_%s (arg_node))\n"
-                      "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                   node_name_upper, son_name_upper,
-                   node_name_upper, son_name_upper,
-                   node_name_upper, son_name_upper);
-
-          free (son_name_upper);
+          emit_str (f, "    }\n");
         }
 
-      fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      if (node->n_sons != 0)
+        emit_str (f, "\n  arg_node = CHKtravSons (arg_node, arg_info);\n");
+
+      emit_str (f, "\n  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
 
-  fprintf (f, "#else // !DBUG_OFF\n"
-              "static int this_translation_unit = 0xdead;\n"
-              "#endif // !DBUG_OFF\n\n");
+  emit_str (f, "#else // !DBUG_OFF\n"
+               "static int this_translation_unit = 0xdead;\n"
+               "#endif // !DBUG_OFF\n\n");
   GEN_FLUSH_AND_CLOSE (f);
   return true;
 }
-
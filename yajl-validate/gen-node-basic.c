@@ -5,6 +5,7 @@
 #include <yajl/yajl_tree.h>
 #include "ast-builder.h"
 #include "gen.h"
+#include "layout.h"
 
 
 /* A helper enum to chose which items we are generating macros for
@@ -17,70 +18,96 @@ enum macro_type
 };
 
 
-/* Traverse through ITEMS and generate macros depending on the TYPE
-   for the case when the node access is being checked and for the case
-   when it isn't.  This is decided by a preprocessor flag
-   CHECK_NODE_ACCESS.  */
+/* Traverse through N_ITEMS names of ITEMS and generate the access macros
+   depending on the TYPE.  Each macro is written in terms of the helpers
+   from gen_access_helpers, which pick the variant of the build: NB_NODE
+   counts, marks or checks the node, NB_SON and NB_ATTR find the member.
+   INDICES are the fields AST_PROFILE_ACCESS counts for the items.  */
 static inline bool
-gen_access_macros (FILE *  f, yajl_val items, const char *  node_name_upper,
-                   const char *  node_name_lower, enum macro_type type)
+gen_access_macros (struct emitter *  f, const struct model_name *  const *  items,
+                   const size_t *  indices, size_t n_items,
+                   const char *  node_name_upper, const char *  node_name_lower,
+                   enum macro_type type)
 {
-  const char *  format_string_check;
-  const char *  format_string_nocheck;
+  const char *  helper = type == m_sons ? "NB_SON" : "NB_ATTR";
+  const char *  member = type == m_flags ? "flags." : "";
 
-  switch (type)
-    {
-    case m_sons:
-      format_string_check = "#  define %s_%s(__n) (NBMacroMatchesType (__n, N_%s)->sons.N_%s->%s)\n";
-      break;
-    case m_attribs:
-      format_string_check = "#  define %s_%s(__n) (NBMacroMatchesType (__n, N_%s)->attribs.N_%s->%s)\n";
-      break;
-    case m_flags:
-      format_string_check = "#  define %s_%s(__n) (NBMacroMatchesType (__n, N_%s)->attribs.N_%s->flags.%s)\n";
-      break;
-    default:
-      assert (0);
-    }
+  for (size_t i = 0; i < n_items; i++)
+    emit_fmt (f, "#define %s_%s(__n) %s (NB_NODE (__n, N_%s, %zu), %s, %s, %s%s)\n",
+              node_name_upper, items[i]->upper, helper, node_name_lower,
+              indices[i], node_name_upper, node_name_lower, member,
+              items[i]->name);
 
-  switch (type)
-    {
-    case m_sons:
-      format_string_nocheck = "#  define %s_%s(__n) ((__n)->sons.N_%s->%s)\n";
-      break;
-    case m_attribs:
-      format_string_nocheck = "#  define %s_%s(__n) ((__n)->attribs.N_%s->%s)\n";
-      break;
-    case m_flags:
-      format_string_nocheck = "#  define %s_%s(__n) ((__n)->attribs.N_%s->flags.%s)\n";
-      break;
-    default:
-      assert (0);
-    }
+  emit_str (f, "\n");
+  return true;
+}
 
 
-  fprintf (f, "#ifdef CHECK_NODE_ACCESS\n");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (items); i++)
-    {
-      const char *  item_name = YAJL_OBJECT_KEYS (items)[i];
-      char *  item_name_upper = string_toupper (item_name);
-      fprintf (f, format_string_check,
-               node_name_upper, item_name_upper, node_name_lower,
-               node_name_lower, item_name);
-      free (item_name_upper);
-    }
-  fprintf (f, "#else\n");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (items); i++)
-    {
-      const char *  item_name = YAJL_OBJECT_KEYS (items)[i];
-      char *  item_name_upper = string_toupper (item_name);
-      fprintf (f, format_string_nocheck,
-               node_name_upper, item_name_upper,
-               node_name_lower, item_name);
-      free (item_name_upper);
-    }
-  fprintf (f, "#endif\n\n");
-  return true;
+/* Generate the helpers of the access macros.  They are defined once for
+   the build, instead of defining every access macro for each variant.
+   NB_NODE (n, type, field) yields the node N after counting the access to
+   FIELD with AST_PROFILE_ACCESS, marking N with AST_DIRTY_TRACKING or
+   checking its TYPE with CHECK_NODE_ACCESS.  NB_COUNT only counts and
+   marks.
+   NB_SON (n, UPPER, lower, member) and NB_ATTR find MEMBER of the sons or
+   the attributes of N, at its offset in NODE_ALLOC_N_<UPPER> with
+   FIXED_NODE_LAYOUT, or through the pointer N_<lower> of the node.  */
+static void
+gen_access_helpers (struct emitter *  f)
+{
+  emit_str (f, "#if defined (AST_PROFILE_ACCESS)\n"
+               "#  define NB_NODE(__n, __type, __field) NBprofileAccess (__n, __type, __field)\n"
+               "#elif defined (AST_DIRTY_TRACKING)\n"
+               "#  define NB_NODE(__n, __type, __field) NBdirtyAccess (__n, __type)\n"
+               "#elif defined (CHECK_NODE_ACCESS)\n"
+               "#  define NB_NODE(__n, __type, __field) NBMacroMatchesType (__n, __type)\n"
+               "#else\n"
+               "#  define NB_NODE(__n, __type, __field) (__n)\n"
+               "#endif\n"
+               "\n"
+               "#if defined (AST_PROFILE_ACCESS)\n"
+               "#  define NB_COUNT(__n, __type, __field) NBprofileAccess (__n, __type, __field)\n"
+               "#elif defined (AST_DIRTY_TRACKING)\n"
+               "#  define NB_COUNT(__n, __type, __field) NBdirtyAccess (__n, __type)\n"
+               "#else\n"
+               "#  define NB_COUNT(__n, __type, __field) (__n)\n"
+               "#endif\n"
+               "\n"
+               "#ifdef FIXED_NODE_LAYOUT\n"
+               "#  define NB_SON(__n, __upper, __lower, __member) \\\n"
+               "     (((struct NODE_ALLOC_N_##__upper *) (__n))->sonstructure.__member)\n"
+               "#  define NB_ATTR(__n, __upper, __lower, __member) \\\n"
+               "     (((struct NODE_ALLOC_N_##__upper *) (__n))->attributestructure.__member)\n"
+               "#else\n"
+               "#  define NB_SON(__n, __upper, __lower, __member) \\\n"
+               "     ((__n)->sons.N_##__lower->__member)\n"
+               "#  define NB_ATTR(__n, __upper, __lower, __member) \\\n"
+               "     ((__n)->attribs.N_##__lower->__member)\n"
+               "#endif\n"
+               "\n");
+}
+
+
+/* The number of fields of NODE that AST_PROFILE_ACCESS counts accesses to:
+   the sons, the attributes, the pointer to the cold attributes and the
+   flags, which are numbered in this order.  */
+static inline size_t
+profile_node_fields (const struct model_node *  node)
+{
+  return node->n_sons + node->n_attributes + (node->n_cold_attributes != 0)
+         + node->n_flags;
+}
+
+
+static size_t
+profile_n_fields (const struct model *  m)
+{
+  size_t n = 0;
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    n += profile_node_fields (&m->nodes[i]);
+
+  return n;
 }
 
 
@@ -91,8 +118,7 @@ gen_access_macros (FILE *  f, yajl_val items, const char *  node_name_upper,
    macro will be genreated.  The function header will be generated
    otherwise.   */
 static inline bool
-gen_make_function_header (FILE *  f, const char *  node_name_lower,
-                          yajl_val attributes, yajl_val sons,
+gen_make_function_header (struct emitter *  f, const struct model_node *  node,
                           bool declaration_and_macro_p)
 {
   /* Keep a constant array of function arguments.
@@ -102,70 +128,52 @@ gen_make_function_header (FILE *  f, const char *  node_name_lower,
   struct {
     const char *  arg_name;
     const char *  arg_type;
-  } params[(attributes ? YAJL_OBJECT_LENGTH (attributes) : 0)
-           + (sons ? YAJL_OBJECT_LENGTH (sons) : 0)];
+  } params[node->n_attributes + node->n_sons + 1];
 
   size_t param_length = 0;
+  const char *  node_name_capital = node->name->capital;
 
-  for (size_t i = 0; attributes && i < YAJL_OBJECT_LENGTH (attributes); i++)
-    {
-      const char *  attr_name = YAJL_OBJECT_KEYS (attributes)[i];
-      const yajl_val attr = YAJL_OBJECT_VALUES (attributes)[i];
-      const yajl_val incons = yajl_tree_get (attr, (const char *[]){"inconstructor", 0}, yajl_t_any);
-      const yajl_val type = yajl_tree_get (attr, (const char *[]){"type", 0}, yajl_t_string);
-
-      if (incons && YAJL_IS_TRUE (incons))
-        {
-          struct attrtype_name *  atn;
-          const char *  type_name = YAJL_GET_STRING (type);
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
-
-          params[param_length].arg_name = attr_name;
-          params[param_length].arg_type = atn->ctype;
-          param_length++;
-        }
-    }
-
-  for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
-    {
-      const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-      const yajl_val son = YAJL_OBJECT_VALUES (sons)[i];
-      const yajl_val def = yajl_tree_get (son, (const char *[]){"default", 0}, yajl_t_string);
+  for (size_t i = 0; i < node->n_attributes; i++)
+    if (node->attributes[i].inconstructor)
+      {
+        params[param_length].arg_name = node->attributes[i].name->name;
+        params[param_length].arg_type = node->attributes[i].type->ctype;
+        param_length++;
+      }
 
-      if (!def)
-        {
-          params[param_length].arg_name = son_name;
-          params[param_length].arg_type = "node *";
-          param_length++;
-        }
-    }
+  for (size_t i = 0; i < node->n_sons; i++)
+    if (!node->sons[i].def)
+      {
+        params[param_length].arg_name = node->sons[i].name->name;
+        params[param_length].arg_type = "node *";
+        param_length++;
+      }
 
   /* Generate function declaration with At.  */
-  fprintf (f, "node *%sTBmake%c%sAt (",
-           declaration_and_macro_p ? "  " : "\n",
-           toupper (node_name_lower[0]), &node_name_lower[1]);
+  emit_fmt (f, "node *%sTBmake%sAt (",
+            declaration_and_macro_p ? "  " : "\n",
+            node_name_capital);
   for (size_t i = 0; i < param_length; i++)
-    fprintf (f, "%s %s%s", params[i].arg_type, params[i].arg_name, i < param_length - 1 ? ", " : "");
+    emit_fmt (f, "%s %s%s", params[i].arg_type, params[i].arg_name, i < param_length - 1 ? ", " : "");
 
   /* FIXME those should become const-qualified.  */
-  fprintf (f, "%schar *  file, size_t line)%s",
-           param_length > 0 ? ", " : "",
-           declaration_and_macro_p ? ";\n" : "\n");
+  emit_fmt (f, "%schar *  file, size_t line)%s",
+            param_length > 0 ? ", " : "",
+            declaration_and_macro_p ? ";\n" : "\n");
 
   if (!declaration_and_macro_p)
     return true;
 
   /* Generate a macro that puts __FILE__ and __LINE__ as last two parameters.  */
-  fprintf (f, "#define TBmake%c%s(", toupper (node_name_lower[0]), &node_name_lower[1]);
+  emit_fmt (f, "#define TBmake%s(", node_name_capital);
   for (size_t i = 0; i < param_length; i++)
-    fprintf (f, "__%s%s", params[i].arg_name, i < param_length - 1 ? ", " : "");
+    emit_fmt (f, "__%s%s", params[i].arg_name, i < param_length - 1 ? ", " : "");
 
-  fprintf (f, ")  TBmake%c%sAt (", toupper (node_name_lower[0]), &node_name_lower[1]);
+  emit_fmt (f, ")  TBmake%sAt (", node_name_capital);
   for (size_t i = 0; i < param_length; i++)
-    fprintf (f, "__%s%s", params[i].arg_name, i < param_length - 1 ? ", " : "");
+    emit_fmt (f, "__%s%s", params[i].arg_name, i < param_length - 1 ? ", " : "");
 
-  fprintf (f, "%s__FILE__, __LINE__)\n\n", param_length > 0 ? ", " : "");
+  emit_fmt (f, "%s__FILE__, __LINE__)\n\n", param_length > 0 ? ", " : "");
   return true;
 }
 
@@ -173,85 +181,313 @@ gen_make_function_header (FILE *  f, const char *  node_name_lower,
 
 /* Generate accessor macros for every node and the TBmake<Node-name> function
    prototype.  */
+/* Emit the enum of the nodesets and the membership test of a node type
+   in a nodeset.  The bitsets are defined in node_basic.c.  */
+static void
+gen_nodeset_decls (struct emitter *  f, const struct model *  m)
+{
+  if (m->n_nodesets == 0)
+    return;
+
+  emit_str (f, "typedef enum\n"
+               "{\n");
+  for (size_t i = 0; i < m->n_nodesets; i++)
+    emit_fmt (f, "  NS_%s,\n", m->nodesets[i].name->lower);
+
+  emit_fmt (f, "} nodesettype;\n"
+               "\n"
+               "#define MAX_NODESETS %zu\n"
+               "\n"
+               "/* The node types of every nodeset as a bitset indexed by nodetype.  */\n"
+               "extern const unsigned char nodesetbits[MAX_NODESETS][%zu];\n"
+               "\n"
+               "/* Check whether the node type TYPE belongs to the nodeset SET.  */\n"
+               "static inline bool\n"
+               "NBnodeInSet (nodetype type, nodesettype set)\n"
+               "{\n"
+               "  return (nodesetbits[set][type / 8] >> (type %% 8)) & 1;\n"
+               "}\n"
+               "\n",
+            m->n_nodesets, (size_t) NODETYPE_BITSET_BYTES (m));
+}
+
+
+/* Emit the bitsets declared by GEN_NODESET_DECLS.  */
+static void
+gen_nodeset_bits (struct emitter *  f, const struct model *  m)
+{
+  const size_t n_bytes = NODETYPE_BITSET_BYTES (m);
+  unsigned char bits[n_bytes];
+
+  if (m->n_nodesets == 0)
+    return;
+
+  emit_fmt (f, "const unsigned char nodesetbits[MAX_NODESETS][%zu] =\n"
+               "{\n",
+            n_bytes);
+
+  for (size_t i = 0; i < m->n_nodesets; i++)
+    {
+      const struct model_nodeset *  nodeset = &m->nodesets[i];
+
+      memset (bits, 0, n_bytes);
+      for (size_t j = 0; j < nodeset->n_nodes; j++)
+        nodetype_bitset_add (bits, m, nodeset->nodes[j]);
+
+      emit_fmt (f, "  /* NS_%s  */\n", nodeset->name->lower);
+      gen_nodetype_bitset (f, bits, n_bytes);
+    }
+
+  emit_str (f, "};\n\n");
+}
+
+
 bool
-gen_node_basic_h (yajl_val nodes, const char *  fname)
+gen_node_basic_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, "__NODE_BASIC_H__",
                 "   Functions to allocate node structures and macros\n"
                 "   to access node memebers");
 
-  fprintf (f, "#include <signal.h>\n"
-              "#include <unistd.h>\n"
-              "\n"
-              "#ifndef _SAC_TREE_BASIC_H_\n"
-              "#  error node_basic.h should only be included as part of tree_basic.h!\n"
-              "#endif\n"
-              "\n"
-              "/* This function is inlined at each macro call to check whether the nodetype\n"
-              "   matches. To allow us to print elaborate error messages instead of a segfault,\n"
-              "   we make use of the nodeenum to nodename mapping. As this is a header file, and\n"
-              "   as header files are only allowed to reference types.h, we add an explicit\n"
-              "   declaration of the globals data type. For the same reason, we cannot use\n"
-              "   DBUG_ASSERT directly, but need to mimic it.  */\n"
-              "\n"
-              "extern global_t global;\n"
-              "\n"
-
-              /* FIXME This can be simplified significantly.  Fix it!.  */
-              "static inline\n"
-              "node *NBMacroMatchesType (node *node, nodetype type)\n"
-              "{\n"
-              "#ifndef DBUG_OFF\n"
-              "  if (node != NULL && node->mnodetype != type)\n"
-              "    {\n"
-              "      const char *ndtp_name = (node->mnodetype <= MAX_NODES\n"
-              "                               ? global.mdb_nodetype[node->mnodetype]\n"
-              "                               : \"!invalid!\");\n"
-              "      printf (\"TRAVERSE ERROR: node of type %%d:%%s found where \"\n"
-              "              \"%%d:%%s was expected!\\n\\n\",\n"
-              "              node->mnodetype, ndtp_name,\n"
-              "              type, global.mdb_nodetype[type]);\n"
-              "      fflush (stdout);\n"
-              "      kill (getpid (), SIGSEGV); /* segfault  */\n"
-              "    }\n"
-              "#endif\n"
-              "\n"
-              "  return node;\n"
-              "}\n\n");
-
-
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_fmt (f, "#include <signal.h>\n"
+               "#include <unistd.h>\n"
+               "\n"
+               "#ifndef _SAC_TREE_BASIC_H_\n"
+               "#  error node_basic.h should only be included as part of tree_basic.h!\n"
+               "#endif\n"
+               "\n"
+               "/* This function is inlined at each macro call to check whether the nodetype\n"
+               "   matches. To allow us to print elaborate error messages instead of a segfault,\n"
+               "   we make use of the nodeenum to nodename mapping. As this is a header file, and\n"
+               "   as header files are only allowed to reference types.h, we add an explicit\n"
+               "   declaration of the globals data type. For the same reason, we cannot use\n"
+               "   DBUG_ASSERT directly, but need to mimic it.  */\n"
+               "\n"
+               "extern global_t global;\n"
+               "\n"
+ 
+               /* FIXME This can be simplified significantly.  Fix it!.  */
+               "static inline\n"
+               "node *NBMacroMatchesType (node *node, nodetype type)\n"
+               "{\n"
+               "#ifndef DBUG_OFF\n"
+               "  if (node != NULL && node->mnodetype != type)\n"
+               "    {\n"
+               "      const char *ndtp_name = (node->mnodetype <= MAX_NODES\n"
+               "                               ? global.mdb_nodetype[node->mnodetype]\n"
+               "                               : \"!invalid!\");\n"
+               "      printf (\"TRAVERSE ERROR: node of type %%d:%%s found where \"\n"
+               "              \"%%d:%%s was expected!\\n\\n\",\n"
+               "              node->mnodetype, ndtp_name,\n"
+               "              type, global.mdb_nodetype[type]);\n"
+               "      fflush (stdout);\n"
+               "      kill (getpid (), SIGSEGV); /* segfault  */\n"
+               "    }\n"
+               "#endif\n"
+               "\n"
+               "  return node;\n"
+               "}\n\n");
+
+  gen_nodeset_decls (f, m);
+
+  /* The byte follows the node structure in every NODE_ALLOC_N_<node-name>,
+     see gen_node_alloc_structs, so no table of offsets is needed.  The
+     path of the traversal is kept by TRAVdirtyCall in traverse_tables.c.  */
+  emit_str (f, "#ifdef AST_DIRTY_TRACKING\n"
+               "\n"
+               "/* The dirty bits of a node, cleared when the tree check reaches it.\n"
+               "   NB_DIRTY_SELF is set when the node is created or accessed through\n"
+               "   an accessor macro, NB_DIRTY_BELOW when a node under it is.  */\n"
+               "#define NODE_DIRTY(__n) (*(unsigned char *) ((node *) (__n) + 1))\n"
+               "#define NB_DIRTY_SELF 1\n"
+               "#define NB_DIRTY_BELOW 2\n"
+               "\n"
+               "/* Set while the tree check reads the tree.  */\n"
+               "extern bool nbdirty_paused;\n"
+               "\n"
+               "/* The nodes of the running traversal handlers, the innermost last.  */\n"
+               "extern node **nbdirty_path;\n"
+               "extern size_t nbdirty_depth;\n"
+               "\n"
+               "extern void NBdirtyPush (node *n);\n"
+               "extern void NBdirtyPop (node *entered, node *result);\n"
+               "\n"
+               "/* Mark N as written.  The node of the innermost handler, which N is\n"
+               "   usually a son of or the same as, is marked as written and as having\n"
+               "   N below it.  */\n"
+               "static inline\n"
+               "node *NBtouch (node *n)\n"
+               "{\n"
+               "  if (!nbdirty_paused)\n"
+               "    {\n"
+               "      NODE_DIRTY (n) |= NB_DIRTY_SELF;\n"
+               "      if (nbdirty_depth != 0)\n"
+               "        NODE_DIRTY (nbdirty_path[nbdirty_depth - 1])\n"
+               "          |= NB_DIRTY_SELF | NB_DIRTY_BELOW;\n"
+               "    }\n"
+               "\n"
+               "  return n;\n"
+               "}\n"
+               "\n"
+               "/* The accessor macros cannot tell reads from writes, so every access\n"
+               "   marks the node as written.  */\n"
+               "static inline\n"
+               "node *NBdirtyAccess (node *node, nodetype type)\n"
+               "{\n"
+               "  NBtouch (node);\n"
+               "\n"
+               "#ifdef CHECK_NODE_ACCESS\n"
+               "  return NBMacroMatchesType (node, type);\n"
+               "#else\n"
+               "  (void) type;\n"
+               "  return node;\n"
+               "#endif\n"
+               "}\n"
+               "\n"
+               "#endif // AST_DIRTY_TRACKING\n\n");
+
+  /* The counters are allocated for a phase when it first accesses a
+     field, so the profile does not depend on the number of phases.  */
+  emit_fmt (f, "#ifdef AST_PROFILE_ACCESS\n"
+               "\n"
+               "/* The number of fields of all nodes that accesses are counted for.  */\n"
+               "#define NB_PROFILE_FIELDS %zu\n"
+               "\n"
+               "/* The access counters of every field, indexed by the phase.  */\n"
+               "extern size_t **nbprofile_counts;\n"
+               "extern size_t nbprofile_n_phases;\n"
+               "\n"
+               "extern size_t *NBprofileCounters (size_t phase);\n"
+               "\n"
+               "static inline\n"
+               "node *NBprofileAccess (node *node, nodetype type, size_t field)\n"
+               "{\n"
+               "  size_t phase = (size_t) global.compiler_anyphase;\n"
+               "  size_t *counts = (phase < nbprofile_n_phases\n"
+               "                    ? nbprofile_counts[phase] : NULL);\n"
+               "\n"
+               "  if (counts == NULL)\n"
+               "    counts = NBprofileCounters (phase);\n"
+               "\n"
+               "  counts[field]++;\n"
+               "\n"
+               "#if defined (AST_DIRTY_TRACKING)\n"
+               "  return NBdirtyAccess (node, type);\n"
+               "#elif defined (CHECK_NODE_ACCESS)\n"
+               "  return NBMacroMatchesType (node, type);\n"
+               "#else\n"
+               "  (void) type;\n"
+               "  return node;\n"
+               "#endif\n"
+               "}\n"
+               "\n"
+               "#endif // AST_PROFILE_ACCESS\n\n",
+            profile_n_fields (m));
+
+  /* The accessors of the fixed layout need the complete allocation
+     structures, which are defined here instead of node_alloc.h.  */
+  emit_str (f, "#ifdef FIXED_NODE_LAYOUT\n\n");
+  gen_node_alloc_structs (f, m);
+  emit_str (f, "#endif // FIXED_NODE_LAYOUT\n\n");
+
+  gen_access_helpers (f);
+
+  size_t field = 0;
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_upper = node->name->upper;
+      const char *  node_name_lower = node->name->lower;
+      const struct model_name *  names[node->n_sons + node->n_attributes + node->n_flags + 1];
+      size_t indices[node->n_sons + node->n_attributes + node->n_flags + 1];
+      size_t cold_index = field + node->n_sons + node->n_attributes;
 
-      fprintf (f, "/* Macros and functions for `%s'.  */\n\n", YAJL_OBJECT_KEYS (nodes)[i]);
+      emit_fmt (f, "/* Macros and functions for `%s'.  */\n\n", node->name->name);
 
-      if (sons && YAJL_OBJECT_LENGTH (sons) != 0)
-        gen_access_macros (f, sons, node_name_upper, node_name_lower, m_sons);
+      if (node->n_sons != 0)
+        {
+          for (size_t j = 0; j < node->n_sons; j++)
+            {
+              names[j] = node->sons[j].name;
+              indices[j] = field + j;
+            }
+          gen_access_macros (f, names, indices, node->n_sons, node_name_upper,
+                             node_name_lower, m_sons);
+        }
 
-      if (attribs && YAJL_OBJECT_LENGTH (attribs) != 0)
-        gen_access_macros (f, attribs, node_name_upper, node_name_lower, m_attribs);
+      if (node->n_attributes != 0)
+        {
+          /* The pointer to the cold attributes is accessed like an
+             attribute kept in the node.  */
+          const struct model_name cold_name = {
+            .name = LAYOUT_COLD_MEMBER,
+            .upper = (char *) "COLDATTRIBS"
+          };
+          size_t n_names = 0;
+
+          for (size_t j = 0; j < node->n_attributes; j++)
+            if (!node->attributes[j].cold)
+              {
+                names[n_names] = node->attributes[j].name;
+                indices[n_names++] = field + node->n_sons + j;
+              }
+
+          if (node->n_cold_attributes != 0)
+            {
+              names[n_names] = &cold_name;
+              indices[n_names++] = cold_index;
+            }
 
-      if (flags && YAJL_OBJECT_LENGTH (flags) != 0)
+          gen_access_macros (f, names, indices, n_names, node_name_upper,
+                             node_name_lower, m_attribs);
+        }
+
+      /* Cold attributes are reached through a block that is allocated
+         with the values of their defaults on the first access.  */
+      if (node->n_cold_attributes != 0)
         {
-          /* FIXME do we want to check access to this structure?  */
-          fprintf (f, "#define %s_FLAGSTRUCTURE(__n) ((__n)->attribs.N_%s->flags)\n\n",
-                   node_name_upper, node_name_lower);
-          gen_access_macros (f, flags, node_name_upper, node_name_lower, m_flags);
+          emit_fmt (f, "extern struct ATTRIBS_COLD_N_%s *NBmakeCold%s (node *n);\n"
+                       "\n"
+                       "static inline struct ATTRIBS_COLD_N_%s *\n"
+                       "NBcold%s (node *n)\n"
+                       "{\n"
+                       "  struct ATTRIBS_COLD_N_%s *cold = %s_COLDATTRIBS (n);\n"
+                       "\n"
+                       "  return cold != NULL ? cold : NBmakeCold%s (n);\n"
+                       "}\n"
+                       "\n",
+                    node_name_upper, node->name->capital, node_name_upper,
+                    node->name->capital, node_name_upper, node_name_upper,
+                    node->name->capital);
+
+          for (size_t j = 0; j < node->n_attributes; j++)
+            if (node->attributes[j].cold)
+              emit_fmt (f, "#define %s_%s(__n) (NBcold%s (NB_COUNT (__n, N_%s, %zu))->%s)\n",
+                        node_name_upper, node->attributes[j].name->upper,
+                        node->name->capital, node_name_lower,
+                        field + node->n_sons + j, node->attributes[j].name->name);
+
+          emit_str (f, "\n");
         }
 
-      gen_make_function_header (f, node_name_lower, attribs, sons, true);
+      if (node->n_flags != 0)
+        {
+          /* FIXME do we want to check access to this structure?  */
+          emit_fmt (f, "#define %s_FLAGSTRUCTURE(__n) NB_ATTR (__n, %s, %s, flags)\n\n",
+                    node_name_upper, node_name_upper, node_name_lower);
+          for (size_t j = 0; j < node->n_flags; j++)
+            {
+              names[j] = node->flags[j].name;
+              indices[j] = cold_index + (node->n_cold_attributes != 0) + j;
+            }
+          gen_access_macros (f, names, indices, node->n_flags, node_name_upper,
+                             node_name_lower, m_flags);
+        }
 
-      free (node_name_upper);
-      free (node_name_lower);
+      gen_make_function_header (f, node, true);
+      field += profile_node_fields (node);
     }
 
   GEN_FOOTER_H (f, "__NODE_BASIC_H__");
@@ -263,39 +499,23 @@ gen_node_basic_h (yajl_val nodes, const char *  fname)
 /* Helper function to generate a predicate in the condition that checks if
    a value assigned to the given son is valid.  */
 static inline bool
-gen_node_son_check (FILE *  f, yajl_val nodesets, const char *  node_name_upper,
-                    const char *  son_name_upper, const char *  x)
+gen_node_son_check (struct emitter *  f, const char *  node_name_upper,
+                    const char *  son_name_upper, const struct model_contains *  x)
 {
   const char *  nchk_pattern = "\n      && NODE_TYPE (%s_%s (xthis)) != N_%s";
-  struct node_name *  nn;
+  const char *  nschk_pattern = "\n      && !NBnodeInSet (NODE_TYPE (%s_%s (xthis)), NS_%s)";
 
-  if (!strcmp (x, "any"))
+  if (!strcmp (x->name, "any"))
     ab_err ("the son `%s' of the node `%s' has target that contains \"any\"",
             son_name_upper, node_name_upper);
 
-  HASH_FIND_STR (node_names, x, nn);
-  assert (nn);
+  assert (x->node || x->nodeset);
 
-  if (nn->name_type == nnt_node)
-    {
-      char *  n_lower = string_tolower (x);
-      fprintf (f, nchk_pattern, node_name_upper, son_name_upper, n_lower);
-      free (n_lower);
-    }
+  if (x->node)
+    emit_fmt (f, nchk_pattern, node_name_upper, son_name_upper, x->node->name->lower);
   else
-    {
-      assert (nn->name_type == nnt_nodeset);
-      const yajl_val ns = yajl_tree_get (nodesets, (const char *[]){x, 0}, yajl_t_array);
-      assert (ns);
-
-      for (size_t i = 0; i < YAJL_ARRAY_LENGTH (ns); i++)
-        {
-          const char *  n = YAJL_GET_STRING (YAJL_ARRAY_VALUES (ns)[i]);
-          char *  n_lower = string_tolower (n);
-          fprintf (f, nchk_pattern, node_name_upper, son_name_upper, n_lower);
-          free (n_lower);
-        }
-    }
+    emit_fmt (f, nschk_pattern, node_name_upper, son_name_upper,
+              x->nodeset->name->lower);
 
   return true;
 }
@@ -305,22 +525,11 @@ gen_node_son_check (FILE *  f, yajl_val nodesets, const char *  node_name_upper,
 /* Helper function, depending on the format of target attribute generate predicates
    for every allowed node.  */
 static inline bool
-gen_node_son_check_from_target (FILE *  f, const yajl_val nodesets, const yajl_val targets,
+gen_node_son_check_from_target (struct emitter *  f, const struct model_target *  target,
                                 const char *  node_name_upper, const char *  son_name_upper)
 {
-  assert (YAJL_IS_OBJECT (targets));
-
-  const yajl_val contains = yajl_tree_get (targets, (const char *[]){"contains", 0}, yajl_t_any);
-
-  if (YAJL_IS_STRING (contains))
-    gen_node_son_check (f, nodesets, node_name_upper, son_name_upper, YAJL_GET_STRING (contains));
-  else if (YAJL_IS_ARRAY (contains))
-    for (size_t i = 0; i < YAJL_ARRAY_LENGTH (contains); i++)
-      {
-        assert (YAJL_IS_STRING (YAJL_ARRAY_VALUES (contains)[i]));
-        gen_node_son_check (f, nodesets, node_name_upper, son_name_upper,
-                            YAJL_GET_STRING (YAJL_ARRAY_VALUES (contains)[i]));
-      }
+  for (size_t i = 0; i < target->n_contains; i++)
+    gen_node_son_check (f, node_name_upper, son_name_upper, &target->contains[i]);
 
   return true;
 }
@@ -329,16 +538,11 @@ gen_node_son_check_from_target (FILE *  f, const yajl_val nodesets, const yajl_v
 
 /* Helprt function to generate checks for the list of targets.  */
 static inline bool
-gen_node_son_check_from_targets (FILE *  f, const yajl_val nodesets, const yajl_val targets,
+gen_node_son_check_from_targets (struct emitter *  f, const struct model_son *  son,
                                  const char *  node_name_upper, const char *  son_name_upper)
 {
-  assert (YAJL_IS_ARRAY (targets));
-
-  for (size_t i = 0; i < YAJL_ARRAY_LENGTH (targets); i++)
-    {
-      const yajl_val target = YAJL_ARRAY_VALUES (targets)[i];
-      gen_node_son_check_from_target (f, nodesets, target, node_name_upper, son_name_upper);
-    }
+  for (size_t i = 0; i < son->n_targets; i++)
+    gen_node_son_check_from_target (f, &son->targets[i], node_name_upper, son_name_upper);
 
   return true;
 }
@@ -348,193 +552,696 @@ gen_node_son_check_from_targets (FILE *  f, const yajl_val nodesets, const yajl_
 
 /* Generate TBmake<Node-name> function for all nodes.  */
 bool
-gen_node_basic_c (yajl_val nodes, yajl_val nodesets, const char *  fname)
+gen_node_basic_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions to allocate node structures");
 
 
-  fprintf (f, "#include \"node_alloc.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#define DBUG_PREFIX \"NDBASIC\"\n"
-              "#include \"debug.h\"\n"
-              "#include \"check_mem.h\"\n"
-              "#include \"str.h\"\n"
-              "#include \"globals.h\"\n"
-              "#include \"memory.h\"\n"
-              "#include \"ctinfo.h\"\n\n");
+  emit_str (f, "#include \"node_alloc.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"free_node.h\"\n"
+               "#define DBUG_PREFIX \"NDBASIC\"\n"
+               "#include \"debug.h\"\n"
+               "#include \"check_mem.h\"\n"
+               "#include \"str.h\"\n"
+               "#include \"globals.h\"\n"
+               "#include \"memory.h\"\n"
+               "#include \"ctinfo.h\"\n\n");
 
+  gen_nodeset_bits (f, m);
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
-
-      gen_make_function_header (f, node_name_lower, attribs, sons, false);
-      fprintf (f, "{\n"
-                  "  struct NODE_ALLOC_N_%s *  nodealloc;\n"
-                  "  node *  xthis;\n"
-                  "\n"
-                  "  DBUG_ENTER ();\n"
-                  "  DBUG_PRINT (\"allocating N_%s node\");\n"
-                  "  nodealloc = (struct NODE_ALLOC_N_%s *) MEMmallocAt (sizeof *nodealloc, file, line);\n"
-                  "  xthis = (node *) &(nodealloc->nodestructure);\n"
-                  "  DBUG_PRINT (\"address: \" F_PTR, xthis);\n\n",
-               node_name_upper, node_name_lower, node_name_upper);
-
-
-      fprintf (f, "#ifndef DBUG_OFF\n"
-                  "  CHKMisNode (xthis, N_%s);\n"
-                  "#endif\n\n",
-               node_name_lower);
-
-      fprintf (f, "  DBUG_PRINT (\"setting node type, filename `%%s', line: %%zu, col: %%zu\",\n"
-                  "              global.filename, global.linenum, global.colnum);\n"
-                  "  NODE_TYPE (xthis) = N_%s;\n"
-                  "  NODE_FILE (xthis) = global.filename;\n"
-                  "  NODE_LINE (xthis) = global.linenum;\n"
-                  "  NODE_COL (xthis) = global.colnum;\n"
-                  "  NODE_ERROR (xthis) = NULL;\n\n",
-               node_name_lower);
-
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
+
+      gen_make_function_header (f, node, false);
+      emit_fmt (f, "{\n"
+                   "  struct NODE_ALLOC_N_%s *  nodealloc;\n"
+                   "  node *  xthis;\n"
+                   "\n"
+                   "  DBUG_ENTER ();\n"
+                   "  DBUG_PRINT (\"allocating N_%s node\");\n"
+                   "  nodealloc = (struct NODE_ALLOC_N_%s *) ",
+                node_name_upper, node_name_lower, node_name_upper);
+
+      if (!strcmp (node->name->name, "Fundef"))
+        emit_str (f, "NODE_FUNDEF_ALLOC_AT (sizeof *nodealloc, file, line);\n");
+      else
+        emit_fmt (f, "NODE_ALLOC_AT (N_%s, sizeof *nodealloc, file, line);\n",
+                  node_name_lower);
+
+      emit_str (f, "  xthis = (node *) &(nodealloc->nodestructure);\n"
+                   "  DBUG_PRINT (\"address: \" F_PTR, xthis);\n\n");
+
+
+      emit_fmt (f, "#if !defined (DBUG_OFF) && !defined (NODE_POOLS) && !defined (NODE_ARENAS)\n"
+                   "  CHKMisNode (xthis, N_%s);\n"
+                   "#endif\n\n",
+                node_name_lower);
+
+      emit_fmt (f, "  DBUG_PRINT (\"setting node type, filename `%%s', line: %%zu, col: %%zu\",\n"
+                   "              global.filename, global.linenum, global.colnum);\n"
+                   "  NODE_TYPE (xthis) = N_%s;\n"
+                   "  NODE_FILE (xthis) = global.filename;\n"
+                   "  NODE_LINE (xthis) = global.linenum;\n"
+                   "  NODE_COL (xthis) = global.colnum;\n"
+                   "  NODE_ERROR (xthis) = NULL;\n"
+                   "#ifdef AST_DIRTY_TRACKING\n"
+                   "  NODE_DIRTY (xthis) = NB_DIRTY_SELF;\n"
+                   "  NBtouch (xthis);\n"
+                   "#endif\n\n",
+                node_name_lower);
+
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          char *  son_name_upper = string_toupper (son_name);
-          const yajl_val son = YAJL_OBJECT_VALUES (sons)[i];
-          const yajl_val def = yajl_tree_get (son, (const char *[]){"default", 0}, yajl_t_string);
+          const char *  son_name = node->sons[i].name->name;
+          const char *  son_name_upper = node->sons[i].name->upper;
           const char *  value;
 
           if (i == 0)
-            fprintf (f, "  /* Setting sons.  */\n"
-                        "  xthis->sons.N_%s = (struct SONS_N_%s *) &(nodealloc->sonstructure);\n",
-                     node_name_lower, node_name_upper);
-
-          if (def)
-            value = YAJL_GET_STRING (def);
+            emit_fmt (f, "  /* Setting sons.  */\n"
+                         "#ifndef FIXED_NODE_LAYOUT\n"
+                         "  xthis->sons.N_%s = (struct SONS_N_%s *) &(nodealloc->sonstructure);\n"
+                         "#endif\n",
+                      node_name_lower, node_name_upper);
+
+          if (node->sons[i].def)
+            value = node->sons[i].def;
           else
             value = son_name;
 
-          fprintf (f, "  DBUG_PRINT (\"assigning inital value "
-                                   "`\" F_PTR \"' to the son `%%s'\", %s, \"%s\");\n"
-                      "  %s_%s (xthis) = %s;\n\n",
-                   value, son_name, node_name_upper, son_name_upper, value);
+          emit_fmt (f, "  DBUG_PRINT (\"assigning inital value "
+                                    "`\" F_PTR \"' to the son `%%s'\", %s, \"%s\");\n"
+                       "  %s_%s (xthis) = %s;\n\n",
+                    value, son_name, node_name_upper, son_name_upper, value);
 
           /* If the current son is an avis, add the backref.  */
           if (!strcmp (son_name, "Avis"))
-            fprintf (f, "  if (%s_AVIS (xthis) != NULL)\n"
-                        "    AVIS_DECL (%s_AVIS (xthis)) = xthis;\n\n",
-                     node_name_upper, node_name_upper);
-
-          free (son_name_upper);
+            emit_fmt (f, "  if (%s_AVIS (xthis) != NULL)\n"
+                         "    AVIS_DECL (%s_AVIS (xthis)) = xthis;\n\n",
+                      node_name_upper, node_name_upper);
         }
 
-      if ((attribs && YAJL_OBJECT_LENGTH (attribs) != 0)
-          || (flags && YAJL_OBJECT_LENGTH (flags) != 0))
-        fprintf (f, "  xthis->attribs.N_%s = (struct ATTRIBS_N_%s *) &(nodealloc->attributestructure);\n\n",
-                 node_name_lower, node_name_upper);
+      if (node->n_attributes != 0 || node->n_flags != 0)
+        emit_fmt (f, "#ifndef FIXED_NODE_LAYOUT\n"
+                     "  xthis->attribs.N_%s = (struct ATTRIBS_N_%s *) &(nodealloc->attributestructure);\n"
+                     "#endif\n\n",
+                  node_name_lower, node_name_upper);
 
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      if (node->n_cold_attributes != 0)
+        emit_fmt (f, "  /* Cold attributes are set when they are first accessed.  */\n"
+                     "  %s_COLDATTRIBS (xthis) = NULL;\n\n",
+                  node_name_upper);
+
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val def = yajl_tree_get (attrib, (const char *[]){"default", 0}, yajl_t_string);
-          const yajl_val incons = yajl_tree_get (attrib, (const char *[]){"inconstructor", 0}, yajl_t_any);
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
+          const struct model_attribute *  attrib = &node->attributes[i];
           const char *  value;
 
           if (i == 0)
-            fprintf (f, "  /* Setting attributes.  */\n");
+            emit_str (f, "  /* Setting attributes.  */\n");
 
-          if (def)
-            value = YAJL_GET_STRING (def);
-          else if (incons && YAJL_IS_TRUE (incons))
-            value = attrib_name;
-          else
-            {
-              char *  type_name = YAJL_GET_STRING (type);
-              struct attrtype_name *  atn;
-              HASH_FIND_STR (attrtype_names, type_name, atn);
-              assert (atn);
-              value = atn->init;
-            }
+          /* NBmakeCold<Node-name> sets the values that do not come from
+             the arguments.  */
+          if (attrib->cold && (attrib->def || !attrib->inconstructor))
+            continue;
 
-          fprintf (f, "  %s_%s (xthis) = %s;\n",
-                   node_name_upper, attrib_name_upper, value);
+          if (attrib->def)
+            value = attrib->def;
+          else if (attrib->inconstructor)
+            value = attrib->name->name;
+          else
+            value = attrib->type->init;
 
-          free (attrib_name_upper);
+          emit_fmt (f, "  %s_%s (xthis) = %s;\n",
+                    node_name_upper, attrib->name->upper, value);
         }
 
 
-      for (size_t i = 0; flags && i < YAJL_OBJECT_LENGTH (flags); i++)
+      for (size_t i = 0; i < node->n_flags; i++)
         {
-          const char *  flag_name = YAJL_OBJECT_KEYS (flags)[i];
-          char *  flag_name_upper = string_toupper (flag_name);
-          const yajl_val flag = YAJL_OBJECT_VALUES (flags)[i];
-          const yajl_val def = yajl_tree_get (flag, (const char *[]){"default", 0}, yajl_t_string);
           const char *  value = "FALSE";
 
           if (i == 0)
-            fprintf (f, "\n"
-                        "  /* Setting flags.  */\n");
+            emit_str (f, "\n"
+                         "  /* Setting flags.  */\n");
 
           /* FIXME make `default' of type boolean.  */
-          if (def)
-            value = YAJL_GET_STRING (def);
+          if (node->flags[i].def)
+            value = node->flags[i].def;
 
-          fprintf (f, "  %s_%s (xthis) = %s;\n",
-                   node_name_upper, flag_name_upper, value);
-
-          free (flag_name_upper);
+          emit_fmt (f, "  %s_%s (xthis) = %s;\n",
+                    node_name_upper, node->flags[i].name->upper, value);
         }
 
 
       /* If DBUG enabled, check for valid arguments.  */
-      fprintf (f, "\n"
-                  "#ifndef DBUG_OFF\n"
-                  "  DBUG_PRINT (\"doing son target checks\");\n\n");
+      emit_str (f, "\n"
+                   "#ifndef DBUG_OFF\n"
+                   "  DBUG_PRINT (\"doing son target checks\");\n\n");
 
       /* For sons without default value defined.  */
-      for (size_t i = 0; i < YAJL_OBJECT_LENGTH (sons); i++)
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          const yajl_val son = YAJL_OBJECT_VALUES (sons)[i];
-          const yajl_val targets = yajl_tree_get (son, (const char *[]){"targets", 0}, yajl_t_any);
-          const yajl_val def = yajl_tree_get (son, (const char *[]){"default", 0}, yajl_t_string);
+          const struct model_son *  son = &node->sons[i];
+          const char *  son_name_upper = son->name->upper;
 
-          if (def)
+          if (son->def)
             continue;
 
-          char *  son_name_upper = string_toupper (son_name);
+          emit_fmt (f, "  if (%s_%s (xthis) != NULL", node_name_upper, son_name_upper);
+          gen_node_son_check_from_targets (f, son, node_name_upper, son_name_upper);
+
+          emit_fmt (f, ")\n"
+                       "    CTIwarn (\"Field `%s' of node N_%s has non-allowed target node: %%s\",\n"
+                       "             NODE_TEXT (%s_%s (xthis)));\n\n",
+                    son->name->name, node_name_lower, node_name_upper, son_name_upper);
+        }
 
-          fprintf (f, "  if (%s_%s (xthis) != NULL", node_name_upper, son_name_upper);
-          if (YAJL_IS_OBJECT (targets))
-            gen_node_son_check_from_target (f, nodesets, targets, node_name_upper, son_name_upper);
-          else if (YAJL_IS_ARRAY (targets))
-            gen_node_son_check_from_targets (f, nodesets, targets, node_name_upper, son_name_upper);
+      emit_str (f, "#endif // DBUG_OFF\n"
+                   "\n"
+                   "  DBUG_RETURN (xthis);\n"
+                   "}\n\n");
+    }
 
-          fprintf (f, ")\n"
-                      "    CTIwarn (\"Field `%s' of node N_%s has non-allowed target node: %%s\",\n"
-                      "             NODE_TEXT (%s_%s (xthis)));\n\n",
-                   son_name, node_name_lower, node_name_upper, son_name_upper);
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_upper = node->name->upper;
+
+      if (node->n_cold_attributes == 0)
+        continue;
+
+      emit_fmt (f, "struct ATTRIBS_COLD_N_%s *\n"
+                   "NBmakeCold%s (node *n)\n"
+                   "{\n"
+                   "  struct ATTRIBS_COLD_N_%s *cold;\n"
+                   "\n"
+                   "  DBUG_ENTER ();\n"
+                   "  DBUG_ASSERT (%s_COLDATTRIBS (n) == NULL,\n"
+                   "               \"Cold attributes of N_%s exist already!\");\n"
+                   "\n"
+                   "  cold = (struct ATTRIBS_COLD_N_%s *) MEMmalloc (sizeof *cold);\n",
+                node_name_upper, node->name->capital, node_name_upper,
+                node_name_upper, node->name->lower, node_name_upper);
+
+      for (size_t j = 0; j < node->n_attributes; j++)
+        {
+          const struct model_attribute *  attrib = &node->attributes[j];
 
-          free (son_name_upper);
+          if (attrib->cold)
+            emit_fmt (f, "  cold->%s = %s;\n", attrib->name->name,
+                      attrib->def ? attrib->def : attrib->type->init);
         }
 
-      fprintf (f, "#endif // DBUG_OFF\n"
-                  "\n"
-                  "  DBUG_RETURN (xthis);\n"
-                  "}\n\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_fmt (f, "  %s_COLDATTRIBS (n) = cold;\n"
+                   "\n"
+                   "  DBUG_RETURN (cold);\n"
+                   "}\n\n",
+                node_name_upper);
+    }
+
+  emit_str (f, "#ifdef AST_DIRTY_TRACKING\n"
+               "\n"
+               "#include <stdlib.h>\n"
+               "\n"
+               "bool nbdirty_paused = FALSE;\n"
+               "node **nbdirty_path = NULL;\n"
+               "size_t nbdirty_depth = 0;\n"
+               "static size_t nbdirty_cap = 0;\n"
+               "\n"
+               "void\n"
+               "NBdirtyPush (node *n)\n"
+               "{\n"
+               "  if (nbdirty_depth == nbdirty_cap)\n"
+               "    {\n"
+               "      nbdirty_cap = nbdirty_cap ? 2 * nbdirty_cap : 256;\n"
+               "      nbdirty_path = (node **) realloc (nbdirty_path,\n"
+               "                                        nbdirty_cap * sizeof (node *));\n"
+               "      if (nbdirty_path == NULL)\n"
+               "        CTIabortOutOfMemory (nbdirty_cap * sizeof (node *));\n"
+               "    }\n"
+               "\n"
+               "  nbdirty_path[nbdirty_depth++] = n;\n"
+               "}\n"
+               "\n"
+               "/* Pass the marks of ENTERED on to the node of the enclosing handler.\n"
+               "   A handler that returns RESULT instead of ENTERED replaces a son of\n"
+               "   that node, and ENTERED may be freed.  */\n"
+               "void\n"
+               "NBdirtyPop (node *entered, node *result)\n"
+               "{\n"
+               "  node *parent;\n"
+               "\n"
+               "  if (--nbdirty_depth == 0)\n"
+               "    return;\n"
+               "\n"
+               "  parent = nbdirty_path[nbdirty_depth - 1];\n"
+               "  if (result != entered)\n"
+               "    NODE_DIRTY (parent) |= NB_DIRTY_SELF | NB_DIRTY_BELOW;\n"
+               "  else if (NODE_DIRTY (entered) != 0)\n"
+               "    NODE_DIRTY (parent) |= NB_DIRTY_BELOW;\n"
+               "}\n"
+               "\n"
+               "#endif // AST_DIRTY_TRACKING\n"
+               "\n");
+
+  /* The fields are listed in the order of their indices in node_basic.h.  */
+  emit_str (f, "#ifdef AST_PROFILE_ACCESS\n"
+               "\n"
+               "#include <stdio.h>\n"
+               "#include <stdlib.h>\n"
+               "#include <string.h>\n"
+               "#include \"phase_info.h\"\n"
+               "\n"
+               "size_t **nbprofile_counts = NULL;\n"
+               "size_t nbprofile_n_phases = 0;\n"
+               "\n"
+               "/* The node and the name of every counted field.  */\n"
+               "static const struct\n"
+               "{\n"
+               "  const char *node;\n"
+               "  const char *field;\n"
+               "} nbprofile_fields[NB_PROFILE_FIELDS] = {\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name = node->name->name;
+
+      for (size_t j = 0; j < node->n_sons; j++)
+        emit_fmt (f, "  {\"%s\", \"%s\"},\n", node_name, node->sons[j].name->name);
+      for (size_t j = 0; j < node->n_attributes; j++)
+        emit_fmt (f, "  {\"%s\", \"%s\"},\n", node_name, node->attributes[j].name->name);
+      if (node->n_cold_attributes != 0)
+        emit_fmt (f, "  {\"%s\", \"" LAYOUT_COLD_MEMBER "\"},\n", node_name);
+      for (size_t j = 0; j < node->n_flags; j++)
+        emit_fmt (f, "  {\"%s\", \"%s\"},\n", node_name, node->flags[j].name->name);
     }
 
+  emit_str (f, "};\n"
+               "\n"
+               "/* Write the non-zero COUNTS as an object that maps the names of nodes\n"
+               "   to objects that map the names of fields to the counts.  */\n"
+               "static void\n"
+               "NBprofileWrite (FILE *f, const size_t *counts, const char *indent)\n"
+               "{\n"
+               "  const char *node = NULL;\n"
+               "\n"
+               "  fprintf (f, \"{\");\n"
+               "  for (size_t i = 0; i < NB_PROFILE_FIELDS; i++)\n"
+               "    {\n"
+               "      if (counts[i] == 0)\n"
+               "        continue;\n"
+               "\n"
+               "      if (node == NULL || strcmp (node, nbprofile_fields[i].node))\n"
+               "        {\n"
+               "          fprintf (f, \"%s\\n%s  \\\"%s\\\": {\", node != NULL ? \"},\" : \"\",\n"
+               "                   indent, nbprofile_fields[i].node);\n"
+               "          node = nbprofile_fields[i].node;\n"
+               "        }\n"
+               "      else\n"
+               "        fprintf (f, \", \");\n"
+               "\n"
+               "      fprintf (f, \"\\\"%s\\\": %zu\", nbprofile_fields[i].field, counts[i]);\n"
+               "    }\n"
+               "\n"
+               "  fprintf (f, \"%s\\n%s}\", node != NULL ? \"}\" : \"\", indent);\n"
+               "}\n"
+               "\n"
+               "/* Write the counts of all phases together and of every phase into\n"
+               "   the file named by AST_PROFILE_FILE, `ast_profile.json' by default.  */\n"
+               "static void\n"
+               "NBprofileDump (void)\n"
+               "{\n"
+               "  const char *fname = getenv (\"AST_PROFILE_FILE\");\n"
+               "  size_t *total = (size_t *) calloc (NB_PROFILE_FIELDS, sizeof (size_t));\n"
+               "  bool first = TRUE;\n"
+               "  FILE *f;\n"
+               "\n"
+               "  if (fname == NULL)\n"
+               "    fname = \"ast_profile.json\";\n"
+               "\n"
+               "  f = fopen (fname, \"w\");\n"
+               "  if (f == NULL || total == NULL)\n"
+               "    {\n"
+               "      CTIwarn (\"Cannot write the access profile `%s'\", fname);\n"
+               "      if (f != NULL)\n"
+               "        fclose (f);\n"
+               "      free (total);\n"
+               "      return;\n"
+               "    }\n"
+               "\n"
+               "  for (size_t p = 0; p < nbprofile_n_phases; p++)\n"
+               "    if (nbprofile_counts[p] != NULL)\n"
+               "      for (size_t i = 0; i < NB_PROFILE_FIELDS; i++)\n"
+               "        total[i] += nbprofile_counts[p][i];\n"
+               "\n"
+               "  fprintf (f, \"{\\n  \\\"total\\\": \");\n"
+               "  NBprofileWrite (f, total, \"  \");\n"
+               "  fprintf (f, \",\\n  \\\"phases\\\": {\");\n"
+               "\n"
+               "  for (size_t p = 0; p < nbprofile_n_phases; p++)\n"
+               "    if (nbprofile_counts[p] != NULL)\n"
+               "      {\n"
+               "        fprintf (f, \"%s\\n    \\\"%s\\\": \", first ? \"\" : \",\",\n"
+               "                 PHIphaseIdent ((compiler_phase_t) p));\n"
+               "        NBprofileWrite (f, nbprofile_counts[p], \"    \");\n"
+               "        first = FALSE;\n"
+               "      }\n"
+               "\n"
+               "  fprintf (f, \"\\n  }\\n}\\n\");\n"
+               "  if (fclose (f) != 0)\n"
+               "    CTIwarn (\"Cannot write the access profile `%s'\", fname);\n"
+               "\n"
+               "  free (total);\n"
+               "}\n"
+               "\n"
+               "size_t *\n"
+               "NBprofileCounters (size_t phase)\n"
+               "{\n"
+               "  if (nbprofile_counts == NULL)\n"
+               "    atexit (NBprofileDump);\n"
+               "\n"
+               "  if (phase >= nbprofile_n_phases)\n"
+               "    {\n"
+               "      nbprofile_counts = (size_t **) realloc (nbprofile_counts,\n"
+               "                                              (phase + 1) * sizeof (size_t *));\n"
+               "      if (nbprofile_counts == NULL)\n"
+               "        CTIabortOutOfMemory ((phase + 1) * sizeof (size_t *));\n"
+               "\n"
+               "      for (size_t p = nbprofile_n_phases; p <= phase; p++)\n"
+               "        nbprofile_counts[p] = NULL;\n"
+               "\n"
+               "      nbprofile_n_phases = phase + 1;\n"
+               "    }\n"
+               "\n"
+               "  nbprofile_counts[phase] = (size_t *) calloc (NB_PROFILE_FIELDS, sizeof (size_t));\n"
+               "  if (nbprofile_counts[phase] == NULL)\n"
+               "    CTIabortOutOfMemory (NB_PROFILE_FIELDS * sizeof (size_t));\n"
+               "\n"
+               "  return nbprofile_counts[phase];\n"
+               "}\n"
+               "\n"
+               "#endif // AST_PROFILE_ACCESS\n"
+               "\n");
+
+  /* The pools know the exact size of every node type, so a slab holds
+     nodes of one type only and needs no per-node header.  */
+  emit_str (f, "#ifdef NODE_POOLS\n"
+               "\n"
+               "NODE_POOL_TLS void *nodepool_free[MAX_NODES + 1];\n"
+               "\n"
+               "static const size_t nodepool_size[MAX_NODES + 1] = {\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    if (strcmp (m->nodes[i].name->name, "Fundef"))
+      emit_fmt (f, "  [N_%s] = sizeof (struct NODE_ALLOC_N_%s),\n",
+                m->nodes[i].name->lower, m->nodes[i].name->upper);
+
+  emit_str (f, "};\n"
+               "\n"
+               "void *\n"
+               "NODEPOOLrefill (nodetype type, char *file, size_t line)\n"
+               "{\n"
+               "  size_t size;\n"
+               "  char *slab;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "  DBUG_ASSERT (type <= MAX_NODES && nodepool_size[type] != 0,\n"
+               "               \"Illegal nodetype found!\");\n"
+               "\n"
+               "  size = nodepool_size[type];\n"
+               "  slab = (char *) MEMmallocAt (NODE_POOL_SLAB * size, file, line);\n"
+               "  DBUG_PRINT (\"new slab of %d N_%s nodes at \" F_PTR,\n"
+               "              NODE_POOL_SLAB, global.mdb_nodetype[type], slab);\n"
+               "\n"
+               "  /* The first node is returned, the others form the free list.  */\n"
+               "  for (size_t i = 1; i + 1 < NODE_POOL_SLAB; i++)\n"
+               "    *(void **) (slab + i * size) = slab + (i + 1) * size;\n"
+               "\n"
+               "  *(void **) (slab + (NODE_POOL_SLAB - 1) * size) = NULL;\n"
+               "  nodepool_free[type] = slab + size;\n"
+               "\n"
+               "  DBUG_RETURN (slab);\n"
+               "}\n"
+               "\n"
+               "#endif // NODE_POOLS\n"
+               "\n");
+
+  /* The addresses of all chunks are kept sorted, so NODE_FREE finds out
+     whether a node belongs to an arena with a binary search, and releasing
+     an arena drops its chunks in one pass.  The nodes of a chunk follow
+     each other, so the release walks them by the sizes of their types.  */
+  emit_str (f, "#ifdef NODE_ARENAS\n"
+               "\n"
+               "/* The header at the start of every chunk.  */\n"
+               "struct NODE_CHUNK\n"
+               "{\n"
+               "  nodearena *arena;\n"
+               "  struct NODE_CHUNK *next;\n"
+               "\n"
+               "  /* The end of the nodes, set when the chunk is full.  */\n"
+               "  char *used;\n"
+               "};\n"
+               "\n"
+               "#define NODE_CHUNK_HEADER NODE_ARENA_ROUND (sizeof (struct NODE_CHUNK))\n"
+               "\n"
+               "nodearena *nodearena_current = NULL;\n"
+               "size_t nodearena_n_chunks = 0;\n"
+               "\n"
+               "static uintptr_t *nodearena_chunks = NULL;\n"
+               "static size_t nodearena_cap_chunks = 0;\n"
+               "\n"
+               "static const size_t nodearena_size[MAX_NODES + 1] = {\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    if (strcmp (m->nodes[i].name->name, "Fundef"))
+      emit_fmt (f, "  [N_%s] = NODE_ARENA_ROUND (sizeof (struct NODE_ALLOC_N_%s)),\n",
+                m->nodes[i].name->lower, m->nodes[i].name->upper);
+
+  emit_str (f, "};\n"
+               "\n"
+               "nodearena *\n"
+               "NODEARENAcreate (void)\n"
+               "{\n"
+               "  nodearena *arena;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "\n"
+               "  arena = (nodearena *) MEMmalloc (sizeof *arena);\n"
+               "  arena->ptr = NULL;\n"
+               "  arena->end = NULL;\n"
+               "  arena->chunks = NULL;\n"
+               "#ifndef DBUG_OFF\n"
+               "  arena->fundefs = NULL;\n"
+               "#endif\n"
+               "\n"
+               "  DBUG_RETURN (arena);\n"
+               "}\n"
+               "\n"
+               "nodearena *\n"
+               "NODEARENAselect (nodearena *arena)\n"
+               "{\n"
+               "  nodearena *prev = nodearena_current;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "\n"
+               "  nodearena_current = arena;\n"
+               "\n"
+               "  DBUG_RETURN (prev);\n"
+               "}\n"
+               "\n"
+               "void *\n"
+               "NODEARENArefill (nodearena *arena, size_t size, char *file, size_t line)\n"
+               "{\n"
+               "  struct NODE_CHUNK *chunk;\n"
+               "  void *mem;\n"
+               "  size_t i;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "  DBUG_ASSERT (NODE_CHUNK_HEADER + size <= NODE_ARENA_CHUNK,\n"
+               "               \"node does not fit into an arena chunk\");\n"
+               "\n"
+               "  if (posix_memalign (&mem, NODE_ARENA_CHUNK, NODE_ARENA_CHUNK) != 0)\n"
+               "    CTIabortOutOfMemory (NODE_ARENA_CHUNK);\n"
+               "\n"
+               "  DBUG_PRINT (\"new arena chunk at \" F_PTR \" for %s:%zu\", mem, file, line);\n"
+               "\n"
+               "  if (arena->chunks != NULL)\n"
+               "    ((struct NODE_CHUNK *) arena->chunks)->used = arena->ptr;\n"
+               "\n"
+               "  chunk = (struct NODE_CHUNK *) mem;\n"
+               "  chunk->arena = arena;\n"
+               "  chunk->next = (struct NODE_CHUNK *) arena->chunks;\n"
+               "  chunk->used = NULL;\n"
+               "  arena->chunks = chunk;\n"
+               "\n"
+               "  if (nodearena_n_chunks == nodearena_cap_chunks)\n"
+               "    {\n"
+               "      nodearena_cap_chunks = nodearena_cap_chunks ? 2 * nodearena_cap_chunks : 64;\n"
+               "      nodearena_chunks = (uintptr_t *) realloc (nodearena_chunks,\n"
+               "                                                nodearena_cap_chunks\n"
+               "                                                * sizeof (uintptr_t));\n"
+               "      if (nodearena_chunks == NULL)\n"
+               "        CTIabortOutOfMemory (nodearena_cap_chunks * sizeof (uintptr_t));\n"
+               "    }\n"
+               "\n"
+               "  for (i = nodearena_n_chunks;\n"
+               "       i > 0 && nodearena_chunks[i - 1] > (uintptr_t) mem; i--)\n"
+               "    nodearena_chunks[i] = nodearena_chunks[i - 1];\n"
+               "\n"
+               "  nodearena_chunks[i] = (uintptr_t) mem;\n"
+               "  nodearena_n_chunks++;\n"
+               "\n"
+               "  arena->ptr = (char *) mem + NODE_CHUNK_HEADER + size;\n"
+               "  arena->end = (char *) mem + NODE_ARENA_CHUNK;\n"
+               "\n"
+               "  DBUG_RETURN ((char *) mem + NODE_CHUNK_HEADER);\n"
+               "}\n"
+               "\n");
+
+  emit_str (f, "nodearena *\n"
+               "NODEARENAlookup (void *p)\n"
+               "{\n"
+               "  uintptr_t base = (uintptr_t) p & ~(uintptr_t) (NODE_ARENA_CHUNK - 1);\n"
+               "  size_t lo = 0;\n"
+               "  size_t hi = nodearena_n_chunks;\n"
+               "\n"
+               "  while (lo < hi)\n"
+               "    {\n"
+               "      size_t mid = lo + (hi - lo) / 2;\n"
+               "\n"
+               "      if (nodearena_chunks[mid] < base)\n"
+               "        lo = mid + 1;\n"
+               "      else\n"
+               "        hi = mid;\n"
+               "    }\n"
+               "\n"
+               "  if (lo < nodearena_n_chunks && nodearena_chunks[lo] == base)\n"
+               "    return ((struct NODE_CHUNK *) base)->arena;\n"
+               "\n"
+               "  return NULL;\n"
+               "}\n"
+               "\n"
+               "/* Call FREEarenaNode for the nodes of ARENA that FREE has not freed.  */\n"
+               "static void\n"
+               "NODEARENAwalk (nodearena *arena, bool own)\n"
+               "{\n"
+               "  struct NODE_CHUNK *chunk;\n"
+               "  char *p;\n"
+               "\n"
+               "  for (chunk = (struct NODE_CHUNK *) arena->chunks; chunk != NULL; chunk = chunk->next)\n"
+               "    for (p = (char *) chunk + NODE_CHUNK_HEADER; p < chunk->used; )\n"
+               "      {\n"
+               "        size_t type = NODE_TYPE ((node *) p);\n"
+               "\n"
+               "        if (type <= MAX_NODES)\n"
+               "          FREEarenaNode ((node *) p, arena, own);\n"
+               "        else\n"
+               "          type -= MAX_NODES + 1;\n"
+               "\n"
+               "        DBUG_ASSERT (type <= MAX_NODES && nodearena_size[type] != 0,\n"
+               "                     \"Illegal nodetype found!\");\n"
+               "        p += nodearena_size[type];\n"
+               "      }\n"
+               "}\n"
+               "\n"
+               "nodearena *\n"
+               "NODEARENArelease (nodearena *arena)\n"
+               "{\n"
+               "  struct NODE_CHUNK *chunk;\n"
+               "  struct NODE_CHUNK *next;\n"
+               "  size_t i, j;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "\n"
+               "  if (nodearena_current == arena)\n"
+               "    nodearena_current = NULL;\n"
+               "\n"
+               "  if (arena->chunks != NULL)\n"
+               "    ((struct NODE_CHUNK *) arena->chunks)->used = arena->ptr;\n"
+               "\n"
+               "  /* The trees that live elsewhere go first, as FREE may come back\n"
+               "     into the arena from them and free some of its nodes in full.\n"
+               "     The payloads of the other nodes are freed afterwards.  */\n"
+               "  NODEARENAwalk (arena, FALSE);\n"
+               "#ifndef DBUG_OFF\n"
+               "  if (arena->fundefs != NULL)\n"
+               "    DBUG_UNREACHABLE (\"arena released under the live fundef %s\",\n"
+               "                      FUNDEF_NAME ((node *) ((char *) arena->fundefs\n"
+               "                                             - sizeof (struct NODE_ALLOC_N_FUNDEF))));\n"
+               "#endif\n"
+               "  NODEARENAwalk (arena, TRUE);\n"
+               "\n"
+               "  for (i = j = 0; i < nodearena_n_chunks; i++)\n"
+               "    if (((struct NODE_CHUNK *) nodearena_chunks[i])->arena != arena)\n"
+               "      nodearena_chunks[j++] = nodearena_chunks[i];\n"
+               "\n"
+               "  nodearena_n_chunks = j;\n"
+               "\n"
+               "  for (chunk = (struct NODE_CHUNK *) arena->chunks; chunk != NULL; chunk = next)\n"
+               "    {\n"
+               "      next = chunk->next;\n"
+               "      free (chunk);\n"
+               "    }\n"
+               "\n"
+               "  arena = MEMfree (arena);\n"
+               "\n"
+               "  DBUG_RETURN (arena);\n"
+               "}\n"
+               "\n");
+
+  emit_str (f, "#ifndef DBUG_OFF\n"
+               "\n"
+               "void *\n"
+               "NODEARENAadopt (void *fundef, size_t size)\n"
+               "{\n"
+               "  struct NODE_ARENA_LINK *link\n"
+               "    = (struct NODE_ARENA_LINK *) ((char *) fundef + size);\n"
+               "\n"
+               "  link->arena = nodearena_current;\n"
+               "  link->prev = NULL;\n"
+               "  link->next = NULL;\n"
+               "\n"
+               "  if (link->arena != NULL)\n"
+               "    {\n"
+               "      link->next = link->arena->fundefs;\n"
+               "      if (link->next != NULL)\n"
+               "        link->next->prev = link;\n"
+               "      link->arena->fundefs = link;\n"
+               "    }\n"
+               "\n"
+               "  return fundef;\n"
+               "}\n"
+               "\n"
+               "void\n"
+               "NODEARENAdisown (node *fundef, size_t size)\n"
+               "{\n"
+               "  struct NODE_ARENA_LINK *link\n"
+               "    = (struct NODE_ARENA_LINK *) ((char *) fundef + size);\n"
+               "\n"
+               "  if (link->arena == NULL)\n"
+               "    return;\n"
+               "\n"
+               "  if (link->prev != NULL)\n"
+               "    link->prev->next = link->next;\n"
+               "  else\n"
+               "    link->arena->fundefs = link->next;\n"
+               "\n"
+               "  if (link->next != NULL)\n"
+               "    link->next->prev = link->prev;\n"
+               "\n"
+               "  link->arena = NULL;\n"
+               "}\n"
+               "\n"
+               "#endif // DBUG_OFF\n"
+               "\n"
+               "#endif // NODE_ARENAS\n");
 
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -7,6 +7,72 @@
 #include "gen.h"
 
 
+/* Generate the metadata of the sons of every node type, indexed by the
+   node type: the number of sons, the byte offset of every son within
+   NODE_ALLOC_N_<nodename> and the name of every son.  The node structure
+   is the first member of NODE_ALLOC_N_<nodename>, so the offsets are
+   relative to the node itself.  */
+static void
+gen_sons_tables (struct emitter *  f, const struct model *  m)
+{
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+
+      if (node->n_sons == 0)
+        continue;
+
+      emit_fmt (f, "static const unsigned short sonsoffsets_%s[] =\n"
+                   "{\n",
+                node->name->lower);
+      for (size_t j = 0; j < node->n_sons; j++)
+        emit_fmt (f, "  offsetof (struct NODE_ALLOC_N_%s, sonstructure.%s),\n",
+                  node->name->upper, node->sons[j].name->name);
+      emit_fmt (f, "};\n"
+                   "\n"
+                   "static const char *const sonsnames_%s[] =\n"
+                   "{\n",
+                node->name->lower);
+      for (size_t j = 0; j < node->n_sons; j++)
+        emit_fmt (f, "  \"%s\",\n", node->sons[j].name->name);
+      emit_str (f, "};\n\n");
+    }
+
+  emit_fmt (f, "const unsigned char sonscount[%zu] =\n"
+               "{\n"
+               "  /* N_undefined  */ 0,\n",
+            m->n_nodes + 1);
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "  /* N_%s  */ %zu,\n",
+              m->nodes[i].name->lower, m->nodes[i].n_sons);
+  emit_str (f, "};\n\n");
+
+  emit_fmt (f, "const unsigned short *const sonsoffsets[%zu] =\n"
+               "{\n"
+               "  /* N_undefined  */ NULL,\n",
+            m->n_nodes + 1);
+  for (size_t i = 0; i < m->n_nodes; i++)
+    if (m->nodes[i].n_sons == 0)
+      emit_fmt (f, "  /* N_%s  */ NULL,\n", m->nodes[i].name->lower);
+    else
+      emit_fmt (f, "  /* N_%s  */ sonsoffsets_%s,\n",
+                m->nodes[i].name->lower, m->nodes[i].name->lower);
+  emit_str (f, "};\n\n");
+
+  emit_fmt (f, "const char *const *const sonsnames[%zu] =\n"
+               "{\n"
+               "  /* N_undefined  */ NULL,\n",
+            m->n_nodes + 1);
+  for (size_t i = 0; i < m->n_nodes; i++)
+    if (m->nodes[i].n_sons == 0)
+      emit_fmt (f, "  /* N_%s  */ NULL,\n", m->nodes[i].name->lower);
+    else
+      emit_fmt (f, "  /* N_%s  */ sonsnames_%s,\n",
+                m->nodes[i].name->lower, m->nodes[i].name->lower);
+  emit_str (f, "};\n\n\n");
+}
+
+
 /* Generate traversal helper functions:
 
        * TRAVsons --- traverse into sons of the node depending on
@@ -14,155 +80,88 @@
 
        * TRAVnumSons --- returns number of sons for the given node.
        
-       * TRAVgetSon --- gets a son by its number in the node.  */
+       * TRAVgetSon --- gets a son by its number in the node.
+
+   All of them are lookups in the tables of sons instead of switches
+   over the node type.  */
 bool
-gen_traverse_helper_c (yajl_val nodes, const char *  fname)
+gen_traverse_helper_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Defines the helper function needed by the traversal system");
 
-  fprintf (f, "#include \"traverse_helper.h\"\n"
-              "#define DBUG_PREFIX \"TRAVHELP\"\n"
-              "#include \"debug.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "\n"
-              "#define TRAV(__son, __info)         \\\n"
-              "do {                                \\\n"
-              "  if (NULL != __son)                \\\n"
-              "    __son = TRAVdo (__son, __info); \\\n"
-              "} while (0)\n"
-              "\n"
-              "\n"
-              "node *\n"
-              "TRAVnone (node *arg_node, info *arg_info)\n"
-              "{\n"
-              "  return (arg_node);\n"
-              "}\n"
-              "\n"
-              "\n"
-              "node *\n"
-              "TRAVerror (node *arg_node, info *arg_info)\n"
-              "{\n"
-              "  DBUG_UNREACHABLE (\"Traveral error, illegal node type found.\");\n"
-              "}\n"
-              "\n"
-              "\n");
-
-  /* Generate the TRAVsons function.  */
-  fprintf (f, "node *\n"
-              "TRAVsons (node *arg_node, info *arg_info)\n"
-              "{\n"
-              "  TRAV (NODE_ERROR (arg_node), arg_info);\n"
-              "  switch (NODE_TYPE (arg_node))\n"
-              "    {\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_upper = string_toupper (node_name);
-      char *  node_name_lower = string_tolower (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      fprintf (f, "    case N_%s:\n", node_name_lower);
-      for (size_t j = 0; sons && j < YAJL_OBJECT_LENGTH (sons); j++)
-        {
-          char *  son_upper = string_toupper (YAJL_OBJECT_KEYS (sons)[j]);
-
-          fprintf (f, "      TRAV (%s_%s (arg_node), arg_info);\n",
-                   node_name_upper,  son_upper);
-
-          free (son_upper);
-        }
-      fprintf (f, "      break;\n\n");
-      free (node_name_upper);
-      free (node_name_lower);
-    }
-
-  fprintf (f, "    default:\n"
-              "      DBUG_UNREACHABLE (\"Illegal nodetype found!\");\n"
-              "    }\n"
-              "\n"
-              "  return (arg_node);\n"
-              "}\n");
-
-  /* Generate TRAVnumSons  */
-  fprintf (f, "int\n"  /* FIXME consider unsigned type here.  */
-              "TRAVnumSons (node *node)\n"
-              "{\n"
-              "  int result = 0;\n"
-              "\n"
-              "  DBUG_ENTER ();\n"
-              "  switch (NODE_TYPE (node))\n"
-              "    {\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      fprintf (f, "    case N_%s:\n"
-                  "      result = %zu;\n"
-                  "      break;\n\n",
-               node_name_lower, sons ? YAJL_OBJECT_LENGTH (sons) : 0);
-
-      free (node_name_lower);
-    }
-
-
-  fprintf (f, "    default:\n"
-              "      DBUG_UNREACHABLE (\"Illegal nodetype found!\");\n"
-              "    }\n"
-              "\n"
-              "  DBUG_RETURN (result);\n"
-              "}\n\n");
-
-
-  /* Generate TRAVgetSon  */
-  fprintf (f, "node *\n"
-              "TRAVgetSon (int no, node *parent)\n"
-              "{\n"
-              "  switch (NODE_TYPE (parent))\n"
-              "    {\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_upper = string_toupper (node_name);
-      char *  node_name_lower = string_tolower (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      fprintf (f, "    case N_%s:\n"
-                  "      switch (no)\n"
-                  "        {\n",
-               node_name_lower);
-      for (size_t j = 0; sons && j < YAJL_OBJECT_LENGTH (sons); j++)
-        {
-          char *  son_upper = string_toupper (YAJL_OBJECT_KEYS (sons)[j]);
-
-          fprintf (f, "        case %zu:\n"
-                      "          return %s_%s (parent);\n",
-                   j, node_name_upper,  son_upper);
-
-          free (son_upper);
-        }
-      fprintf (f, "         default:\n"
-                  "           DBUG_UNREACHABLE (\"index out of range!\");\n"
-                  "         }\n"
-                  "       break;\n\n");
-      free (node_name_upper);
-      free (node_name_lower);
-    }
-
-  fprintf (f, "    default:\n"
-              "      DBUG_UNREACHABLE (\"Illegal nodetype found!\");\n"
-              "    }\n"
-              "}\n\n");
+  emit_str (f, "#include <stddef.h>\n"
+               "#include \"traverse_helper.h\"\n"
+               "#define DBUG_PREFIX \"TRAVHELP\"\n"
+               "#include \"debug.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"node_alloc.h\"\n"
+               "#include \"traverse.h\"\n"
+               "\n"
+               "#define TRAV(__son, __info)         \\\n"
+               "do {                                \\\n"
+               "  if (NULL != __son)                \\\n"
+               "    __son = TRAVdo (__son, __info); \\\n"
+               "} while (0)\n"
+               "\n"
+               "#define NODE_TYPE_VALID_P(__n)                              \\\n"
+               "  (NODE_TYPE (__n) > N_undefined                            \\\n"
+               "   && (size_t) NODE_TYPE (__n) < sizeof (sonscount))\n"
+               "\n"
+               "\n"
+               "node *\n"
+               "TRAVnone (node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  return (arg_node);\n"
+               "}\n"
+               "\n"
+               "\n"
+               "node *\n"
+               "TRAVerror (node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  DBUG_UNREACHABLE (\"Traveral error, illegal node type found.\");\n"
+               "}\n"
+               "\n"
+               "\n");
+
+  gen_sons_tables (f, m);
+
+  emit_str (f, "node *\n"
+               "TRAVsons (node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  const unsigned short *offsets;\n"
+               "  size_t n;\n"
+               "\n"
+               "  TRAV (NODE_ERROR (arg_node), arg_info);\n"
+               "  DBUG_ASSERT (NODE_TYPE_VALID_P (arg_node), \"Illegal nodetype found!\");\n"
+               "\n"
+               "  offsets = sonsoffsets[NODE_TYPE (arg_node)];\n"
+               "  n = sonscount[NODE_TYPE (arg_node)];\n"
+               "  for (size_t i = 0; i < n; i++)\n"
+               "    TRAV (*(node **) ((char *) arg_node + offsets[i]), arg_info);\n"
+               "\n"
+               "  return (arg_node);\n"
+               "}\n"
+               "\n"
+               "\n"
+               "int\n"  /* FIXME consider unsigned type here.  */
+               "TRAVnumSons (node *node)\n"
+               "{\n"
+               "  DBUG_ENTER ();\n"
+               "  DBUG_ASSERT (NODE_TYPE_VALID_P (node), \"Illegal nodetype found!\");\n"
+               "  DBUG_RETURN ((int) sonscount[NODE_TYPE (node)]);\n"
+               "}\n"
+               "\n"
+               "\n"
+               "node *\n"
+               "TRAVgetSon (int no, node *parent)\n"
+               "{\n"
+               "  DBUG_ASSERT (NODE_TYPE_VALID_P (parent), \"Illegal nodetype found!\");\n"
+               "  DBUG_ASSERT (no >= 0 && no < sonscount[NODE_TYPE (parent)],\n"
+               "               \"index out of range!\");\n"
+               "  return *SONS_ADDR (parent, no);\n"
+               "}\n\n");
 
   GEN_FLUSH_AND_CLOSE (f);
   return true;
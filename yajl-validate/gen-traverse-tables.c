@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <regex.h>
 #include <err.h>
 #include <yajl/yajl_tree.h>
@@ -10,9 +11,9 @@
 
 /* Generate data structures for traverse tables.  */
 bool
-gen_traverse_tables_h (yajl_val nodes, yajl_val traversals, const char *  fname)
+gen_traverse_tables_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__TRAVERSE_TABLES_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
@@ -21,22 +22,78 @@ gen_traverse_tables_h (yajl_val nodes, yajl_val traversals, const char *  fname)
   /* FIXME This is insane that we use counts instead of values from the enum
            list.  A proper fix requires adding TR__max and N__max to both enums
            and use those values.  */
-  fprintf (f, "#include \"types.h\"\n"
-              "\n"
-              "typedef travfun_p travfunarray_t[%zu];\n"
-              "typedef travfunarray_t travtables_t[%zu];\n"
-              "typedef travfun_p preposttable_t[%zu];\n"
-              "\n"
-              "extern travtables_t travtables;\n"
-              "extern preposttable_t pretable;\n"
-              "extern preposttable_t posttable;\n"
-              "extern const char *travnames[%zu];\n"
-              "\n\n",
-           YAJL_OBJECT_LENGTH (nodes) + 1,
-           YAJL_OBJECT_LENGTH (traversals) + 2,
-           YAJL_OBJECT_LENGTH (traversals) + 2,
-           YAJL_OBJECT_LENGTH (traversals) + 2);
-
+  if (compact_travtables)
+    emit_fmt (f, "#include <stdint.h>\n"
+                 "#include \"types.h\"\n"
+                 "\n"
+                 "/* Every traversal has a slice of TRAVFUNS with the functions it\n"
+                 "   uses and a row of indices into that slice for every node type.\n"
+                 "   Traversals with the same shape share the row.  */\n"
+                 "typedef %s travindex_t;\n"
+                 "\n"
+                 "typedef struct travtable_s\n"
+                 "{\n"
+                 "  const travfun_p *funs;\n"
+                 "  const travindex_t *row;\n"
+                 "} travtable_t;\n"
+                 "\n"
+                 "typedef travtable_t travtables_t[%zu];\n"
+                 "typedef travfun_p preposttable_t[%zu];\n"
+                 "\n"
+                 "extern travtables_t travtables;\n"
+                 "extern preposttable_t pretable;\n"
+                 "extern preposttable_t posttable;\n"
+                 "extern const char *travnames[%zu];\n"
+                 "\n"
+                 "#define TRAVTABLE_ENTRY(__trav, __nodetype) \\\n"
+                 "  (travtables[__trav].funs[travtables[__trav].row[__nodetype]])\n"
+                 "\n",
+              m->n_nodes <= UINT8_MAX ? "uint8_t" : "uint16_t",
+              m->n_traversals + 2,
+              m->n_traversals + 2,
+              m->n_traversals + 2);
+  else
+    emit_fmt (f, "#include \"types.h\"\n"
+                 "\n"
+                 "typedef travfun_p travfunarray_t[%zu];\n"
+                 "typedef travfunarray_t travtables_t[%zu];\n"
+                 "typedef travfun_p preposttable_t[%zu];\n"
+                 "\n"
+                 "extern travtables_t travtables;\n"
+                 "extern preposttable_t pretable;\n"
+                 "extern preposttable_t posttable;\n"
+                 "extern const char *travnames[%zu];\n"
+                 "\n"
+                 "#define TRAVTABLE_ENTRY(__trav, __nodetype) \\\n"
+                 "  (travtables[__trav][__nodetype])\n"
+                 "\n",
+              m->n_nodes + 1,
+              m->n_traversals + 2,
+              m->n_traversals + 2,
+              m->n_traversals + 2);
+
+
+  /* With TRAV_PROFILE every dispatch goes through a trampoline that
+     times the handler, with AST_DIRTY_TRACKING through one that keeps the
+     path of the traversal for the dirty bits.  */
+  emit_str (f, "#if defined (TRAV_PROFILE) || defined (AST_DIRTY_TRACKING)\n"
+               "extern travfun_p TRAVwrapSelect (trav_t trav, nodetype type);\n"
+               "\n"
+               "#  define TRAVTABLE_FUN(__trav, __nodetype) \\\n"
+               "  TRAVwrapSelect (__trav, __nodetype)\n"
+               "#else\n"
+               "#  define TRAVTABLE_FUN(__trav, __nodetype) \\\n"
+               "  TRAVTABLE_ENTRY (__trav, __nodetype)\n"
+               "#endif\n"
+               "\n");
+
+  /* TRAVdo can return the node right away when the bit is set.  */
+  emit_fmt (f, "extern const unsigned char travskip[%zu][%zu];\n"
+               "\n"
+               "#define TRAVTABLE_SKIP(__trav, __nodetype) \\\n"
+               "  ((travskip[__trav][(__nodetype) / 8] >> ((__nodetype) %% 8)) & 1)\n"
+               "\n\n",
+            m->n_traversals + 2, (m->n_nodes + 1 + 7) / 8);
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -60,207 +117,878 @@ enum pre_or_post
    This is used for phantom traversals like TR_undefined and in the
    else branch of the ifndef.  See GEN_TRAVTABLE for more details.  */
 static inline void
-gen_error_travtable (FILE *  f, yajl_val nodes)
+gen_error_travtable (struct emitter *  f, const struct model *  m)
 {
-  fprintf (f, "  {\n"
-              "    /* %30s  */ &TRAVerror,\n",
-           "<undefined-node>");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  static const char entry[] = "  */ &TRAVerror,\n";
+
+  emit_str (f, "  {\n"
+               "    /* ");
+  emit_padded (f, "<undefined-node>", 30);
+  emit_mem (f, entry, sizeof (entry) - 1);
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      fprintf (f, "    /* %30s  */ &TRAVerror,\n", node_name);
+      emit_mem (f, "    /* ", 7);
+      emit_padded (f, m->nodes[i].name->name, 30);
+      emit_mem (f, entry, sizeof (entry) - 1);
     }
-  fprintf (f, "  },\n\n");
+  emit_str (f, "  },\n\n");
 }
 
 
 
-/* Generate a travtable for the TRAVNAME traversal, where the default value
-   is specidied by TRAVDEFUALT.  */
+/* Generate a travtable for the traversal TRAV.  Functions for every node
+   including the default of the traversal are resolved in the model.  */
 static inline void
-gen_travtable (FILE *  f, yajl_val nodes, const char *  travname, const char *  travdefault)
+gen_travtable (struct emitter *  f, const struct model *  m, const struct model_traversal *  trav)
 {
-  struct traversal_name *  tn;
+  emit_str (f, "  {\n"
+               "    /* ");
+  emit_padded (f, "<undefined-node>", 30);
+  emit_str (f, "  */ &TRAVerror,\n");
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_name *  node_name = m->nodes[i].name;
+
+      emit_mem (f, "    /* ", 7);
+      emit_padded (f, node_name->name, 30);
+      emit_mem (f, "  */ ", 5);
+      switch (trav->node_types[i])
+        {
+        case tnt_sons: emit_mem (f, "&TRAVsons", 9); break;
+        case tnt_none: emit_mem (f, "&TRAVnone", 9); break;
+        case tnt_error: emit_mem (f, "&TRAVerror", 10); break;
+        case tnt_user:
+          emit_char (f, '&');
+          emit_str (f, trav->name->name);
+          emit_str (f, node_name->lower);
+          break;
+        case tnt_default:
+          emit_char (f, '&');
+          emit_str (f, trav->def);
+          break;
+        default: assert (0);
+        }
+
+      emit_mem (f, ",\n", 2);
+    }
+  emit_str (f, "  },\n\n");
+}
+
 
-  /* Find traversal in TRAVERSAL_NAMES --- global variable that is initialised
-     during the validation.  */
-  HASH_FIND_STR (traversal_names, travname, tn);
-  assert (tn);
 
-  fprintf (f, "  {\n"
-              "    /* %30s  */ &TRAVerror,\n",
-           "<undefined-node>");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+/* Generate pre- or post- table for traversals.  */
+static inline void
+gen_prepost_table (struct emitter *  f, const struct model *  m, enum pre_or_post prepost)
+{
+  emit_fmt (f, "preposttable_t %s =\n"
+               "{\n"
+               "  /* TR_undefined  */\n"
+               "  NULL,\n\n",
+            prepost == pp_pre_table ? "pretable" : "posttable");
+
+  for (size_t i = 0; i < m->n_traversals; i++)
     {
-      struct traversal_node *  trn;
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
+      const struct model_traversal *  trav = &m->traversals[i];
+      const char *  prepostfun = (prepost == pp_pre_table ? trav->prefun : trav->postfun);
 
-      HASH_FIND_STR (tn->traversal_nodes, node_name, trn);
+      emit_fmt (f, "  /* TR_%s  */\n", trav->name->lower);
 
-      fprintf (f, "    /* %30s  */ ", node_name);
-      if (trn)
+      if (NULL == prepostfun)
+        emit_str (f, "  NULL,\n\n");
+      else if (trav->ifndef)
         {
-          switch (trn->node_type)
+          emit_fmt (f, "# ifndef %s\n", trav->ifndef);
+          emit_fmt (f, "    &%s,\n", prepostfun);
+          emit_str (f, "# else\n"
+                       "    NULL,\n"
+                       "# endif\n\n");
+        }
+      else
+        emit_fmt (f, "  &%s,\n\n", prepostfun);
+    }
+  emit_str (f, "  /* TR_anonymous  */\n"
+               "  NULL\n"
+               "};\n\n");
+
+}
+
+
+
+/* Generate the dense travtables: a row of function pointers for every
+   traversal.  */
+static void
+gen_dense_travtables (struct emitter *  f, const struct model *  m)
+{
+  emit_str (f, "travtables_t travtables = \n"
+               "{\n");
+
+  emit_str (f, "  /* TR_undefined  */\n");
+  gen_error_travtable (f, m);
+
+  for (size_t i = 0; i < m->n_traversals; i++)
+    {
+      const struct model_traversal *  trav = &m->traversals[i];
+
+      emit_fmt (f, "  /* TR_%s  */\n", trav->name->lower);
+
+      if (trav->ifndef)
+        {
+          emit_fmt (f, "# ifndef %s\n", trav->ifndef);
+          gen_travtable (f, m, trav);
+          emit_str (f, "# else\n");
+          gen_error_travtable (f, m);
+          emit_str (f, "# endif\n\n");
+        }
+      else
+        gen_travtable (f, m, trav);
+    }
+
+  emit_str (f, "  /* TR_anonymous  */\n"
+               "  /* FIXME cuurently there is no table defined, so as a result,\n"
+               "           as TRAVTABLES is a gloval object, the travtable for\n"
+               "           TR_anonymous, will be filled with 0s, which means that\n"
+               "           every function pointer will be NULL.  I don't think\n"
+               "           that it is what we want.  */\n"
+               "};\n\n");
+}
+
+
+
+/* Slots of the functions that are shared by all the node types in the
+   slice of a traversal in the compact layout.  User functions are
+   different for every node type, so they get no slot.  */
+enum slice_slot
+{
+  ss_error,
+  ss_sons,
+  ss_none,
+  ss_default,
+  ss_max
+};
+
+
+/* A row of indices of the compact layout.  Traversals with the same
+   row share it.  */
+struct travrow
+{
+  const uint16_t *  idx;
+  size_t id;
+  UT_hash_handle hh;
+};
+
+
+
+/* Generate the slice of TRAVFUNS for the traversal TRAV and fill its row
+   of indices IDX for N_NODES + 1 node types.  The first element of the
+   slice is always TRAVerror, which is the function for the undefined
+   node type.  Return the size of the slice.  */
+static size_t
+gen_compact_slice (struct emitter *  f, const struct model *  m,
+                   const struct model_traversal *  trav, uint16_t *  idx)
+{
+  size_t slots[ss_max];
+  size_t n = 0;
+
+  for (size_t i = 0; i < ss_max; i++)
+    slots[i] = SIZE_MAX;
+
+  slots[ss_error] = n++;
+  emit_str (f, "  &TRAVerror,\n");
+  idx[0] = slots[ss_error];
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      enum slice_slot slot;
+
+      switch (trav->node_types[i])
+        {
+        case tnt_sons: slot = ss_sons; break;
+        case tnt_none: slot = ss_none; break;
+        case tnt_error: slot = ss_error; break;
+        case tnt_default: slot = ss_default; break;
+        case tnt_user:
+          emit_str (f, "  &");
+          emit_str (f, trav->name->name);
+          emit_str (f, m->nodes[i].name->lower);
+          emit_str (f, ",\n");
+          idx[i + 1] = n++;
+          continue;
+        default: assert (0);
+        }
+
+      if (slots[slot] == SIZE_MAX)
+        {
+          slots[slot] = n++;
+          switch (slot)
             {
-            case tnt_sons: fprintf (f, "&TRAVsons"); break;
-            case tnt_none: fprintf (f, "&TRAVnone"); break;
-            case tnt_error: fprintf (f, "&TRAVerror"); break;
-            case tnt_user:
-              {
-                char *  node_name_lower = string_tolower (node_name);
-                fprintf (f, "&%s%s", travname, node_name_lower);
-                free (node_name_lower);
-                break;
-              }
+            case ss_sons: emit_str (f, "  &TRAVsons,\n"); break;
+            case ss_none: emit_str (f, "  &TRAVnone,\n"); break;
+            case ss_default: emit_fmt (f, "  &%s,\n", trav->def); break;
             default: assert (0);
             }
         }
-      else if (!strcmp (travdefault, "user"))
+      idx[i + 1] = slots[slot];
+    }
+
+  return n;
+}
+
+
+
+/* Generate the compact travtables.  Every traversal gets a slice of
+   the shared array TRAVFUNS holding each function it dispatches to
+   once, and a row of small indices into the slice for every node type.
+   Identical rows are emitted once.  */
+static void
+gen_compact_travtables (struct emitter *  f, const struct model *  m)
+{
+  /* Tables of TR_undefined, of every traversal and of TR_anonymous.  */
+  const size_t n_tables = m->n_traversals + 2;
+  const size_t row_len = m->n_nodes + 1;
+  uint16_t *  idx = calloc (n_tables * row_len, sizeof (*idx));
+  struct travrow *  rows = malloc (n_tables * sizeof (*rows));
+  struct travrow *  row_hash = NULL;
+  size_t *  offsets = malloc (n_tables * sizeof (*offsets));
+  size_t *  row_ids = malloc (n_tables * sizeof (*row_ids));
+  size_t n_funs = 0;
+  size_t n_rows = 0;
+
+  emit_str (f, "static const travfun_p travfuns[] =\n"
+               "{\n"
+               "  /* TR_undefined  */\n"
+               "  &TRAVerror,\n\n");
+  offsets[0] = n_funs++;
+
+  for (size_t i = 0; i < m->n_traversals; i++)
+    {
+      const struct model_traversal *  trav = &m->traversals[i];
+      size_t n;
+
+      emit_fmt (f, "  /* TR_%s  */\n", trav->name->lower);
+      if (trav->ifndef)
+        emit_fmt (f, "# ifndef %s\n", trav->ifndef);
+
+      offsets[i + 1] = n_funs;
+      n = gen_compact_slice (f, m, trav, &idx[(i + 1) * row_len]);
+      n_funs += n;
+
+      /* The alternative has the same size, so the row stays valid.  */
+      if (trav->ifndef)
         {
-          char *  node_name_lower = string_tolower (node_name);
-          fprintf (f, "&%s%s", travname, node_name_lower);
-          free (node_name_lower);
+          emit_str (f, "# else\n");
+          for (size_t j = 0; j < n; j++)
+            emit_str (f, "  &TRAVerror,\n");
+          emit_str (f, "# endif\n");
         }
-      else if (!strcmp (travdefault, "sons"))
-        fprintf (f, "&TRAVsons");
-      else if (!strcmp (travdefault, "none"))
-        fprintf (f, "&TRAVnone");
-      else if (!strcmp (travdefault, "error"))
-        fprintf (f, "&TRAVerror");
-      else
-        fprintf (f, "&%s", travdefault);
+      emit_str (f, "\n");
+    }
+
+  /* FIXME There is no table for TR_anonymous, so it dispatches to NULL
+           for every node type like the dense table filled with 0s.  */
+  emit_str (f, "  /* TR_anonymous  */\n"
+               "  NULL\n"
+               "};\n\n");
+  offsets[n_tables - 1] = n_funs++;
+
+  /* Rows of TR_undefined and TR_anonymous are all zeros.  */
+  for (size_t i = 0; i < n_tables; i++)
+    {
+      struct travrow *  r;
+      const uint16_t *  row = &idx[i * row_len];
+
+      HASH_FIND (hh, row_hash, row, row_len * sizeof (*row), r);
+      if (!r)
+        {
+          r = &rows[n_rows];
+          r->idx = row;
+          r->id = n_rows++;
+          HASH_ADD_KEYPTR (hh, row_hash, r->idx, row_len * sizeof (*row), r);
+        }
+      row_ids[i] = r->id;
+    }
+
+  emit_str (f, "static const travindex_t travrows[][");
+  emit_size (f, row_len);
+  emit_str (f, "] =\n"
+               "{\n");
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      emit_str (f, "  {");
+      for (size_t j = 0; j < row_len; j++)
+        {
+          emit_str (f, j % 16 == 0 ? "\n    " : " ");
+          emit_size (f, rows[i].idx[j]);
+          if (j + 1 < row_len)
+            emit_char (f, ',');
+        }
+      emit_str (f, "\n  },\n");
+    }
+  emit_str (f, "};\n\n");
 
-      fprintf (f, ",\n");
+  emit_str (f, "travtables_t travtables =\n"
+               "{\n");
+  for (size_t i = 0; i < n_tables; i++)
+    {
+      const char *  name = i == 0 ? "undefined"
+                           : i == n_tables - 1 ? "anonymous"
+                           : m->traversals[i - 1].name->lower;
+
+      emit_fmt (f, "  /* TR_%s  */ { &travfuns[%zu], travrows[%zu] }%s\n",
+                name, offsets[i], row_ids[i], i + 1 < n_tables ? "," : "");
     }
-  fprintf (f, "  },\n\n");
+  emit_str (f, "};\n\n");
+
+  HASH_CLEAR (hh, row_hash);
+  free (row_ids);
+  free (offsets);
+  free (rows);
+  free (idx);
 }
 
 
 
-/* Generate pre- or post- table for traversals.  */
-static inline void
-gen_prepost_table (FILE *  f, yajl_val traversals, enum pre_or_post prepost)
+/* Mark in CHILD, a matrix of N_NODES x N_NODES, every node type that can
+   be a son of every other node type in any phase.  A son without
+   targets, or a target that contains `any', can hold every node type.  */
+static void
+travskip_children (const struct model *  m, bool *  child)
 {
-  fprintf (f, "preposttable_t %s =\n"
-              "{\n"
-              "  /* TR_undefined  */\n"
-              "  NULL,\n\n",
-           prepost == pp_pre_table ? "pretable" : "posttable");
+  const size_t n = m->n_nodes;
+  const struct model_node *  error = NULL;
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (traversals); i++)
+  for (size_t p = 0; p < n; p++)
     {
-      const yajl_val traversal = YAJL_OBJECT_VALUES (traversals)[i];
-      const char *  prepostfuntag = (prepost == pp_pre_table ? "prefun" : "postfun");
+      const struct model_node *  node = &m->nodes[p];
+      bool *  row = &child[p * n];
 
-      const yajl_val prepostfun
-        = yajl_tree_get (traversal, (const char *[]){prepostfuntag, 0}, yajl_t_string);
+      if (!strcmp (node->name->name, "Error"))
+        error = node;
 
-      const yajl_val ifndef
-        = yajl_tree_get (traversal, (const char *[]){"ifndef", 0}, yajl_t_string);
+      for (size_t i = 0; i < node->n_sons; i++)
+        {
+          const struct model_son *  son = &node->sons[i];
 
-      char *  trav_lower = string_tolower (YAJL_OBJECT_KEYS (traversals)[i]);
-      fprintf (f, "  /* TR_%s  */\n", trav_lower);
-      free (trav_lower);
+          if (son->n_targets == 0)
+            memset (row, true, n);
 
-      if (NULL == prepostfun)
-        fprintf (f, "  NULL,\n\n");
-      else if (ifndef)
-        {
-          fprintf (f, "# ifndef %s\n", YAJL_GET_STRING (ifndef));
-          fprintf (f, "    &%s,\n", YAJL_GET_STRING (prepostfun));
-          fprintf (f, "# else\n"
-                      "    NULL,\n"
-                      "# endif\n\n");
+          for (size_t j = 0; j < son->n_targets; j++)
+            for (size_t k = 0; k < son->targets[j].n_contains; k++)
+              {
+                const struct model_contains *  c = &son->targets[j].contains[k];
+
+                if (c->node)
+                  row[c->node - m->nodes] = true;
+                else if (c->nodeset)
+                  for (size_t l = 0; l < c->nodeset->n_nodes; l++)
+                    row[c->nodeset->nodes[l] - m->nodes] = true;
+                else
+                  memset (row, true, n);
+              }
         }
-      else
-        fprintf (f, "  &%s,\n\n", YAJL_GET_STRING (prepostfun));
     }
-  fprintf (f, "  /* TR_anonymous  */\n"
-              "  NULL\n"
-              "};\n\n");
 
+  /* TRAVsons walks NODE_ERROR of every node as well.  */
+  if (error)
+    for (size_t p = 0; p < n; p++)
+      child[p * n + (error - m->nodes)] = true;
 }
 
 
 
-/* Main function to generate includes, traversal table, pretable, posttable and
-   the table of traversal names.  */
-bool
-gen_traverse_tables_c (yajl_val nodes, yajl_val traversals, const char *  fname)
+/* Compute in SKIP the node types whose subtrees TRAV never needs to
+   walk: the ones that are handled by TRAVsons or TRAVnone and below
+   which no other handler can be reached.  CHILD is the matrix computed
+   by TRAVSKIP_CHILDREN and STACK has room for N_NODES elements.  Return
+   the number of node types that are skipped.  */
+static size_t
+travskip_compute (const struct model *  m, const bool *  child,
+                  const struct model_traversal *  trav, bool *  skip,
+                  size_t *  stack)
 {
-  FILE *  f;
-  GEN_OPEN_FILE (f, fname);
-  GEN_HEADER (f, "   This file defines the function tables for traversal");
+  const size_t n = m->n_nodes;
+  size_t n_stack = 0;
+  size_t n_skip = 0;
 
-  fprintf (f, "#include \"traverse_tables.h\"\n"
-              "#include \"traverse_helper.h\"\n\n");
+  /* Pre- and post-functions are called by TRAVdo for every node, so
+     no node can be skipped.  */
+  if (trav->prefun || trav->postfun)
+    {
+      memset (skip, false, n);
+      return 0;
+    }
 
-  /* First we generate the list of includes.  */
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (traversals); i++)
+  /* Walk from the nodes with other handlers up to every node that can
+     have them below, through the nodes handled by TRAVsons.  */
+  for (size_t i = 0; i < n; i++)
     {
-      const yajl_val traversal = YAJL_OBJECT_VALUES (traversals)[i];
-      const yajl_val include = yajl_tree_get (traversal, (const char *[]){"include", 0}, yajl_t_string);
+      skip[i] = trav->node_types[i] == tnt_sons || trav->node_types[i] == tnt_none;
+      if (!skip[i])
+        stack[n_stack++] = i;
+    }
 
-      fprintf (f, "#include \"%s\"\n", YAJL_GET_STRING (include));
+  while (n_stack)
+    {
+      size_t c = stack[--n_stack];
+
+      for (size_t p = 0; p < n; p++)
+        if (skip[p] && child[p * n + c] && trav->node_types[p] == tnt_sons)
+          {
+            skip[p] = false;
+            stack[n_stack++] = p;
+          }
     }
 
-  /* Generate travtables.  */
-  fprintf (f, "travtables_t travtables = \n"
-              "{\n");
+  for (size_t i = 0; i < n; i++)
+    n_skip += skip[i];
+
+  return n_skip;
+}
 
-  fprintf (f, "  /* TR_undefined  */\n");
-  gen_error_travtable (f, nodes);
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (traversals); i++)
+
+/* Emit a row of TRAVSKIP where the bit of every node type in SKIP is
+   set.  The bit 0 stands for N_undefined and is never set.  */
+static void
+gen_travskip_row (struct emitter *  f, const struct model *  m, const bool *  skip)
+{
+  const size_t n_bytes = (m->n_nodes + 1 + 7) / 8;
+
+  emit_str (f, "  {");
+  for (size_t i = 0; i < n_bytes; i++)
     {
-      const yajl_val traversal = YAJL_OBJECT_VALUES (traversals)[i];
-      const yajl_val travdefault = yajl_tree_get (traversal, (const char *[]){"default", 0}, yajl_t_string);
-      const yajl_val ifndef = yajl_tree_get (traversal, (const char *[]){"ifndef", 0}, yajl_t_string);
-      const char *  travname = YAJL_OBJECT_KEYS (traversals)[i];
+      unsigned byte = 0;
 
-      char * travname_lower = string_tolower (travname);
-      fprintf (f, "  /* TR_%s  */\n", travname_lower);
-      free (travname_lower);
+      for (size_t j = 0; j < 8; j++)
+        if (i * 8 + j >= 1 && i * 8 + j <= m->n_nodes && skip[i * 8 + j - 1])
+          byte |= 1u << j;
 
-      if (ifndef)
+      emit_str (f, i ? ", " : " ");
+      emit_str (f, "0x");
+      emit_char (f, "0123456789abcdef"[byte >> 4]);
+      emit_char (f, "0123456789abcdef"[byte & 15]);
+    }
+  emit_str (f, " },\n");
+}
+
+
+
+/* Generate TRAVSKIP, the bitsets of node types for every traversal that
+   TRAVdo can return right away without changing the result of the
+   traversal.  The sons of a node type are taken from the targets of
+   all the phases.  */
+static void
+gen_travskip (struct emitter *  f, const struct model *  m)
+{
+  const size_t n = m->n_nodes;
+  bool *  child = calloc (n * n, sizeof (*child));
+  bool *  skip = calloc (n, sizeof (*skip));
+  size_t *  stack = malloc (n * sizeof (*stack));
+
+  travskip_children (m, child);
+
+  emit_fmt (f, "const unsigned char travskip[%zu][%zu] =\n"
+               "{\n"
+               "  /* TR_undefined  */\n",
+            m->n_traversals + 2, (n + 1 + 7) / 8);
+  memset (skip, false, n);
+  gen_travskip_row (f, m, skip);
+
+  for (size_t i = 0; i < m->n_traversals; i++)
+    {
+      const struct model_traversal *  trav = &m->traversals[i];
+      size_t n_skip = travskip_compute (m, child, trav, skip, stack);
+
+      emit_fmt (f, "  /* TR_%s: ", trav->name->lower);
+      emit_size (f, n_skip);
+      emit_fmt (f, " of %zu node types  */\n", n);
+
+      /* Otherwise every node type is handled by TRAVerror.  */
+      if (trav->ifndef)
+        emit_fmt (f, "# ifndef %s\n", trav->ifndef);
+      gen_travskip_row (f, m, skip);
+      if (trav->ifndef)
         {
-          fprintf (f, "# ifndef %s\n", YAJL_GET_STRING (ifndef));
-          gen_travtable (f, nodes, travname, YAJL_GET_STRING (travdefault));
-          fprintf (f, "# else\n");
-          gen_error_travtable (f, nodes);
-          fprintf (f, "# endif\n\n");
+          memset (skip, false, n);
+          emit_str (f, "# else\n");
+          gen_travskip_row (f, m, skip);
+          emit_str (f, "# endif\n");
         }
-      else
-        gen_travtable (f, nodes, travname, YAJL_GET_STRING (travdefault));
     }
 
-  fprintf (f, "  /* TR_anonymous  */\n"
-              "  /* FIXME cuurently there is no table defined, so as a result,\n"
-              "           as TRAVTABLES is a gloval object, the travtable for\n"
-              "           TR_anonymous, will be filled with 0s, which means that\n"
-              "           every function pointer will be NULL.  I don't think\n"
-              "           that it is what we want.  */\n"
-              "};\n\n");
+  memset (skip, false, n);
+  emit_str (f, "  /* TR_anonymous  */\n");
+  gen_travskip_row (f, m, skip);
+  emit_str (f, "};\n\n");
+
+  free (stack);
+  free (skip);
+  free (child);
+}
+
+
+/* Generate the profiler of TRAV_PROFILE.  TRAVprofileCall is called by
+   the wrapper of the traversal selected by TRAVTABLE_FUN, so calls and
+   cycles are counted for every traversal and node type.  */
+static void
+gen_trav_profile (struct emitter *  f, const struct model *  m)
+{
+  emit_fmt (f, "#ifdef TRAV_PROFILE\n"
+               "\n"
+               "#include <stdio.h>\n"
+               "#include <stdlib.h>\n"
+               "#include <string.h>\n"
+               "#include <time.h>\n"
+               "#include \"globals.h\"\n"
+               "#include \"ctinfo.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "\n"
+               "#if defined (__x86_64__) || defined (__i386__)\n"
+               "#  include <x86intrin.h>\n"
+               "#  define TRAV_PROFILE_CLOCK() __rdtsc ()\n"
+               "#else\n"
+               "static inline unsigned long long\n"
+               "TRAVprofileClock (void)\n"
+               "{\n"
+               "  struct timespec ts;\n"
+               "\n"
+               "  clock_gettime (CLOCK_MONOTONIC, &ts);\n"
+               "  return ts.tv_sec * 1000000000ull + ts.tv_nsec;\n"
+               "}\n"
+               "#  define TRAV_PROFILE_CLOCK() TRAVprofileClock ()\n"
+               "#endif\n"
+               "\n"
+               "#define TRAV_PROFILE_TRAVS %zu\n"
+               "#define TRAV_PROFILE_NODES %zu\n",
+            m->n_traversals + 2, m->n_nodes + 1);
+
+  emit_str (f, "\n"
+               "/* A frame of the call tree: the handler of NODE in TRAV called below\n"
+               "   PARENT.  A handler that is already on the path to the root is folded\n"
+               "   into its frame, so the tree does not grow with the depth of the AST.  */\n"
+               "struct TRAV_PROFILE_FRAME\n"
+               "{\n"
+               "  trav_t trav;\n"
+               "  nodetype node;\n"
+               "  unsigned long long calls;\n"
+               "  unsigned long long cycles;\n"
+               "  struct TRAV_PROFILE_FRAME *parent;\n"
+               "  struct TRAV_PROFILE_FRAME *children;\n"
+               "  struct TRAV_PROFILE_FRAME *next;\n"
+               "};\n"
+               "\n"
+               "static struct TRAV_PROFILE_FRAME travprofile_root;\n"
+               "static struct TRAV_PROFILE_FRAME *travprofile_current = &travprofile_root;\n"
+               "\n"
+               "/* The frames to return to.  */\n"
+               "static struct TRAV_PROFILE_FRAME **travprofile_stack = NULL;\n"
+               "static size_t travprofile_depth = 0;\n"
+               "static size_t travprofile_cap = 0;\n"
+               "\n"
+               "/* The time the cycles were last charged to the current frame.  */\n"
+               "static unsigned long long travprofile_last = 0;\n"
+               "\n"
+               "static unsigned long long travprofile_calls[TRAV_PROFILE_TRAVS][TRAV_PROFILE_NODES];\n"
+               "static unsigned long long travprofile_cycles[TRAV_PROFILE_TRAVS][TRAV_PROFILE_NODES];\n"
+               "\n"
+               "static void TRAVprofileDump (void);\n");
+
+  emit_str (f, "\n"
+               "/* Charge the cycles since the last event to the current frame, so every\n"
+               "   frame gets the cycles spent in it but not in its callees.  */\n"
+               "static void\n"
+               "TRAVprofileCharge (void)\n"
+               "{\n"
+               "  unsigned long long now = TRAV_PROFILE_CLOCK ();\n"
+               "  struct TRAV_PROFILE_FRAME *frame = travprofile_current;\n"
+               "\n"
+               "  frame->cycles += now - travprofile_last;\n"
+               "  if (frame != &travprofile_root)\n"
+               "    travprofile_cycles[frame->trav][frame->node] += now - travprofile_last;\n"
+               "\n"
+               "  travprofile_last = now;\n"
+               "}\n"
+               "\n"
+               "static void\n"
+               "TRAVprofileEnter (trav_t trav, nodetype type)\n"
+               "{\n"
+               "  struct TRAV_PROFILE_FRAME *frame;\n"
+               "\n"
+               "  if (travprofile_depth == travprofile_cap)\n"
+               "    {\n"
+               "      travprofile_cap = travprofile_cap ? 2 * travprofile_cap : 256;\n"
+               "      travprofile_stack = (struct TRAV_PROFILE_FRAME **)\n"
+               "        realloc (travprofile_stack, travprofile_cap * sizeof (*travprofile_stack));\n"
+               "      if (travprofile_stack == NULL)\n"
+               "        CTIabortOutOfMemory (travprofile_cap * sizeof (*travprofile_stack));\n"
+               "    }\n"
+               "\n"
+               "  travprofile_stack[travprofile_depth++] = travprofile_current;\n"
+               "\n"
+               "  for (frame = travprofile_current; frame != &travprofile_root; frame = frame->parent)\n"
+               "    if (frame->trav == trav && frame->node == type)\n"
+               "      break;\n"
+               "\n"
+               "  if (frame == &travprofile_root)\n"
+               "    {\n"
+               "      for (frame = travprofile_current->children; frame != NULL; frame = frame->next)\n"
+               "        if (frame->trav == trav && frame->node == type)\n"
+               "          break;\n"
+               "\n"
+               "      if (frame == NULL)\n"
+               "        {\n"
+               "          frame = (struct TRAV_PROFILE_FRAME *) calloc (1, sizeof (*frame));\n"
+               "          if (frame == NULL)\n"
+               "            CTIabortOutOfMemory (sizeof (*frame));\n"
+               "\n"
+               "          frame->trav = trav;\n"
+               "          frame->node = type;\n"
+               "          frame->parent = travprofile_current;\n"
+               "          frame->next = travprofile_current->children;\n"
+               "          travprofile_current->children = frame;\n"
+               "        }\n"
+               "    }\n"
+               "\n"
+               "  frame->calls++;\n"
+               "  travprofile_calls[trav][type]++;\n"
+               "  travprofile_current = frame;\n"
+               "}\n");
+
+  emit_str (f, "\n"
+               "/* Call the handler of TRAV for the type of ARG_NODE.  */\n"
+               "static node *\n"
+               "TRAVprofileCall (trav_t trav, node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  nodetype type = NODE_TYPE (arg_node);\n"
+               "\n"
+               "  if (travprofile_last == 0)\n"
+               "    {\n"
+               "      atexit (TRAVprofileDump);\n"
+               "      travprofile_last = TRAV_PROFILE_CLOCK ();\n"
+               "    }\n"
+               "\n"
+               "  TRAVprofileCharge ();\n"
+               "  TRAVprofileEnter (trav, type);\n"
+               "\n"
+               "  arg_node = TRAVTABLE_ENTRY (trav, type) (arg_node, arg_info);\n"
+               "\n"
+               "  TRAVprofileCharge ();\n"
+               "  travprofile_current = travprofile_stack[--travprofile_depth];\n"
+               "\n"
+               "  return arg_node;\n"
+               "}\n"
+               "\n"
+               "/* Write a line `trav:Node;trav:Node;... cycles' for FRAME and every frame\n"
+               "   below it, where PATH is the path to the parent of FRAME.  */\n"
+               "static void\n"
+               "TRAVprofileFold (FILE *f, const struct TRAV_PROFILE_FRAME *frame, const char *path)\n"
+               "{\n"
+               "  const char *trav = travnames[frame->trav];\n"
+               "  const char *node = global.mdb_nodetype[frame->node];\n"
+               "  size_t len = strlen (path) + strlen (trav) + strlen (node) + 3;\n"
+               "  char *p = (char *) malloc (len);\n"
+               "\n"
+               "  if (p == NULL)\n"
+               "    CTIabortOutOfMemory (len);\n"
+               "\n"
+               "  snprintf (p, len, \"%s%s%s:%s\", path, path[0] ? \";\" : \"\", trav, node);\n"
+               "  if (frame->cycles != 0)\n"
+               "    fprintf (f, \"%s %llu\\n\", p, frame->cycles);\n"
+               "\n"
+               "  for (const struct TRAV_PROFILE_FRAME *c = frame->children; c != NULL; c = c->next)\n"
+               "    TRAVprofileFold (f, c, p);\n"
+               "\n"
+               "  free (p);\n"
+               "}\n");
+
+  emit_str (f, "\n"
+               "/* Write the call tree in the collapsed-stack format of flamegraph.pl\n"
+               "   into the file named by TRAV_PROFILE_FILE, `trav_profile.folded' by\n"
+               "   default, and the calls and the cycles of every handler into the file\n"
+               "   named by TRAV_PROFILE_CALLS, `trav_profile.calls' by default.  */\n"
+               "static void\n"
+               "TRAVprofileDump (void)\n"
+               "{\n"
+               "  const char *fname = getenv (\"TRAV_PROFILE_FILE\");\n"
+               "  const char *calls_fname = getenv (\"TRAV_PROFILE_CALLS\");\n"
+               "  FILE *f;\n"
+               "\n"
+               "  if (fname == NULL)\n"
+               "    fname = \"trav_profile.folded\";\n"
+               "  if (calls_fname == NULL)\n"
+               "    calls_fname = \"trav_profile.calls\";\n"
+               "\n"
+               "  f = fopen (fname, \"w\");\n"
+               "  if (f == NULL)\n"
+               "    CTIwarn (\"Cannot write the traversal profile `%s'\", fname);\n"
+               "  else\n"
+               "    {\n"
+               "      for (const struct TRAV_PROFILE_FRAME *c = travprofile_root.children; c != NULL;\n"
+               "           c = c->next)\n"
+               "        TRAVprofileFold (f, c, \"\");\n"
+               "\n"
+               "      if (fclose (f) != 0)\n"
+               "        CTIwarn (\"Cannot write the traversal profile `%s'\", fname);\n"
+               "    }\n"
+               "\n"
+               "  f = fopen (calls_fname, \"w\");\n"
+               "  if (f == NULL)\n"
+               "    {\n"
+               "      CTIwarn (\"Cannot write the traversal profile `%s'\", calls_fname);\n"
+               "      return;\n"
+               "    }\n"
+               "\n"
+               "  fprintf (f, \"# traversal node calls cycles\\n\");\n"
+               "  for (size_t t = 0; t < TRAV_PROFILE_TRAVS; t++)\n"
+               "    for (size_t n = 0; n < TRAV_PROFILE_NODES; n++)\n"
+               "      if (travprofile_calls[t][n] != 0)\n"
+               "        fprintf (f, \"%s %s %llu %llu\\n\", travnames[t], global.mdb_nodetype[n],\n"
+               "                 travprofile_calls[t][n], travprofile_cycles[t][n]);\n"
+               "\n"
+               "  if (fclose (f) != 0)\n"
+               "    CTIwarn (\"Cannot write the traversal profile `%s'\", calls_fname);\n"
+               "}\n"
+               "\n"
+               "#endif // TRAV_PROFILE\n"
+               "\n");
+}
+
+
+
+/* Generate the trampoline behind TRAVTABLE_FUN with AST_DIRTY_TRACKING.
+   It keeps the nodes of the running handlers in nbdirty_path, so that
+   NBtouch and NBdirtyPop can mark the nodes above a written one.  */
+static void
+gen_trav_dirty (struct emitter *  f)
+{
+  emit_str (f, "#ifdef AST_DIRTY_TRACKING\n"
+               "\n"
+               "#include \"tree_basic.h\"\n"
+               "\n"
+               "#ifdef TRAV_PROFILE\n"
+               "#  define TRAV_DIRTY_CALL(__trav, __node, __info) \\\n"
+               "  TRAVprofileCall (__trav, __node, __info)\n"
+               "#else\n"
+               "#  define TRAV_DIRTY_CALL(__trav, __node, __info) \\\n"
+               "  TRAVTABLE_ENTRY (__trav, NODE_TYPE (__node)) (__node, __info)\n"
+               "#endif\n"
+               "\n"
+               "/* Call the handler of TRAV for the type of ARG_NODE.  */\n"
+               "static node *\n"
+               "TRAVdirtyCall (trav_t trav, node *arg_node, info *arg_info)\n"
+               "{\n"
+               "  node *entered = arg_node;\n"
+               "\n"
+               "  /* The traversal of the tree check is not tracked.  */\n"
+               "  if (nbdirty_paused)\n"
+               "    return TRAV_DIRTY_CALL (trav, arg_node, arg_info);\n"
+               "\n"
+               "  NBdirtyPush (entered);\n"
+               "  arg_node = TRAV_DIRTY_CALL (trav, arg_node, arg_info);\n"
+               "  NBdirtyPop (entered, arg_node);\n"
+               "\n"
+               "  return arg_node;\n"
+               "}\n"
+               "\n"
+               "#endif // AST_DIRTY_TRACKING\n"
+               "\n");
+}
+
+
+
+/* Generate the wrappers returned by TRAVTABLE_FUN with TRAV_PROFILE or
+   AST_DIRTY_TRACKING.  A function pointer cannot carry the traversal it
+   was selected for, and a variable set by the selection would be shared
+   by every caller, so there is one wrapper for every traversal that
+   passes its traversal on to the trampolines.  The node type is not
+   needed, as TRAVdo selects the handler by the type of the node it calls
+   it with.  */
+static void
+gen_trav_wrappers (struct emitter *  f, const struct model *  m)
+{
+  emit_str (f, "#if defined (TRAV_PROFILE) || defined (AST_DIRTY_TRACKING)\n"
+               "\n"
+               "#if defined (AST_DIRTY_TRACKING)\n"
+               "#  define TRAV_WRAP_CALL TRAVdirtyCall\n"
+               "#else\n"
+               "#  define TRAV_WRAP_CALL TRAVprofileCall\n"
+               "#endif\n"
+               "\n"
+               "#define TRAV_WRAP(__trav) \\\n"
+               "  static node * \\\n"
+               "  TRAVwrap_##__trav (node *arg_node, info *arg_info) \\\n"
+               "  { \\\n"
+               "    return TRAV_WRAP_CALL (__trav, arg_node, arg_info); \\\n"
+               "  }\n"
+               "\n"
+               "TRAV_WRAP (TR_undefined)\n");
+  for (size_t i = 0; i < m->n_traversals; i++)
+    emit_fmt (f, "TRAV_WRAP (TR_%s)\n", m->traversals[i].name->lower);
+
+  emit_str (f, "TRAV_WRAP (TR_anonymous)\n"
+               "\n"
+               "static const travfun_p travwrappers[] =\n"
+               "{\n"
+               "  &TRAVwrap_TR_undefined,\n");
+  for (size_t i = 0; i < m->n_traversals; i++)
+    emit_fmt (f, "  &TRAVwrap_TR_%s,\n", m->traversals[i].name->lower);
+
+  emit_str (f, "  &TRAVwrap_TR_anonymous\n"
+               "};\n"
+               "\n"
+               "travfun_p\n"
+               "TRAVwrapSelect (trav_t trav, nodetype type)\n"
+               "{\n"
+               "  return TRAVTABLE_ENTRY (trav, type) != NULL ? travwrappers[trav] : NULL;\n"
+               "}\n"
+               "\n"
+               "#endif // TRAV_PROFILE || AST_DIRTY_TRACKING\n"
+               "\n");
+}
+
+
+
+/* Main function to generate includes, traversal table, pretable, posttable and
+   the table of traversal names.  */
+bool
+gen_traverse_tables_c (const struct model *  m, const char *  fname)
+{
+  struct emitter *  f;
+  GEN_OPEN_FILE (f, fname);
+  GEN_HEADER (f, "   This file defines the function tables for traversal");
+
+  emit_str (f, "#include \"traverse_tables.h\"\n"
+               "#include \"traverse_helper.h\"\n\n");
+
+  /* First we generate the list of includes.  */
+  for (size_t i = 0; i < m->n_traversals; i++)
+    emit_fmt (f, "#include \"%s\"\n", m->traversals[i].include);
+
+  if (compact_travtables)
+    gen_compact_travtables (f, m);
+  else
+    gen_dense_travtables (f, m);
+
+  gen_travskip (f, m);
 
   /* Generate pretable.  */
-  gen_prepost_table (f, traversals, pp_pre_table);
+  gen_prepost_table (f, m, pp_pre_table);
 
   /* Generate posttable.  */
-  gen_prepost_table (f, traversals, pp_post_table);
+  gen_prepost_table (f, m, pp_post_table);
 
   /* Generate traversal names.  */
-  fprintf (f, "const char *travnames[] =\n"
-              "{\n"
-              "  \"undefined\",\n");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (traversals); i++)
-    {
-      char *  trav_lower = string_tolower (YAJL_OBJECT_KEYS (traversals)[i]);
-      fprintf (f, "  \"%s\",\n", trav_lower);
-      free (trav_lower);
-    }
-
-  fprintf (f, "  \"anonymous\"\n"
-              "};\n\n");
+  emit_str (f, "const char *travnames[] =\n"
+               "{\n"
+               "  \"undefined\",\n");
+  for (size_t i = 0; i < m->n_traversals; i++)
+    emit_fmt (f, "  \"%s\",\n", m->traversals[i].name->lower);
+
+  emit_str (f, "  \"anonymous\"\n"
+               "};\n\n");
+
+  gen_trav_profile (f, m);
+  gen_trav_dirty (f);
+  gen_trav_wrappers (f, m);
 
   GEN_FLUSH_AND_CLOSE (f);
 
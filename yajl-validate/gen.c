@@ -6,6 +6,7 @@
 
 #include "ast-builder.h"
 #include "gen.h"
+#include "layout.h"
 
 
 /* Build a enum of all the traversals.  The first item in the enum
@@ -13,28 +14,24 @@
    format TR_<traversal-name> in the lower case and the last item is
    TR_anonymous.  */
 bool
-gen_types_trav_h (yajl_val traversals, const char *  fname)
+gen_types_trav_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__TYPES_TRAV_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   This file defines the trav_t phase enumeration");
 
-  fprintf (f, "typedef enum\n"
-              "{\n"
-              "  TR_undefined = 0,\n");
+  emit_str (f, "typedef enum\n"
+               "{\n"
+               "  TR_undefined = 0,\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (traversals); i++)
-    {
-      char *  name = string_tolower (YAJL_OBJECT_KEYS (traversals)[i]);
-      fprintf (f, "  TR_%s,\n", name);
-      free (name);
-    }
+  for (size_t i = 0; i < m->n_traversals; i++)
+    emit_fmt (f, "  TR_%s,\n", m->traversals[i].name->lower);
 
-  fprintf (f, "  TR_anonymous\n"
-              "} trav_t;\n"
-              "\n");
+  emit_str (f, "  TR_anonymous\n"
+               "} trav_t;\n"
+               "\n");
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -48,31 +45,27 @@ gen_types_trav_h (yajl_val traversals, const char *  fname)
 
    Also define the MAX_NODES macro.  */
 bool
-gen_types_nodetype_h (yajl_val nodes, const char *  fname)
+gen_types_nodetype_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__TYPES_NODETYPE_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   This file defines the nodetype node enumeration");
 
-  fprintf (f, "typedef enum\n"
-              "{\n"
-              "  N_undefined = 0,\n");
+  emit_str (f, "typedef enum\n"
+               "{\n"
+               "  N_undefined = 0,\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      char *  name = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      fprintf (f, "  N_%s,\n", name);
-      free (name);
-    }
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "  N_%s,\n", m->nodes[i].name->lower);
 
-  fprintf (f, "} nodetype;\n\n");
+  emit_str (f, "} nodetype;\n\n");
 
   /* FIXME this is insane that MAX_NODES is pointing to the last index in
            in the tree not to the (last + 1).  Add N__max_nodes and remove
            MAX_NODES usage.  */
-  fprintf (f, "#define MAX_NODES %zu\n\n", YAJL_OBJECT_LENGTH (nodes));
+  emit_fmt (f, "#define MAX_NODES %zu\n\n", m->n_nodes);
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -86,66 +79,75 @@ gen_types_nodetype_h (yajl_val nodes, const char *  fname)
    A strcuture for a son is called `struct SONS_N_<node-name>' in
    uppercase.  The union is called `union SONUNION'.  */
 bool
-gen_sons_h (yajl_val nodes, const char *  fname)
+gen_sons_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__SONS_H__";
 
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Defines the NodesUnion and node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
+  emit_str (f, "#include \"types.h\"\n\n");
 
   /* Generate individual structures.  */
-  fprintf (f, "/* For each node a structure of its sons is defined,\n"
-              "   named SONS_N_<nodename>.  */\n\n");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "/* For each node a structure of its sons is defined,\n"
+               "   named SONS_N_<nodename>.  */\n\n");
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
 
-      if (!sons || YAJL_OBJECT_LENGTH (sons) == 0)
-        fprintf (f, "/* %s has no sons.  */\n\n", node_name);
+      if (node->n_sons == 0)
+        emit_fmt (f, "/* %s has no sons.  */\n\n", node->name->name);
       else
         {
-          fprintf (f, "struct SONS_N_%s\n"
-                      "{\n",
-                   node_name_upper);
+          emit_fmt (f, "struct SONS_N_%s\n"
+                       "{\n",
+                    node->name->upper);
 
-          for (size_t j = 0; sons && j < YAJL_OBJECT_LENGTH (sons); j++)
-            fprintf (f, "  node *  %s;\n", YAJL_OBJECT_KEYS (sons)[j]);
+          for (size_t j = 0; j < node->n_sons; j++)
+            emit_fmt (f, "  node *  %s;\n", node->sons[j].name->name);
 
-          fprintf (f, "};\n\n");
+          emit_str (f, "};\n\n");
         }
-      free (node_name_upper);
     }
 
   /* Generate SONUNION.  */
-  fprintf (f, "/* This union handles all different types of sons.\n"
-              "   Its members are called N_<nodename>.  */\n\n"
-              "union SONUNION\n"
-              "{\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "/* This union handles all different types of sons.\n"
+               "   Its members are called N_<nodename>.  */\n\n"
+               "union SONUNION\n"
+               "{\n"
+               "#ifdef FIXED_NODE_LAYOUT\n"
+               "  /* The sons are found at a fixed offset from the node; the\n"
+               "     member only keeps the union from being empty.  */\n"
+               "  char fixed;\n"
+               "#else\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      if (!sons || YAJL_OBJECT_LENGTH (sons) == 0)
-        fprintf (f, "  /* %s has no sons.  */\n", node_name);
-      else
-        fprintf (f, "  struct SONS_N_%s *  N_%s;\n", node_name_upper, node_name_lower);
+      const struct model_node *  node = &m->nodes[i];
 
-      free (node_name_lower);
-      free (node_name_upper);
+      if (node->n_sons == 0)
+        emit_fmt (f, "  /* %s has no sons.  */\n", node->name->name);
+      else
+        emit_fmt (f, "  struct SONS_N_%s *  N_%s;\n", node->name->upper, node->name->lower);
     }
-  fprintf (f, "};\n\n");
+  emit_str (f, "#endif\n"
+               "};\n\n");
+
+  /* The tables are defined in traverse_helper.c.  */
+  emit_fmt (f, "/* Metadata of the sons of every node type, indexed by the node\n"
+               "   type: the number of sons, the byte offset of every son within\n"
+               "   the node and the name of every son.  */\n"
+               "extern const unsigned char sonscount[%zu];\n"
+               "extern const unsigned short *const sonsoffsets[%zu];\n"
+               "extern const char *const *const sonsnames[%zu];\n"
+               "\n"
+               "/* The address of the son number __I of the node __N.  */\n"
+               "#define SONS_ADDR(__n, __i) \\\n"
+               "  ((node **) ((char *) (__n) + sonsoffsets[NODE_TYPE (__n)][__i]))\n"
+               "\n",
+            m->n_nodes + 1, m->n_nodes + 1, m->n_nodes + 1);
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -159,29 +161,25 @@ gen_sons_h (yajl_val nodes, const char *  fname)
 
    This is used to define an array of node names.  */
 bool
-gen_node_info_mac (yajl_val nodes, const char *  fname)
+gen_node_info_mac (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   This file defines the node to nodename mapping");
 
-  fprintf (f, "#ifndef NIFname\n"
-              "#define NIFname(it_name)\n"
-              "#endif\n"
-              "\n"
-              "#define NIF(it_name) NIFname (it_name)\n\n");
+  emit_str (f, "#ifndef NIFname\n"
+               "#define NIFname(it_name)\n"
+               "#endif\n"
+               "\n"
+               "#define NIF(it_name) NIFname (it_name)\n\n");
 
-  fprintf (f, "NIF (\"undefined\"),\n");
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      fprintf (f, "NIF (\"N_%s\")%s", node_name_lower,
-               i == YAJL_OBJECT_LENGTH (nodes) -1 ? "\n\n" : ",\n");
-      free (node_name_lower);
-    }
+  emit_str (f, "NIF (\"undefined\"),\n");
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "NIF (\"N_%s\")%s", m->nodes[i].name->lower,
+              i == m->n_nodes -1 ? "\n\n" : ",\n");
 
-  fprintf (f, "#undef NIFname\n"
-              "#undef NIF\n\n");
+  emit_str (f, "#undef NIFname\n"
+               "#undef NIF\n\n");
 
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -191,24 +189,26 @@ gen_node_info_mac (yajl_val nodes, const char *  fname)
 /* Generate function prototypes for FREE functions.  Every node gets
    its prototype in the following format: FREE<node-name> in lower case.  */
 bool
-gen_free_node_h (yajl_val nodes, const char *  fname)
+gen_free_node_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__FREE_NODE_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to free node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
+  emit_str (f, "#include \"types.h\"\n\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      fprintf (f, "node *  FREE%s (node *  arg_node, info *  arg_info);\n", node_name_lower);
-      free (node_name_lower);
-    }
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  FREE%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n"
+               "#ifdef NODE_ARENAS\n"
+               "struct NODE_ARENA;\n"
+               "void FREEarenaNode (node *  arg_node, struct NODE_ARENA *  arena, bool own);\n"
+               "#endif\n"
+               "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -221,96 +221,115 @@ gen_free_node_h (yajl_val nodes, const char *  fname)
    Flags are stored in the anonymous structure called `flags' which is a
    part of the ATTRIB_N_<node> structure.  */
 bool
-gen_attribs_h (yajl_val nodes, const char *  fname)
+gen_attribs_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__ATTRIBS_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Defines the AttribUnion and attrib structures");
 
-  fprintf (f, "#include \"types.h\"\n\n"
-              "/* For each node a structure of its attributes is defined,\n"
-              "   named  ATTRIBS_<nodename>.  */\n\n");
+  emit_str (f, "#include \"types.h\"\n\n"
+               "/* For each node a structure of its attributes is defined,\n"
+               "   named  ATTRIBS_<nodename>.  */\n\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attributes = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
 
-      if ((!flags || YAJL_OBJECT_LENGTH (flags) == 0)
-          && (!attributes || YAJL_OBJECT_LENGTH (attributes) == 0))
+      if (node->n_flags == 0 && node->n_attributes == 0)
         {
-          fprintf (f, "/* Node %s does not have atributes or flags.  */\n\n",
-                   YAJL_OBJECT_KEYS (nodes)[i]);
+          emit_fmt (f, "/* Node %s does not have atributes or flags.  */\n\n",
+                    node->name->name);
           continue;
         }
 
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      fprintf (f, "struct ATTRIBS_N_%s\n"
-                  "{\n",
-               node_name_upper);
+      /* Unless the node opts out, the fields are ordered by decreasing
+         alignment to avoid padding between them.  */
+      struct layout l;
 
-      /* Generate atrtibute fields.  */
-      for (size_t i = 0; attributes && i < YAJL_OBJECT_LENGTH (attributes); i++)
+      /* Cold attributes live in a separate block that is allocated on
+         the first access.  */
+      if (node->n_cold_attributes != 0)
         {
-          const char *  attr_name = YAJL_OBJECT_KEYS (attributes)[i];
-          const yajl_val attr = YAJL_OBJECT_VALUES (attributes)[i];
-          const yajl_val type = yajl_tree_get (attr, (const char *[]){"type", 0}, yajl_t_string);
-          const char *  type_name = YAJL_GET_STRING (type);
-
-          struct attrtype_name *  atn;
+          layout_node (node, node->reorder, lp_cold, &l);
+          emit_fmt (f, "struct ATTRIBS_COLD_N_%s\n"
+                       "{\n",
+                    node->name->upper);
 
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
+          for (size_t i = 0; i < l.n_fields; i++)
+            emit_fmt (f, "  %s %s;\n", l.fields[i].attribute->type->ctype,
+                      l.fields[i].attribute->name->name);
 
-          fprintf (f, "  %s %s;\n", atn->ctype, attr_name);
+          layout_free (&l);
+          emit_str (f, "};\n\n");
         }
 
-      /* Generate attribute flags if present.  */
-      if (flags && YAJL_OBJECT_LENGTH (flags) != 0)
-        fprintf (f, "  struct\n"
-                    "  {\n");
+      emit_fmt (f, "struct ATTRIBS_N_%s\n"
+                   "{\n",
+                node->name->upper);
 
-      for (size_t i = 0; flags && i < YAJL_OBJECT_LENGTH (flags); i++)
-        fprintf (f, "    unsigned int %s:1;\n", YAJL_OBJECT_KEYS (flags)[i]);
+      layout_node (node, node->reorder, lp_node, &l);
 
-      if (flags && YAJL_OBJECT_LENGTH (flags) != 0)
-        fprintf (f, "  } flags;\n");
+      for (size_t i = 0; i < l.n_fields; i++)
+        {
+          const struct model_attribute *  attrib = l.fields[i].attribute;
 
-      fprintf (f, "};\n\n");
+          /* Generate an atrtibute field.  */
+          if (l.fields[i].kind == lf_attribute)
+            {
+              emit_fmt (f, "  %s %s;\n", attrib->type->ctype, attrib->name->name);
+              continue;
+            }
 
-      free (node_name_upper);
+          if (l.fields[i].kind == lf_cold)
+            {
+              emit_fmt (f, "  struct ATTRIBS_COLD_N_%s *  " LAYOUT_COLD_MEMBER ";\n",
+                        node->name->upper);
+              continue;
+            }
+
+          /* Generate attribute flags.  */
+          emit_str (f, "  struct\n"
+                       "  {\n");
+
+          for (size_t i = 0; i < node->n_flags; i++)
+            emit_fmt (f, "    unsigned int %s:1;\n", node->flags[i].name->name);
+
+          emit_str (f, "  } flags;\n");
+        }
+
+      layout_free (&l);
+      emit_str (f, "};\n\n");
     }
 
   /* Generate the union of attributes.  */
-  fprintf (f, "/* This union handles all different types of attributes.\n"
-              "   Its members are called N_<nodename>.  */\n\n"
-              "union ATTRIBUNION\n"
-              "{\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "/* This union handles all different types of attributes.\n"
+               "   Its members are called N_<nodename>.  */\n\n"
+               "union ATTRIBUNION\n"
+               "{\n"
+               "#ifdef FIXED_NODE_LAYOUT\n"
+               "  /* The attributes are found at a fixed offset from the node; the\n"
+               "     member only keeps the union from being empty.  */\n"
+               "  char fixed;\n"
+               "#else\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attributes = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
 
-      if ((!flags || YAJL_OBJECT_LENGTH (flags) == 0)
-          && (!attributes || YAJL_OBJECT_LENGTH (attributes) == 0))
+      if (node->n_flags == 0 && node->n_attributes == 0)
         {
-          fprintf (f, "  /* Node %s does not have atributes or flags.  */\n",
-                   YAJL_OBJECT_KEYS (nodes)[i]);
+          emit_fmt (f, "  /* Node %s does not have atributes or flags.  */\n",
+                    node->name->name);
           continue;
         }
 
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      fprintf (f, "  struct ATTRIBS_N_%s *  N_%s;\n", node_name_upper, node_name_lower);
-      free (node_name_upper);
-      free (node_name_lower);
+      emit_fmt (f, "  struct ATTRIBS_N_%s *  N_%s;\n",
+                node->name->upper, node->name->lower);
     }
-  fprintf (f, "};\n\n");
+  emit_str (f, "#endif\n"
+               "};\n\n");
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -320,46 +339,253 @@ gen_attribs_h (yajl_val nodes, const char *  fname)
 
 /* Generate NODE_ALLOC_<node-name> in uppercase structures that contain a common
    node structure and the corresponding sons or attribute structure in case the
-   node has them.  */
+   node has them.  With AST_DIRTY_TRACKING the byte read by NODE_DIRTY follows
+   the node structure.  */
+void
+gen_node_alloc_structs (struct emitter *  f, const struct model *  m)
+{
+  emit_str (f, "/* For each node a structure NODE_ALLOC_N_<nodename> containing all\n"
+               "   three sub-structures is defined to ensure proper alignment.   */\n\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+
+      emit_fmt (f, "struct NODE_ALLOC_N_%s\n"
+                   "{\n"
+                   "  node nodestructure;\n"
+                   "#ifdef AST_DIRTY_TRACKING\n"
+                   "  unsigned char dirty;\n"
+                   "#endif\n",
+                node->name->upper);
+
+      if (node->n_sons != 0)
+        emit_fmt (f, "  struct SONS_N_%s sonstructure;\n", node->name->upper);
+
+      if (node->n_flags != 0 || node->n_attributes != 0)
+        emit_fmt (f, "  struct ATTRIBS_N_%s attributestructure;\n", node->name->upper);
+
+      emit_str (f, "};\n\n");
+    }
+}
+
+
+void
+gen_nodetype_bitset (struct emitter *  f, const unsigned char *  bits,
+                     size_t n_bytes)
+{
+  emit_str (f, "  {");
+  for (size_t i = 0; i < n_bytes; i++)
+    {
+      emit_str (f, i ? ", " : " ");
+      emit_str (f, "0x");
+      emit_char (f, "0123456789abcdef"[bits[i] >> 4]);
+      emit_char (f, "0123456789abcdef"[bits[i] & 15]);
+    }
+  emit_str (f, " },\n");
+}
+
+
 bool
-gen_node_alloc_h (yajl_val nodes, const char *  fname)
+gen_node_alloc_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__NODE_ALLOC_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Defines the a structure that allows alligned allocation of entire\n"
                 "   node structures");
 
-  fprintf (f, "#include \"types.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "\n"
-              "/* For each node a structure NODE_ALLOC_N_<nodename> containing all\n"
-              "   three sub-structures is defined to ensure proper alignment.   */\n\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
-    {
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attributes = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
-
-      fprintf (f, "struct NODE_ALLOC_N_%s\n"
-                  "{\n"
-                  "  node nodestructure;\n",
-               node_name_upper);
-
-      if (sons && YAJL_OBJECT_LENGTH (sons) != 0)
-        fprintf (f, "  struct SONS_N_%s sonstructure;\n", node_name_upper);
-
-      if ((flags && YAJL_OBJECT_LENGTH (flags) != 0)
-          || (attributes && YAJL_OBJECT_LENGTH (attributes) != 0))
-        fprintf (f, "  struct ATTRIBS_N_%s attributestructure;\n", node_name_upper);
-
-      fprintf (f, "};\n\n");
-      free (node_name_upper);
-    }
+  emit_str (f, "#include \"types.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"memory.h\"\n"
+               "\n"
+               "/* With FIXED_NODE_LAYOUT the structures come from node_basic.h.  */\n"
+               "#ifndef FIXED_NODE_LAYOUT\n\n");
+
+  gen_node_alloc_structs (f, m);
+
+  emit_str (f, "#endif // FIXED_NODE_LAYOUT\n\n");
+
+  /* With NODE_POOLS the nodes are taken from slabs of nodes of the same
+     type.  A freed node is put on the free list of its type in the
+     current thread, so the next node of that type reuses it without going
+     through MEMmalloc.  The slabs themselves are never released.  */
+  emit_str (f, "#ifdef NODE_POOLS\n"
+               "\n"
+               "/* The number of nodes allocated at once when a free list is empty.  */\n"
+               "#  ifndef NODE_POOL_SLAB\n"
+               "#    define NODE_POOL_SLAB 256\n"
+               "#  elif NODE_POOL_SLAB < 2\n"
+               "#    error \"NODE_POOL_SLAB must be at least 2\"\n"
+               "#  endif\n"
+               "\n"
+               "#  ifndef NODE_POOL_TLS\n"
+               "#    define NODE_POOL_TLS __thread\n"
+               "#  endif\n"
+               "\n"
+               "/* The heads of the free lists of the current thread indexed by the node\n"
+               "   type.  A free node holds the next free node in its first word.  */\n"
+               "extern NODE_POOL_TLS void *nodepool_free[MAX_NODES + 1];\n"
+               "\n"
+               "/* Allocate a new slab for nodes of TYPE, put all but the first node\n"
+               "   on the free list and return the first one.  */\n"
+               "extern void *NODEPOOLrefill (nodetype type, char *file, size_t line);\n"
+               "\n"
+               "static inline void *\n"
+               "NODEPOOLalloc (nodetype type, char *file, size_t line)\n"
+               "{\n"
+               "  void **p = (void **) nodepool_free[type];\n"
+               "\n"
+               "  if (p == NULL)\n"
+               "    return NODEPOOLrefill (type, file, line);\n"
+               "\n"
+               "  nodepool_free[type] = *p;\n"
+               "  return p;\n"
+               "}\n"
+               "\n"
+               "static inline node *\n"
+               "NODEPOOLfree (node *arg_node)\n"
+               "{\n"
+               "  nodetype type = NODE_TYPE (arg_node);\n"
+               "\n"
+               "  *(void **) arg_node = nodepool_free[type];\n"
+               "  nodepool_free[type] = arg_node;\n"
+               "  return NULL;\n"
+               "}\n"
+               "\n"
+               "#  define NODE_HEAP_ALLOC_AT(__type, __size, __file, __line) \\\n"
+               "     NODEPOOLalloc (__type, __file, __line)\n"
+               "#  define NODE_HEAP_FREE(__node) NODEPOOLfree (__node)\n"
+               "#else\n"
+               "#  define NODE_HEAP_ALLOC_AT(__type, __size, __file, __line) \\\n"
+               "     MEMmallocAt (__size, __file, __line)\n"
+               "#  define NODE_HEAP_FREE(__node) MEMfree (__node)\n"
+               "#endif\n\n");
+
+  /* With NODE_ARENAS the nodes made while an arena is selected are carved
+     from the chunks of that arena.  Chunks are aligned to their size, so
+     the owner of a node is found from its address, and the FREE traversal
+     leaves such nodes to NODEARENArelease.  */
+  emit_str (f, "#ifdef NODE_ARENAS\n"
+               "\n"
+               "#  include <stdint.h>\n"
+               "#  include <stdlib.h>\n"
+               "\n"
+               "/* The size and the alignment of the chunks of an arena, a power of two.  */\n"
+               "#  ifndef NODE_ARENA_CHUNK\n"
+               "#    define NODE_ARENA_CHUNK 65536\n"
+               "#  endif\n"
+               "\n"
+               "#  define NODE_ARENA_ALIGN 16\n"
+               "#  define NODE_ARENA_ROUND(__size)                                    \\\n"
+               "     (((__size) + NODE_ARENA_ALIGN - 1) & ~(size_t) (NODE_ARENA_ALIGN - 1))\n"
+               "\n"
+               "typedef struct NODE_ARENA\n"
+               "{\n"
+               "  char *ptr;\n"
+               "  char *end;\n"
+               "  void *chunks;\n"
+               "#  ifndef DBUG_OFF\n"
+               "  /* The fundefs made while the arena was selected that are not\n"
+               "     zombies yet.  */\n"
+               "  struct NODE_ARENA_LINK *fundefs;\n"
+               "#  endif\n"
+               "} nodearena;\n"
+               "\n"
+               "/* The arena new nodes are allocated from, or NULL.  */\n"
+               "extern nodearena *nodearena_current;\n"
+               "\n"
+               "/* The number of chunks of all live arenas.  */\n"
+               "extern size_t nodearena_n_chunks;\n"
+               "\n"
+               "extern nodearena *NODEARENAcreate (void);\n"
+               "\n"
+               "/* Make ARENA the current arena and return the previous one.  */\n"
+               "extern nodearena *NODEARENAselect (nodearena *arena);\n"
+               "\n"
+               "/* Release all the nodes of ARENA at once, and ARENA itself.  The FREE\n"
+               "   traversal need not run over them first: the trees that hang off\n"
+               "   them but live outside of ARENA are freed with FREE, and the\n"
+               "   attribute payloads of the nodes FREE has not freed are freed with\n"
+               "   their FREEattrib functions.  Nothing outside of these trees may\n"
+               "   point into ARENA any more.  */\n"
+               "extern nodearena *NODEARENArelease (nodearena *arena);\n"
+               "\n"
+               "extern void *NODEARENArefill (nodearena *arena, size_t size,\n"
+               "                              char *file, size_t line);\n"
+               "\n"
+               "/* The arena P was allocated from, or NULL.  */\n"
+               "extern nodearena *NODEARENAlookup (void *p);\n"
+               "\n"
+               "static inline void *\n"
+               "NODEARENAalloc (nodearena *arena, size_t size, char *file, size_t line)\n"
+               "{\n"
+               "  char *p = arena->ptr;\n"
+               "\n"
+               "  size = NODE_ARENA_ROUND (size);\n"
+               "  if ((size_t) (arena->end - p) < size)\n"
+               "    return NODEARENArefill (arena, size, file, line);\n"
+               "\n"
+               "  arena->ptr = p + size;\n"
+               "  return p;\n"
+               "}\n"
+               "\n"
+               "static inline bool\n"
+               "NODEARENAowns (node *arg_node)\n"
+               "{\n"
+               "  return nodearena_n_chunks != 0 && NODEARENAlookup (arg_node) != NULL;\n"
+               "}\n"
+               "\n"
+               "/* A node of an arena that FREE has freed stays in its chunk until the\n"
+               "   arena is released.  Its type is moved past MAX_NODES, so the\n"
+               "   release skips it but still finds its size.  */\n"
+               "static inline node *\n"
+               "NODEARENAforget (node *arg_node)\n"
+               "{\n"
+               "  NODE_TYPE (arg_node) = (nodetype) (NODE_TYPE (arg_node) + MAX_NODES + 1);\n"
+               "  return NULL;\n"
+               "}\n"
+               "\n"
+               "#  define NODE_ALLOC_AT(__type, __size, __file, __line)                \\\n"
+               "     (nodearena_current != NULL                                      \\\n"
+               "      ? NODEARENAalloc (nodearena_current, __size, __file, __line)   \\\n"
+               "      : NODE_HEAP_ALLOC_AT (__type, __size, __file, __line))\n"
+               "#  define NODE_FREE(__node) \\\n"
+               "     (NODEARENAowns (__node) ? NODEARENAforget (__node) : NODE_HEAP_FREE (__node))\n"
+               "\n"
+               "#  ifndef DBUG_OFF\n"
+               "/* Fundefs stay on the heap, while their bodies come from the arena\n"
+               "   selected when they are made.  In debug builds such a fundef is\n"
+               "   linked to the arena behind its node until it becomes a zombie, so\n"
+               "   releasing the arena under a live fundef is caught.  */\n"
+               "struct NODE_ARENA_LINK\n"
+               "{\n"
+               "  nodearena *arena;\n"
+               "  struct NODE_ARENA_LINK *prev;\n"
+               "  struct NODE_ARENA_LINK *next;\n"
+               "};\n"
+               "\n"
+               "extern void *NODEARENAadopt (void *fundef, size_t size);\n"
+               "extern void NODEARENAdisown (node *fundef, size_t size);\n"
+               "\n"
+               "#    define NODE_FUNDEF_ALLOC_AT(__size, __file, __line)              \\\n"
+               "       NODEARENAadopt (MEMmallocAt ((__size) + sizeof (struct NODE_ARENA_LINK), \\\n"
+               "                                    __file, __line),                  \\\n"
+               "                       __size)\n"
+               "#  endif\n"
+               "#else\n"
+               "#  define NODE_ALLOC_AT NODE_HEAP_ALLOC_AT\n"
+               "#  define NODE_FREE NODE_HEAP_FREE\n"
+               "#endif\n"
+               "\n"
+               "/* Zombie fundefs are released with MEMfree by FREEremoveAllZombies,\n"
+               "   so they never come from a node pool or an arena.  */\n"
+               "#if !defined (NODE_ARENAS) || defined (DBUG_OFF)\n"
+               "#  define NODE_FUNDEF_ALLOC_AT(__size, __file, __line) \\\n"
+               "     MEMmallocAt (__size, __file, __line)\n"
+               "#  define NODEARENAdisown(__fundef, __size)\n"
+               "#endif\n\n");
 
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
@@ -371,29 +597,28 @@ gen_node_alloc_h (yajl_val nodes, const char *  fname)
    attributes of nodes.  Each attribute which copy tag is not `literal'
    gets a function called FREEattrib<attribute-type-name>.  */
 bool
-gen_free_attribs_h (const char *  fname)
+gen_free_attribs_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__FREE_ATTRIBS_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to free the attributes of node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
-
-  struct attrtype_name *  atn;
-  struct attrtype_name *  tmp;
+  emit_str (f, "#include \"types.h\"\n\n");
 
-  HASH_ITER (hh, attrtype_names, atn, tmp)
+  for (size_t i = 0; i < m->n_attrtypes; i++)
     {
+      const struct attrtype_name *  atn = m->attrtypes[i];
+
       if (atn->copy_type == act_literal)
         continue;
 
-      fprintf (f, "%s FREEattrib%s (%s attr, node *  parent);\n",
-               atn->ctype, atn->name, atn->ctype);
+      emit_fmt (f, "%s FREEattrib%s (%s attr, node *  parent);\n",
+                atn->ctype, atn->name, atn->ctype);
     }
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -401,28 +626,27 @@ gen_free_attribs_h (const char *  fname)
 
 
 bool
-gen_check_reset_h (const char *  fname)
+gen_check_reset_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__CHECK_RESET_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to CheckTest node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n"
-              "node *  CHKRSTdoTreeCheckReset (node *  syntax_tree);\n\n");
+  emit_str (f, "#include \"types.h\"\n\n"
+               "node *  CHKRSTdoTreeCheckReset (node *  syntax_tree);\n\n");
 
-  struct node_name *  nn;
-  struct node_name *  tmp;
+  /* The list includes the nodesets.  */
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  CHKRST%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-  HASH_ITER (hh, node_names, nn, tmp)
-    {
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  CHKRST%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
-    }
+  for (size_t i = 0; i < m->n_nodesets; i++)
+    emit_fmt (f, "node *  CHKRST%s (node *  arg_node, info *  arg_info);\n",
+              m->nodesets[i].name->lower);
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -430,31 +654,22 @@ gen_check_reset_h (const char *  fname)
 
 
 bool
-gen_check_node_h (const char *  fname)
+gen_check_node_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__CHECK_NODE_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to check node structures");
 
-  fprintf (f, "#include \"types.h\"\n"
-              "#include \"memory.h\"\n\n");
+  emit_str (f, "#include \"types.h\"\n"
+               "#include \"memory.h\"\n\n");
 
-  struct node_name *  nn;
-  struct node_name *  tmp;
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  CHKM%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-  HASH_ITER (hh, node_names, nn, tmp)
-    {
-      if (nn->name_type != nnt_node)
-        continue;
-
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  CHKM%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
-    }
-
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -462,34 +677,161 @@ gen_check_node_h (const char *  fname)
 
 
 bool
-gen_check_h (const char *  fname)
+gen_check_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__CHECK_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to check node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n"
-              "node *  CHKdoTreeCheck (node *  syntax_tree);\n\n");
+  emit_str (f, "#include \"types.h\"\n\n"
+               "node *  CHKdoTreeCheck (node *  syntax_tree);\n\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  CHK%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
+
+  emit_str (f, "\n\n");
+  GEN_FOOTER_H (f, protector);
+  GEN_FLUSH_AND_CLOSE (f);
+  return true;
+}
+
+
+/* Emit the attributes of NODE that FREEarenaNode frees in one of its
+   passes: the node attributes without OWN, the other ones with it.  */
+static void
+gen_free_arena_attributes (struct emitter *  f, const struct model_node *  node,
+                           bool own)
+{
+  const char *  node_name_upper = node->name->upper;
+  const char *  indent = "          ";
+
+  for (int cold = 0; cold < 2; cold++)
+    {
+      bool any = false;
+
+      for (size_t i = 0; i < node->n_attributes; i++)
+        {
+          const struct attrtype_name *  atn = node->attributes[i].type;
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
+
+          if (atn->copy_type == act_literal || node->attributes[i].cold != cold
+              || !strcmp (atn->name, "Node") == own)
+            continue;
+
+          if (cold && !any)
+            {
+              emit_fmt (f, "          if (%s_COLDATTRIBS (arg_node) != NULL)\n"
+                           "            {\n",
+                        node_name_upper);
+              indent = "              ";
+            }
+
+          any = true;
+          if (own)
+            emit_fmt (f, "%s%s_%s (arg_node) = FREEattrib%s (%s_%s (arg_node), arg_node);\n",
+                      indent, node_name_upper, attrib_name_upper, atn->name,
+                      node_name_upper, attrib_name_upper);
+          else
+            emit_fmt (f, "%s%s_%s (arg_node) = FREEARENATREE (%s_%s (arg_node));\n",
+                      indent, node_name_upper, attrib_name_upper,
+                      node_name_upper, attrib_name_upper);
+        }
+
+      /* The block of cold attributes goes with the payloads.  */
+      if (cold && own && node->n_cold_attributes != 0)
+        {
+          if (!any)
+            emit_fmt (f, "          if (%s_COLDATTRIBS (arg_node) != NULL)\n"
+                         "            {\n",
+                      node_name_upper);
+
+          emit_fmt (f, "              %s_COLDATTRIBS (arg_node) = MEMfree (%s_COLDATTRIBS (arg_node));\n",
+                    node_name_upper, node_name_upper);
+          any = true;
+        }
+
+      if (cold && any)
+        emit_str (f, "            }\n");
+    }
+}
 
-  struct node_name *  nn;
-  struct node_name *  tmp;
 
-  HASH_ITER (hh, node_names, nn, tmp)
+/* Generate FREEarenaNode, which NODEARENArelease calls for the nodes of
+   an arena that FREE has not freed.  Fundefs never live in an arena.  */
+static void
+gen_free_arena_node (struct emitter *  f, const struct model *  m)
+{
+  emit_str (f, "#ifdef NODE_ARENAS\n"
+               "\n"
+               "/* Free the tree T unless it comes from ARENA, whose release finds\n"
+               "   its nodes anyway.  */\n"
+               "#define FREEARENATREE(t)                                       \\\n"
+               "   ((t) != NULL && NODEARENAlookup (t) != arena                \\\n"
+               "    ? FREEdoFreeTree (t)                                       \\\n"
+               "    : (t))\n"
+               "\n"
+               "/* Without OWN free the sons and the node attributes of ARG_NODE\n"
+               "   that do not come from ARENA.  With OWN free the other attributes\n"
+               "   of ARG_NODE.  */\n"
+               "void\n"
+               "FREEarenaNode (node *  arg_node, nodearena *  arena, bool own)\n"
+               "{\n"
+               "  DBUG_ENTER ();\n"
+               "\n"
+               "  switch (NODE_TYPE (arg_node))\n"
+               "    {\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      if (nn->name_type == nnt_nodeset)
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_upper = node->name->upper;
+
+      if (!strcmp (node->name->name, "Fundef"))
         continue;
 
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  CHK%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
+      emit_fmt (f, "    case N_%s:\n"
+                   "      if (!own)\n"
+                   "        {\n"
+                   "          NODE_ERROR (arg_node) = FREEARENATREE (NODE_ERROR (arg_node));\n",
+                node->name->lower);
+
+      for (size_t j = 0; j < node->n_sons; j++)
+        emit_fmt (f, "          %s_%s (arg_node) = FREEARENATREE (%s_%s (arg_node));\n",
+                  node_name_upper, node->sons[j].name->upper,
+                  node_name_upper, node->sons[j].name->upper);
+
+      gen_free_arena_attributes (f, node, false);
+      emit_str (f, "        }\n");
+
+      bool payload = node->n_cold_attributes != 0;
+      for (size_t j = 0; j < node->n_attributes; j++)
+        if (node->attributes[j].type->copy_type != act_literal
+            && strcmp (node->attributes[j].type->name, "Node"))
+          payload = true;
+
+      if (payload)
+        {
+          emit_str (f, "      else\n"
+                       "        {\n");
+          gen_free_arena_attributes (f, node, true);
+          emit_str (f, "        }\n");
+        }
+
+      emit_str (f, "      break;\n"
+                   "\n");
     }
 
-  fprintf (f, "\n\n");
-  GEN_FOOTER_H (f, protector);
-  GEN_FLUSH_AND_CLOSE (f);
-  return true;
+  emit_str (f, "    default:\n"
+               "      DBUG_UNREACHABLE (\"Invalid node type found\");\n"
+               "    }\n"
+               "\n"
+               "  DBUG_RETURN ();\n"
+               "}\n"
+               "\n"
+               "#endif // NODE_ARENAS\n");
 }
 
 
@@ -512,230 +854,230 @@ gen_check_h (const char *  fname)
    Furthermore, the node structure itself is not freed. This has to be
    done by a cal of FreeAllZombies.  */
 bool
-gen_free_node_c (yajl_val nodes, const char *  fname)
+gen_free_node_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions needed by free traversal");
 
-  fprintf (f, "#include \"free.h\"\n"
-              "#include \"free_node.h\"\n"
-              "#include \"free_attribs.h\"\n"
-              "#include \"free_info.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#include \"str.h\"\n"
-              "#include \"memory.h\"\n"
-              "#define DBUG_PREFIX \"FREE\"\n"
-              "#include \"debug.h\"\n"
-              "#include \"globals.h\"\n"
-              "\n"
-              "#define FREETRAV(node, info) (node != NULL ? TRAVdo (node, info) : node)\n"
-              "#define FREECOND(node, info)             \\\n"
-              "   (INFO_FREE_FLAG (info) != arg_node    \\\n"
-              "    ? FREETRAV (node, info)              \\\n"
-              "    : node)\n\n");
-
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "#include \"free.h\"\n"
+               "#include \"free_node.h\"\n"
+               "#include \"free_attribs.h\"\n"
+               "#include \"free_info.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#include \"str.h\"\n"
+               "#include \"memory.h\"\n"
+               "#include \"node_alloc.h\"\n"
+               "#define DBUG_PREFIX \"FREE\"\n"
+               "#include \"debug.h\"\n"
+               "#include \"globals.h\"\n"
+               "\n"
+               "#define FREETRAV(node, info) (node != NULL ? TRAVdo (node, info) : node)\n"
+               "#define FREECOND(node, info)             \\\n"
+               "   (INFO_FREE_FLAG (info) != arg_node    \\\n"
+               "    ? FREETRAV (node, info)              \\\n"
+               "    : node)\n\n");
+
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name = node->name->name;
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
 
-      fprintf (f, "node *\n"
-                  "FREE%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n",
-               node_name_lower);
+      emit_fmt (f, "node *\n"
+                   "FREE%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n",
+                node_name_lower);
 
-      fprintf (f, "  DBUG_ENTER ();\n\n");
+      emit_str (f, "  DBUG_ENTER ();\n\n");
 
       if (!strcmp (node_name, "Fundef"))
-        fprintf (f, "  DBUG_PRINT(\"transforming %%s at \" F_PTR \" into a zombie\", "
-                                 "FUNDEF_NAME (arg_node), arg_node);\n"
-                    "  arg_node = FREEzombify (arg_node);\n");
+        emit_fmt (f, "  DBUG_PRINT(\"transforming %%s at \" F_PTR \" into a zombie\", "
+                                  "FUNDEF_NAME (arg_node), arg_node);\n"
+                     "  arg_node = FREEzombify (arg_node);\n"
+                     "  NODEARENAdisown (arg_node, sizeof (struct NODE_ALLOC_N_FUNDEF));\n");
       else
-        fprintf (f, "  node *  result = NULL;\n"
-                    "\n"
-                    "  DBUG_PRINT (\"Processing node %%s at \" F_PTR, "
-                                  "NODE_TEXT (arg_node), arg_node);\n");
+        emit_fmt (f, "  node *  result = NULL;\n"
+                     "\n"
+                     "  DBUG_PRINT (\"Processing node %%s at \" F_PTR, "
+                                   "NODE_TEXT (arg_node), arg_node);\n");
 
-      fprintf (f, "  NODE_ERROR (arg_node) = FREETRAV (NODE_ERROR (arg_node), arg_info);\n");
+      emit_str (f, "  NODE_ERROR (arg_node) = FREETRAV (NODE_ERROR (arg_node), arg_info);\n");
 
       /* Check if we have a son called Next and free it first.
 
          FIXME is it necessary to free things in this order?  */
-      const yajl_val next = yajl_tree_get (sons, (const char *[]){"Next", 0}, yajl_t_object);
-      if (next)
-        fprintf (f, "  %s_NEXT (arg_node) = FREECOND (%s_NEXT (arg_node), arg_info);\n",
-                 node_name_upper, node_name_upper);
+      if (node->next)
+        emit_fmt (f, "  %s_NEXT (arg_node) = FREECOND (%s_NEXT (arg_node), arg_info);\n",
+                  node_name_upper, node_name_upper);
 
 
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-
-          struct attrtype_name *  atn;
-          char *  type_name = YAJL_GET_STRING (type);
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
+          const char *  attrib_name = node->attributes[i].name->name;
+          const struct attrtype_name *  atn = node->attributes[i].type;
 
-          if (atn->copy_type == act_literal)
+          if (atn->copy_type == act_literal || node->attributes[i].cold)
             continue;
 
           /* Skip exceptions in case of FREEfundef.  */
-          if (!strcmp (node_name, "Fundef")
-              && (!strcmp (attrib_name, "Name")
-                  || !strcmp (attrib_name, "Mod")
-                  || !strcmp (attrib_name, "LinkMod")
-                  || !strcmp (attrib_name, "Types")
-                  || !strcmp (attrib_name, "Type")
-                  || !strcmp (attrib_name, "Impl")))
+          if (zombie_attribute_p (node_name, attrib_name))
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  %s_%s (arg_node) = FREEattrib%s (%s_%s (arg_node), arg_node);\n",
-                   node_name_upper, attrib_name_upper, atn->name, node_name_upper, attrib_name_upper);
-
-          free (attrib_name_upper);
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
+          emit_fmt (f, "  %s_%s (arg_node) = FREEattrib%s (%s_%s (arg_node), arg_node);\n",
+                    node_name_upper, attrib_name_upper, atn->name, node_name_upper, attrib_name_upper);
         }
 
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      /* Cold attributes that were never accessed need not be freed.
+         Zombie fundefs keep no cold attributes, so their block goes as
+         well.  */
+      if (node->n_cold_attributes != 0)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
+          emit_fmt (f, "  if (%s_COLDATTRIBS (arg_node) != NULL)\n"
+                       "    {\n",
+                    node_name_upper);
+
+          for (size_t i = 0; i < node->n_attributes; i++)
+            {
+              const struct attrtype_name *  atn = node->attributes[i].type;
+              const char *  attrib_name_upper = node->attributes[i].name->upper;
+
+              if (atn->copy_type == act_literal || !node->attributes[i].cold)
+                continue;
+
+              emit_fmt (f, "      %s_%s (arg_node) = FREEattrib%s (%s_%s (arg_node), arg_node);\n",
+                        node_name_upper, attrib_name_upper, atn->name,
+                        node_name_upper, attrib_name_upper);
+            }
 
+          emit_fmt (f, "      %s_COLDATTRIBS (arg_node) = MEMfree (%s_COLDATTRIBS (arg_node));\n"
+                       "    }\n",
+                    node_name_upper, node_name_upper);
+        }
+
+      for (size_t i = 0; i < node->n_sons; i++)
+        {
           /* We did Next already before the attributes.  */
-          if (!strcmp (son_name, "Next"))
+          if (&node->sons[i] == node->next)
             continue;
 
-          char *  son_name_upper = string_toupper (son_name);
-          fprintf (f, "  %s_%s (arg_node) = FREETRAV (%s_%s (arg_node), arg_info);\n",
-                    node_name_upper, son_name_upper, node_name_upper, son_name_upper);
-
-          free (son_name_upper);
+          const char *  son_name_upper = node->sons[i].name->upper;
+          emit_fmt (f, "  %s_%s (arg_node) = FREETRAV (%s_%s (arg_node), arg_info);\n",
+                     node_name_upper, son_name_upper, node_name_upper, son_name_upper);
         }
 
       if (!strcmp (node_name, "Fundef"))
-        fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                    "}\n\n");
+        emit_str (f, "  DBUG_RETURN (arg_node);\n"
+                     "}\n\n");
       else
         {
-          if (next)
-            fprintf (f, "  result = %s_NEXT (arg_node);\n", node_name_upper);
-
-          fprintf (f, "  DBUG_PRINT (\"Freeing node %%s at \" F_PTR, NODE_TEXT (arg_node), arg_node);\n"
-                      "  arg_node = MEMfree (arg_node);\n"
-                      "\n"
-                      "  DBUG_RETURN (result);\n"
-                      "}\n\n");
+          if (node->next)
+            emit_fmt (f, "  result = %s_NEXT (arg_node);\n", node_name_upper);
+
+          emit_fmt (f, "  DBUG_PRINT (\"Freeing node %%s at \" F_PTR, NODE_TEXT (arg_node), arg_node);\n"
+                       "  arg_node = NODE_FREE (arg_node);\n"
+                       "\n"
+                       "  DBUG_RETURN (result);\n"
+                       "}\n\n");
         }
-
-      free (node_name_upper);
-      free (node_name_lower);
     }
 
+  gen_free_arena_node (f, m);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
 }
 
 
 bool
-gen_check_reset_c (yajl_val nodes, const char *  fname)
+gen_check_reset_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions needed by test check environment");
 
-  fprintf (f, "#include \"check_reset.h\"\n"
-              "#include \"globals.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"CHKRST\"\n"
-              "#include \"debug.h\"\n"
-              "\n"
-              "\n"
-              "node *\n"
-              "CHKRSTdoTreeCheckReset (node *  arg_node)\n"
-              "{\n"
-              "  node *keep_next = NULL;\n"
-              "\n"
-              "  DBUG_ENTER ();\n"
-              "  DBUG_ASSERT (NODE_TYPE( arg_node) == N_module\n"
-              "               || NODE_TYPE( arg_node) == N_fundef,\n"
-              "               \"Illegal argument node!\");\n"
-              "\n"
-              "  DBUG_ASSERT (NODE_TYPE( arg_node) == N_module\n"
-              "               || global.local_funs_grouped,\n"
-              "               \"If run fun-based, special funs must be grouped.\");\n"
-              "\n"
-              "  if (NODE_TYPE (arg_node) == N_fundef)\n"
-              "    {\n"
-              "      /* If this check is called function-based, we do not want to traverse\n"
-              "         into the next fundef, but restrict ourselves to this function and\n"
-              "         its subordinate special functions.  */\n"
-              "      keep_next = FUNDEF_NEXT (arg_node);\n"
-              "      FUNDEF_NEXT (arg_node) = NULL;\n"
-              "    }\n"
-              "\n"
-              "  DBUG_PRINT (\"Reset tree check mechanism\");\n"
-              "\n"
-              "  TRAVpush (TR_chkrst);\n"
-              "  arg_node = TRAVdo (arg_node, NULL);\n"
-              "  TRAVpop ();\n"
-              "\n"
-              "  DBUG_PRINT (\"Reset tree check mechanism completed\");\n"
-              "\n"
-              "  if (NODE_TYPE (arg_node) == N_fundef)\n"
-              "    /* If this check is called function-based, we must restore the original\n"
-              "       fundef chain here.  */\n"
-              "    FUNDEF_NEXT (arg_node) = keep_next;\n"
-              "\n"
-              "  DBUG_RETURN (arg_node);\n"
-              "}\n\n");
-
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "#include \"check_reset.h\"\n"
+               "#include \"globals.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"CHKRST\"\n"
+               "#include \"debug.h\"\n"
+               "\n"
+               "\n"
+               "node *\n"
+               "CHKRSTdoTreeCheckReset (node *  arg_node)\n"
+               "{\n"
+               "  node *keep_next = NULL;\n"
+               "\n"
+               "  DBUG_ENTER ();\n"
+               "  DBUG_ASSERT (NODE_TYPE( arg_node) == N_module\n"
+               "               || NODE_TYPE( arg_node) == N_fundef,\n"
+               "               \"Illegal argument node!\");\n"
+               "\n"
+               "  DBUG_ASSERT (NODE_TYPE( arg_node) == N_module\n"
+               "               || global.local_funs_grouped,\n"
+               "               \"If run fun-based, special funs must be grouped.\");\n"
+               "\n"
+               "  if (NODE_TYPE (arg_node) == N_fundef)\n"
+               "    {\n"
+               "      /* If this check is called function-based, we do not want to traverse\n"
+               "         into the next fundef, but restrict ourselves to this function and\n"
+               "         its subordinate special functions.  */\n"
+               "      keep_next = FUNDEF_NEXT (arg_node);\n"
+               "      FUNDEF_NEXT (arg_node) = NULL;\n"
+               "    }\n"
+               "\n"
+               "  DBUG_PRINT (\"Reset tree check mechanism\");\n"
+               "\n"
+               "  TRAVpush (TR_chkrst);\n"
+               "  arg_node = TRAVdo (arg_node, NULL);\n"
+               "  TRAVpop ();\n"
+               "\n"
+               "  DBUG_PRINT (\"Reset tree check mechanism completed\");\n"
+               "\n"
+               "  if (NODE_TYPE (arg_node) == N_fundef)\n"
+               "    /* If this check is called function-based, we must restore the original\n"
+               "       fundef chain here.  */\n"
+               "    FUNDEF_NEXT (arg_node) = keep_next;\n"
+               "\n"
+               "  DBUG_RETURN (arg_node);\n"
+               "}\n\n");
+
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      fprintf (f, "node *\n"
-                  "CHKRST%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n"
-                  "  NODE_CHECKVISITED (arg_node) = FALSE;\n\n",
-               node_name_lower);
-
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
+
+      emit_fmt (f, "node *\n"
+                   "CHKRST%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n"
+                   "  NODE_CHECKVISITED (arg_node) = FALSE;\n\n",
+                node_name_lower);
+
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-            const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-            char *  son_name_upper = string_toupper (son_name);
-
-            fprintf (f, "  if (%s_%s (arg_node) != NULL)\n"
-                        "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                     node_name_upper, son_name_upper,
-                     node_name_upper, son_name_upper,
-                     node_name_upper, son_name_upper);
+            const char *  son_name_upper = node->sons[i].name->upper;
 
-            free (son_name_upper);
+            emit_fmt (f, "  if (%s_%s (arg_node) != NULL)\n"
+                         "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
+                      node_name_upper, son_name_upper,
+                      node_name_upper, son_name_upper,
+                      node_name_upper, son_name_upper);
         }
 
 
-      fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-      free (node_name_upper);
-      free (node_name_lower);
+      emit_str (f, "  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
 
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FLUSH_AND_CLOSE (f);
   return true;
 }
@@ -747,91 +1089,73 @@ gen_check_reset_c (yajl_val nodes, const char *  fname)
    The return value is ARG_NODE.  */
 
 bool
-gen_check_node_c (yajl_val nodes, const char *  fname)
+gen_check_node_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions needed by test check environment");
 
-  fprintf (f, "#include \"check_node.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"CHKM\"\n"
-              "#include \"debug.h\"\n"
-              "#include \"check_mem.h\"\n"
-              "\n"
-              "#define CHKMTRAV(node, info) (node != NULL ? TRAVdo (node, info) : node)\n\n");
+  emit_str (f, "#include \"check_node.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"CHKM\"\n"
+               "#include \"debug.h\"\n"
+               "#include \"check_mem.h\"\n"
+               "\n"
+               "#define CHKMTRAV(node, info) (node != NULL ? TRAVdo (node, info) : node)\n\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      char *  node_name_lower = string_tolower (YAJL_OBJECT_KEYS (nodes)[i]);
-      char *  node_name_upper = string_toupper (YAJL_OBJECT_KEYS (nodes)[i]);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
 
-      fprintf (f, "node *\n"
-                  "CHKM%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n"
-                  "  CHKMtouch (arg_node, arg_info);\n"
-                  "  NODE_ERROR (arg_node) = CHKMTRAV (NODE_ERROR (arg_node), arg_info);\n\n",
-               node_name_lower);
+      emit_fmt (f, "node *\n"
+                   "CHKM%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n"
+                   "  CHKMtouch (arg_node, arg_info);\n"
+                   "  NODE_ERROR (arg_node) = CHKMTRAV (NODE_ERROR (arg_node), arg_info);\n\n",
+                node_name_lower);
 
 
       /* Check if we have a son called Next and free it first.
 
          FIXME is it necessary to do the Next first?  */
-      const yajl_val next = yajl_tree_get (sons, (const char *[]){"Next", 0}, yajl_t_object);
-      if (next)
-        fprintf (f, "  %s_NEXT (arg_node) = CHKMTRAV (%s_NEXT (arg_node), arg_info);\n",
-                 node_name_upper, node_name_upper);
+      if (node->next)
+        emit_fmt (f, "  %s_NEXT (arg_node) = CHKMTRAV (%s_NEXT (arg_node), arg_info);\n",
+                  node_name_upper, node_name_upper);
 
 
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-          struct attrtype_name *  atn;
-          char *  type_name = YAJL_GET_STRING (type);
-
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
+          const struct attrtype_name *  atn = node->attributes[i].type;
 
           if (atn->copy_type == act_literal || atn->copy_type == act_function)
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  CHKMtouch ((void *) %s_%s (arg_node), arg_info);\n",
-                   node_name_upper, attrib_name_upper);
-
-          free (attrib_name_upper);
+          emit_fmt (f, "  CHKMtouch ((void *) %s_%s (arg_node), arg_info);\n",
+                    node_name_upper, node->attributes[i].name->upper);
         }
 
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-            const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-
             /* We did Next already before the attributes.  */
-            if (!strcmp (son_name, "Next"))
+            if (&node->sons[i] == node->next)
               continue;
 
-            char *  son_name_upper = string_toupper (son_name);
-            fprintf (f, "  %s_%s (arg_node) = CHKMTRAV (%s_%s (arg_node), arg_info);\n",
-                     node_name_upper, son_name_upper,
-                     node_name_upper, son_name_upper);
-            free (son_name_upper);
+            const char *  son_name_upper = node->sons[i].name->upper;
+            emit_fmt (f, "  %s_%s (arg_node) = CHKMTRAV (%s_%s (arg_node), arg_info);\n",
+                      node_name_upper, son_name_upper,
+                      node_name_upper, son_name_upper);
         }
 
-      fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-      free (node_name_upper);
-      free (node_name_lower);
+      emit_str (f, "  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
 
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FLUSH_AND_CLOSE (f);
   return true;
 }
@@ -841,21 +1165,19 @@ gen_check_node_c (yajl_val nodes, const char *  fname)
    by default if `persist' is not present gets a function called
    SATserialize<attribute-type-name>.  */
 bool
-gen_serialize_attribs_h (const char *  fname)
+gen_serialize_attribs_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__SERIALIZE_ATTRIBS_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to serialize the attributes of node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
-
-  struct attrtype_name *  atn;
-  struct attrtype_name *  tmp;
+  emit_str (f, "#include \"types.h\"\n\n");
 
-  HASH_ITER (hh, attrtype_names, atn, tmp)
+  for (size_t i = 0; i < m->n_attrtypes; i++)
     {
+      const struct attrtype_name *  atn = m->attrtypes[i];
       const char *  const_qual = "";
 
       if (!atn->persist)
@@ -869,11 +1191,11 @@ gen_serialize_attribs_h (const char *  fname)
       if (!strcmp (atn->name, "String"))
         const_qual = "const ";
 
-      fprintf (f, "void SATserialize%s (info *, %s%s, node *);\n",
-               atn->name, const_qual, atn->ctype);
+      emit_fmt (f, "void SATserialize%s (info *, %s%s, node *);\n",
+                atn->name, const_qual, atn->ctype);
     }
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -882,30 +1204,21 @@ gen_serialize_attribs_h (const char *  fname)
 /* Generate serialize_node.h, containing prototype to serialise each type of
    nodes.  */
 bool
-gen_serialize_node_h (const char *  fname)
+gen_serialize_node_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__SERIALIZE_NODE_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to serialize node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
-
-  struct node_name *  nn;
-  struct node_name *  tmp;
+  emit_str (f, "#include \"types.h\"\n\n");
 
-  HASH_ITER (hh, node_names, nn, tmp)
-    {
-      if (nn->name_type == nnt_nodeset)
-        continue;
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  SET%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  SET%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
-    }
-
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -915,30 +1228,21 @@ gen_serialize_node_h (const char *  fname)
 /* Generate serialize_link.h, containing prototype to serialise links to
    every type of node.  */
 bool
-gen_serialize_link_h (const char *  fname)
+gen_serialize_link_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__SERIALIZE_LINK_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to serialize links in node structures");
 
-  fprintf (f, "#include \"types.h\"\n\n");
-
-  struct node_name *  nn;
-  struct node_name *  tmp;
-
-  HASH_ITER (hh, node_names, nn, tmp)
-    {
-      if (nn->name_type == nnt_nodeset)
-        continue;
+  emit_str (f, "#include \"types.h\"\n\n");
 
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  SEL%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
-    }
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  SEL%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -948,30 +1252,21 @@ gen_serialize_link_h (const char *  fname)
 /* Generate serialize_link.h, containing prototype to serialise links to
    every type of node.  */
 bool
-gen_serialize_buildstack_h (const char *  fname)
+gen_serialize_buildstack_h (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   const char *  protector = "__SERIALIZE_BUILDSTACK_H__";
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER_H (f, protector,
                 "   Functions to build a serialize stack");
 
-  fprintf (f, "#include \"types.h\"\n\n");
+  emit_str (f, "#include \"types.h\"\n\n");
 
-  struct node_name *  nn;
-  struct node_name *  tmp;
+  for (size_t i = 0; i < m->n_nodes; i++)
+    emit_fmt (f, "node *  SBT%s (node *  arg_node, info *  arg_info);\n",
+              m->nodes[i].name->lower);
 
-  HASH_ITER (hh, node_names, nn, tmp)
-    {
-      if (nn->name_type == nnt_nodeset)
-        continue;
-
-      char *  name_lower = string_tolower (nn->name);
-      fprintf (f, "node *  SBT%s (node *  arg_node, info *  arg_info);\n", name_lower);
-      free (name_lower);
-    }
-
-  fprintf (f, "\n\n");
+  emit_str (f, "\n\n");
   GEN_FOOTER_H (f, protector);
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -980,121 +1275,99 @@ gen_serialize_buildstack_h (const char *  fname)
 
 /* Generate the serialisation function SET<node-name> for all nodes.  */
 bool
-gen_serialize_node_c (yajl_val nodes, const char *  fname)
+gen_serialize_node_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions to allocate node structures");
 
-  fprintf (f, "#include <stdio.h>\n"
-              "#include \"serialize_node.h\"\n"
-              "#include \"serialize_attribs.h\"\n"
-              "#include \"serialize_info.h\"\n"
-              "#include \"serialize_stack.h\"\n"
-              "#include \"serialize_filenames.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"SET\"\n"
-              "#include \"debug.h\"\n\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "#include <stdio.h>\n"
+               "#include \"serialize_node.h\"\n"
+               "#include \"serialize_attribs.h\"\n"
+               "#include \"serialize_info.h\"\n"
+               "#include \"serialize_stack.h\"\n"
+               "#include \"serialize_filenames.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"SET\"\n"
+               "#include \"debug.h\"\n\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name = node->name->name;
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
 
       /* Generate a function header.  */
-      fprintf (f, "node *\n"
-                  "SET%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n"
-                  "  DBUG_PRINT (\"Serialising `%s' node\");\n"
-                  "  fprintf (INFO_SER_FILE (arg_info),\n"
-                  "           \", SHLPmakeNode (%%d, FILENAME (%%d), %%zd, %%zd\",\n"
-                  "           N_%s, SFNgetId (NODE_FILE (arg_node)), NODE_LINE (arg_node),\n"
-                  "           NODE_COL (arg_node));\n\n",
-               node_name_lower,
-               node_name,
-               node_name_lower);
+      emit_fmt (f, "node *\n"
+                   "SET%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n"
+                   "  DBUG_PRINT (\"Serialising `%s' node\");\n"
+                   "  fprintf (INFO_SER_FILE (arg_info),\n"
+                   "           \", SHLPmakeNode (%%d, FILENAME (%%d), %%zd, %%zd\",\n"
+                   "           N_%s, SFNgetId (NODE_FILE (arg_node)), NODE_LINE (arg_node),\n"
+                   "           NODE_COL (arg_node));\n\n",
+                node_name_lower,
+                node_name,
+                node_name_lower);
 
       /* Traverse Attributes and generate a value if an attribute has
          `persist' = true (default).  All other attributes are ignored, as
          they will be set to their default values lateron.  */
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-
-          const char *  type_name = YAJL_GET_STRING (type);
-          struct attrtype_name *  atn;
-
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
+          const struct attrtype_name *  atn = node->attributes[i].type;
 
           if (!atn->persist)
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  fprintf (INFO_SER_FILE (arg_info), \", \");\n");
-          fprintf (f, "  SATserialize%s (arg_info, %s_%s (arg_node), arg_node);\n",
-                   atn->name, node_name_upper, attrib_name_upper);
-
-          free (attrib_name_upper);
+          emit_str (f, "  fprintf (INFO_SER_FILE (arg_info), \", \");\n");
+          emit_fmt (f, "  SATserialize%s (arg_info, %s_%s (arg_node), arg_node);\n",
+                    atn->name, node_name_upper, node->attributes[i].name->upper);
         }
 
       /* Traverse Sons.  */
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          char *  son_name_upper = string_toupper (son_name);
+          const char *  son_name = node->sons[i].name->name;
+          const char *  son_name_upper = node->sons[i].name->upper;
 
           if (i == 0)
-            fprintf (f, "\n");
+            emit_str (f, "\n");
 
           /* FUNDEF_BODY := NULL;  */
           if (!strcmp (node_name, "Fundef") && !strcmp (son_name, "Body"))
-            fprintf (f, "  fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n");
+            emit_str (f, "  fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n");
 
           /* {FUNDEF,OBJDEF,TYPEDEF}_NEXT := NULL;  */
           else if (!strcmp (son_name, "Next")
                    && (!strcmp (node_name, "Fundef")
                        || !strcmp (node_name, "Typedef")
                        || !strcmp (node_name, "Objdef")))
-            fprintf (f, "  fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n");
+            emit_str (f, "  fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n");
 
           else
-            fprintf (f, "  if (NULL == %s_%s (arg_node))\n"
-                        "    fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n"
-                        "  else\n"
-                        "    TRAVdo (%s_%s (arg_node), arg_info);\n",
-                     node_name_upper, son_name_upper,
-                     node_name_upper, son_name_upper);
-
-          fprintf (f, "\n");
-          free (son_name_upper);
+            emit_fmt (f, "  if (NULL == %s_%s (arg_node))\n"
+                         "    fprintf (INFO_SER_FILE (arg_info), \", NULL\");\n"
+                         "  else\n"
+                         "    TRAVdo (%s_%s (arg_node), arg_info);\n",
+                      node_name_upper, son_name_upper,
+                      node_name_upper, son_name_upper);
+
+          emit_str (f, "\n");
         }
 
       /* Traverse Flags.  */
-      for (size_t i = 0; flags && i < YAJL_OBJECT_LENGTH (flags); i++)
-        {
-          const char *  flag_name = YAJL_OBJECT_KEYS (flags)[i];
-          char *  flag_name_upper = string_toupper (flag_name);
-          fprintf (f, "  fprintf (INFO_SER_FILE (arg_info), \", %%d\", %s_%s (arg_node));\n",
-                   node_name_upper, flag_name_upper);
-          free (flag_name_upper);
-        }
+      for (size_t i = 0; i < node->n_flags; i++)
+        emit_fmt (f, "  fprintf (INFO_SER_FILE (arg_info), \", %%d\", %s_%s (arg_node));\n",
+                  node_name_upper, node->flags[i].name->upper);
 
       /* Generate function footer.  */
-      fprintf (f, "  fprintf (INFO_SER_FILE (arg_info), \")\");\n"
-                  "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_str (f, "  fprintf (INFO_SER_FILE (arg_info), \")\");\n"
+                   "  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -1103,75 +1376,70 @@ gen_serialize_node_c (yajl_val nodes, const char *  fname)
 
 /* Generate the serialisation function SET<node-name> for all nodes.  */
 bool
-gen_serialize_link_c (yajl_val nodes, const char *  fname)
+gen_serialize_link_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "   Functions needed by serialize link traversal");
 
-  fprintf (f, "#include <stdio.h>\n"
-              "#include \"serialize_node.h\"\n"
-              "#include \"serialize_attribs.h\"\n"
-              "#include \"serialize_info.h\"\n"
-              "#include \"serialize_stack.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"SEL\"\n"
-              "#include \"debug.h\"\n\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "#include <stdio.h>\n"
+               "#include \"serialize_node.h\"\n"
+               "#include \"serialize_attribs.h\"\n"
+               "#include \"serialize_info.h\"\n"
+               "#include \"serialize_stack.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"SEL\"\n"
+               "#include \"debug.h\"\n\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name = node->name->name;
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
 
       /* Generate a function header.  */
-      fprintf (f, "node *\n"
-                  "SEL%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n\n",
-               node_name_lower);
+      emit_fmt (f, "node *\n"
+                   "SEL%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n\n",
+                node_name_lower);
 
 
       /* Traverse Attributes   */
-      for (size_t i = 0, pos = 1; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0, pos = 1; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-
-          const char *  type_name = YAJL_GET_STRING (type);
+          const char *  attrib_name = node->attributes[i].name->name;
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
+          const char *  type_name = node->attributes[i].type->name;
 
           /* Skip all attributes that are not of type Link or CodeLink.  */
           if (strcmp (type_name, "Link") && strcmp (type_name, "CodeLink"))
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  if (NULL != %s_%s (arg_node)\n"
-                      "      && SERSTACK_NOT_FOUND\n"
-                      "         != SSfindPos (%s_%s (arg_node), INFO_SER_STACK (arg_info)))\n"
-                      "    fprintf (INFO_SER_FILE (arg_info),\n"
-                      "             \"/* Fix link for `%s' attribute.  */\\n\"\n"
-                      "             \"SHLPfixLink (stack, %%d, %zu, %%d);\\n\",\n"
-                      "             SSfindPos (arg_node, INFO_SER_STACK (arg_info)),\n"
-                      "             SSfindPos (%s_%s (arg_node), INFO_SER_STACK (arg_info)));\n\n",
-                   node_name_upper, attrib_name_upper,
-                   node_name_upper, attrib_name_upper,
-                   attrib_name,
-                   pos,
-                   node_name_upper, attrib_name_upper);
+          emit_fmt (f, "  if (NULL != %s_%s (arg_node)\n"
+                       "      && SERSTACK_NOT_FOUND\n"
+                       "         != SSfindPos (%s_%s (arg_node), INFO_SER_STACK (arg_info)))\n"
+                       "    fprintf (INFO_SER_FILE (arg_info),\n"
+                       "             \"/* Fix link for `%s' attribute.  */\\n\"\n"
+                       "             \"SHLPfixLink (stack, %%d, %zu, %%d);\\n\",\n"
+                       "             SSfindPos (arg_node, INFO_SER_STACK (arg_info)),\n"
+                       "             SSfindPos (%s_%s (arg_node), INFO_SER_STACK (arg_info)));\n\n",
+                    node_name_upper, attrib_name_upper,
+                    node_name_upper, attrib_name_upper,
+                    attrib_name,
+                    pos,
+                    node_name_upper, attrib_name_upper);
 
           pos++;
-          free (attrib_name_upper);
         }
 
       /* Traverse Sons.  */
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
+          const char *  son_name = node->sons[i].name->name;
+          const char *  son_name_upper = node->sons[i].name->upper;
 
           if (!strcmp (node_name, "Fundef")
               && (!strcmp (son_name, "Next") || !strcmp (son_name, "Body")))
@@ -1183,41 +1451,31 @@ gen_serialize_link_c (yajl_val nodes, const char *  fname)
           if (!strcmp (node_name, "Objdef") && !strcmp (son_name, "Next"))
             continue;
 
-          char *  son_name_upper = string_toupper (son_name);
-          fprintf (f, "  if (NULL != %s_%s (arg_node))\n"
-                      "    TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                   node_name_upper, son_name_upper,
-                   node_name_upper, son_name_upper);
-          free (son_name_upper);
+          emit_fmt (f, "  if (NULL != %s_%s (arg_node))\n"
+                       "    TRAVdo (%s_%s (arg_node), arg_info);\n\n",
+                    node_name_upper, son_name_upper,
+                    node_name_upper, son_name_upper);
         }
 
       /* Traverse into Attribs of type Node.  */
-       for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+       for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-
-          const char *  type_name = YAJL_GET_STRING (type);
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
 
           /* Skip all the attributes that are not of type Node.  */
-          if (strcmp (type_name, "Node"))
+          if (strcmp (node->attributes[i].type->name, "Node"))
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          fprintf (f, "  if (NULL != %s_%s (arg_node))\n"
-                      "    TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                   node_name_upper, attrib_name_upper,
-                   node_name_upper, attrib_name_upper);
-          free (attrib_name_upper);
+          emit_fmt (f, "  if (NULL != %s_%s (arg_node))\n"
+                       "    TRAVdo (%s_%s (arg_node), arg_info);\n\n",
+                    node_name_upper, attrib_name_upper,
+                    node_name_upper, attrib_name_upper);
         }
 
 
       /* Generate function footer.  */
-      fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_str (f, "  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
   GEN_FLUSH_AND_CLOSE (f);
   return true;
@@ -1225,221 +1483,210 @@ gen_serialize_link_c (yajl_val nodes, const char *  fname)
 
 /* Generate serialisation helper functions SHLPmakeNode and SHLPfixLink.  */
 bool
-gen_serialize_helper_c (yajl_val nodes, const char *  fname)
+gen_serialize_helper_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "    Functions needed by de-serialization code.");
 
-  fprintf (f, "#include \"types.h\"\n"
-              "#include \"str.h\"\n"
-              "#include \"memory.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"node_alloc.h\"\n"
-              "#include \"serialize.h\"\n"
-              "#include \"stdarg.h\"\n"
-              "#include \"check_mem.h\"\n"
-              "#include \"serialize_stack.h\"\n"
-              "#include \"serialize_helper.h\"\n"
-              "#define DBUG_PREFIX \"SHLP\"\n"
-              "#include \"debug.h\"\n"
-              "\n"
-              "#ifndef DBUG_OFF\n"
-              "#  define CHECK_NODE(__node, __type)  CHKMisNode (__node, __type)\n"
-              "#else\n"
-              "#  define CHECK_NODE(__node, __type)\n"
-              "#endif\n"
-              "\n"
-              "node *\n"
-              "SHLPmakeNodeVa (int _node_type, char *sfile, size_t lineno, size_t col,\n"
-              "                va_list args)\n"
-              "{\n"
-              "  nodetype node_type = (nodetype) _node_type;\n"
-              "  node *xthis = NULL;\n"
-              "  switch (node_type)\n"
-              "    {\n");
-
-
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "#include \"types.h\"\n"
+               "#include \"str.h\"\n"
+               "#include \"memory.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"node_alloc.h\"\n"
+               "#include \"serialize.h\"\n"
+               "#include \"stdarg.h\"\n"
+               "#include \"check_mem.h\"\n"
+               "#include \"serialize_stack.h\"\n"
+               "#include \"serialize_helper.h\"\n"
+               "#define DBUG_PREFIX \"SHLP\"\n"
+               "#include \"debug.h\"\n"
+               "\n"
+               "/* Nodes taken from a pool or an arena are not known to check_mem.  */\n"
+               "#if !defined (DBUG_OFF) && !defined (NODE_POOLS) && !defined (NODE_ARENAS)\n"
+               "#  define CHECK_NODE(__node, __type)  CHKMisNode (__node, __type)\n"
+               "#else\n"
+               "#  define CHECK_NODE(__node, __type)\n"
+               "#endif\n"
+               "\n"
+               "node *\n"
+               "SHLPmakeNodeVa (int _node_type, char *sfile, size_t lineno, size_t col,\n"
+               "                va_list args)\n"
+               "{\n"
+               "  nodetype node_type = (nodetype) _node_type;\n"
+               "  node *xthis = NULL;\n"
+               "  switch (node_type)\n"
+               "    {\n");
+
+
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-      const yajl_val flags = yajl_tree_get (node, (const char *[]){"flags", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
 
       /* Generate beginning of the 'case'.  */
-      fprintf (f, "    case N_%s:\n"
-                  "      {\n"
-                  "        struct NODE_ALLOC_N_%s *  nodealloc;\n"
-                  "        nodealloc = (struct NODE_ALLOC_N_%s *) MEMmalloc (sizeof *nodealloc);\n"
-                  "        xthis = (node *) &nodealloc->nodestructure;\n"
-                  "        NODE_TYPE (xthis) = node_type;\n"
-                  "        NODE_FILE (xthis) = sfile;\n"
-                  "        NODE_LINE (xthis) = lineno;\n"
-                  "        NODE_COL (xthis) = col;\n"
-                  "        NODE_ERROR (xthis) = NULL;\n"
-                  "\n"
-                  "        CHECK_NODE (xthis, node_type);\n",
-               node_name_lower,
-               node_name_upper,
-               node_name_upper);
-
-      if (sons && YAJL_OBJECT_LENGTH (sons) != 0)
-        fprintf (f, "        xthis->sons.N_%s = (struct SONS_N_%s *) &nodealloc->sonstructure;\n",
-                 node_name_lower, node_name_upper);
-
-      if ((flags && YAJL_OBJECT_LENGTH (flags) != 0)
-          || (attribs && YAJL_OBJECT_LENGTH (attribs) != 0))
-        fprintf (f, "        xthis->attribs.N_%s = (struct ATTRIBS_N_%s *) "
-                                                   "&nodealloc->attributestructure;\n",
-                 node_name_lower, node_name_upper);
-
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      emit_fmt (f, "    case N_%s:\n"
+                   "      {\n"
+                   "        struct NODE_ALLOC_N_%s *  nodealloc;\n"
+                   "        nodealloc = (struct NODE_ALLOC_N_%s *) ",
+                node_name_lower,
+                node_name_upper,
+                node_name_upper);
+
+      if (!strcmp (node->name->name, "Fundef"))
+        emit_str (f, "NODE_FUNDEF_ALLOC_AT (sizeof *nodealloc, __FILE__, __LINE__);\n");
+      else
+        emit_fmt (f, "NODE_ALLOC_AT (N_%s, sizeof *nodealloc, __FILE__, __LINE__);\n",
+                  node_name_lower);
+
+      emit_str (f, "        xthis = (node *) &nodealloc->nodestructure;\n"
+                   "        NODE_TYPE (xthis) = node_type;\n"
+                   "        NODE_FILE (xthis) = sfile;\n"
+                   "        NODE_LINE (xthis) = lineno;\n"
+                   "        NODE_COL (xthis) = col;\n"
+                   "        NODE_ERROR (xthis) = NULL;\n"
+                   "#ifdef AST_DIRTY_TRACKING\n"
+                   "        NODE_DIRTY (xthis) = NB_DIRTY_SELF;\n"
+                   "        NBtouch (xthis);\n"
+                   "#endif\n"
+                   "\n"
+                   "        CHECK_NODE (xthis, node_type);\n");
+
+      if (node->n_sons != 0 || node->n_flags != 0 || node->n_attributes != 0)
+        emit_str (f, "#ifndef FIXED_NODE_LAYOUT\n");
+
+      if (node->n_sons != 0)
+        emit_fmt (f, "        xthis->sons.N_%s = (struct SONS_N_%s *) &nodealloc->sonstructure;\n",
+                  node_name_lower, node_name_upper);
+
+      if (node->n_flags != 0 || node->n_attributes != 0)
+        emit_fmt (f, "        xthis->attribs.N_%s = (struct ATTRIBS_N_%s *) "
+                                                    "&nodealloc->attributestructure;\n",
+                  node_name_lower, node_name_upper);
+
+      if (node->n_sons != 0 || node->n_flags != 0 || node->n_attributes != 0)
+        emit_str (f, "#endif\n");
+
+      if (node->n_cold_attributes != 0)
+        emit_fmt (f, "        %s_COLDATTRIBS (xthis) = NULL;\n", node_name_upper);
+
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
+          const struct attrtype_name *  atn = node->attributes[i].type;
 
-          const char *  type_name = YAJL_GET_STRING (type);
-          struct attrtype_name *  atn;
-
-          HASH_FIND_STR (attrtype_names, type_name, atn);
-          assert (atn);
+          /* The block of cold attributes starts with the initial values.  */
+          if (!atn->persist && node->attributes[i].cold)
+            continue;
 
           if (!atn->persist)
-            fprintf (f, "        %s_%s (xthis) = %s;\n",
-                    node_name_upper, attrib_name_upper, atn->init);
+            emit_fmt (f, "        %s_%s (xthis) = %s;\n",
+                     node_name_upper, attrib_name_upper, atn->init);
           else
-            fprintf (f, "        %s_%s (xthis) = va_arg (args, %s);\n",
-                     node_name_upper, attrib_name_upper,
-                     atn->vtype ? atn->vtype : atn->ctype);
-          free (attrib_name_upper);
+            emit_fmt (f, "        %s_%s (xthis) = va_arg (args, %s);\n",
+                      node_name_upper, attrib_name_upper,
+                      atn->vtype ? atn->vtype : atn->ctype);
         }
 
 
       /* Traverse Sons.  */
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
-        {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
-          char *  son_name_upper = string_toupper (son_name);
-          fprintf (f, "        %s_%s (xthis) = va_arg (args, node *);\n",
-                   node_name_upper, son_name_upper);
-          free (son_name_upper);
-        }
+      for (size_t i = 0; i < node->n_sons; i++)
+        emit_fmt (f, "        %s_%s (xthis) = va_arg (args, node *);\n",
+                  node_name_upper, node->sons[i].name->upper);
 
       /* Traverse into Attribs of type Node.  */
-       for (size_t i = 0; flags && i < YAJL_OBJECT_LENGTH (flags); i++)
-        {
-          const char *  flag_name = YAJL_OBJECT_KEYS (flags)[i];
-          char *  flag_name_upper = string_toupper (flag_name);
-          fprintf (f, "        %s_%s (xthis) = va_arg (args, int);\n",
-                   node_name_upper, flag_name_upper);
-          free (flag_name_upper);
-        }
+      for (size_t i = 0; i < node->n_flags; i++)
+        emit_fmt (f, "        %s_%s (xthis) = va_arg (args, int);\n",
+                  node_name_upper, node->flags[i].name->upper);
 
       /* Generate function footer.  */
-      fprintf (f, "        break;\n"
-                  "      }\n\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_str (f, "        break;\n"
+                   "      }\n\n");
     }
 
-  fprintf (f, "      default:\n"
-              "        DBUG_UNREACHABLE (\"Invalid node type found\");\n"
-              "      }\n"
-              "\n"
-              "  return (xthis);\n"
-              "}\n\n" 
-              "\n"
-              "node *\n"
-              "SHLPmakeNode (int _node_type, char *sfile, size_t lineno, size_t col, ...)\n"
-              "{\n"
-              "  node *  result;\n"
-              "  va_list argp;\n"
-              "\n"
-              "  va_start (argp, col);\n"
-              "  result = SHLPmakeNodeVa (_node_type, sfile, lineno, col, argp);\n"
-              "  va_end (argp);\n"
-              "\n"
-              "  return (result);\n"
-              "}\n");
+  emit_str (f, "      default:\n"
+               "        DBUG_UNREACHABLE (\"Invalid node type found\");\n"
+               "      }\n"
+               "\n"
+               "  return (xthis);\n"
+               "}\n\n" 
+               "\n"
+               "node *\n"
+               "SHLPmakeNode (int _node_type, char *sfile, size_t lineno, size_t col, ...)\n"
+               "{\n"
+               "  node *  result;\n"
+               "  va_list argp;\n"
+               "\n"
+               "  va_start (argp, col);\n"
+               "  result = SHLPmakeNodeVa (_node_type, sfile, lineno, col, argp);\n"
+               "  va_end (argp);\n"
+               "\n"
+               "  return (result);\n"
+               "}\n");
 
 
   /* Generate SHLPfixLink  */
-  fprintf (f, "void\n"
-              "SHLPfixLink (serstack_t *  stack, int from, int no, int to)\n"
-              "{\n"
-              "  node *  fromp = NULL;\n"
-              "  node *  top = NULL;\n"
-              "\n"
-              "  if (from != SERSTACK_NOT_FOUND)\n"
-              "    {\n"
-              "      fromp = SSlookup (from, stack);\n"
-              "      if (to != SERSTACK_NOT_FOUND)\n"
-              "        top = SSlookup (to, stack);\n"
-              "\n"
-              "      switch (NODE_TYPE (fromp))\n"
-              "        {\n");
-
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  emit_str (f, "void\n"
+               "SHLPfixLink (serstack_t *  stack, int from, int no, int to)\n"
+               "{\n"
+               "  node *  fromp = NULL;\n"
+               "  node *  top = NULL;\n"
+               "\n"
+               "  if (from != SERSTACK_NOT_FOUND)\n"
+               "    {\n"
+               "      fromp = SSlookup (from, stack);\n"
+               "      if (to != SERSTACK_NOT_FOUND)\n"
+               "        top = SSlookup (to, stack);\n"
+               "\n"
+               "      switch (NODE_TYPE (fromp))\n"
+               "        {\n");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name_upper = node->name->upper;
 
-      fprintf (f, "        case N_%s:\n", node_name_lower);
+      emit_fmt (f, "        case N_%s:\n", node->name->lower);
 
-      for (size_t i = 0, pos = 1; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0, pos = 1; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          char *  attrib_name_upper = string_toupper (attrib_name);
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-          const char *  type_name = YAJL_GET_STRING (type);
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
+          const char *  type_name = node->attributes[i].type->name;
 
           /* If the type of the attribute is not `Link' or `CodeLink' --- ignore it.  */
           if (!strcmp (type_name, "Link") || !strcmp (type_name, "CodeLink"))
             {
               if (pos == 1)
-                fprintf (f, "          switch (no)\n"
-                            "            {\n");
-
-              fprintf (f, "            case %zu:\n"
-                          "              %s_%s (fromp) = top;\n"
-                          "              break;\n",
-                          pos,
-                          node_name_upper, attrib_name_upper);
+                emit_str (f, "          switch (no)\n"
+                             "            {\n");
+
+              emit_fmt (f, "            case %zu:\n"
+                           "              %s_%s (fromp) = top;\n"
+                           "              break;\n",
+                           pos,
+                           node_name_upper, attrib_name_upper);
               pos++;
             }
 
           /* If we are at the last attribute and we have seen
              `Link' or `CodeLink' attributes then generate `default'
              case for the `no' switch.  */
-          if (i == YAJL_OBJECT_LENGTH (attribs) - 1 && pos > 1)
-            fprintf (f, "            default:\n"
-                        "              break;\n"
-                        "            }\n");
-
-          free (attrib_name_upper);
+          if (i == node->n_attributes - 1 && pos > 1)
+            emit_str (f, "            default:\n"
+                         "              break;\n"
+                         "            }\n");
         }
 
-      fprintf (f, "          break;\n");
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_str (f, "          break;\n");
     }
 
-  fprintf (f, "        default:\n"
-              "          DBUG_UNREACHABLE (\"Invalid node type found\");\n"
-              "        }\n"
-              "    }\n"
-              "}\n\n");
+  emit_str (f, "        default:\n"
+               "          DBUG_UNREACHABLE (\"Invalid node type found\");\n"
+               "        }\n"
+               "    }\n"
+               "}\n\n");
 
 
 
@@ -1449,41 +1696,40 @@ gen_serialize_helper_c (yajl_val nodes, const char *  fname)
 
 
 bool
-gen_serialize_buildstack_c (yajl_val nodes, const char *  fname)
+gen_serialize_buildstack_c (const struct model *  m, const char *  fname)
 {
-  FILE *  f;
+  struct emitter *  f;
   GEN_OPEN_FILE (f, fname);
   GEN_HEADER (f, "    Functions needed by serialize buildstack traversal.");
 
-  fprintf (f, "#include <stdio.h>\n"
-              "#include \"serialize_buildstack.h\"\n"
-              "#include \"serialize_info.h\"\n"
-              "#include \"serialize_stack.h\"\n"
-              "#include \"tree_basic.h\"\n"
-              "#include \"traverse.h\"\n"
-              "#define DBUG_PREFIX \"SBT\"\n"
-              "#include \"debug.h\"\n\n");
+  emit_str (f, "#include <stdio.h>\n"
+               "#include \"serialize_buildstack.h\"\n"
+               "#include \"serialize_info.h\"\n"
+               "#include \"serialize_stack.h\"\n"
+               "#include \"tree_basic.h\"\n"
+               "#include \"traverse.h\"\n"
+               "#define DBUG_PREFIX \"SBT\"\n"
+               "#include \"debug.h\"\n\n");
 
-  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodes); i++)
+  for (size_t i = 0; i < m->n_nodes; i++)
     {
-      const char *  node_name = YAJL_OBJECT_KEYS (nodes)[i];
-      char *  node_name_lower = string_tolower (node_name);
-      char *  node_name_upper = string_toupper (node_name);
-      const yajl_val node = YAJL_OBJECT_VALUES (nodes)[i];
-      const yajl_val attribs = yajl_tree_get (node, (const char *[]){"attributes", 0}, yajl_t_object);
-      const yajl_val sons = yajl_tree_get (node, (const char *[]){"sons", 0}, yajl_t_object);
-
-      fprintf (f, "node *\n"
-                  "SBT%s (node *  arg_node, info *  arg_info)\n"
-                  "{\n"
-                  "  DBUG_ENTER ();\n"
-                  "  DBUG_PRINT (\"Stacking Annotate node\");\n"
-                  "  SSpush (arg_node, INFO_SER_STACK (arg_info));\n",
-               node_name_lower);
-
-      for (size_t i = 0; sons && i < YAJL_OBJECT_LENGTH (sons); i++)
+      const struct model_node *  node = &m->nodes[i];
+      const char *  node_name = node->name->name;
+      const char *  node_name_lower = node->name->lower;
+      const char *  node_name_upper = node->name->upper;
+
+      emit_fmt (f, "node *\n"
+                   "SBT%s (node *  arg_node, info *  arg_info)\n"
+                   "{\n"
+                   "  DBUG_ENTER ();\n"
+                   "  DBUG_PRINT (\"Stacking Annotate node\");\n"
+                   "  SSpush (arg_node, INFO_SER_STACK (arg_info));\n",
+                node_name_lower);
+
+      for (size_t i = 0; i < node->n_sons; i++)
         {
-          const char *  son_name = YAJL_OBJECT_KEYS (sons)[i];
+          const char *  son_name = node->sons[i].name->name;
+          const char *  son_name_upper = node->sons[i].name->upper;
 
           /* Skip `Next' and `Body' sons of the node `Fundef'.  */
           if (!strcmp (node_name, "Fundef")
@@ -1495,40 +1741,28 @@ gen_serialize_buildstack_c (yajl_val nodes, const char *  fname)
               && !strcmp (son_name, "Next"))
             continue;
 
-          char *  son_name_upper = string_toupper (son_name);
-          fprintf (f, "  if (NULL != %s_%s (arg_node))\n"
-                      "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                   node_name_upper, son_name_upper,
-                   node_name_upper, son_name_upper, node_name_upper, son_name_upper);
-          free (son_name_upper);
+          emit_fmt (f, "  if (NULL != %s_%s (arg_node))\n"
+                       "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
+                    node_name_upper, son_name_upper,
+                    node_name_upper, son_name_upper, node_name_upper, son_name_upper);
         }
 
-      for (size_t i = 0; attribs && i < YAJL_OBJECT_LENGTH (attribs); i++)
+      for (size_t i = 0; i < node->n_attributes; i++)
         {
-          const char *  attrib_name = YAJL_OBJECT_KEYS (attribs)[i];
-          const yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
-          const yajl_val type = yajl_tree_get (attrib, (const char *[]){"type", 0}, yajl_t_string);
-
-          const char *  type_name = YAJL_GET_STRING (type);
+          const char *  attrib_name_upper = node->attributes[i].name->upper;
 
           /* Consider only attributes of type `Node'.  */
-          if (strcmp (type_name, "Node"))
+          if (strcmp (node->attributes[i].type->name, "Node"))
             continue;
 
-          char *  attrib_name_upper = string_toupper (attrib_name);
-
-          fprintf (f, "  if (NULL != %s_%s (arg_node))\n"
-                      "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
-                   node_name_upper, attrib_name_upper,
-                   node_name_upper, attrib_name_upper, node_name_upper, attrib_name_upper);
-          free (attrib_name_upper);
+          emit_fmt (f, "  if (NULL != %s_%s (arg_node))\n"
+                       "    %s_%s (arg_node) = TRAVdo (%s_%s (arg_node), arg_info);\n\n",
+                    node_name_upper, attrib_name_upper,
+                    node_name_upper, attrib_name_upper, node_name_upper, attrib_name_upper);
         }
 
-      fprintf (f, "  DBUG_RETURN (arg_node);\n"
-                  "}\n\n");
-
-      free (node_name_lower);
-      free (node_name_upper);
+      emit_str (f, "  DBUG_RETURN (arg_node);\n"
+                   "}\n\n");
     }
 
   GEN_FLUSH_AND_CLOSE (f);
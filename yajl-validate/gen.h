@@ -1,21 +1,33 @@
 #ifndef __GEN_H__
 #define __GEN_H__
 
-#include <ctype.h>
+#include <errno.h>
+#include <string.h>
 #include <time.h>
 
+#include "model.h"
+#include "emit.h"
+
 #define GEN_HEADER(__f, __comment)                              \
 do {                                                            \
-  time_t now = time (NULL);                                     \
-  char s[20];                                                   \
-  strftime (s, 20, "%F %H:%M:%S", localtime (&now));            \
+  char s[64] = "";                                              \
                                                                 \
-  fprintf (__f,                                                 \
+  /* Timestamps make every run produce a new file, so we omit   \
+     them when only changed files have to be replaced.  */      \
+  if (!update_changed_only)                                     \
+    {                                                           \
+      time_t now = time (NULL);                                 \
+      struct tm tm;                                             \
+      char t[20];                                               \
+      strftime (t, 20, "%F %H:%M:%S", localtime_r (&now, &tm)); \
+      sprintf (s, "   The file was generated on %s\n\n", t);    \
+    }                                                           \
+                                                                \
+  emit_fmt (__f,                                                \
   "/* This file is autogenerated, do not edit it manually,\n"   \
   "   but edit the `%s' function in `%s' file instead.\n"       \
   "\n"                                                          \
-  "   The file was generated on %s\n"                           \
-  "\n"                                                          \
+  "%s"                                                          \
   "\n"                                                          \
   "%s.  */\n"                                                   \
   "\n"                                                          \
@@ -26,7 +38,7 @@ do {                                                            \
 #define GEN_HEADER_H(__f, __protector, __comment)               \
 do {                                                            \
   GEN_HEADER (__f, __comment);                                  \
-  fprintf (__f,                                                 \
+  emit_fmt (__f,                                                \
   "#ifndef %s\n"                                                \
   "#define %s\n"                                                \
   "\n"                                                          \
@@ -36,15 +48,18 @@ do {                                                            \
 
 
 #define GEN_FOOTER_H(__f, __protector)                          \
-  fprintf (__f,                                                 \
+  emit_fmt (__f,                                                \
   "#endif // %s\n", __protector)
 
 
+/* Generated files are rendered into an emitter first and are written
+   to disk by GEN_FLUSH_AND_CLOSE.  */
 #define GEN_OPEN_FILE(__f, __fname)                             \
 do {                                                            \
-  if (!(__f = fopen (__fname, "w")))                            \
+  if (!(__f = gen_open_file (__fname)))                         \
     {                                                           \
-      warn ("failed to open file `%s' for writing", __fname);   \
+      ab_err ("failed to open file `%s' for writing: %s",       \
+              __fname, strerror (errno));                       \
       return false;                                             \
     }                                                           \
 } while (0)
@@ -52,61 +67,64 @@ do {                                                            \
 
 #define GEN_FLUSH_AND_CLOSE(__f)                                \
 do {                                                            \
-  if (0 != fflush (__f)) err_func (fflush);                     \
-  if (0 != fclose (f)) err_func (fclose);                       \
+  if (!gen_close_file (__f))                                    \
+    return false;                                               \
 } while (0)
 
 
-static inline char *
-string_tolower (const char *  s)
-{
-  char *  x = strdup (s);
-  for (size_t i = 0; i < strlen (x); i++)
-    x[i] = (char) tolower (x[i]);
+/* Emit the NODE_ALLOC_N_<node-name> structures into F.  */
+void gen_node_alloc_structs (struct emitter *  f, const struct model *  m);
+
+
+/* The size of a bitset over the node types of M, N_undefined included.  */
+#define NODETYPE_BITSET_BYTES(__m) (((__m)->n_nodes + 1 + 7) / 8)
 
-  return x;
-}
 
-static inline char *
-string_toupper (const char *  s)
+/* Add the node type of NODE to the bitset BITS.  */
+static inline void
+nodetype_bitset_add (unsigned char *  bits, const struct model *  m,
+                     const struct model_node *  node)
 {
-  char *  x = strdup (s);
-  for (size_t i = 0; i < strlen (x); i++)
-    x[i] = (char) toupper (x[i]);
+  size_t type = node - m->nodes + 1;
 
-  return x;
+  bits[type / 8] |= 1u << (type % 8);
 }
 
 
-bool gen_types_trav_h (yajl_val traversals, const char *  fname);
-bool gen_types_nodetype_h (yajl_val nodes, const char *  fname);
-bool gen_traverse_tables_h (yajl_val nodes, yajl_val traversals, const char *  fname);
-bool gen_traverse_tables_c (yajl_val nodes, yajl_val traversals, const char *  fname);
-bool gen_traverse_helper_c (yajl_val nodes, const char *  fname);
-bool gen_sons_h (yajl_val nodes, const char *  fname);
-bool gen_node_info_mac (yajl_val nodes, const char *  fname);
-bool gen_free_node_h (yajl_val nodes, const char *  fname);
-bool gen_attribs_h (yajl_val nodes, const char *  fname);
-bool gen_node_alloc_h (yajl_val nodes, const char *  fname);
-bool gen_node_basic_h (yajl_val nodes, const char *  fname);
-bool gen_free_attribs_h (const char *  fname);
-bool gen_check_reset_h (const char *  fname);
-bool gen_check_node_h (const char *  fname);
-bool gen_check_h (const char *  fname);
-bool gen_node_basic_c (yajl_val nodes, yajl_val nodesets, const char *  fname);
-bool gen_free_node_c (yajl_val nodes, const char *  fname);
-bool gen_check_reset_c (yajl_val nodes, const char *  fname);
-bool gen_check_node_c (yajl_val nodes, const char *  fname);
-bool gen_check_c (yajl_val nodes, yajl_val nodesets, const char *  fname);
-
-bool gen_serialize_attribs_h (const char *  fname);
-bool gen_serialize_node_h (const char *  fname);
-bool gen_serialize_link_h (const char *  fname);
-bool gen_serialize_buildstack_h (const char *  fname);
-bool gen_serialize_node_c (yajl_val nodes, const char *  fname);
-bool gen_serialize_link_c (yajl_val nodes, const char *  fname);
-bool gen_serialize_helper_c (yajl_val nodes, const char *  fname);
-bool gen_serialize_buildstack_c (yajl_val nodes, const char *  fname);
+/* Emit the bitset BITS of N_BYTES bytes as a row of an array
+   initializer.  */
+void gen_nodetype_bitset (struct emitter *  f, const unsigned char *  bits,
+                          size_t n_bytes);
+
+bool gen_types_trav_h (const struct model *  m, const char *  fname);
+bool gen_types_nodetype_h (const struct model *  m, const char *  fname);
+bool gen_traverse_tables_h (const struct model *  m, const char *  fname);
+bool gen_traverse_tables_c (const struct model *  m, const char *  fname);
+bool gen_traverse_helper_c (const struct model *  m, const char *  fname);
+bool gen_sons_h (const struct model *  m, const char *  fname);
+bool gen_node_info_mac (const struct model *  m, const char *  fname);
+bool gen_free_node_h (const struct model *  m, const char *  fname);
+bool gen_attribs_h (const struct model *  m, const char *  fname);
+bool gen_node_alloc_h (const struct model *  m, const char *  fname);
+bool gen_node_basic_h (const struct model *  m, const char *  fname);
+bool gen_free_attribs_h (const struct model *  m, const char *  fname);
+bool gen_check_reset_h (const struct model *  m, const char *  fname);
+bool gen_check_node_h (const struct model *  m, const char *  fname);
+bool gen_check_h (const struct model *  m, const char *  fname);
+bool gen_node_basic_c (const struct model *  m, const char *  fname);
+bool gen_free_node_c (const struct model *  m, const char *  fname);
+bool gen_check_reset_c (const struct model *  m, const char *  fname);
+bool gen_check_node_c (const struct model *  m, const char *  fname);
+bool gen_check_c (const struct model *  m, const char *  fname);
+
+bool gen_serialize_attribs_h (const struct model *  m, const char *  fname);
+bool gen_serialize_node_h (const struct model *  m, const char *  fname);
+bool gen_serialize_link_h (const struct model *  m, const char *  fname);
+bool gen_serialize_buildstack_h (const struct model *  m, const char *  fname);
+bool gen_serialize_node_c (const struct model *  m, const char *  fname);
+bool gen_serialize_link_c (const struct model *  m, const char *  fname);
+bool gen_serialize_helper_c (const struct model *  m, const char *  fname);
+bool gen_serialize_buildstack_c (const struct model *  m, const char *  fname);
 
 
 
@@ -0,0 +1,637 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "json.h"
+
+
+/* Objects and arrays nested deeper than this are rejected, which keeps
+   the recursion of the parser bounded.  */
+#define JSON_MAX_DEPTH 1024
+
+/* The minimal size of an arena block.  */
+#define JSON_BLOCK_SIZE 4096
+
+/* The whole file is read, so fault it in at once where possible.  */
+#ifdef MAP_POPULATE
+#  define JSON_MAP_FLAGS (MAP_PRIVATE | MAP_POPULATE)
+#else
+#  define JSON_MAP_FLAGS MAP_PRIVATE
+#endif
+
+
+/* The values of a tree are allocated from a list of blocks which are
+   freed all at once.  */
+struct json_block
+{
+  struct json_block *  next;
+  size_t size;
+  size_t used;
+  union { long long i; double d; void *  p; } data[];
+};
+
+
+/* A loaded document.  The root value goes first, so that the document
+   can be recovered from the value returned by JSON_LOAD.  */
+struct json_doc
+{
+  struct yajl_val_s root;
+  char *  map;
+  size_t map_size;
+  struct json_block *  blocks;
+};
+
+
+struct json_parser
+{
+  const char *  fname;
+  struct json_doc *  doc;
+  char *  p;
+  char *  end;
+
+  /* The current line and its beginning.  New lines can only appear
+     in whitespace, so they are counted when skipping it.  */
+  size_t line;
+  const char *  line_start;
+  size_t depth;
+
+  /* A stack of the items of the objects and arrays being parsed.  When
+     a container is closed its items are moved into the arena.  */
+  const char **  keys;
+  yajl_val *  vals;
+  size_t top;
+  size_t cap;
+};
+
+
+static void *
+json_alloc (struct json_doc *  doc, size_t size)
+{
+  struct json_block *  b = doc->blocks;
+  const size_t align = sizeof (b->data[0]);
+  void *  res;
+
+  size = (size + align - 1) / align * align;
+  if (!b || b->size - b->used < size)
+    {
+      /* The first block is as large as the file, which is usually
+         enough for the whole tree.  */
+      size_t bsz = b ? 2 * b->size : doc->map_size;
+
+      if (bsz < JSON_BLOCK_SIZE)
+        bsz = JSON_BLOCK_SIZE;
+      while (bsz < size)
+        bsz *= 2;
+
+      if (!(b = malloc (sizeof (*b) + bsz)))
+        err_func (malloc);
+
+      b->size = bsz;
+      b->used = 0;
+      b->next = doc->blocks;
+      doc->blocks = b;
+    }
+
+  res = (char *) b->data + b->used;
+  b->used += size;
+  return res;
+}
+
+
+/* Print an error message MSG about the position POS of the file.  */
+static bool
+json_error (const struct json_parser *  jp, const char *  pos, const char *  msg)
+{
+  if (pos >= jp->end)
+    msg = "unexpected end of file";
+
+  ab_err ("%s:%zu:%zu: parse error: %s", jp->fname, jp->line,
+          (size_t) (pos - jp->line_start) + 1, msg);
+  return false;
+}
+
+
+static inline void
+json_skip_whitespace (struct json_parser *  jp)
+{
+  for (; jp->p < jp->end; jp->p++)
+    switch (*jp->p)
+      {
+      case '\n':
+        jp->line++;
+        jp->line_start = jp->p + 1;
+        break;
+
+      case ' ':
+      case '\t':
+      case '\r':
+        break;
+
+      default:
+        return;
+      }
+}
+
+
+static inline bool
+json_at (const struct json_parser *  jp, char c)
+{
+  return jp->p < jp->end && *jp->p == c;
+}
+
+
+static inline bool
+json_digit_at (const char *  p, const char *  end)
+{
+  return p < end && *p >= '0' && *p <= '9';
+}
+
+
+static void
+json_push (struct json_parser *  jp, const char *  key, yajl_val v)
+{
+  if (jp->top == jp->cap)
+    {
+      jp->cap = jp->cap ? 2 * jp->cap : 256;
+      if (!(jp->keys = realloc (jp->keys, jp->cap * sizeof (*jp->keys))))
+        err_func (realloc);
+      if (!(jp->vals = realloc (jp->vals, jp->cap * sizeof (*jp->vals))))
+        err_func (realloc);
+    }
+
+  jp->keys[jp->top] = key;
+  jp->vals[jp->top] = v;
+  jp->top++;
+}
+
+
+/* Read four hex digits at S into RES.  */
+static bool
+json_hex4 (const char *  s, const char *  end, unsigned long *  res)
+{
+  *res = 0;
+  if (end - s < 4)
+    return false;
+
+  for (size_t i = 0; i < 4; i++)
+    {
+      char c = s[i];
+
+      *res <<= 4;
+      if (c >= '0' && c <= '9')
+        *res |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        *res |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        *res |= c - 'A' + 10;
+      else
+        return false;
+    }
+
+  return true;
+}
+
+
+/* Write the code point CP as UTF-8 at DST and return the position
+   after it.  */
+static char *
+json_put_utf8 (char *  dst, unsigned long cp)
+{
+  if (cp < 0x80)
+    *dst++ = cp;
+  else if (cp < 0x800)
+    {
+      *dst++ = 0xc0 | (cp >> 6);
+      *dst++ = 0x80 | (cp & 0x3f);
+    }
+  else if (cp < 0x10000)
+    {
+      *dst++ = 0xe0 | (cp >> 12);
+      *dst++ = 0x80 | ((cp >> 6) & 0x3f);
+      *dst++ = 0x80 | (cp & 0x3f);
+    }
+  else
+    {
+      *dst++ = 0xf0 | (cp >> 18);
+      *dst++ = 0x80 | ((cp >> 12) & 0x3f);
+      *dst++ = 0x80 | ((cp >> 6) & 0x3f);
+      *dst++ = 0x80 | (cp & 0x3f);
+    }
+
+  return dst;
+}
+
+
+/* Parse the string starting at the current position and unescape it
+   in place.  The closing quote is replaced with the terminating zero.
+   An escape sequence is never shorter than its expansion, so the
+   unescaped string never overtakes the parser.  */
+static char *
+json_parse_string (struct json_parser *  jp)
+{
+  char *  res = ++jp->p;
+  char *  dst = res;
+
+  while (jp->p < jp->end)
+    {
+      unsigned char c = *jp->p;
+      unsigned long cp, lo;
+
+      if (c == '"')
+        {
+          *dst = '\0';
+          jp->p++;
+          return res;
+        }
+      else if (c < 0x20)
+        {
+          json_error (jp, jp->p, "invalid character inside string");
+          return NULL;
+        }
+      else if (c != '\\')
+        {
+          *dst++ = *jp->p++;
+          continue;
+        }
+
+      if (jp->p + 1 >= jp->end)
+        break;
+
+      switch (jp->p[1])
+        {
+        case '"':
+        case '\\':
+        case '/':
+          *dst++ = jp->p[1];
+          break;
+        case 'b':
+          *dst++ = '\b';
+          break;
+        case 'f':
+          *dst++ = '\f';
+          break;
+        case 'n':
+          *dst++ = '\n';
+          break;
+        case 'r':
+          *dst++ = '\r';
+          break;
+        case 't':
+          *dst++ = '\t';
+          break;
+
+        case 'u':
+          if (!json_hex4 (jp->p + 2, jp->end, &cp))
+            {
+              json_error (jp, jp->p, "invalid \\u escape in string");
+              return NULL;
+            }
+
+          if (cp >= 0xd800 && cp < 0xdc00)
+            {
+              const char *  q = jp->p + 6;
+
+              if (jp->end - q < 6 || q[0] != '\\' || q[1] != 'u'
+                  || !json_hex4 (q + 2, jp->end, &lo)
+                  || lo < 0xdc00 || lo >= 0xe000)
+                {
+                  json_error (jp, jp->p, "invalid surrogate pair in string");
+                  return NULL;
+                }
+
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+              jp->p += 6;
+            }
+          else if (cp >= 0xdc00 && cp < 0xe000)
+            {
+              json_error (jp, jp->p, "invalid surrogate pair in string");
+              return NULL;
+            }
+
+          dst = json_put_utf8 (dst, cp);
+          jp->p += 6;
+          continue;
+
+        default:
+          json_error (jp, jp->p, "invalid escape in string");
+          return NULL;
+        }
+
+      jp->p += 2;
+    }
+
+  json_error (jp, jp->end, NULL);
+  return NULL;
+}
+
+
+/* Parse a number.  The text of the number is the only part of the file
+   that is copied, as it is not followed by a character that could be
+   overwritten with the terminating zero.  */
+static bool
+json_parse_number (struct json_parser *  jp, yajl_val v)
+{
+  const char *  s = jp->p;
+  const char *  q = s;
+  bool integer_p = true;
+  size_t len;
+  char *  r;
+
+  if (q < jp->end && *q == '-')
+    q++;
+
+  if (q < jp->end && *q == '0')
+    q++;
+  else if (json_digit_at (q, jp->end))
+    while (json_digit_at (q, jp->end))
+      q++;
+  else
+    return json_error (jp, q, "invalid number");
+
+  if (q < jp->end && *q == '.')
+    {
+      integer_p = false;
+      if (!json_digit_at (++q, jp->end))
+        return json_error (jp, q, "missing digits after the decimal point");
+      while (json_digit_at (q, jp->end))
+        q++;
+    }
+
+  if (q < jp->end && (*q == 'e' || *q == 'E'))
+    {
+      integer_p = false;
+      if (++q < jp->end && (*q == '+' || *q == '-'))
+        q++;
+      if (!json_digit_at (q, jp->end))
+        return json_error (jp, q, "missing digits in the exponent");
+      while (json_digit_at (q, jp->end))
+        q++;
+    }
+
+  len = q - s;
+  r = json_alloc (jp->doc, len + 1);
+  memcpy (r, s, len);
+  r[len] = '\0';
+
+  v->type = yajl_t_number;
+  v->u.number.r = r;
+  v->u.number.flags = 0;
+
+  if (integer_p)
+    {
+      errno = 0;
+      v->u.number.i = strtoll (r, NULL, 10);
+      if (errno == 0)
+        v->u.number.flags |= YAJL_NUMBER_INT_VALID;
+    }
+
+  errno = 0;
+  v->u.number.d = strtod (r, NULL);
+  if (errno == 0)
+    v->u.number.flags |= YAJL_NUMBER_DOUBLE_VALID;
+
+  jp->p += len;
+  return true;
+}
+
+
+static bool
+json_parse_literal (struct json_parser *  jp, yajl_val v, const char *  lit,
+                    yajl_type type)
+{
+  size_t len = strlen (lit);
+
+  if ((size_t) (jp->end - jp->p) < len || memcmp (jp->p, lit, len))
+    return json_error (jp, jp->p, "invalid literal");
+
+  v->type = type;
+  jp->p += len;
+  return true;
+}
+
+
+static bool json_parse_value (struct json_parser *  jp, yajl_val v);
+
+
+/* Parse an object when OBJECT_P is set or an array otherwise.  */
+static bool
+json_parse_container (struct json_parser *  jp, yajl_val v, bool object_p)
+{
+  const char close = object_p ? '}' : ']';
+  const size_t base = jp->top;
+  size_t len;
+
+  if (++jp->depth > JSON_MAX_DEPTH)
+    return json_error (jp, jp->p, "too deeply nested");
+
+  jp->p++;
+  json_skip_whitespace (jp);
+
+  if (json_at (jp, close))
+    jp->p++;
+  else
+    while (true)
+      {
+        const char *  key = NULL;
+        yajl_val item;
+
+        if (object_p)
+          {
+            if (!json_at (jp, '"'))
+              return json_error (jp, jp->p, "expected a string as an object key");
+
+            if (!(key = json_parse_string (jp)))
+              return false;
+
+            json_skip_whitespace (jp);
+            if (!json_at (jp, ':'))
+              return json_error (jp, jp->p, "expected `:' after an object key");
+
+            jp->p++;
+            json_skip_whitespace (jp);
+          }
+
+        item = json_alloc (jp->doc, sizeof (*item));
+        if (!json_parse_value (jp, item))
+          return false;
+
+        json_push (jp, key, item);
+        json_skip_whitespace (jp);
+
+        if (json_at (jp, ','))
+          {
+            jp->p++;
+            json_skip_whitespace (jp);
+          }
+        else if (json_at (jp, close))
+          {
+            jp->p++;
+            break;
+          }
+        else
+          return json_error (jp, jp->p, object_p
+                                        ? "expected `,' or `}' after an object value"
+                                        : "expected `,' or `]' after an array value");
+      }
+
+  len = jp->top - base;
+  if (object_p)
+    {
+      v->type = yajl_t_object;
+      v->u.object.len = len;
+      v->u.object.keys = NULL;
+      v->u.object.values = NULL;
+      if (len != 0)
+        {
+          v->u.object.keys = json_alloc (jp->doc, len * sizeof (*jp->keys));
+          v->u.object.values = json_alloc (jp->doc, len * sizeof (*jp->vals));
+          memcpy (v->u.object.keys, &jp->keys[base], len * sizeof (*jp->keys));
+          memcpy (v->u.object.values, &jp->vals[base], len * sizeof (*jp->vals));
+        }
+    }
+  else
+    {
+      v->type = yajl_t_array;
+      v->u.array.len = len;
+      v->u.array.values = NULL;
+      if (len != 0)
+        {
+          v->u.array.values = json_alloc (jp->doc, len * sizeof (*jp->vals));
+          memcpy (v->u.array.values, &jp->vals[base], len * sizeof (*jp->vals));
+        }
+    }
+
+  jp->top = base;
+  jp->depth--;
+  return true;
+}
+
+
+static bool
+json_parse_value (struct json_parser *  jp, yajl_val v)
+{
+  if (jp->p >= jp->end)
+    return json_error (jp, jp->p, NULL);
+
+  switch (*jp->p)
+    {
+    case '{':
+      return json_parse_container (jp, v, true);
+    case '[':
+      return json_parse_container (jp, v, false);
+    case '"':
+      v->type = yajl_t_string;
+      return NULL != (v->u.string = json_parse_string (jp));
+    case 't':
+      return json_parse_literal (jp, v, "true", yajl_t_true);
+    case 'f':
+      return json_parse_literal (jp, v, "false", yajl_t_false);
+    case 'n':
+      return json_parse_literal (jp, v, "null", yajl_t_null);
+    default:
+      if (*jp->p == '-' || json_digit_at (jp->p, jp->end))
+        return json_parse_number (jp, v);
+      return json_error (jp, jp->p, "unexpected character, expected a value");
+    }
+}
+
+
+yajl_val
+json_load (const char *  fname)
+{
+  struct json_parser jp = { .fname = fname, .line = 1 };
+  struct json_doc *  doc;
+  struct stat st;
+  bool ok;
+  int fd;
+
+  if (-1 == (fd = open (fname, O_RDONLY)))
+    {
+      ab_err ("failed to open `%s': %s", fname, strerror (errno));
+      return NULL;
+    }
+
+  if (0 != fstat (fd, &st))
+    err_func (fstat);
+
+  if (!(doc = calloc (1, sizeof (*doc))))
+    err_func (calloc);
+
+  /* The mapping is private and writable: strings are unescaped and
+     terminated in place, and the changes never reach the file.  */
+  doc->map_size = (size_t) st.st_size;
+  if (doc->map_size != 0)
+    {
+      doc->map = mmap (NULL, doc->map_size, PROT_READ | PROT_WRITE,
+                       JSON_MAP_FLAGS, fd, 0);
+      if (doc->map == MAP_FAILED)
+        {
+          ab_err ("failed to map `%s': %s", fname, strerror (errno));
+          close (fd);
+          free (doc);
+          return NULL;
+        }
+    }
+
+  close (fd);
+
+  jp.doc = doc;
+  jp.p = doc->map;
+  jp.end = doc->map + doc->map_size;
+  jp.line_start = doc->map;
+
+  json_skip_whitespace (&jp);
+  ok = json_parse_value (&jp, &doc->root);
+  if (ok)
+    {
+      json_skip_whitespace (&jp);
+      if (jp.p < jp.end)
+        ok = json_error (&jp, jp.p, "trailing garbage after the top-level value");
+    }
+
+  free (jp.keys);
+  free (jp.vals);
+
+  if (!ok)
+    {
+      json_free (&doc->root);
+      return NULL;
+    }
+
+  return &doc->root;
+}
+
+
+void
+json_free (yajl_val v)
+{
+  struct json_doc *  doc = (struct json_doc *) v;
+
+  if (!doc)
+    return;
+
+  if (doc->map && 0 != munmap (doc->map, doc->map_size))
+    err_func (munmap);
+
+  while (doc->blocks)
+    {
+      struct json_block *  b = doc->blocks;
+      doc->blocks = b->next;
+      free (b);
+    }
+
+  free (doc);
+}
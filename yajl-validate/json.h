@@ -0,0 +1,21 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <yajl/yajl_tree.h>
+
+
+/* Map the json file FNAME into memory and parse it in a single pass
+   into a yajl tree.  Strings and object keys of the tree point into
+   the private mapping of the file, where they are unescaped in place.
+   On error print the line and the column of the problem and return
+   NULL.  */
+yajl_val json_load (const char *  fname);
+
+
+/* Free the tree V obtained from JSON_LOAD together with the mapping
+   of its file.  V can be NULL.  The tree must not be freed with
+   YAJL_TREE_FREE.  */
+void json_free (yajl_val v);
+
+
+#endif // __JSON_H__
@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+
+#include <sys/types.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "json.h"
+#include "layout.h"
+
+
+/* The size of the cache line used in the report.  */
+#define CACHE_LINE 64
+
+
+/* An attribute with less accesses than this percentage of the accesses
+   to the most used attribute of its node is cold.  */
+#define COLD_PERCENT 1
+
+
+/* Standard C types that may appear in `ctype' with their size and
+   alignment on the host.  */
+#define C_TYPE(__t) { #__t, sizeof (__t), __alignof__ (__t) }
+static const struct
+{
+  const char *  name;
+  size_t size;
+  size_t align;
+} c_types[] = {
+  C_TYPE (bool),
+  C_TYPE (char),
+  C_TYPE (signed char),
+  C_TYPE (unsigned char),
+  C_TYPE (short),
+  C_TYPE (unsigned short),
+  C_TYPE (int),
+  C_TYPE (unsigned int),
+  C_TYPE (unsigned),
+  C_TYPE (long),
+  C_TYPE (unsigned long),
+  C_TYPE (long long),
+  C_TYPE (unsigned long long),
+  C_TYPE (float),
+  C_TYPE (double),
+  C_TYPE (long double),
+  C_TYPE (size_t),
+};
+#undef C_TYPE
+
+
+/* Find the size and the alignment of the attribute type ATN.  Types that
+   are neither described in `attrtypes.json' nor known here are most
+   likely enums or typedefs of pointers, so they are estimated as
+   pointers.  Estimates only make the order less compact: the C compiler
+   still lays out the structure correctly.  */
+static void
+attrtype_layout (const struct attrtype_name *  atn, struct layout_field *  lf)
+{
+  const char *  ctype = atn->ctype;
+  size_t len;
+
+  lf->estimated_p = false;
+
+  if (atn->size)
+    {
+      lf->size = atn->size;
+      lf->align = atn->align;
+      return;
+    }
+
+  lf->size = sizeof (void *);
+  lf->align = __alignof__ (void *);
+
+  if (strchr (ctype, '*'))
+    return;
+
+  while (*ctype == ' ')
+    ctype++;
+
+  len = strlen (ctype);
+  while (len > 0 && ctype[len - 1] == ' ')
+    len--;
+
+  for (size_t i = 0; i < sizeof (c_types) / sizeof (c_types[0]); i++)
+    if (strlen (c_types[i].name) == len && !strncmp (c_types[i].name, ctype, len))
+      {
+        lf->size = c_types[i].size;
+        lf->align = c_types[i].align;
+        return;
+      }
+
+  lf->estimated_p = true;
+}
+
+
+void
+layout_node (const struct model_node *  node, bool reorder_p,
+             enum layout_part part, struct layout *  l)
+{
+  size_t n = 0;
+
+  for (size_t i = 0; i < node->n_attributes; i++)
+    n += part == lp_all || node->attributes[i].cold == (part == lp_cold);
+
+  if (part != lp_cold)
+    n += node->n_flags != 0;
+
+  if (part == lp_node)
+    n += node->n_cold_attributes != 0;
+
+  l->fields = calloc (n ? n : 1, sizeof (*l->fields));
+  if (!l->fields)
+    err_func (calloc);
+
+  l->n_fields = n;
+  l->size = 0;
+  l->align = 1;
+  l->padding = 0;
+  l->estimated_p = false;
+
+  n = 0;
+  for (size_t i = 0; i < node->n_attributes; i++)
+    if (part == lp_all || node->attributes[i].cold == (part == lp_cold))
+      {
+        l->fields[n].kind = lf_attribute;
+        l->fields[n].attribute = &node->attributes[i];
+        attrtype_layout (node->attributes[i].type, &l->fields[n]);
+        n++;
+      }
+
+  /* The flags are `unsigned int' bit-fields of one bit.  */
+  if (part != lp_cold && node->n_flags != 0)
+    {
+      struct layout_field *  lf = &l->fields[n++];
+      size_t bits = sizeof (unsigned int) * 8;
+
+      lf->kind = lf_flags;
+      lf->size = (node->n_flags + bits - 1) / bits * sizeof (unsigned int);
+      lf->align = __alignof__ (unsigned int);
+    }
+
+  if (part == lp_node && node->n_cold_attributes != 0)
+    {
+      struct layout_field *  lf = &l->fields[n++];
+
+      lf->kind = lf_cold;
+      lf->size = sizeof (void *);
+      lf->align = __alignof__ (void *);
+    }
+
+  /* A stable insertion sort, so fields of the same alignment keep their
+     order in the json file.  */
+  if (reorder_p)
+    for (size_t i = 1; i < n; i++)
+      {
+        struct layout_field x = l->fields[i];
+        size_t j = i;
+
+        for (; j > 0 && l->fields[j - 1].align < x.align; j--)
+          l->fields[j] = l->fields[j - 1];
+
+        l->fields[j] = x;
+      }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      struct layout_field *  lf = &l->fields[i];
+      size_t offset = (l->size + lf->align - 1) / lf->align * lf->align;
+
+      l->padding += offset - l->size;
+      lf->offset = offset;
+      l->size = offset + lf->size;
+      if (lf->align > l->align)
+        l->align = lf->align;
+      l->estimated_p |= lf->estimated_p;
+    }
+
+  /* The tail padding.  */
+  if (l->size % l->align)
+    {
+      l->padding += l->align - l->size % l->align;
+      l->size += l->align - l->size % l->align;
+    }
+}
+
+
+void
+layout_free (struct layout *  l)
+{
+  free (l->fields);
+  l->fields = NULL;
+  l->n_fields = 0;
+}
+
+
+bool
+layout_report (const struct model *  m, const char *  fname)
+{
+  FILE *  f = fopen (fname, "w");
+  size_t total_size = 0, total_padding = 0;
+  size_t total_json_size = 0, total_json_padding = 0;
+
+  if (!f)
+    {
+      ab_err ("failed to open file `%s' for writing: %s", fname, strerror (errno));
+      return false;
+    }
+
+  fprintf (f, "# The layout of the ATTRIBS_N_* structures.  Sizes are in bytes;\n"
+              "# `cold' is the size of the block of cold attributes, `json'\n"
+              "# columns are for all attributes in the order of ast.json, `~'\n"
+              "# marks sizes based on estimated types.\n"
+              "%-28s %6s %6s %8s %6s %6s %10s %12s\n",
+              "node", "fields", "size", "padding", "lines", "cold", "json size",
+              "json padding");
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+      struct layout l, cold, json;
+
+      if (node->n_attributes == 0 && node->n_flags == 0)
+        continue;
+
+      layout_node (node, node->reorder, lp_node, &l);
+      layout_node (node, node->reorder, lp_cold, &cold);
+      layout_node (node, false, lp_all, &json);
+
+      fprintf (f, "%-28s %6zu %5zu%c %8zu %6zu %6zu %10zu %12zu%s\n",
+               node->name->name, l.n_fields, l.size, l.estimated_p ? '~' : ' ',
+               l.padding, (l.size + CACHE_LINE - 1) / CACHE_LINE, cold.size,
+               json.size, json.padding, node->reorder ? "" : "  (not reordered)");
+
+      total_size += l.size;
+      total_padding += l.padding;
+      total_json_size += json.size;
+      total_json_padding += json.padding;
+
+      layout_free (&l);
+      layout_free (&cold);
+      layout_free (&json);
+    }
+
+  fprintf (f, "%-28s %6s %6zu %8zu %6s %6s %10zu %12zu\n",
+           "total", "", total_size, total_padding, "", "", total_json_size,
+           total_json_padding);
+
+  if (0 != fclose (f))
+    {
+      ab_err ("failed to write `%s': %s", fname, strerror (errno));
+      return false;
+    }
+
+  return true;
+}
+
+
+/* The number of accesses to the attribute NAME in the profile P of a node,
+   or -1 when the profile is malformed.  */
+static long long
+profile_count (yajl_val p, const char *  node_name, const char *  name)
+{
+  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (p); i++)
+    if (!strcmp (YAJL_OBJECT_KEYS (p)[i], name))
+      {
+        yajl_val v = YAJL_OBJECT_VALUES (p)[i];
+
+        if (!YAJL_IS_INTEGER (v) || YAJL_GET_INTEGER (v) < 0)
+          {
+            ab_err ("the count of `%s' of node `%s' in the profile must be "
+                    "a non-negative integer", name, node_name);
+            return -1;
+          }
+
+        return YAJL_GET_INTEGER (v);
+      }
+
+  return 0;
+}
+
+
+/* Mark the attributes of NODE with less than COLD_PERCENT of the accesses
+   of its most used attribute as cold.  Then, while the attributes kept in
+   the node do not fit into a cache line, move the least used one out.
+   Attributes marked as hot in ast.json always stay.  */
+static bool
+profile_node (struct model_node *  node, yajl_val p)
+{
+  long long counts[node->n_attributes + 1];
+  long long max = 0;
+
+  if (!YAJL_IS_OBJECT (p))
+    {
+      ab_err ("the profile of node `%s' must be an object", node->name->name);
+      return false;
+    }
+
+  for (size_t i = 0; i < node->n_attributes; i++)
+    {
+      counts[i] = profile_count (p, node->name->name,
+                                 node->attributes[i].name->name);
+      if (counts[i] < 0)
+        return false;
+      if (counts[i] > max)
+        max = counts[i];
+    }
+
+  for (size_t i = 0; i < node->n_attributes; i++)
+    {
+      struct model_attribute *  a = &node->attributes[i];
+
+      if (!a->hot && !a->cold && counts[i] * 100 < max * COLD_PERCENT)
+        {
+          a->cold = true;
+          node->n_cold_attributes++;
+        }
+    }
+
+  while (true)
+    {
+      struct layout l;
+      size_t size;
+      ssize_t coldest = -1;
+
+      layout_node (node, node->reorder, lp_node, &l);
+      size = l.size;
+      layout_free (&l);
+
+      if (size <= CACHE_LINE)
+        break;
+
+      for (size_t i = 0; i < node->n_attributes; i++)
+        if (!node->attributes[i].hot && !node->attributes[i].cold
+            && (coldest < 0 || counts[i] <= counts[coldest]))
+          coldest = i;
+
+      if (coldest < 0)
+        break;
+
+      node->attributes[coldest].cold = true;
+      node->n_cold_attributes++;
+    }
+
+  return true;
+}
+
+
+bool
+layout_apply_profile (struct model *  m, const char *  fname)
+{
+  yajl_val profile = json_load (fname);
+  bool ok = true;
+
+  if (!profile)
+    return false;
+
+  if (!YAJL_IS_OBJECT (profile))
+    {
+      ab_err ("top-level node of `%s' must be an object", fname);
+      json_free (profile);
+      return false;
+    }
+
+  /* The dump of AST_PROFILE_ACCESS keeps the counts of all phases
+     together in `total'.  */
+  yajl_val nodes = yajl_tree_get (profile, (const char *[]){"total", 0}, yajl_t_object);
+  if (!nodes)
+    nodes = profile;
+
+  for (size_t i = 0; ok && i < YAJL_OBJECT_LENGTH (nodes); i++)
+    {
+      const char *  name = YAJL_OBJECT_KEYS (nodes)[i];
+      size_t j;
+
+      for (j = 0; j < m->n_nodes; j++)
+        if (!strcmp (m->nodes[j].name->name, name))
+          break;
+
+      /* A profile may be older than the model.  */
+      if (j == m->n_nodes)
+        {
+          ab_warn ("the node `%s' of the profile `%s' does not exist", name, fname);
+          continue;
+        }
+
+      ok = profile_node (&m->nodes[j], YAJL_OBJECT_VALUES (nodes)[i]);
+    }
+
+  json_free (profile);
+  return ok;
+}
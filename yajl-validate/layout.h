@@ -0,0 +1,91 @@
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "model.h"
+
+
+/* The name of the member of ATTRIBS_N_<node-name> that points to the
+   cold attributes of the node.  */
+#define LAYOUT_COLD_MEMBER "ColdAttribs"
+
+
+/* A member of the ATTRIBS_N_<node-name> structure: an attribute, the
+   structure of all the flags of the node or the pointer to its cold
+   attributes.  */
+enum layout_field_kind
+{
+  lf_attribute,
+  lf_flags,
+  lf_cold
+};
+
+
+struct layout_field
+{
+  enum layout_field_kind kind;
+  /* The attribute for LF_ATTRIBUTE fields.  */
+  const struct model_attribute *  attribute;
+  size_t size;
+  size_t align;
+  size_t offset;
+
+  /* Set when the size of the type is not given in `attrtypes.json' and
+     is not the one of a pointer or of a standard C type.  */
+  bool estimated_p;
+};
+
+
+/* The layout of the ATTRIBS_N_<node-name> structure as a C compiler
+   would lay it out on the host.  */
+struct layout
+{
+  struct layout_field *  fields;
+  size_t n_fields;
+  size_t size;
+  size_t align;
+
+  /* The bytes between the fields and after the last one.  */
+  size_t padding;
+  bool estimated_p;
+};
+
+
+/* The parts of the attributes of a node that can be laid out.  */
+enum layout_part
+{
+  /* The attributes kept in the node, the flags and the pointer to the
+     cold attributes if there are any.  */
+  lp_node,
+  /* The cold attributes.  */
+  lp_cold,
+  /* All the attributes and the flags, as if none of them was cold.  */
+  lp_all
+};
+
+
+/* Lay out the part PART of the attributes and flags of NODE into L.
+   When REORDER_P is set, the fields are sorted by decreasing alignment,
+   which leaves no padding between them; otherwise they are kept in the
+   order of the json file with the flags and the pointer to the cold
+   attributes at the end.  */
+void layout_node (const struct model_node *  node, bool reorder_p,
+                  enum layout_part part, struct layout *  l);
+
+void layout_free (struct layout *  l);
+
+
+/* Write the size, the padding and the number of cache lines of the
+   attribute structure of every node of M into FNAME.  */
+bool layout_report (const struct model *  m, const char *  fname);
+
+
+/* Mark attributes of M as cold according to the access profile FNAME,
+   a json object that maps node names to objects mapping attribute names
+   to the number of accesses.  */
+bool layout_apply_profile (struct model *  m, const char *  fname);
+
+
+#endif // __LAYOUT_H__
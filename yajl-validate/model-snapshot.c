@@ -0,0 +1,646 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "model.h"
+
+
+/* The snapshot is a copy of the model in a single block: the header is
+   followed by the arrays and the strings of the model.  Every pointer
+   of the block holds an offset from the beginning of the block.  The
+   offset 0 is the header, so it stands for NULL.  After the block is
+   mapped, the offsets are turned back into pointers in one walk over
+   the model.  */
+
+#define SNAPSHOT_MAGIC "ABMODEL"
+
+/* The version of the layout of the snapshot itself.  */
+#define SNAPSHOT_FORMAT 1
+
+
+struct snapshot_header
+{
+  char magic[8];
+  uint64_t key;
+  uint64_t size;
+  struct model model;
+
+  /* The interned names and the attribute types are shared by many
+     items, so they are stored once in these arrays.  */
+  struct model_name *  names;
+  size_t n_names;
+  struct attrtype_name *  attrtypes;
+};
+
+
+/* A map from the objects of the model that are referenced from many
+   places to their offsets in the snapshot.  */
+struct snapshot_ref
+{
+  const void *  key;
+  size_t off;
+  UT_hash_handle hh;
+};
+
+struct snapshot_writer
+{
+  const struct model *  m;
+  char *  data;
+  size_t size;
+  size_t cap;
+
+  struct snapshot_ref *  ptrs;
+  struct snapshot_ref *  strings;
+
+  size_t nodes;
+  size_t nodesets;
+};
+
+
+#define SNAPSHOT_OFF(off) ((void *) (uintptr_t) (off))
+
+
+/* Allocate SIZE zeroed bytes aligned to ALIGN in the snapshot and
+   return their offset.  The data of the writer can move, so the
+   result should not be kept as a pointer.  */
+static size_t
+snapshot_alloc (struct snapshot_writer *  w, size_t size, size_t align)
+{
+  size_t off = (w->size + align - 1) / align * align;
+
+  if (off + size > w->cap)
+    {
+      while (off + size > w->cap)
+        w->cap = w->cap ? 2 * w->cap : 65536;
+
+      if (!(w->data = realloc (w->data, w->cap)))
+        err_func (realloc);
+    }
+
+  memset (w->data + w->size, 0, off + size - w->size);
+  w->size = off + size;
+  return off;
+}
+
+
+static inline size_t
+snapshot_array (struct snapshot_writer *  w, size_t n, size_t size)
+{
+  return n ? snapshot_alloc (w, n * size, sizeof (void *)) : 0;
+}
+
+
+static inline void
+snapshot_put (struct snapshot_writer *  w, size_t off, const void *  item,
+              size_t size)
+{
+  memcpy (w->data + off, item, size);
+}
+
+
+static void *
+snapshot_string (struct snapshot_writer *  w, const char *  s)
+{
+  struct snapshot_ref *  ref;
+  size_t len;
+
+  if (!s)
+    return NULL;
+
+  len = strlen (s);
+  HASH_FIND (hh, w->strings, s, len, ref);
+  if (!ref)
+    {
+      ref = malloc (sizeof (*ref));
+      ref->key = s;
+      ref->off = snapshot_alloc (w, len + 1, 1);
+      memcpy (w->data + ref->off, s, len + 1);
+      HASH_ADD_KEYPTR (hh, w->strings, s, len, ref);
+    }
+
+  return SNAPSHOT_OFF (ref->off);
+}
+
+
+static void
+snapshot_add_ref (struct snapshot_writer *  w, const void *  p, size_t off)
+{
+  struct snapshot_ref *  ref = malloc (sizeof (*ref));
+
+  ref->key = p;
+  ref->off = off;
+  HASH_ADD_PTR (w->ptrs, key, ref);
+}
+
+
+static void *
+snapshot_ref (struct snapshot_writer *  w, const void *  p)
+{
+  struct snapshot_ref *  ref;
+
+  if (!p)
+    return NULL;
+
+  HASH_FIND_PTR (w->ptrs, &p, ref);
+  assert (ref);
+  return SNAPSHOT_OFF (ref->off);
+}
+
+
+static void
+snapshot_free_refs (struct snapshot_ref **  refs)
+{
+  struct snapshot_ref *  ref;
+  struct snapshot_ref *  tmp;
+
+  HASH_ITER (hh, *refs, ref, tmp)
+    {
+      HASH_DEL (*refs, ref);
+      free (ref);
+    }
+}
+
+
+static void *
+snapshot_targets (struct snapshot_writer *  w, const struct model_target *  targets,
+                  size_t n)
+{
+  size_t off = snapshot_array (w, n, sizeof (*targets));
+
+  for (size_t i = 0; i < n; i++)
+    {
+      struct model_target t = targets[i];
+      size_t phases = snapshot_array (w, t.n_phases, sizeof (*t.phases));
+      size_t contains = snapshot_array (w, t.n_contains, sizeof (*t.contains));
+
+      for (size_t j = 0; j < t.n_phases; j++)
+        {
+          struct model_phase p = {
+            .phase = snapshot_string (w, t.phases[j].phase),
+            .from = snapshot_string (w, t.phases[j].from),
+            .to = snapshot_string (w, t.phases[j].to)
+          };
+          snapshot_put (w, phases + j * sizeof (p), &p, sizeof (p));
+        }
+
+      for (size_t j = 0; j < t.n_contains; j++)
+        {
+          const struct model_contains *  x = &t.contains[j];
+          struct model_contains c = {
+            .name = snapshot_string (w, x->name),
+            .node = x->node
+                    ? SNAPSHOT_OFF (w->nodes + (x->node - w->m->nodes) * sizeof (*x->node))
+                    : NULL,
+            .nodeset = x->nodeset
+                       ? SNAPSHOT_OFF (w->nodesets
+                                       + (x->nodeset - w->m->nodesets) * sizeof (*x->nodeset))
+                       : NULL
+          };
+          snapshot_put (w, contains + j * sizeof (c), &c, sizeof (c));
+        }
+
+      t.phases = SNAPSHOT_OFF (phases);
+      t.contains = SNAPSHOT_OFF (contains);
+      snapshot_put (w, off + i * sizeof (t), &t, sizeof (t));
+    }
+
+  return SNAPSHOT_OFF (off);
+}
+
+
+static void
+snapshot_node (struct snapshot_writer *  w, const struct model_node *  node,
+               size_t node_off)
+{
+  struct model_node n = *node;
+  size_t sons = snapshot_array (w, n.n_sons, sizeof (*n.sons));
+  size_t attributes = snapshot_array (w, n.n_attributes, sizeof (*n.attributes));
+  size_t flags = snapshot_array (w, n.n_flags, sizeof (*n.flags));
+  size_t checks = snapshot_array (w, n.n_checks, sizeof (*n.checks));
+
+  for (size_t i = 0; i < n.n_sons; i++)
+    {
+      struct model_son s = n.sons[i];
+
+      s.name = snapshot_ref (w, s.name);
+      s.def = snapshot_string (w, s.def);
+      s.targets = snapshot_targets (w, s.targets, s.n_targets);
+      snapshot_put (w, sons + i * sizeof (s), &s, sizeof (s));
+    }
+
+  for (size_t i = 0; i < n.n_attributes; i++)
+    {
+      struct model_attribute a = n.attributes[i];
+
+      a.name = snapshot_ref (w, a.name);
+      a.type = snapshot_ref (w, a.type);
+      a.def = snapshot_string (w, a.def);
+      a.targets = snapshot_targets (w, a.targets, a.n_targets);
+      snapshot_put (w, attributes + i * sizeof (a), &a, sizeof (a));
+    }
+
+  for (size_t i = 0; i < n.n_flags; i++)
+    {
+      struct model_flag f = n.flags[i];
+
+      f.name = snapshot_ref (w, f.name);
+      f.def = snapshot_string (w, f.def);
+      snapshot_put (w, flags + i * sizeof (f), &f, sizeof (f));
+    }
+
+  for (size_t i = 0; i < n.n_checks; i++)
+    {
+      const char *  c = snapshot_string (w, n.checks[i]);
+      snapshot_put (w, checks + i * sizeof (c), &c, sizeof (c));
+    }
+
+  n.name = snapshot_ref (w, n.name);
+  n.next = n.next ? SNAPSHOT_OFF (sons + (n.next - n.sons) * sizeof (*n.next)) : NULL;
+  n.sons = SNAPSHOT_OFF (sons);
+  n.attributes = SNAPSHOT_OFF (attributes);
+  n.flags = SNAPSHOT_OFF (flags);
+  n.checks = SNAPSHOT_OFF (checks);
+  snapshot_put (w, node_off, &n, sizeof (n));
+}
+
+
+bool
+model_snapshot_save (const struct model *  m, const char *  fname, uint64_t key)
+{
+  struct snapshot_writer w = { .m = m };
+  struct snapshot_header h = { .magic = SNAPSHOT_MAGIC, .key = key };
+  struct model_name *  mn;
+  bool ret;
+
+  snapshot_alloc (&w, sizeof (h), sizeof (void *));
+
+  h.n_names = HASH_COUNT (m->names);
+  size_t names = snapshot_array (&w, h.n_names, sizeof (*mn));
+  size_t i = 0;
+
+  for (mn = m->names; mn; mn = mn->hh.next, i++)
+    {
+      struct model_name n = {
+        .name = snapshot_string (&w, mn->name),
+        .lower = snapshot_string (&w, mn->lower),
+        .upper = snapshot_string (&w, mn->upper),
+        .capital = snapshot_string (&w, mn->capital)
+      };
+      snapshot_put (&w, names + i * sizeof (n), &n, sizeof (n));
+      snapshot_add_ref (&w, mn, names + i * sizeof (n));
+    }
+
+  size_t attrtypes = snapshot_array (&w, m->n_attrtypes, sizeof (struct attrtype_name));
+  size_t attrtype_ptrs = snapshot_array (&w, m->n_attrtypes, sizeof (*m->attrtypes));
+
+  for (i = 0; i < m->n_attrtypes; i++)
+    {
+      struct attrtype_name a = *m->attrtypes[i];
+      size_t off = attrtypes + i * sizeof (a);
+      void *  p = SNAPSHOT_OFF (off);
+
+      memset (&a.hh, 0, sizeof (a.hh));
+      a.name = snapshot_string (&w, a.name);
+      a.ctype = snapshot_string (&w, a.ctype);
+      a.vtype = snapshot_string (&w, a.vtype);
+      a.init = snapshot_string (&w, a.init);
+      snapshot_put (&w, off, &a, sizeof (a));
+      snapshot_put (&w, attrtype_ptrs + i * sizeof (p), &p, sizeof (p));
+      snapshot_add_ref (&w, m->attrtypes[i], off);
+    }
+
+  w.nodes = snapshot_array (&w, m->n_nodes, sizeof (*m->nodes));
+  w.nodesets = snapshot_array (&w, m->n_nodesets, sizeof (*m->nodesets));
+  size_t traversals = snapshot_array (&w, m->n_traversals, sizeof (*m->traversals));
+
+  for (i = 0; i < m->n_nodes; i++)
+    snapshot_node (&w, &m->nodes[i], w.nodes + i * sizeof (*m->nodes));
+
+  for (i = 0; i < m->n_nodesets; i++)
+    {
+      struct model_nodeset s = m->nodesets[i];
+      size_t nodes = snapshot_array (&w, s.n_nodes, sizeof (*s.nodes));
+
+      for (size_t j = 0; j < s.n_nodes; j++)
+        {
+          void *  p = SNAPSHOT_OFF (w.nodes + (s.nodes[j] - m->nodes) * sizeof (*m->nodes));
+          snapshot_put (&w, nodes + j * sizeof (p), &p, sizeof (p));
+        }
+
+      s.name = snapshot_ref (&w, s.name);
+      s.nodes = SNAPSHOT_OFF (nodes);
+      snapshot_put (&w, w.nodesets + i * sizeof (s), &s, sizeof (s));
+    }
+
+  for (i = 0; i < m->n_traversals; i++)
+    {
+      struct model_traversal t = m->traversals[i];
+      size_t node_types = snapshot_array (&w, m->n_nodes, sizeof (*t.node_types));
+
+      if (m->n_nodes)
+        snapshot_put (&w, node_types, t.node_types, m->n_nodes * sizeof (*t.node_types));
+
+      t.name = snapshot_ref (&w, t.name);
+      t.include = snapshot_string (&w, t.include);
+      t.ifndef = snapshot_string (&w, t.ifndef);
+      t.prefun = snapshot_string (&w, t.prefun);
+      t.postfun = snapshot_string (&w, t.postfun);
+      t.def = snapshot_string (&w, t.def);
+      t.node_types = SNAPSHOT_OFF (node_types);
+      snapshot_put (&w, traversals + i * sizeof (t), &t, sizeof (t));
+    }
+
+  h.model.nodes = SNAPSHOT_OFF (w.nodes);
+  h.model.n_nodes = m->n_nodes;
+  h.model.nodesets = SNAPSHOT_OFF (w.nodesets);
+  h.model.n_nodesets = m->n_nodesets;
+  h.model.traversals = SNAPSHOT_OFF (traversals);
+  h.model.n_traversals = m->n_traversals;
+  h.model.attrtypes = SNAPSHOT_OFF (attrtype_ptrs);
+  h.model.n_attrtypes = m->n_attrtypes;
+  h.names = SNAPSHOT_OFF (names);
+  h.attrtypes = SNAPSHOT_OFF (attrtypes);
+  h.size = w.size;
+  snapshot_put (&w, 0, &h, sizeof (h));
+
+  ret = replace_file (fname, w.data, w.size);
+
+  snapshot_free_refs (&w.ptrs);
+  snapshot_free_refs (&w.strings);
+  free (w.data);
+  return ret;
+}
+
+
+/* Turn the offset stored in the pointer P into a pointer into the
+   block BASE.  */
+#define RELOC(p) \
+  ((p) = (void *) ((p) ? base + (uintptr_t) (p) : NULL))
+
+
+static void
+snapshot_reloc_targets (char *  base, struct model_target *  targets, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+      struct model_target *  t = &targets[i];
+
+      RELOC (t->phases);
+      for (size_t j = 0; j < t->n_phases; j++)
+        {
+          RELOC (t->phases[j].phase);
+          RELOC (t->phases[j].from);
+          RELOC (t->phases[j].to);
+        }
+
+      RELOC (t->contains);
+      for (size_t j = 0; j < t->n_contains; j++)
+        {
+          RELOC (t->contains[j].name);
+          RELOC (t->contains[j].node);
+          RELOC (t->contains[j].nodeset);
+        }
+    }
+}
+
+
+static void
+snapshot_reloc_node (char *  base, struct model_node *  n)
+{
+  RELOC (n->name);
+  RELOC (n->next);
+
+  RELOC (n->sons);
+  for (size_t i = 0; i < n->n_sons; i++)
+    {
+      RELOC (n->sons[i].name);
+      RELOC (n->sons[i].def);
+      RELOC (n->sons[i].targets);
+      snapshot_reloc_targets (base, n->sons[i].targets, n->sons[i].n_targets);
+    }
+
+  RELOC (n->attributes);
+  for (size_t i = 0; i < n->n_attributes; i++)
+    {
+      RELOC (n->attributes[i].name);
+      RELOC (n->attributes[i].type);
+      RELOC (n->attributes[i].def);
+      RELOC (n->attributes[i].targets);
+      snapshot_reloc_targets (base, n->attributes[i].targets,
+                              n->attributes[i].n_targets);
+    }
+
+  RELOC (n->flags);
+  for (size_t i = 0; i < n->n_flags; i++)
+    {
+      RELOC (n->flags[i].name);
+      RELOC (n->flags[i].def);
+    }
+
+  RELOC (n->checks);
+  for (size_t i = 0; i < n->n_checks; i++)
+    RELOC (n->checks[i]);
+}
+
+
+bool
+model_snapshot_load (struct model *  m, const char *  fname, uint64_t key)
+{
+  struct snapshot_header *  h;
+  struct model *  sm;
+  struct stat st;
+  char *  base;
+  int fd;
+
+  if (-1 == (fd = open (fname, O_RDONLY)))
+    return false;
+
+  if (0 != fstat (fd, &st))
+    err_func (fstat);
+
+  if ((size_t) st.st_size < sizeof (*h))
+    {
+      close (fd);
+      return false;
+    }
+
+  /* The mapping is private, so the relocation does not change the
+     file.  */
+  base = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (base == MAP_FAILED)
+    return false;
+
+  h = (struct snapshot_header *) base;
+  if (memcmp (h->magic, SNAPSHOT_MAGIC, sizeof (h->magic))
+      || h->key != key || h->size != (uint64_t) st.st_size)
+    {
+      munmap (base, st.st_size);
+      return false;
+    }
+
+  RELOC (h->names);
+  for (size_t i = 0; i < h->n_names; i++)
+    {
+      RELOC (h->names[i].name);
+      RELOC (h->names[i].lower);
+      RELOC (h->names[i].upper);
+      RELOC (h->names[i].capital);
+    }
+
+  sm = &h->model;
+
+  RELOC (h->attrtypes);
+  RELOC (sm->attrtypes);
+  for (size_t i = 0; i < sm->n_attrtypes; i++)
+    {
+      RELOC (h->attrtypes[i].name);
+      RELOC (h->attrtypes[i].ctype);
+      RELOC (h->attrtypes[i].vtype);
+      RELOC (h->attrtypes[i].init);
+      RELOC (sm->attrtypes[i]);
+    }
+
+  RELOC (sm->nodes);
+  for (size_t i = 0; i < sm->n_nodes; i++)
+    snapshot_reloc_node (base, &sm->nodes[i]);
+
+  RELOC (sm->nodesets);
+  for (size_t i = 0; i < sm->n_nodesets; i++)
+    {
+      RELOC (sm->nodesets[i].name);
+      RELOC (sm->nodesets[i].nodes);
+      for (size_t j = 0; j < sm->nodesets[i].n_nodes; j++)
+        RELOC (sm->nodesets[i].nodes[j]);
+    }
+
+  RELOC (sm->traversals);
+  for (size_t i = 0; i < sm->n_traversals; i++)
+    {
+      struct model_traversal *  t = &sm->traversals[i];
+
+      RELOC (t->name);
+      RELOC (t->include);
+      RELOC (t->ifndef);
+      RELOC (t->prefun);
+      RELOC (t->postfun);
+      RELOC (t->def);
+      RELOC (t->node_types);
+    }
+
+  *m = *sm;
+  m->snapshot = base;
+  m->snapshot_size = st.st_size;
+  return true;
+}
+
+
+uint64_t
+model_hash (uint64_t h, const void *  data, size_t size)
+{
+  const unsigned char *  p = data;
+
+  for (size_t i = 0; i < size; i++)
+    {
+      h ^= p[i];
+      h *= UINT64_C (0x100000001b3);
+    }
+
+  return h;
+}
+
+
+const char *
+tool_version ()
+{
+  static char version[sizeof (AST_BUILDER_VERSION) + 17];
+  uint64_t h = MODEL_HASH_INIT;
+  char buf[65536];
+  ssize_t len;
+  int fd;
+
+  if (version[0])
+    return version;
+
+  /* Without /proc only the version number is used.  */
+  if (-1 != (fd = open ("/proc/self/exe", O_RDONLY)))
+    {
+      while ((len = read (fd, buf, sizeof (buf))) > 0)
+        h = model_hash (h, buf, len);
+      close (fd);
+    }
+
+  snprintf (version, sizeof (version), "%s-%016" PRIx64, AST_BUILDER_VERSION, h);
+  return version;
+}
+
+
+bool
+model_snapshot_key (const char *const *  fnames, size_t n, uint64_t *  key)
+{
+  /* Snapshots are only valid for the same tool and the same layout
+     of the model.  */
+  const size_t layout[] = {
+    SNAPSHOT_FORMAT, sizeof (void *), sizeof (struct snapshot_header),
+    sizeof (struct model), sizeof (struct model_name),
+    sizeof (struct model_phase), sizeof (struct model_contains),
+    sizeof (struct model_target), sizeof (struct model_son),
+    sizeof (struct model_attribute), sizeof (struct model_flag),
+    sizeof (struct model_node), sizeof (struct model_nodeset),
+    sizeof (struct model_traversal), sizeof (struct attrtype_name)
+  };
+  uint64_t h = MODEL_HASH_INIT;
+
+  h = model_hash (h, tool_version (), strlen (tool_version ()));
+  h = model_hash (h, layout, sizeof (layout));
+
+  for (size_t i = 0; i < n; i++)
+    {
+      struct stat st;
+      uint64_t size;
+      void *  p;
+      int fd;
+
+      if (-1 == (fd = open (fnames[i], O_RDONLY)))
+        return false;
+
+      if (0 != fstat (fd, &st))
+        err_func (fstat);
+
+      size = st.st_size;
+      h = model_hash (h, &size, sizeof (size));
+      if (size != 0)
+        {
+          p = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (p == MAP_FAILED)
+            {
+              close (fd);
+              return false;
+            }
+
+          h = model_hash (h, p, size);
+          munmap (p, size);
+        }
+
+      close (fd);
+    }
+
+  *key = h;
+  return true;
+}
@@ -0,0 +1,488 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <err.h>
+
+#include <sys/mman.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "model.h"
+
+
+/* A temporary map from node and nodeset names to the model objects,
+   used to resolve `contains' lists.  */
+struct model_ref
+{
+  const char *  name;
+  const struct model_node *  node;
+  const struct model_nodeset *  nodeset;
+  UT_hash_handle hh;
+};
+
+
+static inline yajl_val
+get (yajl_val v, const char *  key, yajl_type type)
+{
+  return v ? yajl_tree_get (v, (const char *[]){key, 0}, type) : NULL;
+}
+
+static inline size_t
+object_length (yajl_val v)
+{
+  return v ? YAJL_OBJECT_LENGTH (v) : 0;
+}
+
+static inline size_t
+array_length (yajl_val v)
+{
+  return v ? YAJL_ARRAY_LENGTH (v) : 0;
+}
+
+static void *
+xcalloc (size_t n, size_t size)
+{
+  void *  p = calloc (n ? n : 1, size);
+
+  if (!p)
+    err_func (calloc);
+
+  return p;
+}
+
+
+/* Return the interned spellings of NAME.  */
+static const struct model_name *
+intern_name (struct model *  m, const char *  name)
+{
+  struct model_name *  mn;
+  size_t len = strlen (name);
+
+  HASH_FIND (hh, m->names, name, len, mn);
+  if (mn)
+    return mn;
+
+  /* The three spellings share one allocation.  */
+  mn = xcalloc (1, sizeof *mn);
+  mn->name = name;
+  mn->lower = xcalloc (3, len + 1);
+  mn->upper = mn->lower + len + 1;
+  mn->capital = mn->upper + len + 1;
+
+  for (size_t i = 0; i < len; i++)
+    {
+      mn->lower[i] = mn->capital[i] = (char) tolower (name[i]);
+      mn->upper[i] = (char) toupper (name[i]);
+    }
+
+  if (len > 0)
+    mn->capital[0] = (char) toupper (mn->capital[0]);
+
+  HASH_ADD_KEYPTR (hh, m->names, mn->name, len, mn);
+  return mn;
+}
+
+
+/* Number of targets in the `targets' field TARGETS.  */
+static inline size_t
+count_targets (yajl_val targets)
+{
+  return YAJL_IS_ARRAY (targets) ? YAJL_ARRAY_LENGTH (targets) : 1;
+}
+
+
+/* Add the number of phases and contains items of the targets TARGETS
+   to N_PHASES and N_CONTAINS.  */
+static void
+count_target_items (yajl_val targets, size_t *  n_phases, size_t *  n_contains)
+{
+  size_t n = count_targets (targets);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      yajl_val target = YAJL_IS_ARRAY (targets)
+                        ? YAJL_ARRAY_VALUES (targets)[i] : targets;
+      yajl_val phases = get (target, "phases", yajl_t_any);
+      yajl_val contains = get (target, "contains", yajl_t_any);
+
+      *n_phases += YAJL_IS_ARRAY (phases) ? YAJL_ARRAY_LENGTH (phases) : 1;
+      *n_contains += YAJL_IS_ARRAY (contains) ? YAJL_ARRAY_LENGTH (contains) : 1;
+    }
+}
+
+
+static void
+build_phase (struct model_phase *  mp, yajl_val phase)
+{
+  if (YAJL_IS_STRING (phase))
+    mp->phase = YAJL_GET_STRING (phase);
+  else
+    {
+      mp->from = YAJL_GET_STRING (get (phase, "from", yajl_t_string));
+      mp->to = YAJL_GET_STRING (get (phase, "to", yajl_t_string));
+    }
+}
+
+
+static void
+build_contains (struct model_contains *  mc, yajl_val contains,
+                struct model_ref *  refs)
+{
+  struct model_ref *  ref;
+
+  mc->name = YAJL_GET_STRING (contains);
+  HASH_FIND_STR (refs, mc->name, ref);
+  if (ref)
+    {
+      mc->node = ref->node;
+      mc->nodeset = ref->nodeset;
+    }
+}
+
+
+/* Fill the targets of a son or an attribute taking the storage from
+   the model M.  */
+static struct model_target *
+build_targets (struct model *  m, yajl_val targets, size_t *  n_targets,
+               struct model_ref *  refs)
+{
+  struct model_target *  res = m->targets;
+
+  *n_targets = count_targets (targets);
+  m->targets += *n_targets;
+
+  for (size_t i = 0; i < *n_targets; i++)
+    {
+      struct model_target *  mt = &res[i];
+      yajl_val target = YAJL_IS_ARRAY (targets)
+                        ? YAJL_ARRAY_VALUES (targets)[i] : targets;
+      yajl_val phases = get (target, "phases", yajl_t_any);
+      yajl_val contains = get (target, "contains", yajl_t_any);
+
+      mt->all_phases_p = YAJL_IS_STRING (phases)
+                         && !strcmp (phases->u.string, "all");
+      mt->phases = m->phases;
+      if (YAJL_IS_ARRAY (phases))
+        {
+          mt->n_phases = YAJL_ARRAY_LENGTH (phases);
+          for (size_t j = 0; j < mt->n_phases; j++)
+            build_phase (&mt->phases[j], YAJL_ARRAY_VALUES (phases)[j]);
+        }
+      else
+        {
+          mt->n_phases = 1;
+          build_phase (&mt->phases[0], phases);
+        }
+      m->phases += mt->n_phases;
+
+      mt->contains_list_p = YAJL_IS_ARRAY (contains);
+      mt->contains = m->contains;
+      if (YAJL_IS_ARRAY (contains))
+        {
+          mt->n_contains = YAJL_ARRAY_LENGTH (contains);
+          for (size_t j = 0; j < mt->n_contains; j++)
+            build_contains (&mt->contains[j], YAJL_ARRAY_VALUES (contains)[j], refs);
+        }
+      else
+        {
+          mt->n_contains = 1;
+          build_contains (&mt->contains[0], contains, refs);
+        }
+      m->contains += mt->n_contains;
+
+      mt->mandatory = YAJL_IS_TRUE (get (target, "mandatory", yajl_t_any));
+    }
+
+  return res;
+}
+
+
+static void
+build_node (struct model *  m, struct model_node *  mn, const char *  name,
+            yajl_val node, struct model_ref *  refs)
+{
+  yajl_val sons = get (node, "sons", yajl_t_object);
+  yajl_val attribs = get (node, "attributes", yajl_t_object);
+  yajl_val flags = get (node, "flags", yajl_t_object);
+  yajl_val checks = get (node, "checks", yajl_t_array);
+
+  mn->name = intern_name (m, name);
+
+  mn->sons = m->sons;
+  mn->n_sons = object_length (sons);
+  m->sons += mn->n_sons;
+  for (size_t i = 0; i < mn->n_sons; i++)
+    {
+      struct model_son *  ms = &mn->sons[i];
+      yajl_val son = YAJL_OBJECT_VALUES (sons)[i];
+
+      ms->name = intern_name (m, YAJL_OBJECT_KEYS (sons)[i]);
+      ms->def = YAJL_GET_STRING (get (son, "default", yajl_t_string));
+      ms->targets = build_targets (m, get (son, "targets", yajl_t_any),
+                                   &ms->n_targets, refs);
+
+      if (!strcmp (ms->name->name, "Next"))
+        mn->next = ms;
+    }
+
+  mn->attributes = m->attributes;
+  mn->n_attributes = object_length (attribs);
+  m->attributes += mn->n_attributes;
+  for (size_t i = 0; i < mn->n_attributes; i++)
+    {
+      struct model_attribute *  ma = &mn->attributes[i];
+      yajl_val attrib = YAJL_OBJECT_VALUES (attribs)[i];
+      const char *  type_name = YAJL_GET_STRING (get (attrib, "type", yajl_t_string));
+      struct attrtype_name *  atn;
+
+      HASH_FIND_STR (attrtype_names, type_name, atn);
+      assert (atn);
+
+      ma->name = intern_name (m, YAJL_OBJECT_KEYS (attribs)[i]);
+      ma->type = atn;
+      ma->def = YAJL_GET_STRING (get (attrib, "default", yajl_t_string));
+      ma->inconstructor = YAJL_IS_TRUE (get (attrib, "inconstructor", yajl_t_any));
+      ma->targets = build_targets (m, get (attrib, "targets", yajl_t_any),
+                                   &ma->n_targets, refs);
+      ma->hot = YAJL_IS_TRUE (get (attrib, "hot", yajl_t_any))
+                || zombie_attribute_p (name, ma->name->name);
+      ma->cold = YAJL_IS_TRUE (get (attrib, "cold", yajl_t_any));
+      mn->n_cold_attributes += ma->cold;
+    }
+
+  mn->flags = m->flags;
+  mn->n_flags = object_length (flags);
+  m->flags += mn->n_flags;
+  for (size_t i = 0; i < mn->n_flags; i++)
+    {
+      struct model_flag *  mf = &mn->flags[i];
+      yajl_val flag = YAJL_OBJECT_VALUES (flags)[i];
+
+      mf->name = intern_name (m, YAJL_OBJECT_KEYS (flags)[i]);
+      mf->def = YAJL_GET_STRING (get (flag, "default", yajl_t_string));
+    }
+
+  mn->checks = m->checks;
+  mn->n_checks = array_length (checks);
+  m->checks += mn->n_checks;
+  for (size_t i = 0; i < mn->n_checks; i++)
+    mn->checks[i] = YAJL_GET_STRING (YAJL_ARRAY_VALUES (checks)[i]);
+
+  mn->reorder = !YAJL_IS_FALSE (get (node, "reorder", yajl_t_any));
+}
+
+
+static enum trav_node_type
+trav_default_type (const char *  def)
+{
+  if (!strcmp (def, "user"))
+    return tnt_user;
+  else if (!strcmp (def, "sons"))
+    return tnt_sons;
+  else if (!strcmp (def, "none"))
+    return tnt_none;
+  else if (!strcmp (def, "error"))
+    return tnt_error;
+  else
+    return tnt_default;
+}
+
+
+static void
+build_traversal (struct model *  m, struct model_traversal *  mt,
+                 const char *  name, yajl_val traversal)
+{
+  struct traversal_name *  tn;
+
+  /* Nodes of the traversal lists are validated and stored in
+     TRAVERSAL_NAMES.  */
+  HASH_FIND_STR (traversal_names, name, tn);
+  assert (tn);
+
+  mt->name = intern_name (m, name);
+  mt->include = YAJL_GET_STRING (get (traversal, "include", yajl_t_string));
+  mt->ifndef = YAJL_GET_STRING (get (traversal, "ifndef", yajl_t_string));
+  mt->prefun = YAJL_GET_STRING (get (traversal, "prefun", yajl_t_string));
+  mt->postfun = YAJL_GET_STRING (get (traversal, "postfun", yajl_t_string));
+  mt->def = YAJL_GET_STRING (get (traversal, "default", yajl_t_string));
+
+  enum trav_node_type def_type = trav_default_type (mt->def);
+
+  mt->node_types = m->trav_node_types;
+  m->trav_node_types += m->n_nodes;
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      struct traversal_node *  trn;
+
+      HASH_FIND_STR (tn->traversal_nodes, m->nodes[i].name->name, trn);
+      mt->node_types[i] = trn ? trn->node_type : def_type;
+    }
+}
+
+
+void
+model_build (struct model *  m, yajl_val ast, yajl_val nodesets,
+             yajl_val traversals)
+{
+  size_t n_sons = 0, n_attributes = 0, n_flags = 0, n_targets = 0;
+  size_t n_phases = 0, n_contains = 0, n_nodeset_nodes = 0, n_checks = 0;
+
+  memset (m, 0, sizeof *m);
+
+  /* Count all the items first, so that every kind of item is allocated
+     in one piece.  */
+  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (ast); i++)
+    {
+      yajl_val node = YAJL_OBJECT_VALUES (ast)[i];
+      yajl_val sons = get (node, "sons", yajl_t_object);
+      yajl_val attribs = get (node, "attributes", yajl_t_object);
+
+      for (size_t j = 0; j < object_length (sons); j++)
+        {
+          yajl_val targets = get (YAJL_OBJECT_VALUES (sons)[j], "targets", yajl_t_any);
+          n_targets += count_targets (targets);
+          count_target_items (targets, &n_phases, &n_contains);
+        }
+
+      for (size_t j = 0; j < object_length (attribs); j++)
+        {
+          yajl_val targets = get (YAJL_OBJECT_VALUES (attribs)[j], "targets", yajl_t_any);
+          n_targets += count_targets (targets);
+          count_target_items (targets, &n_phases, &n_contains);
+        }
+
+      n_sons += object_length (sons);
+      n_attributes += object_length (attribs);
+      n_flags += object_length (get (node, "flags", yajl_t_object));
+      n_checks += array_length (get (node, "checks", yajl_t_array));
+    }
+
+  for (size_t i = 0; i < YAJL_OBJECT_LENGTH (nodesets); i++)
+    n_nodeset_nodes += YAJL_ARRAY_LENGTH (YAJL_OBJECT_VALUES (nodesets)[i]);
+
+  m->n_nodes = YAJL_OBJECT_LENGTH (ast);
+  m->n_nodesets = YAJL_OBJECT_LENGTH (nodesets);
+  m->n_traversals = YAJL_OBJECT_LENGTH (traversals);
+  m->n_attrtypes = HASH_COUNT (attrtype_names);
+
+  m->nodes = xcalloc (m->n_nodes, sizeof *m->nodes);
+  m->nodesets = xcalloc (m->n_nodesets, sizeof *m->nodesets);
+  m->traversals = xcalloc (m->n_traversals, sizeof *m->traversals);
+  m->attrtypes = xcalloc (m->n_attrtypes, sizeof *m->attrtypes);
+  m->sons = xcalloc (n_sons, sizeof *m->sons);
+  m->attributes = xcalloc (n_attributes, sizeof *m->attributes);
+  m->flags = xcalloc (n_flags, sizeof *m->flags);
+  m->targets = xcalloc (n_targets, sizeof *m->targets);
+  m->phases = xcalloc (n_phases, sizeof *m->phases);
+  m->contains = xcalloc (n_contains, sizeof *m->contains);
+  m->nodeset_nodes = xcalloc (n_nodeset_nodes, sizeof *m->nodeset_nodes);
+  m->checks = xcalloc (n_checks, sizeof *m->checks);
+  m->trav_node_types = xcalloc (m->n_traversals * m->n_nodes,
+                                sizeof *m->trav_node_types);
+
+  /* The storage pointers are advanced while the items are filled
+     in and are reset at the end.  */
+  struct model storage = *m;
+
+  /* Nodes and nodesets are resolved by name in `contains'.  */
+  struct model_ref *  refs = NULL;
+  struct model_ref *  ref_storage = xcalloc (m->n_nodes + m->n_nodesets,
+                                             sizeof *ref_storage);
+  struct model_ref *  ref = ref_storage;
+
+  for (size_t i = 0; i < m->n_nodes; i++, ref++)
+    {
+      ref->name = YAJL_OBJECT_KEYS (ast)[i];
+      ref->node = &m->nodes[i];
+      HASH_ADD_KEYPTR (hh, refs, ref->name, strlen (ref->name), ref);
+    }
+
+  for (size_t i = 0; i < m->n_nodesets; i++, ref++)
+    {
+      ref->name = YAJL_OBJECT_KEYS (nodesets)[i];
+      ref->nodeset = &m->nodesets[i];
+      HASH_ADD_KEYPTR (hh, refs, ref->name, strlen (ref->name), ref);
+    }
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    build_node (m, &m->nodes[i], YAJL_OBJECT_KEYS (ast)[i],
+                YAJL_OBJECT_VALUES (ast)[i], refs);
+
+  for (size_t i = 0; i < m->n_nodesets; i++)
+    {
+      struct model_nodeset *  ms = &m->nodesets[i];
+      yajl_val nodes = YAJL_OBJECT_VALUES (nodesets)[i];
+
+      ms->name = intern_name (m, YAJL_OBJECT_KEYS (nodesets)[i]);
+      ms->nodes = m->nodeset_nodes;
+      ms->n_nodes = YAJL_ARRAY_LENGTH (nodes);
+      m->nodeset_nodes += ms->n_nodes;
+
+      for (size_t j = 0; j < ms->n_nodes; j++)
+        {
+          HASH_FIND_STR (refs, YAJL_GET_STRING (YAJL_ARRAY_VALUES (nodes)[j]), ref);
+          assert (ref && ref->node);
+          ms->nodes[j] = ref->node;
+        }
+    }
+
+  for (size_t i = 0; i < m->n_traversals; i++)
+    build_traversal (m, &m->traversals[i], YAJL_OBJECT_KEYS (traversals)[i],
+                     YAJL_OBJECT_VALUES (traversals)[i]);
+
+  struct attrtype_name *  atn;
+  struct attrtype_name *  tmp;
+  size_t i = 0;
+
+  HASH_ITER (hh, attrtype_names, atn, tmp)
+    m->attrtypes[i++] = atn;
+
+  HASH_CLEAR (hh, refs);
+  free (ref_storage);
+
+  storage.names = m->names;
+  *m = storage;
+}
+
+
+void
+model_free (struct model *  m)
+{
+  struct model_name *  mn;
+  struct model_name *  tmp;
+
+  /* All the items of a loaded model live in the snapshot.  */
+  if (m->snapshot)
+    {
+      if (0 != munmap (m->snapshot, m->snapshot_size))
+        err_func (munmap);
+
+      memset (m, 0, sizeof *m);
+      return;
+    }
+
+  HASH_ITER (hh, m->names, mn, tmp)
+    {
+      HASH_DEL (m->names, mn);
+      free (mn->lower);
+      free (mn);
+    }
+
+  free (m->nodes);
+  free (m->nodesets);
+  free (m->traversals);
+  free (m->attrtypes);
+  free (m->sons);
+  free (m->attributes);
+  free (m->flags);
+  free (m->targets);
+  free (m->phases);
+  free (m->contains);
+  free (m->nodeset_nodes);
+  free (m->checks);
+  free (m->trav_node_types);
+  memset (m, 0, sizeof *m);
+}
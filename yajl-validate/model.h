@@ -0,0 +1,226 @@
+#ifndef __MODEL_H__
+#define __MODEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uthash.h"
+
+
+/* The model is a typed view of the validated json files, built once
+   after the validation and shared by all the generators.  Nodes, sons,
+   attributes, flags, targets and traversals are stored in contiguous
+   arrays in the order of the json files; cross references are
+   resolved into pointers.  Strings point into the json trees, so the
+   trees have to outlive the model.  */
+
+
+/* All the spellings of a name used in the generated code.  Names are
+   interned, so every distinct name is converted only once.  */
+struct model_name
+{
+  const char *  name;
+  char *  lower;
+  char *  upper;
+  /* The lower case name with the first letter in upper case.  */
+  char *  capital;
+  UT_hash_handle hh;
+};
+
+
+/* A single phase `phase' or a range of phases `from'--`to'.  */
+struct model_phase
+{
+  const char *  phase;
+  const char *  from;
+  const char *  to;
+};
+
+
+/* An item of the `contains' list of a target.  Neither NODE nor NODESET
+   are set when NAME is `any'.  */
+struct model_contains
+{
+  const char *  name;
+  const struct model_node *  node;
+  const struct model_nodeset *  nodeset;
+};
+
+
+struct model_target
+{
+  /* Set when `phases' is the string `all'.  */
+  bool all_phases_p;
+  struct model_phase *  phases;
+  size_t n_phases;
+
+  /* Set when `contains' was specified as an array.  */
+  bool contains_list_p;
+  struct model_contains *  contains;
+  size_t n_contains;
+
+  bool mandatory;
+};
+
+
+struct model_son
+{
+  const struct model_name *  name;
+  const char *  def;
+  struct model_target *  targets;
+  size_t n_targets;
+};
+
+
+struct model_attribute
+{
+  const struct model_name *  name;
+  const struct attrtype_name *  type;
+  const char *  def;
+  bool inconstructor;
+  struct model_target *  targets;
+  size_t n_targets;
+
+  /* Set by `"hot": true', which keeps the attribute in the node even
+     when an access profile says it is rarely used.  */
+  bool hot;
+
+  /* Whether the attribute lives in the separately allocated block of
+     cold attributes of the node.  */
+  bool cold;
+};
+
+
+struct model_flag
+{
+  const struct model_name *  name;
+  const char *  def;
+};
+
+
+struct model_node
+{
+  const struct model_name *  name;
+
+  struct model_son *  sons;
+  size_t n_sons;
+  /* The son called `Next' or NULL.  */
+  const struct model_son *  next;
+
+  struct model_attribute *  attributes;
+  size_t n_attributes;
+
+  struct model_flag *  flags;
+  size_t n_flags;
+
+  const char **  checks;
+  size_t n_checks;
+
+  /* Whether the attributes may be reordered to reduce padding; cleared
+     by `"reorder": false'.  */
+  bool reorder;
+
+  /* The number of attributes with COLD set.  */
+  size_t n_cold_attributes;
+};
+
+
+struct model_nodeset
+{
+  const struct model_name *  name;
+  const struct model_node **  nodes;
+  size_t n_nodes;
+};
+
+
+struct model_traversal
+{
+  const struct model_name *  name;
+  const char *  include;
+  const char *  ifndef;
+  const char *  prefun;
+  const char *  postfun;
+
+  /* The function for every node of the model, including the default
+     of the traversal.  TNT_DEFAULT means that the function is DEFAULT.  */
+  enum trav_node_type *  node_types;
+  const char *  def;
+};
+
+
+struct model
+{
+  struct model_node *  nodes;
+  size_t n_nodes;
+
+  struct model_nodeset *  nodesets;
+  size_t n_nodesets;
+
+  struct model_traversal *  traversals;
+  size_t n_traversals;
+
+  /* Attribute types in the order of the attribute types file.  */
+  const struct attrtype_name **  attrtypes;
+  size_t n_attrtypes;
+
+  /* Storage for the items of all the nodes and traversals.  */
+  struct model_son *  sons;
+  struct model_attribute *  attributes;
+  struct model_flag *  flags;
+  struct model_target *  targets;
+  struct model_phase *  phases;
+  struct model_contains *  contains;
+  const struct model_node **  nodeset_nodes;
+  const char **  checks;
+  enum trav_node_type *  trav_node_types;
+
+  struct model_name *  names;
+
+  /* The mapping of the snapshot the model was loaded from, if any.  */
+  void *  snapshot;
+  size_t snapshot_size;
+};
+
+
+/* Build the model from the validated json trees.  */
+void model_build (struct model *  m, yajl_val ast, yajl_val nodesets,
+                  yajl_val traversals);
+
+
+/* Free the model M.  */
+void model_free (struct model *  m);
+
+
+/* The initial value for MODEL_HASH.  */
+#define MODEL_HASH_INIT UINT64_C (0xcbf29ce484222325)
+
+
+/* FNV-1a hash of SIZE bytes of DATA continuing from the hash H.  */
+uint64_t model_hash (uint64_t h, const void *  data, size_t size);
+
+
+/* The version of the tool followed by a hash of its binary, so that the
+   state of one build of the tool is never reused by another.  */
+const char *  tool_version ();
+
+
+/* Compute the key of a model snapshot from the tool version and the
+   content of the N input files FNAMES.  Returns FALSE if any of the
+   files cannot be read.  */
+bool model_snapshot_key (const char *const *  fnames, size_t n, uint64_t *  key);
+
+
+/* Write the model M into the file FNAME as a snapshot with the key KEY.
+   The snapshot is a single block where pointers are stored as offsets
+   from its beginning.  */
+bool model_snapshot_save (const struct model *  m, const char *  fname,
+                          uint64_t key);
+
+
+/* Map the snapshot FNAME and relocate it into the model M.  Returns
+   FALSE if the file does not exist or its key is not KEY.  */
+bool model_snapshot_load (struct model *  m, const char *  fname, uint64_t key);
+
+
+#endif // __MODEL_H__
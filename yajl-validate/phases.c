@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "json.h"
+#include "phases.h"
+
+
+bool
+phases_load (struct phase_order *  po, const char *  fname)
+{
+  yajl_val v = json_load (fname);
+  bool ok = true;
+
+  memset (po, 0, sizeof (*po));
+
+  if (!v)
+    return false;
+
+  if (!YAJL_IS_ARRAY (v) || YAJL_ARRAY_LENGTH (v) == 0)
+    {
+      ab_err ("top-level node of `%s' must be a non-empty array", fname);
+      json_free (v);
+      return false;
+    }
+
+  po->phases = calloc (YAJL_ARRAY_LENGTH (v), sizeof (*po->phases));
+  if (!po->phases)
+    err_func (calloc);
+
+  for (size_t i = 0; i < YAJL_ARRAY_LENGTH (v); i++)
+    {
+      const yajl_val x = YAJL_ARRAY_VALUES (v)[i];
+      const char *  name = YAJL_IS_STRING (x) ? YAJL_GET_STRING (x) : NULL;
+      struct phase_name *  p;
+
+      if (!name)
+        {
+          ab_err ("the item #%zu of `%s' must be a string", i + 1, fname);
+          ok = false;
+          continue;
+        }
+
+      HASH_FIND_STR (po->index, name, p);
+      if (p)
+        {
+          ab_err ("the phase `%s' is listed twice in `%s'", p->name, fname);
+          ok = false;
+          continue;
+        }
+
+      p = &po->phases[po->n_phases];
+      if (!(p->name = strdup (name)))
+        err_func (strdup);
+
+      p->index = po->n_phases++;
+      HASH_ADD_KEYPTR (hh, po->index, p->name, strlen (p->name), p);
+    }
+
+  json_free (v);
+
+  if (!ok)
+    phases_free (po);
+
+  return ok;
+}
+
+
+/* Find the index of the phase NAME of the target #TARGET of the son or
+   the attribute FIELD of NODE.  */
+static bool
+phase_index (const struct phase_order *  po, const char *  name,
+             const char *  node, const char *  field, bool son_p,
+             size_t target, size_t *  index)
+{
+  struct phase_name *  p;
+
+  HASH_FIND_STR (po->index, name, p);
+  if (!p)
+    {
+      ab_err ("target #%zu of %s `%s' of node `%s' refers to the phase `%s' "
+              "that is not in the phase list",
+              target + 1, son_p ? "son" : "attribute", field, node, name);
+      return false;
+    }
+
+  *index = p->index;
+  return true;
+}
+
+
+/* Check the targets of the son or the attribute FIELD of NODE.  */
+static bool
+phases_check_targets (const struct phase_order *  po, const char *  node,
+                      const char *  field, bool son_p,
+                      const struct model_target *  targets, size_t n_targets)
+{
+  /* The target that applies in each phase, or SIZE_MAX.  */
+  size_t owner[po->n_phases];
+  /* The phases of the current target.  */
+  bool mine[po->n_phases];
+  bool ok = true;
+
+  for (size_t i = 0; i < po->n_phases; i++)
+    owner[i] = SIZE_MAX;
+
+  for (size_t i = 0; i < n_targets; i++)
+    {
+      const struct model_target *  t = &targets[i];
+      size_t n_mine = 0;
+      size_t n_taken = 0;
+      size_t taken = SIZE_MAX;
+
+      /* A target for all phases is the only one, see validate-nodes.c.  */
+      if (t->all_phases_p)
+        continue;
+
+      for (size_t k = 0; k < po->n_phases; k++)
+        mine[k] = false;
+
+      for (size_t j = 0; j < t->n_phases; j++)
+        {
+          const struct model_phase *  p = &t->phases[j];
+          size_t from, to;
+
+          if (p->phase)
+            {
+              if (!phase_index (po, p->phase, node, field, son_p, i, &from))
+                {
+                  ok = false;
+                  continue;
+                }
+              to = from + 1;
+            }
+          else if (!phase_index (po, p->from, node, field, son_p, i, &from)
+                   || !phase_index (po, p->to, node, field, son_p, i, &to))
+            {
+              ok = false;
+              continue;
+            }
+          else if (from > to)
+            {
+              ab_err ("target #%zu of %s `%s' of node `%s' has the range of "
+                      "phases from `%s' to `%s' that ends before it starts",
+                      i + 1, son_p ? "son" : "attribute", field, node,
+                      p->from, p->to);
+              ok = false;
+              continue;
+            }
+          /* Such ranges exist in ast.json; they never apply, so they
+             do not make the checks stricter than intended.  */
+          else if (from == to)
+            ab_warn ("target #%zu of %s `%s' of node `%s' has the empty range "
+                     "of phases from `%s' to `%s'",
+                     i + 1, son_p ? "son" : "attribute", field, node,
+                     p->from, p->to);
+
+          for (size_t k = from; k < to; k++)
+            mine[k] = true;
+        }
+
+      for (size_t k = 0; k < po->n_phases; k++)
+        if (mine[k])
+          {
+            n_mine++;
+            if (owner[k] != SIZE_MAX)
+              {
+                if (n_taken++ == 0)
+                  taken = k;
+              }
+            else
+              owner[k] = i;
+          }
+
+      /* The first target that applies in a phase wins, so a target whose
+         phases are all covered by earlier ones is dead.  Such targets
+         exist in ast.json and are harmless.  A partial overlap makes the
+         target apply in fewer phases than it says, so it is an error.  */
+      if (n_taken != 0 && n_taken == n_mine)
+        ab_warn ("target #%zu of %s `%s' of node `%s' never applies, as "
+                 "earlier targets cover all of its phases",
+                 i + 1, son_p ? "son" : "attribute", field, node);
+      else if (n_taken != 0)
+        {
+          ab_err ("targets #%zu and #%zu of %s `%s' of node `%s' both "
+                  "apply in the phase `%s'",
+                  owner[taken] + 1, i + 1, son_p ? "son" : "attribute",
+                  field, node, po->phases[taken].name);
+          ok = false;
+        }
+    }
+
+  return ok;
+}
+
+
+bool
+phases_check (const struct model *  m, const struct phase_order *  po)
+{
+  bool ok = true;
+
+  for (size_t i = 0; i < m->n_nodes; i++)
+    {
+      const struct model_node *  node = &m->nodes[i];
+
+      for (size_t j = 0; j < node->n_sons; j++)
+        ok &= phases_check_targets (po, node->name->name,
+                                    node->sons[j].name->name, true,
+                                    node->sons[j].targets,
+                                    node->sons[j].n_targets);
+
+      for (size_t j = 0; j < node->n_attributes; j++)
+        ok &= phases_check_targets (po, node->name->name,
+                                    node->attributes[j].name->name, false,
+                                    node->attributes[j].targets,
+                                    node->attributes[j].n_targets);
+    }
+
+  return ok;
+}
+
+
+void
+phases_target_mask (const struct phase_order *  po,
+                    const struct model_target *  target,
+                    unsigned char *  mask)
+{
+  if (target->all_phases_p)
+    {
+      for (size_t i = 0; i < po->n_phases; i++)
+        mask[i / 8] |= 1u << (i % 8);
+      return;
+    }
+
+  for (size_t i = 0; i < target->n_phases; i++)
+    {
+      const struct model_phase *  p = &target->phases[i];
+      struct phase_name *  from;
+      struct phase_name *  to = NULL;
+
+      HASH_FIND_STR (po->index, p->phase ? p->phase : p->from, from);
+      if (!p->phase)
+        HASH_FIND_STR (po->index, p->to, to);
+
+      assert (from && (p->phase || to));
+      for (size_t k = from->index; k < (to ? to->index : from->index + 1); k++)
+        mask[k / 8] |= 1u << (k % 8);
+    }
+}
+
+
+void
+phases_free (struct phase_order *  po)
+{
+  HASH_CLEAR (hh, po->index);
+
+  for (size_t i = 0; i < po->n_phases; i++)
+    free (po->phases[i].name);
+
+  free (po->phases);
+  memset (po, 0, sizeof (*po));
+}
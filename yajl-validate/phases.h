@@ -0,0 +1,64 @@
+#ifndef __PHASES_H__
+#define __PHASES_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "uthash.h"
+#include "model.h"
+
+
+/* A phase of sac2c and its value in the `compiler_phase_t' enum.  */
+struct phase_name
+{
+  char *  name;
+  size_t index;
+  UT_hash_handle hh;
+};
+
+
+/* The phases of sac2c in the order of the `compiler_phase_t' enum, as
+   given by the phase list file.  */
+struct phase_order
+{
+  /* The names without the PH_ prefix, indexed by the value of the
+     phase.  */
+  struct phase_name *  phases;
+  size_t n_phases;
+
+  struct phase_name *  index;
+};
+
+
+/* The order of the phases given with --phases, or NULL.  */
+extern struct phase_order *  phase_order;
+
+
+/* The size of a mask over the phases of PO.  */
+#define PHASE_MASK_BYTES(__po) (((__po)->n_phases + 7) / 8)
+
+
+/* Load the phase list FNAME, a json array of the names of the phases in
+   the order of the `compiler_phase_t' enum of sac2c, starting with
+   `initial' and ending with `final'.  It stands in for phase_info.mac,
+   which the enum is generated from.  */
+bool phases_load (struct phase_order *  po, const char *  fname);
+
+
+/* Check that every phase of the targets of M is in PO, that ranges are
+   not empty and that the targets of a son or an attribute do not apply
+   in the same phase.  */
+bool phases_check (const struct model *  m, const struct phase_order *  po);
+
+
+/* Set the bits of the phases in which TARGET applies in MASK of
+   PHASE_MASK_BYTES bytes.  The phases of TARGET must be in PO.  */
+void phases_target_mask (const struct phase_order *  po,
+                         const struct model_target *  target,
+                         unsigned char *  mask);
+
+
+void phases_free (struct phase_order *  po);
+
+
+#endif // __PHASES_H__
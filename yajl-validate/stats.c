@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <regex.h>
+#include <yajl/yajl_tree.h>
+
+#include "ast-builder.h"
+#include "stats.h"
+
+
+bool stats_enabled = false;
+
+__thread size_t stats_bytes = 0;
+
+
+/* The number of allocations made by the current thread.  */
+static __thread size_t stats_allocs = 0;
+
+
+/* Allocations are only counted in builds with -DAB_ALLOC_STATS, which
+   replaces the allocation functions of the process.  This relies on
+   glibc: its internal allocations use the replacement as well, so those
+   of memory streams are counted too, and __libc_* gives the original
+   functions.  */
+#ifdef AB_ALLOC_STATS
+#  ifndef __GLIBC__
+#    error AB_ALLOC_STATS needs glibc
+#  endif
+
+extern void *  __libc_malloc (size_t size);
+extern void *  __libc_calloc (size_t n, size_t size);
+extern void *  __libc_realloc (void *  p, size_t size);
+extern void *  __libc_memalign (size_t align, size_t size);
+
+void *
+malloc (size_t size)
+{
+  stats_allocs++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  stats_allocs++;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *  p, size_t size)
+{
+  stats_allocs++;
+  return __libc_realloc (p, size);
+}
+
+void *
+reallocarray (void *  p, size_t n, size_t size)
+{
+  if (size != 0 && n > SIZE_MAX / size)
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  return realloc (p, n * size);
+}
+
+void *
+aligned_alloc (size_t align, size_t size)
+{
+  stats_allocs++;
+  return __libc_memalign (align, size);
+}
+
+void *
+memalign (size_t align, size_t size)
+{
+  stats_allocs++;
+  return __libc_memalign (align, size);
+}
+
+int
+posix_memalign (void **  p, size_t align, size_t size)
+{
+  void *  x;
+
+  if (align < sizeof (void *) || (align & (align - 1)) != 0)
+    return EINVAL;
+
+  stats_allocs++;
+  if (!(x = __libc_memalign (align, size)))
+    return ENOMEM;
+
+  *p = x;
+  return 0;
+}
+
+#  define ALLOC_STATS_P true
+#else
+#  define ALLOC_STATS_P false
+#endif
+
+
+/* Finished phases in the order they were stopped.  */
+static struct stats_phase *  phases = NULL;
+static size_t n_phases = 0;
+static size_t cap_phases = 0;
+static pthread_mutex_t phases_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static inline double
+elapsed_ms (const struct timespec *  start, const struct timespec *  end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e3
+         + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+
+void
+stats_start (struct stats_phase *  p, const char *  name, bool thread_p)
+{
+  if (!stats_enabled)
+    return;
+
+  memset (p, 0, sizeof (*p));
+  p->name = strdup (name);
+  p->thread_p = thread_p;
+  p->allocs_start = stats_allocs;
+  stats_bytes = 0;
+  clock_gettime (CLOCK_MONOTONIC, &p->wall_start);
+  clock_gettime (thread_p ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID,
+                 &p->cpu_start);
+}
+
+
+void
+stats_stop (struct stats_phase *  p)
+{
+  struct timespec wall, cpu;
+  struct rusage ru;
+
+  if (!stats_enabled)
+    return;
+
+  clock_gettime (p->thread_p ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID,
+                 &cpu);
+  clock_gettime (CLOCK_MONOTONIC, &wall);
+
+  p->wall_ms = elapsed_ms (&p->wall_start, &wall);
+  p->cpu_ms = elapsed_ms (&p->cpu_start, &cpu);
+  p->allocs = stats_allocs - p->allocs_start;
+  p->bytes = stats_bytes;
+
+  /* The peak is the one of the process up to the end of the phase.  */
+  if (0 != getrusage (RUSAGE_SELF, &ru))
+    err_func (getrusage);
+  p->max_rss_kb = ru.ru_maxrss;
+
+  pthread_mutex_lock (&phases_lock);
+  if (n_phases == cap_phases)
+    {
+      cap_phases = cap_phases ? 2 * cap_phases : 64;
+      if (!(phases = realloc (phases, cap_phases * sizeof (*phases))))
+        err_func (realloc);
+    }
+  phases[n_phases++] = *p;
+  pthread_mutex_unlock (&phases_lock);
+}
+
+
+/* Print S as a json string.  */
+static void
+print_json_string (FILE *  f, const char *  s)
+{
+  fputc ('"', f);
+  for (; *s; s++)
+    if (*s == '"' || *s == '\\')
+      fprintf (f, "\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      fprintf (f, "\\u%04x", *s);
+    else
+      fputc (*s, f);
+  fputc ('"', f);
+}
+
+
+void
+stats_report (FILE *  f, bool json_p)
+{
+  if (!stats_enabled)
+    return;
+
+  if (json_p)
+    {
+      fprintf (f, "{\n  \"allocs_counted\": %s,\n  \"phases\": [",
+               ALLOC_STATS_P ? "true" : "false");
+      for (size_t i = 0; i < n_phases; i++)
+        {
+          const struct stats_phase *  p = &phases[i];
+
+          fprintf (f, "%s\n    {\"name\": ", i == 0 ? "" : ",");
+          print_json_string (f, p->name);
+          fprintf (f, ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                      "\"max_rss_kb\": %ld, \"allocs\": %zu, \"bytes\": %zu}",
+                   p->wall_ms, p->cpu_ms, p->max_rss_kb, p->allocs, p->bytes);
+        }
+      fprintf (f, "\n  ]\n}\n");
+    }
+  else
+    {
+      fprintf (f, "%-44s %10s %10s %10s %8s %9s\n",
+               "phase", "wall ms", "cpu ms", "maxrss KB", "allocs", "bytes");
+      for (size_t i = 0; i < n_phases; i++)
+        {
+          const struct stats_phase *  p = &phases[i];
+
+          fprintf (f, "%-44s %10.3f %10.3f %10ld ", p->name, p->wall_ms,
+                   p->cpu_ms, p->max_rss_kb);
+          if (ALLOC_STATS_P)
+            fprintf (f, "%8zu ", p->allocs);
+          else
+            fprintf (f, "%8s ", "-");
+          if (p->bytes)
+            fprintf (f, "%9zu\n", p->bytes);
+          else
+            fprintf (f, "%9s\n", "-");
+        }
+    }
+
+  for (size_t i = 0; i < n_phases; i++)
+    free (phases[i].name);
+
+  free (phases);
+  phases = NULL;
+  n_phases = cap_phases = 0;
+}
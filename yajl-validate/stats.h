@@ -0,0 +1,55 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+
+/* Measurements of one phase of the run: reading a json file, one of
+   the validations or generating one file.  */
+struct stats_phase
+{
+  char *  name;
+
+  /* When set, the CPU time is measured for the current thread only,
+     as other threads run their own phases at the same time.  */
+  bool thread_p;
+
+  struct timespec wall_start;
+  struct timespec cpu_start;
+  size_t allocs_start;
+
+  double wall_ms;
+  double cpu_ms;
+  long max_rss_kb;
+  size_t allocs;
+
+  /* The size of the generated file or 0 for other phases.  */
+  size_t bytes;
+};
+
+
+/* Set when the statistics are collected.  */
+extern bool stats_enabled;
+
+
+/* The number of bytes written by GEN_CLOSE_FILE in the current thread.  */
+extern __thread size_t stats_bytes;
+
+
+/* Start measuring the phase P called NAME.  */
+void stats_start (struct stats_phase *  p, const char *  name, bool thread_p);
+
+
+/* Finish measuring the phase P and add it to the report.  */
+void stats_stop (struct stats_phase *  p);
+
+
+/* Print all the phases into F as a table, or as a json object when
+   JSON_P is set, and free them.  */
+void stats_report (FILE *  f, bool json_p);
+
+
+#endif // __STATS_H__
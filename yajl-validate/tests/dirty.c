@@ -0,0 +1,166 @@
+/* The driver of the test `dirty_tracking' of run.py, linked with the files
+   generated for the small model with AST_DIRTY_TRACKING.
+
+   After two checks of a clean tree, the traversal MUT drops the
+   statements of the assignments through the plain accessor ASSIGN_STMT.
+   The next check has to report the missing sons.  A check in another
+   phase has to report them again, although nothing has been written
+   since the last check.  */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "tree_basic.h"
+#include "traverse.h"
+#include "traverse_tables.h"
+#include "traverse_helper.h"
+#include "check.h"
+#include "check_lib.h"
+#include "globals.h"
+#include "mutate.h"
+
+global_t global;
+
+/* The missing mandatory sons reported and the nodes visited by the
+   running check.  */
+static int missing;
+static int visited;
+
+node *
+CHKinsertError (node *error, char *message)
+{
+  (void) message;
+  return error;
+}
+
+node *
+CHKexistSon (node *son, node *father, char *message)
+{
+  (void) father;
+  (void) message;
+
+  if (son == NULL)
+    missing++;
+
+  return son;
+}
+
+intptr_t
+CHKexistAttribute (intptr_t attribute, node *father, char *message)
+{
+  (void) father;
+  (void) message;
+  return attribute;
+}
+
+intptr_t
+CHKnotExist (intptr_t son_attribute, node *arg_node, char *message)
+{
+  (void) arg_node;
+  (void) message;
+  return son_attribute;
+}
+
+node *
+CHKcorrectTypeInsertError (node *arg_node, char *message)
+{
+  (void) message;
+  return arg_node;
+}
+
+static trav_t travstack[8];
+static size_t travdepth = 0;
+
+void
+TRAVpush (trav_t traversal)
+{
+  travstack[travdepth++] = traversal;
+}
+
+trav_t
+TRAVpop (void)
+{
+  return travstack[--travdepth];
+}
+
+node *
+TRAVdo (node *arg_node, info *arg_info)
+{
+  trav_t trav = travstack[travdepth - 1];
+
+  if (trav == TR_chk)
+    visited++;
+
+  return TRAVTABLE_FUN (trav, NODE_TYPE (arg_node)) (arg_node, arg_info);
+}
+
+node *
+MUTassign (node *arg_node, info *arg_info)
+{
+  ASSIGN_STMT (arg_node) = NULL;
+  return TRAVsons (arg_node, arg_info);
+}
+
+/* Check MODULE and compare the number of missing sons with EXPECTED.  */
+static int
+check (node *module, const char *what, int expected)
+{
+  missing = 0;
+  visited = 0;
+  CHKdoTreeCheck (module);
+
+  printf ("%s: %d missing, %d visited\n", what, missing, visited);
+  if (missing != expected)
+    {
+      printf ("%s: expected %d missing\n", what, expected);
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+main (void)
+{
+  node *module;
+  int full;
+  int failed = 0;
+
+  global.local_funs_grouped = TRUE;
+  global.compiler_anyphase = PH_a;
+
+  module = TBmakeModule (
+             TBmakeFundef ("f",
+                           TBmakeBlock (TBmakeAssign (TBmakeNum (1),
+                                                      TBmakeAssign (TBmakeNum (2),
+                                                                    NULL))),
+                           TBmakeFundef ("g",
+                                         TBmakeBlock (TBmakeAssign (TBmakeNum (3),
+                                                                    NULL)),
+                                         NULL)));
+
+  failed |= check (module, "new tree", 0);
+  full = visited;
+
+  /* Clean subtrees are left out, so the check below is not a full one
+     by accident.  */
+  failed |= check (module, "clean tree", 0);
+  if (visited >= full)
+    {
+      printf ("clean tree: all %d nodes visited\n", visited);
+      failed = 1;
+    }
+
+  TRAVpush (TR_mut);
+  module = TRAVdo (module, NULL);
+  TRAVpop ();
+
+  failed |= check (module, "statements dropped", 3);
+  failed |= check (module, "same phase", 0);
+
+  global.compiler_anyphase = PH_b;
+  failed |= check (module, "next phase", 3);
+
+  return failed;
+}
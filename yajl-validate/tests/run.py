@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+#
+# Run the tests of the ast-builder.
+#
+# Every test writes a model into a temporary directory, runs the
+# ast-builder on it into a temporary stand-in for SAC2CBASE, and checks
+# its exit status, its messages and the generated files.
+#
+# phases.json is an order of the phases of sac2c that is consistent with
+# the ranges of the targets in ast.json.  It stands in for the list that
+# is generated from phase_info.mac in a sac2c tree.
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+HERE = os.path.dirname (os.path.abspath (__file__))
+
+# The directory of ast.json and the other json files of sac2c.
+ROOT = os.path.join (HERE, "..", "..")
+
+# The directories of sac2c where the files are generated.
+GEN_DIRS = ["tree", "types", "global", "serialize"]
+
+# The stubs of the headers of sac2c that the generated files include.
+STUBS = os.path.join (HERE, "sac2c")
+
+# The json files of a model.
+MODEL_FILES = ["ast.json", "attrtypes.json", "nodesets.json", "traversals.json"]
+
+
+class Failure (Exception):
+    pass
+
+
+def fail (s):
+    raise Failure (s)
+
+
+def target (contains, phases="all", mandatory=False):
+    return {"phases": phases, "contains": contains, "mandatory": mandatory}
+
+
+def small_model ():
+    """A model with a module of functions made of assignments of numbers,
+    small enough to compile the generated files against a few stubs."""
+    attrtypes = {
+        "Node": {"copy": "function", "ctype": "node*", "init": "NULL"},
+        "String": {"copy": "function", "ctype": "char*", "init": "NULL"},
+        "Int": {"copy": "literal", "ctype": "int", "init": "0", "vtype": "int"},
+    }
+
+    ast = {
+        "Module": {
+            "description": ["A module."],
+            "sons": {"Funs": {"targets": target ("Fundef")}},
+        },
+        "Fundef": {
+            "description": ["A function."],
+            "sons": {
+                "Body": {"targets": target ("Block")},
+                "Next": {"targets": target ("Fundef")},
+            },
+            "attributes": {
+                "Name": {"type": "String", "inconstructor": True,
+                         "targets": target ("any", mandatory=True)},
+            },
+        },
+        "Block": {
+            "description": ["The body of a function."],
+            "sons": {"Assigns": {"targets": target ("Assign")}},
+        },
+        "Assign": {
+            "description": ["An assignment."],
+            "sons": {
+                "Stmt": {"targets": target ("Num", mandatory=True)},
+                "Next": {"targets": target ("Assign")},
+            },
+        },
+        "Num": {
+            "description": ["A number."],
+            "attributes": {
+                "Value": {"type": "Int", "inconstructor": True,
+                          "targets": target ("any")},
+            },
+        },
+    }
+
+    traversals = {
+        "CHK": {"name": "Check the Tree", "include": "check.h", "default": "user"},
+    }
+
+    return {"ast.json": ast, "attrtypes.json": attrtypes,
+            "nodesets.json": {}, "traversals.json": traversals}
+
+
+class Run:
+    """A run of the ast-builder in the directory ROOT."""
+
+    def __init__ (self, builder, root, model):
+        self.builder = builder
+        self.model = os.path.join (root, "model")
+        self.work = os.path.join (self.model, "work")
+        self.base = os.path.join (root, "sac2c")
+        self.libsac2c = os.path.join (self.base, "src", "libsac2c")
+
+        os.makedirs (self.work)
+        for d in GEN_DIRS + ["stub"]:
+            os.makedirs (os.path.join (self.libsac2c, d))
+
+        for fname in MODEL_FILES:
+            with open (os.path.join (self.model, fname), "w") as f:
+                json.dump (model[fname], f, indent=4)
+
+        # Every traversal has to provide its include file.
+        for t in model["traversals.json"].values ():
+            with open (os.path.join (self.libsac2c, "stub", t["include"]), "w") as f:
+                f.write ("/* Stub.  */\n")
+
+    def __call__ (self, *args):
+        cmd = [self.builder, "--sac2cbase", self.base] + list (args)
+        p = subprocess.run (cmd, cwd=self.work, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+        self.cmd = " ".join (cmd)
+        self.returncode = p.returncode
+        self.stderr = p.stderr
+        return self
+
+    def succeeded (self):
+        if self.returncode != 0:
+            fail ("`%s' failed:\n%s" % (self.cmd, self.stderr))
+
+    def failed (self):
+        if self.returncode == 0:
+            fail ("`%s' succeeded" % self.cmd)
+
+    def reported (self, s):
+        if s not in self.stderr:
+            fail ("`%s' did not report `%s':\n%s" % (self.cmd, s, self.stderr))
+
+    def generated (self, fname):
+        with open (os.path.join (self.libsac2c, fname)) as f:
+            return f.read ()
+
+
+def real_model ():
+    model = {}
+    for fname in MODEL_FILES:
+        with open (os.path.join (ROOT, fname)) as f:
+            model[fname] = json.load (f)
+    return model
+
+
+def write_phases (run, phases):
+    fname = os.path.join (run.model, "phases.json")
+    with open (fname, "w") as f:
+        json.dump (phases, f)
+    return fname
+
+
+# The phases of the small model.
+SMALL_PHASES = ["initial", "a", "b", "c", "final"]
+
+
+def test_phase_list (builder, root):
+    """The targets of ast.json fit the phase list, and the tree checker
+    gets a mask of phases for every target."""
+    run = Run (builder, root, real_model ())
+    run ("--phases", os.path.join (HERE, "phases.json")).succeeded ()
+    if "chk_phase_masks" not in run.generated ("tree/check.c"):
+        fail ("check.c has no masks of phases")
+
+
+def test_subsumed_target (builder, root):
+    """A target whose phases are all covered by earlier targets is only
+    reported."""
+    model = small_model ()
+    model["ast.json"]["Assign"]["sons"]["Stmt"]["targets"] = [
+        target ("Num", {"from": "a", "to": "final"}, True),
+        target ("Num", ["b"]),
+    ]
+
+    run = Run (builder, root, model)
+    run ("--phases", write_phases (run, SMALL_PHASES)).succeeded ()
+    run.reported ("target #2 of son `Stmt' of node `Assign' never applies, "
+                  "as earlier targets cover all of its phases")
+
+
+def test_overlapping_targets (builder, root):
+    """Targets that apply in some but not all of the same phases are an
+    error."""
+    model = small_model ()
+    model["ast.json"]["Assign"]["sons"]["Stmt"]["targets"] = [
+        target ("Num", {"from": "a", "to": "c"}, True),
+        target ("Num", {"from": "b", "to": "final"}),
+    ]
+
+    run = Run (builder, root, model)
+    run ("--phases", write_phases (run, SMALL_PHASES)).failed ()
+    run.reported ("targets #1 and #2 of son `Stmt' of node `Assign' both "
+                  "apply in the phase `b'")
+
+
+def test_dirty_tracking (builder, root):
+    """With AST_DIRTY_TRACKING, a son dropped through a plain accessor in a
+    traversal is reported by the next check, and the first check in
+    another phase checks every node.  The generated files are compiled
+    against the stubs in STUBS with the driver dirty.c."""
+    model = small_model ()
+    model["traversals.json"]["MUT"] = {
+        "name": "Mutate", "include": "mutate.h", "default": "sons",
+        "travuser": ["Assign"],
+    }
+
+    run = Run (builder, root, model)
+    run ().succeeded ()
+
+    tree = os.path.join (run.libsac2c, "tree")
+    exe = os.path.join (root, "dirty")
+    cmd = [os.environ.get ("CC", "cc"), "-std=gnu99", "-DAST_DIRTY_TRACKING",
+           "-I", STUBS, "-I", tree, "-I", os.path.join (run.libsac2c, "types"),
+           "-o", exe, os.path.join (HERE, "dirty.c")]
+    cmd += [os.path.join (tree, f) for f in ["node_basic.c", "check.c",
+                                             "traverse_tables.c",
+                                             "traverse_helper.c"]]
+
+    for c in [cmd, [exe]]:
+        p = subprocess.run (c, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            universal_newlines=True)
+        if p.returncode != 0:
+            fail ("`%s' failed:\n%s" % (" ".join (c), p.stdout))
+
+
+TESTS = [
+    test_phase_list,
+    test_subsumed_target,
+    test_overlapping_targets,
+    test_dirty_tracking,
+]
+
+
+def main ():
+    ap = argparse.ArgumentParser (description="Run the tests of the ast-builder.")
+    ap.add_argument ("--builder", default=os.path.join (HERE, "..", "ast-builder"),
+                     help="the ast-builder binary")
+    ap.add_argument ("--keep", action="store_true",
+                     help="keep the directories of the tests")
+    ap.add_argument ("tests", nargs="*",
+                     help="the names of the tests to run, all by default")
+    args = ap.parse_args ()
+
+    builder = os.path.abspath (args.builder)
+    if not os.access (builder, os.X_OK):
+        print ("error: cannot execute `%s'" % builder, file=sys.stderr)
+        sys.exit (1)
+
+    names = [t.__name__[len ("test_"):] for t in TESTS]
+    for name in args.tests:
+        if name not in names:
+            print ("error: unknown test `%s'" % name, file=sys.stderr)
+            sys.exit (1)
+
+    failed = 0
+    for t, name in zip (TESTS, names):
+        if args.tests and name not in args.tests:
+            continue
+
+        root = tempfile.mkdtemp (prefix="ast-builder-test-")
+        try:
+            t (builder, root)
+            print ("PASS %s" % name)
+        except Failure as e:
+            print ("FAIL %s: %s" % (name, e))
+            failed += 1
+        finally:
+            if args.keep:
+                print ("kept `%s'" % root, file=sys.stderr)
+            else:
+                shutil.rmtree (root)
+
+    sys.exit (1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main ()
@@ -0,0 +1,14 @@
+#ifndef _SAC_CHECK_LIB_H_
+#define _SAC_CHECK_LIB_H_
+
+#include <stdint.h>
+
+#include "types.h"
+
+extern node *CHKinsertError (node *error, char *message);
+extern node *CHKexistSon (node *son, node *father, char *message);
+extern intptr_t CHKexistAttribute (intptr_t attribute, node *father, char *message);
+extern intptr_t CHKnotExist (intptr_t son_attribute, node *arg_node, char *message);
+extern node *CHKcorrectTypeInsertError (node *arg_node, char *message);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _SAC_CHECK_MEM_H_
+#define _SAC_CHECK_MEM_H_
+
+#define CHKMisNode(__node, __type) ((void) 0)
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _SAC_CTINFO_H_
+#define _SAC_CTINFO_H_
+
+#include <stdlib.h>
+
+#define CTIwarn(...) ((void) 0)
+#define CTIabortOutOfMemory(__size) abort ()
+
+#endif
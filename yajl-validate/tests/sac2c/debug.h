@@ -0,0 +1,12 @@
+#ifndef _SAC_DEBUG_H_
+#define _SAC_DEBUG_H_
+
+#include <assert.h>
+
+#define DBUG_ENTER()
+#define DBUG_RETURN(x) return x
+#define DBUG_PRINT(...)
+#define DBUG_ASSERT(c, ...) assert (c)
+#define DBUG_UNREACHABLE(...) abort ()
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef _SAC_FREE_INFO_H_
+#define _SAC_FREE_INFO_H_
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SAC_GLOBALS_H_
+#define _SAC_GLOBALS_H_
+
+#include "types.h"
+
+extern global_t global;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _SAC_MEMORY_H_
+#define _SAC_MEMORY_H_
+
+#include <stdlib.h>
+
+#define MEMmalloc malloc
+#define MEMmallocAt(__size, __file, __line) malloc (__size)
+#define MEMfree(x) (free (x), NULL)
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _SAC_MUTATE_H_
+#define _SAC_MUTATE_H_
+
+#include "types.h"
+
+/* The handler of the traversal MUT of tests/dirty.c.  */
+extern node *MUTassign (node *arg_node, info *arg_info);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SAC_PHASE_INFO_H_
+#define _SAC_PHASE_INFO_H_
+
+#include "types.h"
+
+extern const char *PHIphaseIdent (compiler_phase_t phase);
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef _SAC_STR_H_
+#define _SAC_STR_H_
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _SAC_TRAVERSE_H_
+#define _SAC_TRAVERSE_H_
+
+#include "types.h"
+
+extern node *TRAVdo (node *arg_node, info *arg_info);
+extern void TRAVpush (trav_t traversal);
+extern trav_t TRAVpop (void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _SAC_TRAVERSE_HELPER_H_
+#define _SAC_TRAVERSE_HELPER_H_
+
+#include "types.h"
+
+extern node *TRAVnone (node *arg_node, info *arg_info);
+extern node *TRAVerror (node *arg_node, info *arg_info);
+extern node *TRAVsons (node *arg_node, info *arg_info);
+extern int TRAVnumSons (node *node);
+extern node *TRAVgetSon (int no, node *parent);
+
+#endif
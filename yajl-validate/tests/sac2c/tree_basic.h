@@ -0,0 +1,32 @@
+#ifndef _SAC_TREE_BASIC_H_
+#define _SAC_TREE_BASIC_H_
+
+#include <stdio.h>
+
+#include "types.h"
+#include "sons.h"
+#include "attribs.h"
+
+struct NODE
+{
+  nodetype mnodetype;
+  char *file;
+  size_t line;
+  size_t col;
+  node *error;
+  bool checkvisited;
+  union SONUNION sons;
+  union ATTRIBUNION attribs;
+};
+
+#define NODE_TYPE(n) ((n)->mnodetype)
+#define NODE_FILE(n) ((n)->file)
+#define NODE_LINE(n) ((n)->line)
+#define NODE_COL(n) ((n)->col)
+#define NODE_ERROR(n) ((n)->error)
+#define NODE_CHECKVISITED(n) ((n)->checkvisited)
+#define NODE_TEXT(n) (global.mdb_nodetype[NODE_TYPE (n)])
+
+#include "node_basic.h"
+
+#endif
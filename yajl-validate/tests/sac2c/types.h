@@ -0,0 +1,41 @@
+/* The types of sac2c used by the generated files of the small model of
+   tests/run.py.  */
+
+#ifndef _SAC_TYPES_H_
+#define _SAC_TYPES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRUE true
+#define FALSE false
+
+typedef struct NODE node;
+typedef struct INFO info;
+
+#include "types_nodetype.h"
+#include "types_trav.h"
+
+typedef node *(*travfun_p) (node *, info *);
+
+/* The phases of SMALL_PHASES in tests/run.py.  */
+typedef enum
+{
+  PH_initial,
+  PH_a,
+  PH_b,
+  PH_c,
+  PH_final
+} compiler_phase_t;
+
+typedef struct
+{
+  char *filename;
+  size_t linenum;
+  size_t colnum;
+  compiler_phase_t compiler_anyphase;
+  bool local_funs_grouped;
+  const char *mdb_nodetype[MAX_NODES + 1];
+} global_t;
+
+#endif
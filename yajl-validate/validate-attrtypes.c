@@ -13,7 +13,9 @@ attrtype_field_allowed_p (const char *  x)
          || !strcmp (x, "vtype")
          || !strcmp (x, "copy")
          || !strcmp (x, "init")
-         || !strcmp (x, "persist");
+         || !strcmp (x, "persist")
+         || !strcmp (x, "size")
+         || !strcmp (x, "align");
 }
 
 
@@ -69,6 +71,8 @@ load_attrtype_names (yajl_val attrtypes, const char *  fname)
       const yajl_val vtype = yajl_tree_get (attrtype, (const char *[]){"vtype", 0}, yajl_t_string);
       const yajl_val init = yajl_tree_get (attrtype, (const char *[]){"init", 0}, yajl_t_string);
       const yajl_val persist = yajl_tree_get (attrtype, (const char *[]){"persist", 0}, yajl_t_any);
+      const yajl_val size = yajl_tree_get (attrtype, (const char *[]){"size", 0}, yajl_t_any);
+      const yajl_val align = yajl_tree_get (attrtype, (const char *[]){"align", 0}, yajl_t_any);
 
       /* Check that the `copy' attribute exists.  */
       enum attrtype_copy_type copy_type;
@@ -112,6 +116,35 @@ load_attrtype_names (yajl_val attrtypes, const char *  fname)
 
       const char *  vtype_name = vtype ? YAJL_GET_STRING (vtype) : NULL;
 
+      /* Check that `size' and `align' are given together, that both are
+         positive integers, that the alignment is a power of two and that
+         the size is a multiple of the alignment, as for any C type.  */
+      if (!size != !align)
+        {
+          ab_err ("attrtype `%s' must specify both `size' and `align' or none of them",
+                  name);
+          return false;
+        }
+
+      if (size && (!YAJL_IS_INTEGER (size) || YAJL_GET_INTEGER (size) <= 0))
+        {
+          ab_err ("`size' of attrtype `%s' must be a positive integer", name);
+          return false;
+        }
+
+      if (align && (!YAJL_IS_INTEGER (align) || YAJL_GET_INTEGER (align) <= 0
+                    || (YAJL_GET_INTEGER (align) & (YAJL_GET_INTEGER (align) - 1))))
+        {
+          ab_err ("`align' of attrtype `%s' must be a power of two", name);
+          return false;
+        }
+
+      if (size && YAJL_GET_INTEGER (size) % YAJL_GET_INTEGER (align))
+        {
+          ab_err ("`size' of attrtype `%s' must be a multiple of its `align'", name);
+          return false;
+        }
+
       assert (name && ctype_name && init_name);
       atn = malloc (sizeof *atn);
       atn->name = strdup (name);
@@ -120,6 +153,8 @@ load_attrtype_names (yajl_val attrtypes, const char *  fname)
       atn->vtype = vtype_name ? strdup (vtype_name) : NULL;
       atn->init = strdup (init_name);
       atn->persist = persist && YAJL_IS_FALSE (persist) ? false : true;
+      atn->size = size ? YAJL_GET_INTEGER (size) : 0;
+      atn->align = align ? YAJL_GET_INTEGER (align) : 0;
       HASH_ADD_KEYPTR (hh, attrtype_names, atn->name,
                        strlen (atn->name), atn);
     }
@@ -16,7 +16,8 @@ node_field_allowed_p (const char *  x)
          || !strcmp (x, "sons")
          || !strcmp (x, "flags")
          || !strcmp (x, "attributes")
-         || !strcmp (x, "checks");
+         || !strcmp (x, "checks")
+         || !strcmp (x, "reorder");
 }
 
 static inline bool
@@ -26,7 +27,9 @@ attribute_field_allowed_p (const char *  x)
          || !strcmp (x, "inconstructor")
          || !strcmp (x, "type")
          || !strcmp (x, "targets")
-         || !strcmp (x, "default");
+         || !strcmp (x, "default")
+         || !strcmp (x, "hot")
+         || !strcmp (x, "cold");
 }
 
 static inline bool
@@ -375,6 +378,32 @@ validate_attribute (const char *  node_name, const char *  attr_name, const yajl
       return false;
     }
 
+  /* Check that hot and cold are boolean and not both set.  */
+  const yajl_val hot = yajl_tree_get (attribute, (const char *[]){"hot", 0}, yajl_t_any);
+  const yajl_val cold = yajl_tree_get (attribute, (const char *[]){"cold", 0}, yajl_t_any);
+  if ((hot && !YAJL_IS_TRUE (hot) && !YAJL_IS_FALSE (hot))
+      || (cold && !YAJL_IS_TRUE (cold) && !YAJL_IS_FALSE (cold)))
+    {
+      ab_err ("`hot' and `cold' fields of attribute `%s' of node `%s' must be "
+              "of type boolean", attr_name, node_name);
+      return false;
+    }
+
+  if (YAJL_IS_TRUE (hot) && YAJL_IS_TRUE (cold))
+    {
+      ab_err ("attribute `%s' of node `%s' cannot be both hot and cold",
+              attr_name, node_name);
+      return false;
+    }
+
+  /* Zombie fundefs keep these attributes after the cold block is freed.  */
+  if (YAJL_IS_TRUE (cold) && zombie_attribute_p (node_name, attr_name))
+    {
+      ab_err ("attribute `%s' of node `%s' is kept by zombie fundefs and "
+              "cannot be cold", attr_name, node_name);
+      return false;
+    }
+
   /* Check that the type of the attribute is valid.  */
   const yajl_val type = yajl_tree_get (attribute, (const char *[]){"type", 0}, yajl_t_string);
   if (!type)
@@ -622,6 +651,13 @@ validate_ast (const yajl_val ast)
             return false;
         }
 
+      const yajl_val reorder = yajl_tree_get (node, (const char *[]){"reorder", 0}, yajl_t_any);
+      if (reorder && !YAJL_IS_TRUE (reorder) && !YAJL_IS_FALSE (reorder))
+        {
+          ab_err ("`reorder' field of node `%s' must be of type boolean", name);
+          return false;
+        }
+
       const yajl_val checks = yajl_tree_get (node, (const char *[]){"checks", 0}, yajl_t_any);
       if (checks)
         if (!YAJL_IS_ARRAY (checks))
@@ -80,6 +80,34 @@ traversal_validate_nodes (yajl_val traversal, const char *  nodelist_name,
   return true;
 }
 
+/* Check that the file INCLUDE of the traversal NAME is either generated
+   or exists in SAC2CBASE.  */
+bool
+validate_traversal_include (const char *  name, const char *  include)
+{
+  /* Check if `include' is generated file.  */
+  for (size_t j = 0; j < f_max; j++)
+    {
+      char *  p = strrchr (gen_file_pathes[j], '/');
+      if (p && !strcmp (p+1, include))
+        return true;
+    }
+
+  /* Check that the include file exists, in case the
+     file is not autogenerated.  */
+  const char *  p = "/src/libsac2c";
+  char path[strlen (sac2cbase) + strlen (p) + 1];
+  sprintf (path, "%s%s", sac2cbase, p);
+  if (!find_file (path, include))
+    {
+      ab_err ("file `%s' included in the traversal `%s' not found",
+              include, name);
+      return false;
+    }
+
+  return true;
+}
+
 /*  We validate that:
 
        1. The top-level json in the traversals is object
@@ -148,33 +176,8 @@ load_and_validate_traversals (yajl_val traversals, const char *  fname)
           return false;
         }
       
-      const char *  include_str = YAJL_GET_STRING (include);
-
-      /* Check if `include' is generated file.  */
-      bool generated_file_p = false;
-      for (size_t j = 0; j < f_max; j++)
-        {
-          char *  p = strrchr (gen_file_pathes[j], '/');
-          if (p && !strcmp (p+1, include_str))
-            {
-              generated_file_p = true;
-              break;
-            }
-        }
-
-      /* Check that the include file exists, in case the 
-         file is not autogenerated.  */
-      const char *  p = "/src/libsac2c";
-      char path[strlen (sac2cbase) + strlen (p) + 1];
-      sprintf (path, "%s%s", sac2cbase, p);
-      if (!generated_file_p && !find_file (path, include_str))
-        {
-
-          ab_err ("file `%s' included in the traversal `%s' not found",
-                  YAJL_GET_STRING (include), name);
-
-          return false;
-        }
+      if (!validate_traversal_include (name, YAJL_GET_STRING (include)))
+        return false;
 
       HASH_FIND_STR (traversal_names, name, tn);
       if (tn)
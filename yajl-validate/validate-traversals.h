@@ -3,6 +3,7 @@
 
 
 bool load_and_validate_traversals (yajl_val traversals, const char *  fname);
+bool validate_traversal_include (const char *  name, const char *  include);
 void traversal_names_free ();
 
 